@@ -31,6 +31,7 @@
 #include "../nodecpp/common.h"
 #include "q_based_infrastructure.h"
 #include "inproc_queue.h"
+#include "../nodecpp/thread_placement.h"
 
 extern InterThreadCommData threadQueues[MAX_THREADS];
 
@@ -43,6 +44,7 @@ void nodeThreadMain( void* pdata )
 	NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, pdata != nullptr ); 
 	ThreadStartupDataT startupData = *sd;
 	nodecpp::stddealloc( sd, 1 );
+	placement::placeThisThread( placement::Role::Worker ); // before the node's allocator is initialized
 	QueueBasedNodeLoop<NodeT> r( startupData );
 	r.init();
 	r.run();
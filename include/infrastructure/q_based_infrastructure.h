@@ -112,6 +112,7 @@ struct InfraNodeWrapper
 	using NodeT = Node;
 	static constexpr bool has_global_mq_message_handler = has_global_mq_message_handler_call<NodeT, nodecpp::platform::internal_msg::InternalMsg>;
 	static constexpr bool has_infrastructure_message_handler = has_infrastructure_message_handler_call<NodeT, NodeAddress, nodecpp::platform::internal_msg::InternalMsg>;
+	static constexpr bool has_broadcast_message_handler = has_broadcast_message_handler_call<NodeT>;
 	NlsT nls;
 #ifdef NODECPP_USE_IIBMALLOC
 		nodecpp::iibmalloc::ThreadLocalAllocatorT allocManager;
@@ -264,6 +265,15 @@ public:
 						throw std::exception(); // unexpected / unhandled message type
 					break;
 				}
+				case InterThreadMsgType::Broadcast:
+				{
+					// the payload is shared with other recipients and must be treated as read-only
+					if constexpr ( NodeType::has_broadcast_message_handler )
+						node.node->onBroadcastMessage( thq->sourceThreadID, thq->obj );
+					else
+						throw std::exception(); // unexpected / unhandled message type
+					break;
+				}
 				default:
 					throw std::exception(); // unexpected
 			}
@@ -33,6 +33,7 @@
 #ifndef NODECPP_NO_COROUTINES
 
 #include <experimental/coroutine>
+#include "metrics.h"
 
 #define CO_RETURN co_return
 
@@ -113,20 +114,30 @@ struct promise_type_struct_base {
 		return std::experimental::suspend_never{};
     }
 
+	// frames are accounted as metrics::MemCategory::CoroutineFrames (the sized form of delete is what frames are freed with, if present)
 #if (defined NODECPP_MEMORY_SAFETY) && (NODECPP_MEMORY_SAFETY == 0)
 	void* operator new  ( std::size_t count ) { 
 		uint8_t* ret = reinterpret_cast<uint8_t*>( safememory::detail::allocate(count + NODECPP_MAX_SUPPORTED_ALIGNMENT_FOR_NEW) );
 		*reinterpret_cast<uint16_t*>( ret ) = nodecpp::iibmalloc::g_CurrentAllocManager ? nodecpp::iibmalloc::g_CurrentAllocManager->allocatorID() : 0;
+		nodecpp::metrics::chargeMemory( nodecpp::metrics::MemCategory::CoroutineFrames, count );
 		return ret + NODECPP_MAX_SUPPORTED_ALIGNMENT_FOR_NEW;
 	}
-	void operator delete ( void* ptr ) { 
+	void operator delete ( void* ptr, std::size_t count ) { 
+		nodecpp::metrics::chargeMemory( nodecpp::metrics::MemCategory::CoroutineFrames, -(int64_t)count );
 		uint8_t* delptr = reinterpret_cast<uint8_t*>( ptr ) - NODECPP_MAX_SUPPORTED_ALIGNMENT_FOR_NEW;
 		uint16_t allocatorID = *reinterpret_cast<uint16_t*>( delptr );
 		safememory::detail::deallocate( delptr, allocatorID );
 	}
 #else
-	void* operator new  ( std::size_t count ) { return safememory::detail::allocate(count); }
-	void operator delete ( void* ptr ) { safememory::detail::deallocate(ptr); }
+	void* operator new  ( std::size_t count ) {
+		void* ret = safememory::detail::allocate(count);
+		nodecpp::metrics::chargeMemory( nodecpp::metrics::MemCategory::CoroutineFrames, count );
+		return ret;
+	}
+	void operator delete ( void* ptr, std::size_t count ) {
+		nodecpp::metrics::chargeMemory( nodecpp::metrics::MemCategory::CoroutineFrames, -(int64_t)count );
+		safememory::detail::deallocate(ptr);
+	}
 #endif
 };
 
@@ -345,6 +356,56 @@ inline void dbg_awaitingNotPlannedReturnedValueOfNoInterest( awaitable<void>& p
 
 
 
+// a coroutine waiting in a queue (such as nodecpp::vector<awaitable_handle_t>) is resumed by resumeAll() on that queue
+template<class QueueT>
+auto a_waitAt( QueueT& queue ) { 
+
+	struct queue_awaiter {
+		std::experimental::coroutine_handle<> myawaiting = nullptr;
+		QueueT& queue;
+
+		queue_awaiter(QueueT& queue_) : queue( queue_ ) {}
+
+		queue_awaiter(const queue_awaiter &) = delete;
+		queue_awaiter &operator = (const queue_awaiter &) = delete;
+
+		~queue_awaiter() {}
+
+		bool await_ready() {
+			return false;
+		}
+
+		void await_suspend(std::experimental::coroutine_handle<> awaiting) {
+			nodecpp::initCoroData(awaiting);
+			queue.push_back( awaiting );
+			myawaiting = awaiting;
+		}
+
+		auto await_resume() {
+			NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, myawaiting != nullptr ); 
+			if ( nodecpp::isCoroException(myawaiting) )
+				throw nodecpp::getCoroException(myawaiting);
+		}
+	};
+	return queue_awaiter(queue);
+}
+
+// in the order of waiting; coroutines that start waiting meanwhile are left for the next call
+template<class QueueT>
+void resumeAll( QueueT& queue, bool withException )
+{
+	if ( queue.empty() )
+		return;
+	QueueT handles = std::move( queue );
+	queue.clear();
+	for ( auto hr : handles )
+	{
+		if ( withException )
+			nodecpp::setCoroException(hr, std::exception()); // TODO: switch to our exceptions ASAP!
+		hr();
+	}
+}
+
 template<class ... T>
 auto wait_for_all( nodecpp::awaitable<T>& ... calls ) -> nodecpp::awaitable<std::tuple<typename nodecpp::void_type_converter<T>::type...>>
 {
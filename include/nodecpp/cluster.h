@@ -52,6 +52,17 @@ namespace nodecpp
 		Port uport;
 	};
 
+	struct ConnMigratedEvMsg // followed by readSize bytes of unread data and writeSize bytes of pending data
+	{
+		uint16_t serverPort;
+		uintptr_t socket;
+		Ip4 ip;
+		Port uport;
+		size_t readSize;
+		size_t writeSize;
+	};
+	static constexpr size_t maxMigratedBufferedBytes = 2048; // a message is expected to fit a single page
+
 	struct ServerErrorEvMsg
 	{
 		size_t requestID;
@@ -103,6 +114,8 @@ namespace nodecpp
 		static constexpr size_t invalidID = (size_t)(-1);
 		friend class Cluster;
 		size_t id_ = invalidID;
+		ThreadID threadID_;
+		bool retiring_ = false;
 		uint16_t portToMaster = 0;
 		Worker() {}
 		void setID( size_t id ) { 
@@ -118,9 +131,21 @@ namespace nodecpp
 		Worker(Worker&& other) {
 			id_ = other.id_;
 			other.id_ = invalidID;
+			threadID_ = other.threadID_;
+			retiring_ = other.retiring_;
 			ctrlServer = std::move( other.ctrlServer );
 		}
+		Worker& operator = (Worker&& other) {
+			id_ = other.id_;
+			other.id_ = invalidID;
+			threadID_ = other.threadID_;
+			retiring_ = other.retiring_;
+			ctrlServer = std::move( other.ctrlServer );
+			return *this;
+		}
 		size_t id() const { return id_; }
+		ThreadID threadID() const { return threadID_; }
+		bool isRetiring() const { return retiring_; }
 		void disconnect();
 	};
 
@@ -134,6 +159,48 @@ namespace nodecpp
 	public:
 		static constexpr size_t InvalidThreadID = (size_t)(-1);
 
+		// MasterAcceptor: connections are accepted by the master (or listener threads) and handed off to workers
+		// ReusePortPerWorker: each worker binds its own SO_REUSEPORT listener and the kernel spreads connections;
+		//                     if this is not possible for a given server, it falls back to MasterAcceptor
+		enum class ListeningMode { MasterAcceptor, ReusePortPerWorker };
+		// how listener threads pick a worker for an accepted connection (MasterAcceptor mode)
+		// LeastLoaded and PowerOfTwoChoices compare per-worker scores built from loop busy ratio, queued events, bytes/s and connection count
+		enum class WorkerSelection { RoundRobin, LeastLoaded, PowerOfTwoChoices, ConsistentHashByIp };
+		struct ListeningOptions
+		{
+			ListeningMode mode = ListeningMode::MasterAcceptor;
+			bool steerByCpu = false; // Linux only: attach a classic BPF program selecting the listener of the worker pinned to the receiving CPU
+			WorkerSelection workerSelection = WorkerSelection::PowerOfTwoChoices;
+		};
+
+		// the master may add and retire workers by their average event loop utilization (see autoscaleIfDue());
+		// a retired worker migrates connections opted in by the app, waits for the rest to close, and exits; its thread slot is reused
+		struct ElasticPoolOptions
+		{
+			bool enabled = false;
+			size_t minWorkers = 1;
+			size_t maxWorkers = 0; // 0: number of hardware threads
+			uint32_t scaleUpPermille = 800; // average busy ratio sustained above this adds a worker...
+			uint32_t scaleDownPermille = 300; // ...and sustained below this retires one
+			uint64_t sustainMs = 5000;
+			uint64_t cooldownMs = 30000; // minimal interval between two consecutive actions
+			uint64_t drainTimeoutMs = 30000; // connections of a retiring worker still there by then are closed
+		};
+		static constexpr uint64_t retirementGraceMks = 1000000; // hand-offs selected just before retirement may still be in flight
+
+	private:
+		static inline ListeningOptions listeningOptions; // set at master before forking; read-only afterwards
+		static inline ElasticPoolOptions elasticPoolOptions; // same
+		struct AutoscaleState
+		{
+			uint64_t lastCheck = 0;
+			uint64_t aboveSince = 0;
+			uint64_t belowSince = 0;
+			uint64_t lastAction = 0;
+		};
+		AutoscaleState autoscaleState; // master only
+		uint64_t retirementStartedAt = 0; // worker only; non-zero once retiring
+
 	private:
 		class MasterProcessor
 		{
@@ -143,26 +210,21 @@ namespace nodecpp
 
 			static void sendListeningEv( ThreadID targetThreadId, size_t requestID )
 			{
-				ListeningEvMsg msg;
-				msg.requestID = requestID;
-
-				nodecpp::platform::internal_msg::InternalMsg imsg;
-				imsg.append( &msg, sizeof(msg) );
-				postInterThreadMsg( std::move( imsg ), InterThreadMsgType::ServerListening, targetThreadId );
+				InterThreadObj obj = makeInterThreadObj<ListeningEvMsg>();
+				obj.get<ListeningEvMsg>()->requestID = requestID;
+				tryPostInterThreadMsg( std::move( obj ), InterThreadMsgType::ServerListening, targetThreadId );
 			}
 
 			static void sendConnAcceptedEv( ThreadID targetThreadId, size_t internalID, size_t requestID, uintptr_t socket, Ip4& remoteIp, Port& remotePort )
 			{
-				ConnAcceptedEvMsg msg;
-				msg.requestID = requestID;
-				msg.serverIdx = internalID;
-				msg.socket = socket;
-				msg.ip = remoteIp;
-				msg.uport = remotePort;
-
-				nodecpp::platform::internal_msg::InternalMsg imsg;
-				imsg.append( &msg, sizeof(msg) );
-				postInterThreadMsg( std::move( imsg ), InterThreadMsgType::ConnAccepted, targetThreadId );
+				InterThreadObj obj = makeInterThreadArray<ConnAcceptedEvMsg>( 1 );
+				ConnAcceptedEvMsg* msg = obj.get<ConnAcceptedEvMsg>();
+				msg->requestID = requestID;
+				msg->serverIdx = internalID;
+				msg->socket = socket;
+				msg->ip = remoteIp;
+				msg->uport = remotePort;
+				tryPostInterThreadMsg( std::move( obj ), InterThreadMsgType::ConnAccepted, targetThreadId );
 			}
 
 			static void sendServerErrorEv( ThreadID targetThreadId, size_t requestID, Error e )
@@ -173,7 +235,7 @@ namespace nodecpp
 
 				nodecpp::platform::internal_msg::InternalMsg imsg;
 				imsg.append( &msg, sizeof(msg) );
-				postInterThreadMsg( std::move( imsg ), InterThreadMsgType::ServerError, targetThreadId );
+				tryPostInterThreadMsg( std::move( imsg ), InterThreadMsgType::ServerError, targetThreadId );
 			}
 
 			static void deserializeListeningRequestBody( nodecpp::net::Address& addr, int& backlog, nodecpp::platform::internal_msg::InternalMsg::ReadIter& riter, size_t bodySz ) {
@@ -199,7 +261,7 @@ namespace nodecpp
 
 				nodecpp::platform::internal_msg::InternalMsg imsg;
 				imsg.append( &msg, sizeof(msg) );
-				postInterThreadMsg( std::move( imsg ), InterThreadMsgType::ServerClosedNotification, targetThreadId );
+				tryPostInterThreadMsg( std::move( imsg ), InterThreadMsgType::ServerClosedNotification, targetThreadId );
 			}
 
 		public:
@@ -218,6 +280,12 @@ namespace nodecpp
 //						NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, mh.assignedThreadID != Cluster::InvalidThreadID ); 
 					break;
 				}
+				case InterThreadMsgType::ThreadTerminate:
+				{
+					nodecpp::log::default_log::info( nodecpp::log::ModuleID(nodecpp::nodecpp_module_id), "MasterSocket: processing ThreadTerminate({}) notification (for thread id: {})", (size_t)(msgtype), requestingThreadId.slotId );
+					onWorkerExited( requestingThreadId );
+					break;
+				}
 				case InterThreadMsgType::ServerListening:
 				{
 					NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, sizeof( ListeningRequestMsg ) <= sz, "{} vs. {}", sizeof( ListeningRequestMsg ), sz ); 
@@ -297,18 +365,23 @@ namespace nodecpp
 		private:
 			size_t assignedThreadID;
 			size_t requestIdBase = 0;
+			nodecpp::stdvector<std::pair<size_t, size_t>> listeningRequests; // requestID and entryIndex, until the master reports listening
 
 			void sendListeningRequest( size_t entryIndex, Ip4 ip, uint16_t port, IPFAMILY family, int backlog)
 			{
-				Cluster::serializeAndSendListeningRequest( ThreadID({0,0}), ++requestIdBase, entryIndex, ip, port, backlog, family );
+				listeningRequests.push_back( std::make_pair( ++requestIdBase, entryIndex ) );
+				Cluster::serializeAndSendListeningRequest( ThreadID({0,0}), requestIdBase, entryIndex, ip, port, backlog, family );
 			}
 
+			void onListeningReported( size_t requestID ); // the slave server that has made the request emits 'listening'
+
 			void sendServerCloseRequest( size_t entryIndex )
 			{
 				Cluster::serializeAndSendServerCloseRequest( ThreadID({0,0}), ++requestIdBase, entryIndex );
 			}
 
 			nodecpp::handler_ret_type processResponse( ThreadID requestingThreadId, InterThreadMsgType msgType, nodecpp::platform::internal_msg::InternalMsg::ReadIter& riter );
+			nodecpp::handler_ret_type processTypedResponse( ThreadID requestingThreadId, InterThreadMsgType msgType, InterThreadObj& obj );
 
 		public:
 			nodecpp::handler_ret_type reportThreadStarted()
@@ -327,6 +400,11 @@ namespace nodecpp
 			public:
 			nodecpp::handler_ret_type onInterthreadMessage( InterThreadMsg& msg )
 			{
+				if ( msg.obj )
+				{
+					processTypedResponse( msg.sourceThreadID, msg.msgType, msg.obj );
+					CO_RETURN;
+				}
 				// NOTE: in present quick-and-dirty implementation we assume that the message total size is less than a single page
 				auto riter = msg.msg.getReadIter();
 				processResponse( msg.sourceThreadID, msg.msgType, riter );
@@ -374,6 +452,9 @@ namespace nodecpp
 		public:
 			nodecpp::handler_ret_type onListening() { 
 				nodecpp::log::default_log::info( nodecpp::log::ModuleID(nodecpp::nodecpp_module_id),"clustering Agent server: onListening()!");
+				// slaves that have joined later are reported right away (see processRequestForListeningAtMaster())
+				for ( auto& slaveData : socketsToSlaves )
+					MasterProcessor::sendListeningEv( slaveData.targetThreadId, requestID );
 
 				CO_RETURN;
 			}
@@ -470,30 +551,35 @@ namespace nodecpp
 			nodecpp::soft_ptr<AgentServer> server = createAgentServer();
 			server->requestID = requestID;
 			server->socketsToSlaves.push_back( slaveData );
+			auto listeners = getListeners();
 #ifdef NODECPP_USE_SHARED_SOCKS_FOR_LISTENERS
-			server->dataForCommandProcessing.localAddress.ip = address.ip;
-			server->dataForCommandProcessing.localAddress.port = address.port;
-			server->dataForCommandProcessing.localAddress.family = address.family;
-			server->dataForCommandProcessing.state = nodecpp::Cluster::AgentServer::DataForCommandProcessing::State::Listening;
+			bool sharded = true;
+#elif defined _MSC_VER || defined __MINGW32__
+			bool sharded = false;
 #else
-			server->listen( address.port, address.ip, backlog );
+			// with several listener threads each of them owns its own SO_REUSEPORT shard (instead of all polling a single socket)
+			bool sharded = listeners.second > 1 && address.port != 0;
 #endif // NODECPP_USE_SHARED_SOCKS_FOR_LISTENERS
+			if ( sharded )
+			{
+				server->dataForCommandProcessing.localAddress.ip = address.ip;
+				server->dataForCommandProcessing.localAddress.port = address.port;
+				server->dataForCommandProcessing.localAddress.family = address.family;
+				server->dataForCommandProcessing.state = nodecpp::Cluster::AgentServer::DataForCommandProcessing::State::Listening;
+			}
+			else
+				server->listen( address.port, address.ip, backlog );
 			nodecpp::log::default_log::info( nodecpp::log::ModuleID(nodecpp::nodecpp_module_id), "processRequestForListeningAtMaster(): new Agent Server for Addr {}:{}, and RequestID {}", server->dataForCommandProcessing.localAddress.ip.toStr(), server->dataForCommandProcessing.localAddress.port, server->requestID );
 
 			// now, unless an error happened, we have a socket alredy good for polling
 			RequestToListenerThread rq;
-#ifdef NODECPP_USE_SHARED_SOCKS_FOR_LISTENERS
-			rq.type = RequestToListenerThread::Type::CreateSharedServerSocket;
-#else
-			rq.type = RequestToListenerThread::Type::AddServerSocket;
-#endif // NODECPP_USE_SHARED_SOCKS_FOR_LISTENERS
+			rq.type = sharded ? RequestToListenerThread::Type::CreateSharedServerSocket : RequestToListenerThread::Type::AddServerSocket;
 			rq.entryIndex = entryIndex;
 			rq.ip = address.ip;
 			rq.port = Port::fromHost( address.port );
 			rq.backlog = backlog;
 			rq.socket = server->dataForCommandProcessing.osSocket;
 
-			auto listeners = getListeners();
 			for ( size_t i=0; i<listeners.second; ++i )
 			{
 nodecpp::log::default_log::info( nodecpp::log::ModuleID(nodecpp::nodecpp_module_id), "sending CreateSharedServerSocket request (for thread id: {}), entryIndex = {:x}, ip = {} port: {}", listeners.first[ i ].threadID.slotId, rq.entryIndex, rq.ip.toStr(), rq.port.toStr() );
@@ -579,6 +665,33 @@ nodecpp::log::default_log::info( nodecpp::log::ModuleID(nodecpp::nodecpp_module_
 		Cluster(Cluster&&) = delete;
 		Cluster& operator = (Cluster&&) = delete;
 
+		void setListeningOptions( ListeningOptions opts ) {
+			NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, isMaster() );
+			NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, workers_.size() == 0, "must be set before forking; indeed: {} workers", workers_.size() );
+#if defined _MSC_VER || defined __MINGW32__
+			opts.mode = ListeningMode::MasterAcceptor; // SO_REUSEADDR on Windows does not balance connections
+#endif
+			listeningOptions = opts;
+		}
+		static const ListeningOptions& getListeningOptions() { return listeningOptions; }
+
+		void setElasticPoolOptions( ElasticPoolOptions opts ) {
+			NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, isMaster() );
+			elasticPoolOptions = opts;
+		}
+		static const ElasticPoolOptions& getElasticPoolOptions() { return elasticPoolOptions; }
+		void autoscaleIfDue( uint64_t nowMks );
+		bool retire( Worker& worker );
+		void onWorkerExited( ThreadID id );
+
+		void beginRetirement( uint64_t nowMks ) { 
+			NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, isWorker() );
+			if ( retirementStartedAt == 0 )
+				retirementStartedAt = nowMks;
+		}
+		bool isRetiring() const { return retirementStartedAt != 0; }
+		uint64_t getRetirementStartedAt() const { return retirementStartedAt; }
+
 		bool isMaster() const { return thisThreadWorker.id() == 0; }
 		bool isWorker() const { return thisThreadWorker.id() != 0; }
 		const nodecpp::vector<Worker>& workers() const { return workers_; }
@@ -101,6 +101,21 @@ namespace nodecpp
 	using awaitable_handle_t = void (*)();
 #endif
 
+	// code behind an awaitable handle, for attribution purposes only (see metrics::HandlerScope)
+	inline const void* coroutineOrigin( awaitable_handle_t h ) {
+#ifndef NODECPP_NO_COROUTINES
+		if ( !h )
+			return nullptr;
+#if defined(__GNUC__) || defined(__clang__)
+		return *reinterpret_cast<void* const*>( h.address() ); // with both gcc and clang a coroutine frame starts with a pointer to its resume function
+#else
+		return h.address();
+#endif
+#else
+		return reinterpret_cast<const void*>( h );
+#endif // NODECPP_NO_COROUTINES
+	}
+
 #ifndef NODECPP_NO_COROUTINES
 	handler_ret_type a_timeout(uint32_t ms);
 	handler_ret_type a_sleep(uint32_t ms);
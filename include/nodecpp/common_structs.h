@@ -29,6 +29,7 @@
 #define COMMON_STRUCTS_H
 
 #include "common.h"
+#include "metrics.h"
 #include <map>
 #include <typeinfo>
 #include <typeindex>
@@ -43,6 +44,7 @@ namespace nodecpp {
 		size_t _size = 0;
 		size_t _capacity = 0;
 		std::unique_ptr<uint8_t[]> _data;
+		nodecpp::metrics::MemCategory _memCategory = nodecpp::metrics::currentMemCategory(); // see setMemCategory()
 
 	private:
 		void ensureCapacity(size_t sz) { // NOTE: may invalidate pointers
@@ -53,6 +55,7 @@ namespace nodecpp {
 				size_t cp = std::max(sz, MIN_BUFFER);
 				std::unique_ptr<uint8_t[]> tmp(new uint8_t[cp]);
 				memcpy(tmp.get(), _data.get(), _size);
+				nodecpp::metrics::chargeMemory( _memCategory, (int64_t)cp - (int64_t)_capacity );
 				_capacity = cp;
 				_data = std::move(tmp);
 			}
@@ -65,15 +68,31 @@ namespace nodecpp {
 			std::swap(_size, p._size);
 			std::swap(_capacity, p._capacity);
 			std::swap(_data, p._data);
+			std::swap(_memCategory, p._memCategory);
 		}
 		Buffer& operator = (Buffer&& p) {
 			std::swap(_size, p._size);
 			std::swap(_capacity, p._capacity);
 			std::swap(_data, p._data);
+			std::swap(_memCategory, p._memCategory);
 			return *this;
 		}
 		Buffer(const Buffer&) = delete;
 		Buffer& operator = (const Buffer& p) = delete;
+		~Buffer() {
+			if ( _capacity != 0 )
+				nodecpp::metrics::chargeMemory( _memCategory, -(int64_t)_capacity );
+		}
+
+		// by default, memory of a buffer is accounted under the category of the scope it has been created in (see metrics::MemoryCategoryScope)
+		void setMemCategory( nodecpp::metrics::MemCategory cat ) {
+			if ( _capacity != 0 )
+			{
+				nodecpp::metrics::chargeMemory( _memCategory, -(int64_t)_capacity );
+				nodecpp::metrics::chargeMemory( cat, _capacity );
+			}
+			_memCategory = cat;
+		}
 
 		Buffer clone() {
 			Buffer cp(size());
@@ -88,6 +107,7 @@ namespace nodecpp {
 
 			size_t cp = std::max(sz, MIN_BUFFER);
 			std::unique_ptr<uint8_t[]> tmp(new uint8_t[cp]);
+			nodecpp::metrics::chargeMemory( _memCategory, cp );
 
 			_capacity = cp;
 			_data = std::move(tmp);
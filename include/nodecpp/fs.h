@@ -49,6 +49,7 @@ namespace nodecpp::fs
 	{
 		friend FD impl::openSync( const char* path, std::optional<nodecpp::string> flags, std::optional<nodecpp::string> mode );
 		friend size_t readSync( FD fd, Buffer& b, size_t offset, size_t length, std::optional<size_t> position );
+		friend size_t writeSync( FD fd, const Buffer& b, size_t offset, size_t length, std::optional<size_t> position );
 		friend void closeSync( FD fd );
 		friend Buffer impl::readFileSync( const char* path );
 		FILE* fd = nullptr;
@@ -89,6 +90,14 @@ namespace nodecpp::fs
 		}
 	}
 
+	inline
+	size_t writeSync( FD fd, const Buffer& b, size_t offset, size_t length, std::optional<size_t> position ) { 
+		NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, offset + length <= b.size(), "{} + {} vs. {}", offset, length, b.size() );
+		if ( position.has_value() )
+			fseek( fd.fd, position.value(), SEEK_SET );
+		return fwrite( b.begin() + offset, 1, length, fd.fd );
+	}
+
 	inline
 	Buffer readFileSync( nodecpp::string path ) { 
 		return impl::readFileSync( path.c_str() );
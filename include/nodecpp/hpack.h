@@ -0,0 +1,541 @@
+/* -------------------------------------------------------------------------------
+* Copyright (c) 2021, OLogN Technologies AG
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*     * Neither the name of the OLogN Technologies AG nor the
+*       names of its contributors may be used to endorse or promote products
+*       derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL OLogN Technologies AG BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+* -------------------------------------------------------------------------------*/
+
+#ifndef NODECPP_HPACK_H
+#define NODECPP_HPACK_H
+
+#include "common.h"
+#include "common_structs.h"
+
+// HPACK (RFC 7541) header compression for HTTP/2
+
+namespace nodecpp {
+
+	namespace net {
+
+	namespace hpack {
+
+		// RFC 7541, Appendix B (symbol 256 is EOS)
+		static constexpr uint32_t huffmanCodes[257] = {
+			0x1ff8, 0x7fffd8, 0xfffffe2, 0xfffffe3, 0xfffffe4, 0xfffffe5, 0xfffffe6, 0xfffffe7,
+			0xfffffe8, 0xffffea, 0x3ffffffc, 0xfffffe9, 0xfffffea, 0x3ffffffd, 0xfffffeb, 0xfffffec,
+			0xfffffed, 0xfffffee, 0xfffffef, 0xffffff0, 0xffffff1, 0xffffff2, 0x3ffffffe, 0xffffff3,
+			0xffffff4, 0xffffff5, 0xffffff6, 0xffffff7, 0xffffff8, 0xffffff9, 0xffffffa, 0xffffffb,
+			0x14, 0x3f8, 0x3f9, 0xffa, 0x1ff9, 0x15, 0xf8, 0x7fa,
+			0x3fa, 0x3fb, 0xf9, 0x7fb, 0xfa, 0x16, 0x17, 0x18,
+			0x0, 0x1, 0x2, 0x19, 0x1a, 0x1b, 0x1c, 0x1d,
+			0x1e, 0x1f, 0x5c, 0xfb, 0x7ffc, 0x20, 0xffb, 0x3fc,
+			0x1ffa, 0x21, 0x5d, 0x5e, 0x5f, 0x60, 0x61, 0x62,
+			0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a,
+			0x6b, 0x6c, 0x6d, 0x6e, 0x6f, 0x70, 0x71, 0x72,
+			0xfc, 0x73, 0xfd, 0x1ffb, 0x7fff0, 0x1ffc, 0x3ffc, 0x22,
+			0x7ffd, 0x3, 0x23, 0x4, 0x24, 0x5, 0x25, 0x26,
+			0x27, 0x6, 0x74, 0x75, 0x28, 0x29, 0x2a, 0x7,
+			0x2b, 0x76, 0x2c, 0x8, 0x9, 0x2d, 0x77, 0x78,
+			0x79, 0x7a, 0x7b, 0x7ffe, 0x7fc, 0x3ffd, 0x1ffd, 0xffffffc,
+			0xfffe6, 0x3fffd2, 0xfffe7, 0xfffe8, 0x3fffd3, 0x3fffd4, 0x3fffd5, 0x7fffd9,
+			0x3fffd6, 0x7fffda, 0x7fffdb, 0x7fffdc, 0x7fffdd, 0x7fffde, 0xffffeb, 0x7fffdf,
+			0xffffec, 0xffffed, 0x3fffd7, 0x7fffe0, 0xffffee, 0x7fffe1, 0x7fffe2, 0x7fffe3,
+			0x7fffe4, 0x1fffdc, 0x3fffd8, 0x7fffe5, 0x3fffd9, 0x7fffe6, 0x7fffe7, 0xffffef,
+			0x3fffda, 0x1fffdd, 0xfffe9, 0x3fffdb, 0x3fffdc, 0x7fffe8, 0x7fffe9, 0x1fffde,
+			0x7fffea, 0x3fffdd, 0x3fffde, 0xfffff0, 0x1fffdf, 0x3fffdf, 0x7fffeb, 0x7fffec,
+			0x1fffe0, 0x1fffe1, 0x3fffe0, 0x1fffe2, 0x7fffed, 0x3fffe1, 0x7fffee, 0x7fffef,
+			0xfffea, 0x3fffe2, 0x3fffe3, 0x3fffe4, 0x7ffff0, 0x3fffe5, 0x3fffe6, 0x7ffff1,
+			0x3ffffe0, 0x3ffffe1, 0xfffeb, 0x7fff1, 0x3fffe7, 0x7ffff2, 0x3fffe8, 0x1ffffec,
+			0x3ffffe2, 0x3ffffe3, 0x3ffffe4, 0x7ffffde, 0x7ffffdf, 0x3ffffe5, 0xfffff1, 0x1ffffed,
+			0x7fff2, 0x1fffe3, 0x3ffffe6, 0x7ffffe0, 0x7ffffe1, 0x3ffffe7, 0x7ffffe2, 0xfffff2,
+			0x1fffe4, 0x1fffe5, 0x3ffffe8, 0x3ffffe9, 0xffffffd, 0x7ffffe3, 0x7ffffe4, 0x7ffffe5,
+			0xfffec, 0xfffff3, 0xfffed, 0x1fffe6, 0x3fffe9, 0x1fffe7, 0x1fffe8, 0x7ffff3,
+			0x3fffea, 0x3fffeb, 0x1ffffee, 0x1ffffef, 0xfffff4, 0xfffff5, 0x3ffffea, 0x7ffff4,
+			0x3ffffeb, 0x7ffffe6, 0x3ffffec, 0x3ffffed, 0x7ffffe7, 0x7ffffe8, 0x7ffffe9, 0x7ffffea,
+			0x7ffffeb, 0xffffffe, 0x7ffffec, 0x7ffffed, 0x7ffffee, 0x7ffffef, 0x7fffff0, 0x3ffffee,
+			0x3fffffff
+		};
+		static constexpr uint8_t huffmanCodeLengths[257] = {
+			13, 23, 28, 28, 28, 28, 28, 28, 28, 24, 30, 28, 28, 30, 28, 28,
+			28, 28, 28, 28, 28, 28, 30, 28, 28, 28, 28, 28, 28, 28, 28, 28,
+			6, 10, 10, 12, 13, 6, 8, 11, 10, 10, 8, 11, 8, 6, 6, 6,
+			5, 5, 5, 6, 6, 6, 6, 6, 6, 6, 7, 8, 15, 6, 12, 10,
+			13, 6, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+			7, 7, 7, 7, 7, 7, 7, 7, 8, 7, 8, 13, 19, 13, 14, 6,
+			15, 5, 6, 5, 6, 5, 6, 6, 6, 5, 7, 7, 6, 6, 6, 5,
+			6, 7, 6, 5, 5, 6, 7, 7, 7, 7, 7, 15, 11, 14, 13, 28,
+			20, 22, 20, 20, 22, 22, 22, 23, 22, 23, 23, 23, 23, 23, 24, 23,
+			24, 24, 22, 23, 24, 23, 23, 23, 23, 21, 22, 23, 22, 23, 23, 24,
+			22, 21, 20, 22, 22, 23, 23, 21, 23, 22, 22, 24, 21, 22, 23, 23,
+			21, 21, 22, 21, 23, 22, 23, 23, 20, 22, 22, 22, 23, 22, 22, 23,
+			26, 26, 20, 19, 22, 23, 22, 25, 26, 26, 26, 27, 27, 26, 24, 25,
+			19, 21, 26, 27, 27, 26, 27, 24, 21, 21, 26, 26, 28, 27, 27, 27,
+			20, 24, 20, 21, 22, 21, 21, 23, 22, 22, 25, 25, 24, 24, 26, 23,
+			26, 27, 26, 26, 27, 27, 27, 27, 27, 28, 27, 27, 27, 27, 27, 26,
+			30
+		};
+
+		// the code is canonical, so symbols of the same length have consecutive codes; tables below are indexed by code length
+		static constexpr uint16_t huffmanSymbolsByCode[257] = {
+			48, 49, 50, 97, 99, 101, 105, 111, 115, 116, 32, 37, 45, 46, 47, 51,
+			52, 53, 54, 55, 56, 57, 61, 65, 95, 98, 100, 102, 103, 104, 108, 109,
+			110, 112, 114, 117, 58, 66, 67, 68, 69, 70, 71, 72, 73, 74, 75, 76,
+			77, 78, 79, 80, 81, 82, 83, 84, 85, 86, 87, 89, 106, 107, 113, 118,
+			119, 120, 121, 122, 38, 42, 44, 59, 88, 90, 33, 34, 40, 41, 63, 39,
+			43, 124, 35, 62, 0, 36, 64, 91, 93, 126, 94, 125, 60, 96, 123, 92,
+			195, 208, 128, 130, 131, 162, 184, 194, 224, 226, 153, 161, 167, 172, 176, 177,
+			179, 209, 216, 217, 227, 229, 230, 129, 132, 133, 134, 136, 146, 154, 156, 160,
+			163, 164, 169, 170, 173, 178, 181, 185, 186, 187, 189, 190, 196, 198, 228, 232,
+			233, 1, 135, 137, 138, 139, 140, 141, 143, 147, 149, 150, 151, 152, 155, 157,
+			158, 165, 166, 168, 174, 175, 180, 182, 183, 188, 191, 197, 231, 239, 9, 142,
+			144, 145, 148, 159, 171, 206, 215, 225, 236, 237, 199, 207, 234, 235, 192, 193,
+			200, 201, 202, 205, 210, 213, 218, 219, 238, 240, 242, 243, 255, 203, 204, 211,
+			212, 214, 221, 222, 223, 241, 244, 245, 246, 247, 248, 250, 251, 252, 253, 254,
+			2, 3, 4, 5, 6, 7, 8, 11, 12, 14, 15, 16, 17, 18, 19, 20,
+			21, 23, 24, 25, 26, 27, 28, 29, 30, 31, 127, 220, 249, 10, 13, 22,
+			256
+		};
+		static constexpr uint32_t huffmanFirstCode[31] = { 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x14, 0x5c, 0xf8, 0x0, 0x3f8, 0x7fa, 0xffa, 0x1ff8, 0x3ffc, 0x7ffc, 0x0, 0x0, 0x0, 0x7fff0, 0xfffe6, 0x1fffdc, 0x3fffd2, 0x7fffd8, 0xffffea, 0x1ffffec, 0x3ffffe0, 0x7ffffde, 0xfffffe2, 0x0, 0x3ffffffc };
+		static constexpr uint16_t huffmanFirstIndex[31] = { 0, 0, 0, 0, 0, 0, 10, 36, 68, 0, 74, 79, 82, 84, 90, 92, 0, 0, 0, 95, 98, 106, 119, 145, 174, 186, 190, 205, 224, 0, 253 };
+		static constexpr uint16_t huffmanCountByLength[31] = { 0, 0, 0, 0, 0, 10, 26, 32, 6, 0, 5, 3, 2, 6, 2, 3, 0, 0, 0, 3, 8, 13, 26, 29, 12, 4, 15, 19, 29, 0, 4 };
+
+		struct StaticTableEntry { const char* name; const char* value; };
+		// RFC 7541, Appendix A (index 0 is unused)
+		static constexpr StaticTableEntry staticTable[62] = {
+			{ nullptr, nullptr },
+			{ ":authority", "" },
+			{ ":method", "GET" },
+			{ ":method", "POST" },
+			{ ":path", "/" },
+			{ ":path", "/index.html" },
+			{ ":scheme", "http" },
+			{ ":scheme", "https" },
+			{ ":status", "200" },
+			{ ":status", "204" },
+			{ ":status", "206" },
+			{ ":status", "304" },
+			{ ":status", "400" },
+			{ ":status", "404" },
+			{ ":status", "500" },
+			{ "accept-charset", "" },
+			{ "accept-encoding", "gzip, deflate" },
+			{ "accept-language", "" },
+			{ "accept-ranges", "" },
+			{ "accept", "" },
+			{ "access-control-allow-origin", "" },
+			{ "age", "" },
+			{ "allow", "" },
+			{ "authorization", "" },
+			{ "cache-control", "" },
+			{ "content-disposition", "" },
+			{ "content-encoding", "" },
+			{ "content-language", "" },
+			{ "content-length", "" },
+			{ "content-location", "" },
+			{ "content-range", "" },
+			{ "content-type", "" },
+			{ "cookie", "" },
+			{ "date", "" },
+			{ "etag", "" },
+			{ "expect", "" },
+			{ "expires", "" },
+			{ "from", "" },
+			{ "host", "" },
+			{ "if-match", "" },
+			{ "if-modified-since", "" },
+			{ "if-none-match", "" },
+			{ "if-range", "" },
+			{ "if-unmodified-since", "" },
+			{ "last-modified", "" },
+			{ "link", "" },
+			{ "location", "" },
+			{ "max-forwards", "" },
+			{ "proxy-authenticate", "" },
+			{ "proxy-authorization", "" },
+			{ "range", "" },
+			{ "referer", "" },
+			{ "refresh", "" },
+			{ "retry-after", "" },
+			{ "server", "" },
+			{ "set-cookie", "" },
+			{ "strict-transport-security", "" },
+			{ "transfer-encoding", "" },
+			{ "user-agent", "" },
+			{ "vary", "" },
+			{ "via", "" },
+			{ "www-authenticate", "" }
+		};
+		static constexpr size_t staticTableSize = 61;
+
+		inline
+		void assignRaw( nodecpp::string& str, const uint8_t* data, size_t sz )
+		{
+#ifdef NODECPP_USE_SAFE_MEMORY_CONTAINERS					
+			str.assign_unsafe( (const char*)(data), sz );
+#else
+			str.assign( (const char*)(data), sz );
+#endif // NODECPP_USE_SAFE_MEMORY_CONTAINERS					
+		}
+
+		// bit-by-bit walk over canonical code; no allocations apart from growing out
+		inline
+		bool huffmanDecode( const uint8_t* data, size_t sz, nodecpp::string& out )
+		{
+			out.clear();
+			out.reserve( sz + ( sz >> 2 ) + 1 ); // shortest code is 5 bits
+			uint32_t code = 0;
+			uint32_t len = 0;
+			for ( size_t i=0; i<sz; ++i )
+			{
+				uint8_t byte = data[i];
+				for ( int bit=7; bit>=0; --bit )
+				{
+					code = ( code << 1 ) | ( ( byte >> bit ) & 1 );
+					++len;
+					if ( len < 5 )
+						continue;
+					if ( code - huffmanFirstCode[len] < huffmanCountByLength[len] )
+					{
+						uint16_t sym = huffmanSymbolsByCode[huffmanFirstIndex[len] + code - huffmanFirstCode[len]];
+						if ( sym == 256 ) // EOS must not appear in a string
+							return false;
+						out.push_back( (char)sym );
+						code = 0;
+						len = 0;
+					}
+					else if ( len >= 30 )
+						return false;
+				}
+			}
+			// padding: up to 7 most significant bits of EOS (all ones)
+			return len < 8 && code == ( ( 1u << len ) - 1 );
+		}
+
+		inline
+		size_t huffmanEncodedSize( const uint8_t* data, size_t sz )
+		{
+			size_t bits = 0;
+			for ( size_t i=0; i<sz; ++i )
+				bits += huffmanCodeLengths[data[i]];
+			return ( bits + 7 ) >> 3;
+		}
+
+		inline
+		void huffmanEncode( const uint8_t* data, size_t sz, Buffer& out )
+		{
+			uint64_t acc = 0;
+			uint32_t bits = 0;
+			for ( size_t i=0; i<sz; ++i )
+			{
+				acc = ( acc << huffmanCodeLengths[data[i]] ) | huffmanCodes[data[i]];
+				bits += huffmanCodeLengths[data[i]];
+				while ( bits >= 8 )
+				{
+					bits -= 8;
+					out.appendUint8( (uint8_t)( acc >> bits ) );
+				}
+			}
+			if ( bits )
+				out.appendUint8( (uint8_t)( ( acc << ( 8 - bits ) ) | ( 0xFF >> bits ) ) );
+		}
+
+		inline
+		bool decodeInteger( const uint8_t*& p, const uint8_t* end, uint8_t prefixBits, size_t& value )
+		{
+			if ( p >= end )
+				return false;
+			uint8_t mask = (uint8_t)( ( 1u << prefixBits ) - 1 );
+			value = *p++ & mask;
+			if ( value < mask )
+				return true;
+			for ( uint32_t shift = 0; p < end && shift < 56; shift += 7 )
+			{
+				uint8_t b = *p++;
+				value += (size_t)( b & 0x7F ) << shift;
+				if ( ( b & 0x80 ) == 0 )
+					return true;
+			}
+			return false;
+		}
+
+		inline
+		void encodeInteger( Buffer& out, uint8_t flags, uint8_t prefixBits, size_t value )
+		{
+			uint8_t mask = (uint8_t)( ( 1u << prefixBits ) - 1 );
+			if ( value < mask )
+			{
+				out.appendUint8( flags | (uint8_t)value );
+				return;
+			}
+			out.appendUint8( flags | mask );
+			value -= mask;
+			while ( value >= 0x80 )
+			{
+				out.appendUint8( (uint8_t)( value & 0x7F ) | 0x80 );
+				value >>= 7;
+			}
+			out.appendUint8( (uint8_t)value );
+		}
+
+		inline
+		bool decodeString( const uint8_t*& p, const uint8_t* end, nodecpp::string& str )
+		{
+			if ( p >= end )
+				return false;
+			bool huffman = ( *p & 0x80 ) != 0;
+			size_t len;
+			if ( !decodeInteger( p, end, 7, len ) || len > (size_t)(end - p) )
+				return false;
+			bool ok = true;
+			if ( huffman )
+				ok = huffmanDecode( p, len, str );
+			else
+				assignRaw( str, p, len );
+			p += len;
+			return ok;
+		}
+
+		inline
+		void encodeString( Buffer& out, const nodecpp::string& str )
+		{
+			size_t hsz = huffmanEncodedSize( (const uint8_t*)(str.c_str()), str.size() );
+			if ( hsz < str.size() )
+			{
+				encodeInteger( out, 0x80, 7, hsz );
+				huffmanEncode( (const uint8_t*)(str.c_str()), str.size(), out );
+			}
+			else
+			{
+				encodeInteger( out, 0, 7, str.size() );
+				out.append( str.c_str(), str.size() );
+			}
+		}
+
+		// entries are kept in a ring, the newest one having index 0
+		class DynamicTable
+		{
+			struct Entry
+			{
+				nodecpp::string name;
+				nodecpp::string value;
+			};
+			nodecpp::vector<Entry> ring;
+			size_t first = 0; // position of the oldest entry
+			size_t count = 0;
+			size_t octets = 0;
+			size_t maxOctets = 4096;
+
+			static size_t entrySize( const Entry& e ) { return e.name.size() + e.value.size() + 32; }
+
+			void evictOldest()
+			{
+				NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, count != 0 ); 
+				Entry& e = ring[first];
+				octets -= entrySize( e );
+				e.name.clear();
+				e.value.clear();
+				first = ( first + 1 ) % ring.size();
+				--count;
+			}
+
+		public:
+			size_t size() const { return count; }
+			size_t getOctets() const { return octets; }
+			size_t getMaxSize() const { return maxOctets; }
+
+			void setMaxSize( size_t sz )
+			{
+				maxOctets = sz;
+				while ( octets > maxOctets )
+					evictOldest();
+			}
+
+			void add( const nodecpp::string& name, const nodecpp::string& value )
+			{
+				size_t sz = name.size() + value.size() + 32;
+				while ( count && octets + sz > maxOctets )
+					evictOldest();
+				if ( sz > maxOctets ) // an entry larger than the whole table just empties it
+					return;
+				if ( count == ring.size() )
+				{
+					nodecpp::vector<Entry> grown;
+					grown.resize( ring.size() ? ring.size() * 2 : 16 );
+					for ( size_t i=0; i<count; ++i )
+						grown[i] = std::move( ring[(first + i) % ring.size()] );
+					ring = std::move( grown );
+					first = 0;
+				}
+				Entry& e = ring[(first + count) % ring.size()];
+				e.name = name;
+				e.value = value;
+				++count;
+				octets += sz;
+			}
+
+			const Entry* get( size_t idx ) const
+			{
+				if ( idx >= count )
+					return nullptr;
+				return &(ring[(first + count - 1 - idx) % ring.size()]);
+			}
+		};
+
+		class Decoder
+		{
+			DynamicTable table;
+			size_t maxAllowedTableSize = 4096; // as announced by SETTINGS_HEADER_TABLE_SIZE
+			nodecpp::string name;
+			nodecpp::string value;
+
+			bool getIndexed( size_t idx, nodecpp::string& n, nodecpp::string* v )
+			{
+				if ( idx == 0 )
+					return false;
+				if ( idx <= staticTableSize )
+				{
+					n = staticTable[idx].name;
+					if ( v )
+						*v = staticTable[idx].value;
+					return true;
+				}
+				auto e = table.get( idx - staticTableSize - 1 );
+				if ( e == nullptr )
+					return false;
+				n = e->name;
+				if ( v )
+					*v = e->value;
+				return true;
+			}
+
+		public:
+			void setMaxAllowedTableSize( size_t sz ) { maxAllowedTableSize = sz; }
+			const DynamicTable& getTable() const { return table; }
+
+			// onHeader( const nodecpp::string& name, const nodecpp::string& value ) is called for each header field
+			template<class OnHeaderT>
+			bool decode( const uint8_t* data, size_t sz, OnHeaderT&& onHeader )
+			{
+				const uint8_t* p = data;
+				const uint8_t* end = data + sz;
+				while ( p < end )
+				{
+					uint8_t b = *p;
+					size_t idx;
+					if ( b & 0x80 ) // indexed field
+					{
+						if ( !decodeInteger( p, end, 7, idx ) || !getIndexed( idx, name, &value ) )
+							return false;
+					}
+					else if ( ( b & 0xE0 ) == 0x20 ) // dynamic table size update
+					{
+						if ( !decodeInteger( p, end, 5, idx ) || idx > maxAllowedTableSize )
+							return false;
+						table.setMaxSize( idx );
+						continue;
+					}
+					else // literal
+					{
+						bool incremental = ( b & 0xC0 ) == 0x40;
+						if ( !decodeInteger( p, end, incremental ? 6 : 4, idx ) )
+							return false;
+						if ( idx )
+						{
+							if ( !getIndexed( idx, name, nullptr ) )
+								return false;
+						}
+						else if ( !decodeString( p, end, name ) )
+							return false;
+						if ( !decodeString( p, end, value ) )
+							return false;
+						if ( incremental )
+							table.add( name, value );
+					}
+					onHeader( name, value );
+				}
+				return true;
+			}
+		};
+
+		// never adds to the dynamic table (so that peer's table size setting never matters); uses static table and Huffman coding only
+		class Encoder
+		{
+			static size_t findStatic( const nodecpp::string& name, const nodecpp::string& value, bool& fullMatch )
+			{
+				size_t nameIdx = 0;
+				fullMatch = false;
+				for ( size_t i=1; i<=staticTableSize; ++i )
+					if ( name == staticTable[i].name )
+					{
+						if ( value == staticTable[i].value )
+						{
+							fullMatch = true;
+							return i;
+						}
+						if ( nameIdx == 0 )
+							nameIdx = i;
+					}
+				return nameIdx;
+			}
+
+		public:
+			void encodeStatus( size_t status, Buffer& out )
+			{
+				switch ( status )
+				{
+					case 200: out.appendUint8( 0x80 | 8 ); return;
+					case 204: out.appendUint8( 0x80 | 9 ); return;
+					case 206: out.appendUint8( 0x80 | 10 ); return;
+					case 304: out.appendUint8( 0x80 | 11 ); return;
+					case 400: out.appendUint8( 0x80 | 12 ); return;
+					case 404: out.appendUint8( 0x80 | 13 ); return;
+					case 500: out.appendUint8( 0x80 | 14 ); return;
+					default:
+						encodeInteger( out, 0, 4, 8 ); // literal without indexing, name ":status"
+						encodeString( out, nodecpp::format( "{}", status ) );
+				}
+			}
+
+			// name is expected in lower case
+			void encode( const nodecpp::string& name, const nodecpp::string& value, Buffer& out )
+			{
+				bool fullMatch;
+				size_t idx = findStatic( name, value, fullMatch );
+				if ( fullMatch )
+				{
+					encodeInteger( out, 0x80, 7, idx );
+					return;
+				}
+				encodeInteger( out, 0, 4, idx ); // literal without indexing
+				if ( idx == 0 )
+					encodeString( out, name );
+				encodeString( out, value );
+			}
+		};
+
+	} // namespace hpack
+
+	} //namespace net
+} //namespace nodecpp
+
+#endif // NODECPP_HPACK_H
@@ -0,0 +1,993 @@
+/* -------------------------------------------------------------------------------
+* Copyright (c) 2021, OLogN Technologies AG
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*     * Neither the name of the OLogN Technologies AG nor the
+*       names of its contributors may be used to endorse or promote products
+*       derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL OLogN Technologies AG BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+* -------------------------------------------------------------------------------*/
+
+#ifndef NODECPP_HTTP2_H
+#define NODECPP_HTTP2_H
+
+#include "http_socket_at_server.h"
+#include "hpack.h"
+
+// Cleartext HTTP/2 (h2c) on top of HttpSocketBase: both prior knowledge (connection starts with the client preface)
+// and HTTP/1.1 Upgrade are supported. Each stream gets its own IncomingHttpMessageAtServer/HttpServerResponse pair,
+// so that request handlers see no difference. Server push and priorities are not implemented.
+
+namespace nodecpp {
+
+	namespace net {
+
+	namespace h2_impl {
+
+		enum FrameType : uint8_t { DATA = 0, HEADERS = 1, PRIORITY = 2, RST_STREAM = 3, SETTINGS = 4, PUSH_PROMISE = 5, PING = 6, GOAWAY = 7, WINDOW_UPDATE = 8, CONTINUATION = 9 };
+		enum FrameFlags : uint8_t { END_STREAM = 0x1, ACK = 0x1, END_HEADERS = 0x4, PADDED = 0x8, PRIORITY_FLAG = 0x20 };
+		enum ErrorCode : uint32_t { NO_ERROR = 0, PROTOCOL_ERROR = 1, INTERNAL_ERROR = 2, FLOW_CONTROL_ERROR = 3, SETTINGS_TIMEOUT = 4, STREAM_CLOSED = 5, FRAME_SIZE_ERROR = 6, REFUSED_STREAM = 7, CANCEL = 8, COMPRESSION_ERROR = 9, ENHANCE_YOUR_CALM = 0xb };
+		enum SettingId : uint16_t { HEADER_TABLE_SIZE = 1, ENABLE_PUSH = 2, MAX_CONCURRENT_STREAMS = 3, INITIAL_WINDOW_SIZE = 4, MAX_FRAME_SIZE = 5, MAX_HEADER_LIST_SIZE = 6 };
+
+		static constexpr size_t frameHeaderSize = 9;
+		static constexpr uint32_t defaultWindowSize = 65535;
+		static constexpr uint32_t defaultMaxFrameSize = 16384;
+		static constexpr int64_t maxWindowSize = 0x7FFFFFFF;
+		static constexpr const char* clientPreface = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+		static constexpr size_t clientPrefaceSize = 24;
+
+		struct FrameHeader
+		{
+			uint32_t length = 0;
+			uint8_t type = 0;
+			uint8_t flags = 0;
+			uint32_t streamId = 0;
+
+			void parse( const uint8_t* p )
+			{
+				length = ( (uint32_t)(p[0]) << 16 ) | ( (uint32_t)(p[1]) << 8 ) | p[2];
+				type = p[3];
+				flags = p[4];
+				streamId = ( ( (uint32_t)(p[5]) << 24 ) | ( (uint32_t)(p[6]) << 16 ) | ( (uint32_t)(p[7]) << 8 ) | p[8] ) & 0x7FFFFFFF;
+			}
+		};
+
+		inline
+		void appendFrameHeader( Buffer& out, size_t length, uint8_t type, uint8_t flags, uint32_t streamId )
+		{
+			uint8_t h[frameHeaderSize] = { (uint8_t)(length >> 16), (uint8_t)(length >> 8), (uint8_t)length, type, flags,
+				(uint8_t)( ( streamId >> 24 ) & 0x7F ), (uint8_t)(streamId >> 16), (uint8_t)(streamId >> 8), (uint8_t)streamId };
+			out.append( h, frameHeaderSize );
+		}
+
+		inline
+		void appendUint32( Buffer& out, uint32_t val )
+		{
+			uint8_t b[4] = { (uint8_t)(val >> 24), (uint8_t)(val >> 16), (uint8_t)(val >> 8), (uint8_t)val };
+			out.append( b, 4 );
+		}
+
+		inline
+		uint32_t readUint32( const uint8_t* p ) { return ( (uint32_t)(p[0]) << 24 ) | ( (uint32_t)(p[1]) << 16 ) | ( (uint32_t)(p[2]) << 8 ) | p[3]; }
+
+		// HTTP2-Settings header of Upgrade request (base64url, no padding)
+		inline
+		bool base64UrlDecode( const nodecpp::string& in, Buffer& out )
+		{
+			uint32_t acc = 0;
+			int bits = 0;
+			for ( char c : in )
+			{
+				int v;
+				if ( c >= 'A' && c <= 'Z' ) v = c - 'A';
+				else if ( c >= 'a' && c <= 'z' ) v = c - 'a' + 26;
+				else if ( c >= '0' && c <= '9' ) v = c - '0' + 52;
+				else if ( c == '-' || c == '+' ) v = 62;
+				else if ( c == '_' || c == '/' ) v = 63;
+				else if ( c == '=' ) break;
+				else return false;
+				acc = ( acc << 6 ) | v;
+				bits += 6;
+				if ( bits >= 8 )
+				{
+					bits -= 8;
+					out.appendUint8( (uint8_t)( acc >> bits ) );
+				}
+			}
+			return true;
+		}
+
+		// connection-specific headers are not allowed in HTTP/2
+		inline
+		bool isConnectionSpecificHeader( const nodecpp::string& name )
+		{
+			return name == "connection" || name == "keep-alive" || name == "proxy-connection" || name == "transfer-encoding" || name == "upgrade";
+		}
+
+	} // namespace h2_impl
+
+#ifndef NODECPP_NO_COROUTINES
+		class Http2Stream
+		{
+			friend class Http2Session;
+			friend class IncomingHttpMessageAtServer;
+			friend class HttpServerResponse;
+
+		public:
+			nodecpp::soft_this_ptr<Http2Stream> myThis;
+
+		private:
+			nodecpp::soft_ptr<Http2Session> session;
+			uint32_t id = 0;
+			nodecpp::owning_ptr<IncomingHttpMessageAtServer> request;
+			nodecpp::owning_ptr<HttpServerResponse> response;
+
+			int64_t sendWindow = h2_impl::defaultWindowSize;
+			int64_t recvWindow = h2_impl::defaultWindowSize;
+			size_t consumedSinceUpdate = 0;
+			Buffer receivedData; // not yet taken by the handler
+			Buffer outFrame;
+			bool remoteEnded = false;
+			bool localEnded = false;
+			bool reset = false;
+			bool active = false; // counts against MAX_CONCURRENT_STREAMS
+			nodecpp::vector<awaitable_handle_t> waitingForData;
+
+		public:
+			Http2Stream() {}
+			Http2Stream(const Http2Stream&) = delete;
+			Http2Stream& operator = (const Http2Stream&) = delete;
+
+			uint32_t getId() const { return id; }
+		};
+
+		class Http2Session
+		{
+			friend class HttpSocketBase;
+			friend class IncomingHttpMessageAtServer;
+			friend class HttpServerResponse;
+
+		public:
+			nodecpp::soft_this_ptr<Http2Session> myThis;
+
+		private:
+			static constexpr size_t maxSpareStreams = 16;
+
+			nodecpp::soft_ptr<HttpSocketBase> sock;
+			nodecpp::soft_ptr<HttpServerBase> server;
+			Http2Options options;
+			hpack::Decoder decoder;
+			hpack::Encoder encoder;
+
+			nodecpp::map<uint32_t, nodecpp::owning_ptr<Http2Stream>> streams;
+			nodecpp::vector<nodecpp::owning_ptr<Http2Stream>> finishedStreams; // released from the read loop only, never from within stream's own calls
+			nodecpp::vector<nodecpp::owning_ptr<Http2Stream>> spareStreams;
+			size_t activeStreams = 0;
+			uint32_t lastStreamId = 0;
+
+			uint32_t peerMaxFrameSize = h2_impl::defaultMaxFrameSize;
+			uint32_t peerInitialWindowSize = h2_impl::defaultWindowSize;
+			int64_t connSendWindow = h2_impl::defaultWindowSize;
+			int64_t connRecvWindow = h2_impl::defaultWindowSize;
+			size_t connConsumedSinceUpdate = 0;
+
+			uint32_t headersStreamId = 0; // non-zero while CONTINUATION frames are expected
+			uint8_t headersFlags = 0;
+			Buffer headerBlock;
+
+			bool closed = false;
+			bool goingAway = false;
+			bool draining = false;
+			nodecpp::vector<awaitable_handle_t> waitingForWindow;
+			nodecpp::vector<awaitable_handle_t> waitingForDrain;
+
+			Buffer frameHeaderBuff;
+			Buffer payload;
+			Buffer controlBuff;
+
+			void sendNow( Buffer& b )
+			{
+				if ( !closed )
+					sock->write( b );
+			}
+
+			void sendSettings()
+			{
+				controlBuff.clear();
+				h2_impl::appendFrameHeader( controlBuff, 6 * 6, h2_impl::SETTINGS, 0, 0 );
+				auto setting = [&]( uint16_t id, uint32_t val ) {
+					controlBuff.appendUint8( (uint8_t)(id >> 8) );
+					controlBuff.appendUint8( (uint8_t)id );
+					h2_impl::appendUint32( controlBuff, val );
+				};
+				setting( h2_impl::HEADER_TABLE_SIZE, (uint32_t)(options.headerTableSize) );
+				setting( h2_impl::ENABLE_PUSH, 0 );
+				setting( h2_impl::MAX_CONCURRENT_STREAMS, options.maxConcurrentStreams );
+				setting( h2_impl::INITIAL_WINDOW_SIZE, options.initialWindowSize );
+				setting( h2_impl::MAX_FRAME_SIZE, options.maxFrameSize );
+				setting( h2_impl::MAX_HEADER_LIST_SIZE, (uint32_t)(options.maxHeaderListSize) );
+				if ( options.initialWindowSize > h2_impl::defaultWindowSize )
+				{
+					h2_impl::appendFrameHeader( controlBuff, 4, h2_impl::WINDOW_UPDATE, 0, 0 );
+					h2_impl::appendUint32( controlBuff, options.initialWindowSize - h2_impl::defaultWindowSize );
+					connRecvWindow = options.initialWindowSize;
+				}
+				sendNow( controlBuff );
+			}
+
+			void sendWindowUpdate( uint32_t streamId, size_t increment )
+			{
+				controlBuff.clear();
+				h2_impl::appendFrameHeader( controlBuff, 4, h2_impl::WINDOW_UPDATE, 0, streamId );
+				h2_impl::appendUint32( controlBuff, (uint32_t)increment );
+				sendNow( controlBuff );
+			}
+
+			void sendRstStream( uint32_t streamId, uint32_t errorCode )
+			{
+				controlBuff.clear();
+				h2_impl::appendFrameHeader( controlBuff, 4, h2_impl::RST_STREAM, 0, streamId );
+				h2_impl::appendUint32( controlBuff, errorCode );
+				sendNow( controlBuff );
+			}
+
+			void sendGoAway( uint32_t errorCode )
+			{
+				controlBuff.clear();
+				h2_impl::appendFrameHeader( controlBuff, 8, h2_impl::GOAWAY, 0, 0 );
+				h2_impl::appendUint32( controlBuff, lastStreamId );
+				h2_impl::appendUint32( controlBuff, errorCode );
+				sendNow( controlBuff );
+			}
+
+			// n bytes of DATA have been taken by the application (or dropped); the peer may send more
+			void connConsumed( size_t n )
+			{
+				connConsumedSinceUpdate += n;
+				if ( connConsumedSinceUpdate >= options.initialWindowSize / 2 )
+				{
+					sendWindowUpdate( 0, connConsumedSinceUpdate );
+					connRecvWindow += connConsumedSinceUpdate;
+					connConsumedSinceUpdate = 0;
+				}
+			}
+
+			void consumed( nodecpp::soft_ptr<Http2Stream> s, size_t n )
+			{
+				connConsumed( n );
+				if ( !s->remoteEnded && !s->reset )
+				{
+					s->consumedSinceUpdate += n;
+					if ( s->consumedSinceUpdate >= options.initialWindowSize / 2 )
+					{
+						sendWindowUpdate( s->id, s->consumedSinceUpdate );
+						s->recvWindow += s->consumedSinceUpdate;
+						s->consumedSinceUpdate = 0;
+					}
+				}
+			}
+
+			nodecpp::soft_ptr<Http2Stream> findStream( uint32_t id )
+			{
+				auto it = streams.find( id );
+				if ( it == streams.end() )
+					return nodecpp::soft_ptr<Http2Stream>();
+				return it->second;
+			}
+
+			nodecpp::soft_ptr<Http2Stream> openStream( uint32_t id )
+			{
+				nodecpp::owning_ptr<Http2Stream> s;
+				if ( spareStreams.size() )
+				{
+					s = std::move( spareStreams.back() );
+					spareStreams.pop_back();
+				}
+				else
+				{
+					s = nodecpp::make_owning<Http2Stream>();
+					nodecpp::soft_ptr<Http2Stream> sp = s;
+					s->session = myThis.getSoftPtr<Http2Session>(this);
+					s->request = nodecpp::make_owning<IncomingHttpMessageAtServer>();
+					s->response = nodecpp::make_owning<HttpServerResponse>();
+					nodecpp::soft_ptr<IncomingHttpMessageAtServer> rq = s->request;
+					nodecpp::soft_ptr<HttpServerResponse> rsp = s->response;
+					s->request->counterpart = nodecpp::soft_ptr_reinterpret_cast<HttpMessageBase>(rsp);
+					s->response->counterpart = nodecpp::soft_ptr_reinterpret_cast<HttpMessageBase>(rq);
+					s->request->sock = sock;
+					s->response->sock = sock;
+					s->response->myRequest = rq;
+					s->request->h2stream = sp;
+					s->response->h2stream = sp;
+					s->outFrame.reserve( h2_impl::frameHeaderSize + h2_impl::defaultMaxFrameSize );
+				}
+				s->id = id;
+				s->sendWindow = peerInitialWindowSize;
+				s->recvWindow = options.initialWindowSize;
+				s->consumedSinceUpdate = 0;
+				s->receivedData.clear();
+				s->remoteEnded = false;
+				s->localEnded = false;
+				s->reset = false;
+				s->active = true;
+				++activeStreams;
+				nodecpp::soft_ptr<Http2Stream> ret = s;
+				streams.insert( nodecpp::make_pair( id, std::move( s ) ) );
+				return ret;
+			}
+
+			void deactivate( nodecpp::soft_ptr<Http2Stream> s )
+			{
+				if ( s->active )
+				{
+					s->active = false;
+					--activeStreams;
+				}
+			}
+
+			void resetStream( nodecpp::soft_ptr<Http2Stream> s, uint32_t errorCode )
+			{
+				sendRstStream( s->id, errorCode );
+				s->reset = true;
+				deactivate( s );
+				size_t unread = s->receivedData.size();
+				s->receivedData.clear();
+				connConsumed( unread );
+				resumeAll( s->waitingForData, true );
+				resumeAll( waitingForWindow, false ); // blocked writers of this stream will find it reset
+			}
+
+			// the response is complete
+			void streamDone( nodecpp::soft_ptr<Http2Stream> s )
+			{
+				deactivate( s );
+				if ( !s->remoteEnded && !s->reset && !closed )
+					sendRstStream( s->id, h2_impl::NO_ERROR ); // the rest of request body is of no interest any longer
+				connConsumed( s->receivedData.size() );
+				s->receivedData.clear();
+				auto it = streams.find( s->id );
+				if ( it != streams.end() )
+				{
+					finishedStreams.push_back( std::move( it->second ) );
+					streams.erase( it );
+				}
+			}
+
+			void recycleFinished()
+			{
+				for ( auto& s : finishedStreams )
+					if ( spareStreams.size() < maxSpareStreams )
+						spareStreams.push_back( std::move( s ) );
+				finishedStreams.clear();
+			}
+
+			uint32_t applySettings( const uint8_t* p, size_t sz )
+			{
+				if ( sz % 6 )
+					return h2_impl::FRAME_SIZE_ERROR;
+				for ( size_t i=0; i<sz; i+=6 )
+				{
+					uint16_t id = (uint16_t)( ( p[i] << 8 ) | p[i+1] );
+					uint32_t val = h2_impl::readUint32( p + i + 2 );
+					switch ( id )
+					{
+						case h2_impl::ENABLE_PUSH:
+							if ( val > 1 )
+								return h2_impl::PROTOCOL_ERROR;
+							break;
+						case h2_impl::INITIAL_WINDOW_SIZE:
+						{
+							if ( val > h2_impl::maxWindowSize )
+								return h2_impl::FLOW_CONTROL_ERROR;
+							int64_t delta = (int64_t)val - (int64_t)peerInitialWindowSize;
+							for ( auto& entry : streams )
+								entry.second->sendWindow += delta;
+							peerInitialWindowSize = val;
+							break;
+						}
+						case h2_impl::MAX_FRAME_SIZE:
+							if ( val < h2_impl::defaultMaxFrameSize || val > 0xFFFFFF )
+								return h2_impl::PROTOCOL_ERROR;
+							peerMaxFrameSize = val;
+							break;
+						default: // HEADER_TABLE_SIZE does not matter as our encoder never uses dynamic table; the rest are advisory
+							break;
+					}
+				}
+				return h2_impl::NO_ERROR;
+			}
+
+			void dispatch( nodecpp::soft_ptr<Http2Stream> s )
+			{
+				s->response->compression = server->getCompression();
+				server->onNewRequest( s->request, s->response );
+			}
+
+			uint32_t onHeaderBlock()
+			{
+				uint32_t id = headersStreamId;
+				headersStreamId = 0;
+				bool endStream = ( headersFlags & h2_impl::END_STREAM ) != 0;
+				auto existing = findStream( id );
+				if ( existing != nullptr ) // trailers; decoded to keep HPACK state in sync, then dropped
+				{
+					if ( !decoder.decode( headerBlock.begin(), headerBlock.size(), []( const nodecpp::string&, const nodecpp::string& ) {} ) )
+						return h2_impl::COMPRESSION_ERROR;
+					if ( !endStream )
+						resetStream( existing, h2_impl::PROTOCOL_ERROR );
+					else
+					{
+						existing->remoteEnded = true;
+						resumeAll( existing->waitingForData, false );
+					}
+					return h2_impl::NO_ERROR;
+				}
+
+				bool refuse = goingAway || activeStreams >= options.maxConcurrentStreams;
+				if ( refuse )
+				{
+					if ( !decoder.decode( headerBlock.begin(), headerBlock.size(), []( const nodecpp::string&, const nodecpp::string& ) {} ) )
+						return h2_impl::COMPRESSION_ERROR;
+					sendRstStream( id, h2_impl::REFUSED_STREAM );
+					return h2_impl::NO_ERROR;
+				}
+
+				auto s = openStream( id );
+				IncomingHttpMessageAtServer& rq = *(s->request);
+				rq.clear();
+				bool malformed = false;
+				bool ok = decoder.decode( headerBlock.begin(), headerBlock.size(), [&]( const nodecpp::string& name, const nodecpp::string& value ) {
+					if ( name.size() && name[0] == ':' )
+					{
+						if ( name == ":method" )
+							rq.method.name = value;
+						else if ( name == ":path" )
+							rq.method.url = value;
+						else if ( name == ":authority" )
+							rq.header.insert( nodecpp::make_pair( nodecpp::string( "host" ), value ) );
+						else if ( name != ":scheme" )
+							malformed = true;
+						return;
+					}
+					auto it = rq.header.find( name );
+					if ( it == rq.header.end() )
+						rq.header.insert( nodecpp::make_pair( name, value ) );
+					else
+					{
+						it->second.append( name == "cookie" ? "; " : ", " );
+						it->second.append( value );
+					}
+				} );
+				if ( !ok )
+					return h2_impl::COMPRESSION_ERROR;
+				if ( malformed || rq.method.name.empty() || rq.method.url.empty() )
+				{
+					resetStream( s, h2_impl::PROTOCOL_ERROR );
+					streamDone( s );
+					return h2_impl::NO_ERROR;
+				}
+				rq.method.version = "2.0";
+				rq.parseContentLength();
+				rq.connStatus = IncomingHttpMessageAtServer::ConnStatus::keep_alive;
+				s->remoteEnded = endStream;
+				rq.readStatus = endStream ? IncomingHttpMessageAtServer::ReadStatus::completed : IncomingHttpMessageAtServer::ReadStatus::in_body;
+				dispatch( s );
+				return h2_impl::NO_ERROR;
+			}
+
+			uint32_t onData( const h2_impl::FrameHeader& fh )
+			{
+				if ( fh.streamId == 0 )
+					return h2_impl::PROTOCOL_ERROR;
+				const uint8_t* data = payload.begin();
+				size_t dataSz = fh.length;
+				if ( fh.flags & h2_impl::PADDED )
+				{
+					if ( fh.length == 0 || payload.begin()[0] >= fh.length )
+						return h2_impl::PROTOCOL_ERROR;
+					dataSz = fh.length - 1 - payload.begin()[0];
+					++data;
+				}
+				connRecvWindow -= fh.length;
+				if ( connRecvWindow < 0 )
+					return h2_impl::FLOW_CONTROL_ERROR;
+				auto s = findStream( fh.streamId );
+				if ( s == nullptr || s->reset || s->remoteEnded )
+				{
+					connConsumed( fh.length );
+					if ( fh.streamId > lastStreamId )
+						return h2_impl::PROTOCOL_ERROR;
+					if ( s == nullptr || s->remoteEnded )
+						sendRstStream( fh.streamId, h2_impl::STREAM_CLOSED );
+					return h2_impl::NO_ERROR;
+				}
+				s->recvWindow -= fh.length;
+				if ( s->recvWindow < 0 )
+				{
+					connConsumed( fh.length );
+					resetStream( s, h2_impl::FLOW_CONTROL_ERROR );
+					return h2_impl::NO_ERROR;
+				}
+				s->receivedData.append( data, dataSz );
+				if ( dataSz != fh.length )
+					consumed( s, fh.length - dataSz ); // padding
+				if ( fh.flags & h2_impl::END_STREAM )
+				{
+					s->remoteEnded = true;
+					s->request->readStatus = IncomingHttpMessageAtServer::ReadStatus::completed;
+				}
+				resumeAll( s->waitingForData, false );
+				return h2_impl::NO_ERROR;
+			}
+
+			uint32_t onHeaders( const h2_impl::FrameHeader& fh )
+			{
+				if ( fh.streamId == 0 || ( fh.streamId & 1 ) == 0 )
+					return h2_impl::PROTOCOL_ERROR;
+				size_t start = 0;
+				size_t end = fh.length;
+				if ( fh.flags & h2_impl::PADDED )
+				{
+					if ( fh.length == 0 || payload.begin()[0] >= fh.length )
+						return h2_impl::PROTOCOL_ERROR;
+					end -= payload.begin()[0];
+					start = 1;
+				}
+				if ( fh.flags & h2_impl::PRIORITY_FLAG )
+					start += 5;
+				if ( start > end )
+					return h2_impl::PROTOCOL_ERROR;
+				if ( findStream( fh.streamId ) == nullptr )
+				{
+					if ( fh.streamId <= lastStreamId )
+						return h2_impl::STREAM_CLOSED;
+					lastStreamId = fh.streamId;
+				}
+				headerBlock.clear();
+				headerBlock.append( payload.begin() + start, end - start );
+				headersStreamId = fh.streamId;
+				headersFlags = fh.flags;
+				return ( fh.flags & h2_impl::END_HEADERS ) ? onHeaderBlock() : h2_impl::NO_ERROR;
+			}
+
+			uint32_t onContinuation( const h2_impl::FrameHeader& fh )
+			{
+				if ( fh.streamId != headersStreamId )
+					return h2_impl::PROTOCOL_ERROR;
+				if ( headerBlock.size() + fh.length > options.maxHeaderListSize )
+					return h2_impl::ENHANCE_YOUR_CALM;
+				headerBlock.append( payload.begin(), fh.length );
+				return ( fh.flags & h2_impl::END_HEADERS ) ? onHeaderBlock() : h2_impl::NO_ERROR;
+			}
+
+			uint32_t processFrame( const h2_impl::FrameHeader& fh )
+			{
+				if ( headersStreamId != 0 && fh.type != h2_impl::CONTINUATION )
+					return h2_impl::PROTOCOL_ERROR;
+				switch ( fh.type )
+				{
+					case h2_impl::DATA:
+						return onData( fh );
+					case h2_impl::HEADERS:
+						return onHeaders( fh );
+					case h2_impl::CONTINUATION:
+						return onContinuation( fh );
+					case h2_impl::PRIORITY:
+						return fh.length == 5 ? h2_impl::NO_ERROR : h2_impl::FRAME_SIZE_ERROR;
+					case h2_impl::RST_STREAM:
+					{
+						if ( fh.length != 4 )
+							return h2_impl::FRAME_SIZE_ERROR;
+						if ( fh.streamId == 0 || fh.streamId > lastStreamId )
+							return h2_impl::PROTOCOL_ERROR;
+						auto s = findStream( fh.streamId );
+						if ( s != nullptr && !s->reset )
+						{
+							s->reset = true;
+							deactivate( s );
+							connConsumed( s->receivedData.size() );
+							s->receivedData.clear();
+							resumeAll( s->waitingForData, true );
+							resumeAll( waitingForWindow, false );
+						}
+						return h2_impl::NO_ERROR;
+					}
+					case h2_impl::SETTINGS:
+					{
+						if ( fh.streamId != 0 )
+							return h2_impl::PROTOCOL_ERROR;
+						if ( fh.flags & h2_impl::ACK )
+							return fh.length == 0 ? h2_impl::NO_ERROR : h2_impl::FRAME_SIZE_ERROR;
+						uint32_t err = applySettings( payload.begin(), fh.length );
+						if ( err != h2_impl::NO_ERROR )
+							return err;
+						controlBuff.clear();
+						h2_impl::appendFrameHeader( controlBuff, 0, h2_impl::SETTINGS, h2_impl::ACK, 0 );
+						sendNow( controlBuff );
+						resumeAll( waitingForWindow, false );
+						return h2_impl::NO_ERROR;
+					}
+					case h2_impl::PING:
+					{
+						if ( fh.length != 8 )
+							return h2_impl::FRAME_SIZE_ERROR;
+						if ( fh.streamId != 0 )
+							return h2_impl::PROTOCOL_ERROR;
+						if ( ( fh.flags & h2_impl::ACK ) == 0 )
+						{
+							controlBuff.clear();
+							h2_impl::appendFrameHeader( controlBuff, 8, h2_impl::PING, h2_impl::ACK, 0 );
+							controlBuff.append( payload.begin(), 8 );
+							sendNow( controlBuff );
+						}
+						return h2_impl::NO_ERROR;
+					}
+					case h2_impl::GOAWAY:
+						if ( fh.streamId != 0 )
+							return h2_impl::PROTOCOL_ERROR;
+						goingAway = true;
+						return h2_impl::NO_ERROR;
+					case h2_impl::WINDOW_UPDATE:
+					{
+						if ( fh.length != 4 )
+							return h2_impl::FRAME_SIZE_ERROR;
+						uint32_t increment = h2_impl::readUint32( payload.begin() ) & 0x7FFFFFFF;
+						if ( fh.streamId == 0 )
+						{
+							if ( increment == 0 )
+								return h2_impl::PROTOCOL_ERROR;
+							connSendWindow += increment;
+							if ( connSendWindow > h2_impl::maxWindowSize )
+								return h2_impl::FLOW_CONTROL_ERROR;
+						}
+						else
+						{
+							auto s = findStream( fh.streamId );
+							if ( s != nullptr && !s->reset )
+							{
+								if ( increment == 0 )
+									resetStream( s, h2_impl::PROTOCOL_ERROR );
+								else
+								{
+									s->sendWindow += increment;
+									if ( s->sendWindow > h2_impl::maxWindowSize )
+										resetStream( s, h2_impl::FLOW_CONTROL_ERROR );
+								}
+							}
+						}
+						resumeAll( waitingForWindow, false );
+						return h2_impl::NO_ERROR;
+					}
+					case h2_impl::PUSH_PROMISE: // clients may not push
+						return h2_impl::PROTOCOL_ERROR;
+					default: // unknown frame types are to be ignored
+						return h2_impl::NO_ERROR;
+				}
+			}
+
+			void close()
+			{
+				if ( closed )
+					return;
+				closed = true;
+				nodecpp::vector<nodecpp::soft_ptr<Http2Stream>> live;
+				for ( auto& entry : streams )
+					live.push_back( entry.second );
+				for ( auto& s : live )
+				{
+					s->reset = true;
+					resumeAll( s->waitingForData, true );
+				}
+				resumeAll( waitingForWindow, true );
+				resumeAll( waitingForDrain, true );
+				if ( !sock->destroyed() )
+					sock->end();
+			}
+
+			// frames of a single call are written contiguously; when too much is buffered, all writers wait for the drain
+			::nodecpp::awaitable<void> a_send( Buffer& frames )
+			{
+				if ( closed )
+					throw Error();
+				sock->write( frames );
+				if ( sock->bufferSize() >= options.writeHighWaterMark )
+				{
+					if ( draining )
+						co_await a_waitAt( waitingForDrain );
+					else
+					{
+						draining = true;
+						try {
+							co_await sock->a_drain();
+						}
+						catch (...) {
+							draining = false;
+							resumeAll( waitingForDrain, true );
+							throw;
+						}
+						draining = false;
+						resumeAll( waitingForDrain, false );
+					}
+				}
+				CO_RETURN;
+			}
+
+		public:
+			Http2Session() : frameHeaderBuff( h2_impl::frameHeaderSize ), controlBuff( 0x100 ) {}
+			Http2Session(const Http2Session&) = delete;
+			Http2Session& operator = (const Http2Session&) = delete;
+
+			void init( nodecpp::soft_ptr<HttpSocketBase> sock_, nodecpp::soft_ptr<HttpServerBase> server_, const Http2Options& options_ )
+			{
+				sock = sock_;
+				server = server_;
+				options = options_;
+				decoder.setMaxAllowedTableSize( options.headerTableSize );
+				payload.reserve( options.maxFrameSize );
+				headerBlock.reserve( 0x1000 );
+				sock->dataForCommandProcessing.readBuffer.reserve( options.maxFrameSize + h2_impl::frameHeaderSize );
+			}
+
+			size_t streamCount() const { return activeStreams; }
+
+			// prefaceConsumed: number of bytes of client preface already consumed by HTTP/1 request parser
+			nodecpp::handler_ret_type run( size_t prefaceConsumed, nodecpp::soft_ptr<IncomingHttpMessageAtServer> upgradeRequest )
+			{
+				try {
+					nodecpp::soft_ptr<Http2Stream> upgraded;
+					if ( upgradeRequest != nullptr )
+					{
+						Buffer reply;
+						reply.appendString( nodecpp::string( "HTTP/1.1 101 Switching Protocols\r\nConnection: Upgrade\r\nUpgrade: h2c\r\n\r\n" ) );
+						sendNow( reply );
+						Buffer peerSettings;
+						if ( !h2_impl::base64UrlDecode( upgradeRequest->getHeader( "http2-settings" ), peerSettings ) || applySettings( peerSettings.begin(), peerSettings.size() ) != h2_impl::NO_ERROR )
+						{
+							sendGoAway( h2_impl::PROTOCOL_ERROR );
+							close();
+							CO_RETURN;
+						}
+						// the request becomes stream 1, half-closed on the client side
+						upgraded = openStream( 1 );
+						lastStreamId = 1;
+						*(upgraded->request) = std::move( *upgradeRequest );
+						upgraded->request->method.version = "2.0";
+						upgraded->request->readStatus = IncomingHttpMessageAtServer::ReadStatus::completed;
+						upgraded->remoteEnded = true;
+					}
+					sendSettings();
+
+					size_t prefaceRemaining = h2_impl::clientPrefaceSize - prefaceConsumed;
+					Buffer preface( h2_impl::clientPrefaceSize );
+					co_await sock->a_read( preface, prefaceRemaining, prefaceRemaining );
+					if ( memcmp( preface.begin(), h2_impl::clientPreface + prefaceConsumed, prefaceRemaining ) != 0 )
+					{
+						sendGoAway( h2_impl::PROTOCOL_ERROR );
+						close();
+						CO_RETURN;
+					}
+					if ( upgraded != nullptr )
+						dispatch( upgraded );
+
+					for (;;)
+					{
+						recycleFinished();
+						if ( goingAway && activeStreams == 0 )
+							break;
+						co_await sock->a_read( frameHeaderBuff, h2_impl::frameHeaderSize, h2_impl::frameHeaderSize );
+						h2_impl::FrameHeader fh;
+						fh.parse( frameHeaderBuff.begin() );
+						if ( fh.length > options.maxFrameSize )
+						{
+							sendGoAway( h2_impl::FRAME_SIZE_ERROR );
+							break;
+						}
+						if ( fh.length )
+							co_await sock->a_read( payload, fh.length, fh.length );
+						else
+							payload.clear();
+						uint32_t err = processFrame( fh );
+						if ( err != h2_impl::NO_ERROR )
+						{
+							sendGoAway( err );
+							break;
+						}
+					}
+				}
+				catch (...) {}
+				close();
+				CO_RETURN;
+			}
+		};
+
+		//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+		inline
+		bool HttpSocketBase::isH2cUpgrade( IncomingHttpMessageAtServer& request )
+		{
+			if ( !soft_ptr_static_cast<HttpServerBase>(myServerSocket)->getHttp2Options().enabled )
+				return false;
+			if ( request.getHttpVersion() != "1.1" || request.getContentLength() != 0 )
+				return false;
+			nodecpp::string upgrade = request.getHeader( "upgrade" );
+			return upgrade.find( "h2c" ) != nodecpp::string::npos && request.getHeader( "http2-settings" ).size() != 0;
+		}
+
+		inline
+		nodecpp::handler_ret_type HttpSocketBase::runHttp2( size_t prefaceConsumed, nodecpp::soft_ptr<IncomingHttpMessageAtServer> upgradeRequest )
+		{
+			auto server = soft_ptr_static_cast<HttpServerBase>(myServerSocket);
+			h2session = nodecpp::make_owning<Http2Session>();
+			h2session->init( myThis.getSoftPtr<HttpSocketBase>(this), server, server->getHttp2Options() );
+			co_await h2session->run( prefaceConsumed, upgradeRequest );
+			CO_RETURN;
+		}
+
+		inline
+		HttpSocketBase::~HttpSocketBase() {}
+
+		inline
+		nodecpp::handler_ret_type IncomingHttpMessageAtServer::h2ReadBody( Buffer& b )
+		{
+			b.clear();
+			auto s = h2stream;
+			while ( s->receivedData.size() == 0 && !s->remoteEnded && !s->reset )
+				co_await a_waitAt( s->waitingForData );
+			if ( s->reset )
+				throw Error();
+			std::swap( b, s->receivedData );
+			bodyBytesRetrieved += b.size();
+			s->session->consumed( s, b.size() );
+			CO_RETURN;
+		}
+
+		inline
+		void HttpServerResponse::h2SerializeHeaders()
+		{
+			NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, writeStatus == WriteStatus::notyet ); 
+			auto session = h2stream->session;
+			Buffer block( 0x400 );
+
+			// status line and, possibly, headers as put to replyStatus by writeHead()
+			size_t status = 200;
+			size_t lineEnd = replyStatus.find( '\n' );
+			size_t sp = replyStatus.find( ' ' );
+			if ( sp < lineEnd )
+				status = ::strtoul( replyStatus.c_str() + sp + 1, nullptr, 10 );
+			session->encoder.encodeStatus( status, block );
+			auto encodeHeader = [&]( nodecpp::string name, const nodecpp::string& value ) {
+				makeLower( name );
+				if ( !h2_impl::isConnectionSpecificHeader( name ) )
+					session->encoder.encode( name, value, block );
+			};
+			forEachReplyStatusHeader( encodeHeader );
+			for ( auto& h : header )
+				encodeHeader( h.first, h.second );
+
+			// HEADERS followed by CONTINUATIONs, if required
+			size_t maxFrame = session->peerMaxFrameSize;
+			size_t offset = 0;
+			headerBuff.clear();
+			do
+			{
+				size_t sz = block.size() - offset;
+				if ( sz > maxFrame )
+					sz = maxFrame;
+				bool last = offset + sz == block.size();
+				h2_impl::appendFrameHeader( headerBuff, sz, offset == 0 ? h2_impl::HEADERS : h2_impl::CONTINUATION, last ? h2_impl::END_HEADERS : 0, h2stream->id );
+				headerBuff.append( block.begin() + offset, sz );
+				offset += sz;
+			}
+			while ( offset < block.size() );
+
+			contentLength = 0;
+			auto cl = header.find( "Content-Length" );
+			if ( cl != header.end() )
+				contentLength = ::atol( cl->second.c_str() );
+			writeStatus = WriteStatus::hdr_serialized;
+			header.clear();
+		}
+
+		inline
+		nodecpp::handler_ret_type HttpServerResponse::h2WriteBody( const uint8_t* data, size_t sz, bool endStream )
+		{
+			auto s = h2stream;
+			auto session = s->session;
+			try {
+				if ( writeStatus == WriteStatus::notyet )
+					h2SerializeHeaders();
+				if ( s->reset || session->closed )
+					throw Error();
+				if ( writeStatus == WriteStatus::hdr_serialized )
+				{
+					if ( endStream && sz == 0 )
+					{
+						headerBuff.begin()[4] |= h2_impl::END_STREAM;
+						s->localEnded = true;
+					}
+					co_await session->a_send( headerBuff );
+					headerBuff.clear();
+					writeStatus = WriteStatus::hdr_flushed;
+				}
+				while ( sz || ( endStream && !s->localEnded ) )
+				{
+					while ( sz && !s->reset && !session->closed && ( s->sendWindow <= 0 || session->connSendWindow <= 0 ) )
+						co_await a_waitAt( session->waitingForWindow );
+					if ( s->reset || session->closed )
+						throw Error();
+					size_t chunk = sz;
+					if ( chunk > (size_t)(s->sendWindow) )
+						chunk = (size_t)(s->sendWindow);
+					if ( chunk > (size_t)(session->connSendWindow) )
+						chunk = (size_t)(session->connSendWindow);
+					if ( chunk > session->peerMaxFrameSize )
+						chunk = session->peerMaxFrameSize;
+					bool last = endStream && chunk == sz;
+					s->outFrame.clear();
+					h2_impl::appendFrameHeader( s->outFrame, chunk, h2_impl::DATA, last ? h2_impl::END_STREAM : 0, s->id );
+					s->outFrame.append( data, chunk );
+					s->sendWindow -= chunk;
+					session->connSendWindow -= chunk;
+					if ( last )
+						s->localEnded = true;
+					co_await session->a_send( s->outFrame );
+					data += chunk;
+					sz -= chunk;
+				}
+			}
+			catch (...) {
+				// the stream has been reset or the connection is gone; the rest of the response is silently dropped
+			}
+			writeStatus = WriteStatus::in_body;
+			CO_RETURN;
+		}
+
+		inline
+		void HttpServerResponse::h2Complete()
+		{
+			auto s = h2stream;
+			auto session = s->session;
+			if ( !s->localEnded && !s->reset && !session->closed )
+			{
+				if ( writeStatus == WriteStatus::notyet )
+					h2SerializeHeaders();
+				if ( writeStatus == WriteStatus::hdr_serialized )
+				{
+					headerBuff.begin()[4] |= h2_impl::END_STREAM;
+					session->sendNow( headerBuff );
+				}
+				else
+				{
+					headerBuff.clear();
+					h2_impl::appendFrameHeader( headerBuff, 0, h2_impl::DATA, h2_impl::END_STREAM, s->id );
+					session->sendNow( headerBuff );
+				}
+				s->localEnded = true;
+			}
+			myRequest->clear();
+			clear();
+			session->streamDone( s );
+		}
+#endif // NODECPP_NO_COROUTINES
+
+	} //namespace net
+} //namespace nodecpp
+
+#endif // NODECPP_HTTP2_H
@@ -0,0 +1,577 @@
+/* -------------------------------------------------------------------------------
+* Copyright (c) 2021, OLogN Technologies AG
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*     * Neither the name of the OLogN Technologies AG nor the
+*       names of its contributors may be used to endorse or promote products
+*       derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL OLogN Technologies AG BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+* -------------------------------------------------------------------------------*/
+
+#ifndef HTTP_CLIENT_H
+#define HTTP_CLIENT_H
+
+#include "http_server_common.h"
+#include "socket_common.h"
+#include "timers.h"
+
+#include <algorithm>
+#include <cctype>
+
+// NOTE: hosts are expected to be given as IPv4 literals (no name resolution so far)
+
+namespace nodecpp {
+
+	namespace net {
+
+		class HttpClient; // forward declaration
+		class HttpClientConnection; // forward declaration
+
+		class HttpClientRequest
+		{
+			friend class HttpClient;
+			friend class HttpClientConnection;
+
+			typedef nodecpp::map<nodecpp::string, nodecpp::string> header_t;
+			header_t header;
+
+		public:
+			nodecpp::string method = "GET";
+			nodecpp::string host;
+			uint16_t port = 80;
+			nodecpp::string path = "/";
+			Buffer body;
+
+			HttpClientRequest() {}
+			HttpClientRequest( nodecpp::string method_, nodecpp::string host_, uint16_t port_, nodecpp::string path_ ) : method( method_ ), host( host_ ), port( port_ ), path( path_ ) {}
+			HttpClientRequest(const HttpClientRequest&) = delete;
+			HttpClientRequest& operator = (const HttpClientRequest&) = delete;
+
+			void setHeader( nodecpp::string key, nodecpp::string value )
+			{
+				// TODO: sanitize
+				if ( key != "Content-Length" && key != "Host" )
+					header.insert( nodecpp::make_pair( key, value ) );
+			}
+
+			nodecpp::string origin() const { return nodecpp::format( "{}:{}", host, port ); }
+		};
+
+		class HttpClientResponse : protected HttpMessageBase
+		{
+			friend class HttpClientConnection;
+
+			nodecpp::string version;
+			size_t statusCode = 0;
+			nodecpp::string statusMessage;
+			Buffer body;
+			bool chunked = false;
+			bool keepAlive = true;
+
+			bool parseStatusLine( const nodecpp::string& line )
+			{
+				// HTTP/1.1 200 OK
+				if ( line.size() < 12 || memcmp( line.c_str(), "HTTP/", 5 ) != 0 )
+					return false;
+				size_t sp1 = line.find( ' ' );
+				if ( sp1 == nodecpp::string::npos )
+					return false;
+				version = line.substr( 5, sp1 - 5 );
+				size_t codeStart = line.find_first_not_of( ' ', sp1 );
+				if ( codeStart == nodecpp::string::npos || codeStart + 3 > line.size() )
+					return false;
+				statusCode = 0;
+				for ( size_t i=codeStart; i<codeStart + 3; ++i )
+				{
+					if ( line[i] < '0' || line[i] > '9' )
+						return false;
+					statusCode = statusCode * 10 + ( line[i] - '0' );
+				}
+				size_t msgStart = line.find_first_not_of( ' ', codeStart + 3 );
+				size_t end = line.find_last_not_of( " \t\r\n" );
+				if ( msgStart != nodecpp::string::npos && end != nodecpp::string::npos && end >= msgStart )
+					statusMessage = line.substr( msgStart, end - msgStart + 1 );
+				return true;
+			}
+
+			// returns false at the empty line that terminates the header
+			bool parseHeaderEntry( const nodecpp::string& line, bool& ok )
+			{
+				size_t end = line.find_last_not_of(" \t\r\n" );
+				if ( end == nodecpp::string::npos )
+				{
+					parseContentLength();
+					auto te = header.find( "transfer-encoding" );
+					chunked = te != header.end() && te->second.find( "chunked" ) != nodecpp::string::npos;
+					auto cs = header.find( "connection" );
+					if ( cs != header.end() )
+					{
+						nodecpp::string val = cs->second;
+						val = makeLower( val );
+						keepAlive = val.find( "close" ) == nodecpp::string::npos;
+					}
+					else
+						keepAlive = version != "1.0";
+					ok = true;
+					return false;
+				}
+				ok = addHeaderFromLine( line, end );
+				return ok;
+			}
+
+			bool hasHeaderContentLength() const { return header.find( "content-length" ) != header.end(); }
+
+		public:
+			HttpClientResponse() {}
+			HttpClientResponse(const HttpClientResponse&) = delete;
+			HttpClientResponse& operator = (const HttpClientResponse&) = delete;
+
+			void clear()
+			{
+				header.clear();
+				body.clear();
+				version.clear();
+				statusMessage.clear();
+				statusCode = 0;
+				contentLength = 0;
+				chunked = false;
+				keepAlive = true;
+			}
+
+			size_t getStatusCode() const { return statusCode; }
+			const nodecpp::string& getStatusMessage() const { return statusMessage; }
+			const nodecpp::string& getHttpVersion() const { return version; }
+			size_t getContentLength() const { return contentLength; }
+			Buffer& getBody() { return body; }
+
+			nodecpp::string getHeader( nodecpp::string key ) // empty if not present
+			{
+				auto h = header.find( makeLower( key ) );
+				return h != header.end() ? h->second : nodecpp::string();
+			}
+
+			void dbgTrace()
+			{
+				nodecpp::log::default_log::info( nodecpp::log::ModuleID(nodecpp::nodecpp_module_id), "   [<-] HTTP/{} {} {}", version, statusCode, statusMessage );
+				for ( auto& entry : header )
+					nodecpp::log::default_log::info( nodecpp::log::ModuleID(nodecpp::nodecpp_module_id), "   [<-] {}: {}", entry.first, entry.second );
+				nodecpp::log::default_log::info( nodecpp::log::ModuleID(nodecpp::nodecpp_module_id), "[CL = {}, chunked = {}, keep-alive = {}]", contentLength, chunked, keepAlive );
+			}
+		};
+
+#ifndef NODECPP_NO_COROUTINES
+		// A single keep-alive connection to an origin. Requests may be pipelined: they are written in order of arrival,
+		// and responses are read strictly in the same order (each request waits for its turn to read).
+		class HttpClientConnection
+		{
+			friend class HttpClient;
+
+		public:
+			nodecpp::soft_this_ptr<HttpClientConnection> myThis;
+
+		private:
+			static constexpr size_t maxHeaderSize = 0x4000;
+
+			nodecpp::owning_ptr<SocketBase> sock;
+			nodecpp::string host;
+			uint16_t port = 0;
+			enum State { notConnected, connecting, connected, broken };
+			State state = State::notConnected;
+			bool reusable = true;
+			bool timedOut = false;
+
+			size_t inFlight = 0;
+			uint64_t nextTicket = 0;
+			uint64_t nextToRead = 0;
+			uint64_t idleSince = 0;
+
+			nodecpp::vector<awaitable_handle_t> waitingForConnect;
+			nodecpp::vector<awaitable_handle_t> waitingForTurn;
+			nodecpp::Timeout deadline;
+			bool deadlineSet = false;
+
+			Buffer lineBuff;
+			Buffer reqBuff;
+
+			void setBroken()
+			{
+				if ( state == State::broken )
+					return;
+				state = State::broken;
+				reusable = false;
+				if ( !sock->destroyed() )
+					sock->destroy();
+				resumeAll( waitingForConnect, true );
+				resumeAll( waitingForTurn, true );
+			}
+
+			void armDeadline( uint32_t ms )
+			{
+				if ( deadlineSet )
+					nodecpp::clearTimeout( deadline );
+				nodecpp::soft_ptr<HttpClientConnection> myPtr = myThis.getSoftPtr<HttpClientConnection>(this);
+				deadline = nodecpp::setTimeout( [myPtr]() { myPtr->deadlineSet = false; myPtr->timedOut = true; myPtr->setBroken(); }, ms );
+				deadlineSet = true;
+			}
+
+			void disarmDeadline()
+			{
+				if ( deadlineSet )
+				{
+					nodecpp::clearTimeout( deadline );
+					deadlineSet = false;
+				}
+			}
+
+			::nodecpp::awaitable<bool> readLine( nodecpp::string& line )
+			{
+				lineBuff.clear();
+				CoroStandardOutcomes ret = co_await sock->a_readUntil( lineBuff, '\n' );
+				if ( ret != CoroStandardOutcomes::ok )
+					CO_RETURN false;
+#ifdef NODECPP_USE_SAFE_MEMORY_CONTAINERS					
+				line.assign_unsafe( (const char*)(lineBuff.begin()), lineBuff.size() );
+#else
+				line.assign( (const char*)(lineBuff.begin()), lineBuff.size() );
+#endif // NODECPP_USE_SAFE_MEMORY_CONTAINERS					
+				CO_RETURN true;
+			}
+
+			// payload goes from socket's read buffer directly to b
+			::nodecpp::awaitable<void> readExactly( Buffer& b, size_t sz )
+			{
+				auto& readBuffer = sock->dataForCommandProcessing.readBuffer;
+				while ( sz )
+				{
+					if ( readBuffer.empty() )
+						co_await sock->a_someDataAvailable();
+					sz -= readBuffer.append_ready_data( b, sz );
+				}
+				CO_RETURN;
+			}
+
+			// chunk-size [ chunk-ext ] CRLF
+			static bool parseChunkSize( const nodecpp::string& line, size_t& sz )
+			{
+				const char* p = line.c_str();
+				const char* digits = p;
+				sz = 0;
+				for ( ; isxdigit( (unsigned char)*p ); ++p )
+				{
+					if ( sz >> ( sizeof( size_t ) * 8 - 4 ) )
+						return false; // would overflow
+					sz = ( sz << 4 ) | ( *p <= '9' ? *p - '0' : ( *p | 0x20 ) - 'a' + 10 );
+				}
+				if ( p == digits )
+					return false;
+				while ( *p == ' ' || *p == '\t' )
+					++p;
+				return *p == ';' || *p == '\r' || *p == '\n';
+			}
+
+			::nodecpp::awaitable<bool> readResponse( const HttpClientRequest& request, HttpClientResponse& response, size_t maxBodySize )
+			{
+				nodecpp::string line;
+				do // skip interim 1xx responses
+				{
+					response.clear();
+					if ( !co_await readLine( line ) || !response.parseStatusLine( line ) )
+						CO_RETURN false;
+					bool ok = true;
+					for (;;)
+					{
+						if ( !co_await readLine( line ) )
+							CO_RETURN false;
+						if ( !response.parseHeaderEntry( line, ok ) )
+							break;
+					}
+					if ( !ok )
+						CO_RETURN false;
+				}
+				while ( response.statusCode >= 100 && response.statusCode < 200 );
+
+				bool noBody = request.method == "HEAD" || response.statusCode == 204 || response.statusCode == 304;
+				if ( noBody )
+					;
+				else if ( response.chunked )
+				{
+					for (;;)
+					{
+						if ( !co_await readLine( line ) )
+							CO_RETURN false;
+						size_t chunkSz = 0;
+						if ( !parseChunkSize( line, chunkSz ) )
+							CO_RETURN false;
+						if ( chunkSz == 0 )
+							break;
+						if ( chunkSz > maxBodySize - response.body.size() )
+							CO_RETURN false;
+						co_await readExactly( response.body, chunkSz );
+						if ( !co_await readLine( line ) ) // CRLF after chunk data
+							CO_RETURN false;
+					}
+					for (;;) // trailers (ignored)
+					{
+						if ( !co_await readLine( line ) )
+							CO_RETURN false;
+						if ( line.find_last_not_of( " \t\r\n" ) == nodecpp::string::npos )
+							break;
+					}
+				}
+				else if ( response.hasHeaderContentLength() )
+				{
+					if ( response.contentLength > maxBodySize )
+						CO_RETURN false;
+					co_await readExactly( response.body, response.contentLength );
+				}
+				else
+				{
+					// body is delimited by connection close
+					response.keepAlive = false;
+					auto& readBuffer = sock->dataForCommandProcessing.readBuffer;
+					try {
+						for (;;)
+						{
+							if ( readBuffer.empty() )
+								co_await sock->a_someDataAvailable();
+							readBuffer.append_ready_data( response.body, readBuffer.used_size() );
+							if ( response.body.size() > maxBodySize )
+								CO_RETURN false;
+						}
+					}
+					catch (...) {}
+				}
+				CO_RETURN true;
+			}
+
+			void serializeRequest( HttpClientRequest& request )
+			{
+				reqBuff.clear();
+				reqBuff.appendString( nodecpp::format( "{} {} HTTP/1.1\r\nHost: {}:{}\r\n", request.method, request.path, request.host, request.port ) );
+				for ( auto& h : request.header )
+					reqBuff.appendString( nodecpp::format( "{}: {}\r\n", h.first, h.second ) );
+				if ( request.body.size() || request.method == "POST" || request.method == "PUT" || request.method == "PATCH" )
+					reqBuff.appendString( nodecpp::format( "Content-Length: {}\r\n", request.body.size() ) );
+				reqBuff.append( "\r\n", 2 );
+				if ( request.body.size() )
+					reqBuff.append( request.body );
+			}
+
+		public:
+			HttpClientConnection() : lineBuff( maxHeaderSize ), reqBuff( 0x1000 ) {}
+			HttpClientConnection(const HttpClientConnection&) = delete;
+			HttpClientConnection& operator = (const HttpClientConnection&) = delete;
+			~HttpClientConnection() { disarmDeadline(); }
+
+			bool isUsable() const { return state != State::broken && reusable; }
+			size_t pending() const { return inFlight; }
+
+			::nodecpp::awaitable<CoroStandardOutcomes> a_request( HttpClientRequest& request, HttpClientResponse& response, uint32_t connectTimeoutMs, uint32_t responseTimeoutMs, size_t maxBodySize )
+			{
+				uint64_t ticket = nextTicket++;
+				++inFlight;
+				CoroStandardOutcomes ret = CoroStandardOutcomes::ok;
+				try {
+					// requests are written in the order of tickets (writing is synchronous, and waiters for connection are resumed in the order of waiting)
+					if ( state == State::notConnected )
+					{
+						state = State::connecting;
+						armDeadline( connectTimeoutMs );
+						co_await sock->a_connect( port, host.c_str() );
+						disarmDeadline();
+						state = State::connected;
+						serializeRequest( request );
+						sock->write( reqBuff );
+						resumeAll( waitingForConnect, false ); // they write theirs synchronously, that is, after ours
+					}
+					else
+					{
+						if ( state == State::connecting )
+							co_await a_waitAt( waitingForConnect );
+						if ( state != State::connected )
+							throw Error();
+						serializeRequest( request );
+						sock->write( reqBuff );
+					}
+
+					while ( nextToRead != ticket )
+						co_await a_waitAt( waitingForTurn );
+
+					armDeadline( responseTimeoutMs );
+					bool ok = co_await readResponse( request, response, maxBodySize );
+					disarmDeadline();
+					if ( !ok )
+					{
+						ret = CoroStandardOutcomes::failed;
+						setBroken();
+					}
+					else if ( !response.keepAlive )
+						reusable = false;
+					++nextToRead;
+					resumeAll( waitingForTurn, false );
+				}
+				catch (...) {
+					disarmDeadline();
+					ret = timedOut ? CoroStandardOutcomes::timeout : CoroStandardOutcomes::failed;
+					setBroken();
+				}
+				--inFlight;
+				if ( inFlight == 0 )
+				{
+					idleSince = infraGetCurrentTime();
+					if ( !reusable && state == State::connected )
+						sock->end();
+				}
+				CO_RETURN ret;
+			}
+		};
+
+		// Keeps a pool of keep-alive connections per origin ("host:port"); idle connections are closed by a periodic sweep
+		class HttpClient
+		{
+		public:
+			struct Options
+			{
+				size_t maxConnectionsPerOrigin = 8;
+				size_t maxPipelineDepth = 1; // 1 means no pipelining
+				uint32_t idleTimeoutMs = 30000;
+				uint32_t connectTimeoutMs = 5000;
+				uint32_t responseTimeoutMs = 30000;
+				size_t maxResponseBodySize = 0x4000000;
+			};
+
+		private:
+			struct Pool
+			{
+				nodecpp::vector<nodecpp::owning_ptr<HttpClientConnection>> conns;
+			};
+			nodecpp::map<nodecpp::string, Pool> pools;
+			Options options;
+			nodecpp::Timeout sweepTimer;
+			bool sweepRunning = false;
+
+			nodecpp::soft_ptr<HttpClientConnection> acquire( HttpClientRequest& request )
+			{
+				Pool& pool = pools[request.origin()];
+				removeUnusable( pool );
+				nodecpp::soft_ptr<HttpClientConnection> best;
+				size_t bestLoad = SIZE_MAX;
+				for ( auto& c : pool.conns )
+					if ( c->isUsable() && c->pending() < bestLoad )
+					{
+						best = c;
+						bestLoad = c->pending();
+					}
+				if ( best != nullptr && ( bestLoad == 0 || ( bestLoad < options.maxPipelineDepth ) || pool.conns.size() >= options.maxConnectionsPerOrigin ) )
+					return best; // NOTE: if all connections are saturated, the request is queued behind the least loaded one
+				nodecpp::owning_ptr<HttpClientConnection> conn = nodecpp::make_owning<HttpClientConnection>();
+				conn->sock = net::createSocket();
+				conn->host = request.host;
+				conn->port = request.port;
+				nodecpp::soft_ptr<HttpClientConnection> ret = conn;
+				pool.conns.push_back( std::move( conn ) );
+				startSweep();
+				return ret;
+			}
+
+			static void removeUnusable( Pool& pool )
+			{
+				for ( size_t i=0; i<pool.conns.size(); )
+					if ( !pool.conns[i]->isUsable() && pool.conns[i]->pending() == 0 )
+					{
+						pool.conns[i] = std::move( pool.conns.back() );
+						pool.conns.pop_back();
+					}
+					else
+						++i;
+			}
+
+			void startSweep()
+			{
+				if ( sweepRunning )
+					return;
+				sweepRunning = true;
+				sweepTimer = nodecpp::setTimeout( [this]() { sweepIdle(); }, options.idleTimeoutMs / 2 ? options.idleTimeoutMs / 2 : 1 );
+			}
+
+			void sweepIdle()
+			{
+				uint64_t now = infraGetCurrentTime();
+				uint64_t idleTimeout = (uint64_t)(options.idleTimeoutMs) * 1000;
+				size_t remaining = 0;
+				for ( auto& entry : pools )
+				{
+					Pool& pool = entry.second;
+					for ( auto& c : pool.conns )
+						if ( c->pending() == 0 && c->isUsable() && now - c->idleSince >= idleTimeout )
+						{
+							c->reusable = false;
+							if ( c->state == HttpClientConnection::State::connected )
+								c->sock->end();
+						}
+					removeUnusable( pool );
+					remaining += pool.conns.size();
+				}
+				sweepRunning = false;
+				if ( remaining )
+					startSweep();
+			}
+
+		public:
+			HttpClient() {}
+			HttpClient( const Options& options_ ) : options( options_ ) {}
+			HttpClient(const HttpClient&) = delete;
+			HttpClient& operator = (const HttpClient&) = delete;
+			~HttpClient()
+			{
+				if ( sweepRunning )
+					nodecpp::clearTimeout( sweepTimer );
+			}
+
+			const Options& getOptions() const { return options; }
+
+			::nodecpp::awaitable<CoroStandardOutcomes> a_request( HttpClientRequest& request, HttpClientResponse& response )
+			{
+				nodecpp::soft_ptr<HttpClientConnection> conn = acquire( request );
+				CoroStandardOutcomes ret = co_await conn->a_request( request, response, options.connectTimeoutMs, options.responseTimeoutMs, options.maxResponseBodySize );
+				CO_RETURN ret;
+			}
+
+			::nodecpp::awaitable<CoroStandardOutcomes> a_get( nodecpp::string host, uint16_t port, nodecpp::string path, HttpClientResponse& response )
+			{
+				HttpClientRequest request( "GET", host, port, path );
+				CoroStandardOutcomes ret = co_await a_request( request, response );
+				CO_RETURN ret;
+			}
+
+			size_t connectionCount() const
+			{
+				size_t ret = 0;
+				for ( auto& entry : pools )
+					ret += entry.second.conns.size();
+				return ret;
+			}
+		};
+#endif // NODECPP_NO_COROUTINES
+
+	} //namespace net
+} //namespace nodecpp
+
+#endif // HTTP_CLIENT_H
@@ -0,0 +1,349 @@
+/* -------------------------------------------------------------------------------
+* Copyright (c) 2021, OLogN Technologies AG
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*     * Neither the name of the OLogN Technologies AG nor the
+*       names of its contributors may be used to endorse or promote products
+*       derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL OLogN Technologies AG BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+* -------------------------------------------------------------------------------*/
+
+#ifndef NODECPP_HTTP_COMPRESSION_H
+#define NODECPP_HTTP_COMPRESSION_H
+
+#include "common.h"
+#include "common_structs.h"
+#include "fs.h"
+
+#include <algorithm>
+#include <cctype>
+
+#ifdef NODECPP_ENABLE_HTTP_COMPRESSION
+#include <zlib.h>
+#endif // NODECPP_ENABLE_HTTP_COMPRESSION
+
+namespace nodecpp {
+
+	namespace net {
+
+		enum class ContentEncoding { identity, deflate, gzip };
+
+		struct HttpCompressionOptions
+		{
+			bool enabled = false;
+			int level = 6; // zlib level, 1 (fastest) to 9 (best)
+			size_t minSize = 1024; // smaller bodies are sent as is
+			bool allowGzip = true;
+			bool allowDeflate = true;
+		};
+
+		inline
+		const char* contentEncodingName( ContentEncoding enc )
+		{
+			switch ( enc )
+			{
+				case ContentEncoding::gzip: return "gzip";
+				case ContentEncoding::deflate: return "deflate";
+				default: return "identity";
+			}
+		}
+
+		// picks the best encoding out of Accept-Encoding value (e.g. "gzip;q=0.8, deflate, br"); gzip wins ties
+		inline
+		ContentEncoding negotiateContentEncoding( const nodecpp::string& acceptEncoding, const HttpCompressionOptions& options )
+		{
+#ifdef NODECPP_ENABLE_HTTP_COMPRESSION
+			if ( !options.enabled )
+				return ContentEncoding::identity;
+			int qGzip = -1, qDeflate = -1, qAny = -1; // in thousandths
+			size_t pos = 0;
+			while ( pos < acceptEncoding.size() )
+			{
+				size_t next = acceptEncoding.find( ',', pos );
+				if ( next == nodecpp::string::npos )
+					next = acceptEncoding.size();
+				size_t start = acceptEncoding.find_first_not_of( " \t", pos );
+				if ( start < next )
+				{
+					size_t semicolon = acceptEncoding.find( ';', start );
+					size_t tokenEnd = semicolon < next ? semicolon : next;
+					while ( tokenEnd > start && ( acceptEncoding[tokenEnd-1] == ' ' || acceptEncoding[tokenEnd-1] == '\t' ) )
+						--tokenEnd;
+					int q = 1000;
+					if ( semicolon < next )
+					{
+						size_t qpos = acceptEncoding.find( "q=", semicolon );
+						if ( qpos < next )
+						{
+							double val = ::atof( acceptEncoding.c_str() + qpos + 2 );
+							q = (int)( val * 1000 + 0.5 );
+						}
+					}
+					auto tokenIs = [&]( const char* name ) {
+						size_t ln = strlen( name );
+						if ( tokenEnd - start != ln )
+							return false;
+						for ( size_t i=0; i<ln; ++i )
+							if ( std::tolower( (unsigned char)(acceptEncoding[start+i]) ) != name[i] )
+								return false;
+						return true;
+					};
+					if ( tokenIs( "gzip" ) || tokenIs( "x-gzip" ) )
+						qGzip = q;
+					else if ( tokenIs( "deflate" ) )
+						qDeflate = q;
+					else if ( tokenIs( "*" ) )
+						qAny = q;
+				}
+				pos = next + 1;
+			}
+			if ( qGzip < 0 )
+				qGzip = qAny;
+			if ( qDeflate < 0 )
+				qDeflate = qAny;
+			if ( !options.allowGzip )
+				qGzip = 0;
+			if ( !options.allowDeflate )
+				qDeflate = 0;
+			if ( qGzip > 0 && qGzip >= qDeflate )
+				return ContentEncoding::gzip;
+			if ( qDeflate > 0 )
+				return ContentEncoding::deflate;
+#endif // NODECPP_ENABLE_HTTP_COMPRESSION
+			return ContentEncoding::identity;
+		}
+
+		// already compressed media gains nothing from another pass
+		inline
+		bool isCompressibleContentType( const nodecpp::string& contentType )
+		{
+			auto startsWith = [&]( const char* prefix ) { return contentType.compare( 0, strlen( prefix ), prefix ) == 0; };
+			if ( startsWith( "image/" ) )
+				return startsWith( "image/svg" ) || startsWith( "image/bmp" );
+			if ( startsWith( "video/" ) || startsWith( "audio/" ) || startsWith( "font/woff" ) )
+				return false;
+			return contentType.find( "zip" ) == nodecpp::string::npos && contentType.find( "compressed" ) == nodecpp::string::npos;
+		}
+
+#ifdef NODECPP_ENABLE_HTTP_COMPRESSION
+		// zlib deflate stream; initialized once and then reset between responses (deflateInit2() is by far the most expensive part)
+		class DeflateContext
+		{
+			z_stream strm;
+			ContentEncoding encoding;
+			int level;
+
+			void drain( Buffer& out, int flush )
+			{
+				uint8_t scratch[0x4000];
+				int ret;
+				do
+				{
+					strm.next_out = scratch;
+					strm.avail_out = sizeof( scratch );
+					ret = deflate( &strm, flush );
+					NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, ret != Z_STREAM_ERROR ); 
+					out.append( scratch, sizeof( scratch ) - strm.avail_out );
+				}
+				while ( strm.avail_out == 0 || ( flush == Z_FINISH && ret != Z_STREAM_END ) );
+			}
+
+		public:
+			DeflateContext( ContentEncoding encoding_, int level_ ) : encoding( encoding_ ), level( level_ )
+			{
+				NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, encoding != ContentEncoding::identity ); 
+				memset( &strm, 0, sizeof( strm ) );
+				int ret = deflateInit2( &strm, level, Z_DEFLATED, encoding == ContentEncoding::gzip ? 15 + 16 : 15, 8, Z_DEFAULT_STRATEGY );
+				if ( ret != Z_OK )
+					throw Error();
+			}
+			DeflateContext(const DeflateContext&) = delete;
+			DeflateContext& operator = (const DeflateContext&) = delete;
+			~DeflateContext() { deflateEnd( &strm ); }
+
+			ContentEncoding getEncoding() const { return encoding; }
+
+			void reset( int level_ )
+			{
+				deflateReset( &strm );
+				if ( level_ != level )
+				{
+					deflateParams( &strm, level_, Z_DEFAULT_STRATEGY );
+					level = level_;
+				}
+			}
+
+			size_t bound( size_t sz ) { return deflateBound( &strm, (uLong)sz ); }
+
+			void write( const uint8_t* data, size_t sz, Buffer& out, bool finish )
+			{
+				strm.next_in = const_cast<uint8_t*>( data );
+				strm.avail_in = (uInt)sz;
+				drain( out, finish ? Z_FINISH : Z_NO_FLUSH );
+				NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, strm.avail_in == 0 ); 
+			}
+		};
+
+		// per-thread free lists of deflate contexts
+		class DeflateContextPool
+		{
+			static constexpr size_t maxRetained = 16;
+			struct FreeList
+			{
+				std::vector<std::unique_ptr<DeflateContext>> gzip;
+				std::vector<std::unique_ptr<DeflateContext>> deflate;
+			};
+			static FreeList& freeList() { thread_local FreeList fl; return fl; }
+
+		public:
+			static std::unique_ptr<DeflateContext> acquire( ContentEncoding enc, int level )
+			{
+				auto& list = enc == ContentEncoding::gzip ? freeList().gzip : freeList().deflate;
+				if ( list.empty() )
+					return std::make_unique<DeflateContext>( enc, level );
+				std::unique_ptr<DeflateContext> ret = std::move( list.back() );
+				list.pop_back();
+				ret->reset( level );
+				return ret;
+			}
+			static void release( std::unique_ptr<DeflateContext> ctx )
+			{
+				if ( ctx == nullptr )
+					return;
+				auto& list = ctx->getEncoding() == ContentEncoding::gzip ? freeList().gzip : freeList().deflate;
+				if ( list.size() < maxRetained )
+					list.push_back( std::move( ctx ) );
+			}
+		};
+
+		inline
+		Buffer compressBuffer( const uint8_t* data, size_t sz, ContentEncoding enc, int level )
+		{
+			std::unique_ptr<DeflateContext> ctx = DeflateContextPool::acquire( enc, level );
+			Buffer out( ctx->bound( sz ) );
+			ctx->write( data, sz, out, true );
+			DeflateContextPool::release( std::move( ctx ) );
+			return out;
+		}
+#endif // NODECPP_ENABLE_HTTP_COMPRESSION
+
+		// static content kept along with its compressed representations (made once, on adding)
+		class PrecompressedContent
+		{
+			friend class PrecompressedCache;
+
+			Buffer identity;
+			Buffer gzip;
+			Buffer deflate;
+			nodecpp::string contentType;
+
+		public:
+			PrecompressedContent() {}
+			PrecompressedContent(const PrecompressedContent&) = delete;
+			PrecompressedContent& operator = (const PrecompressedContent&) = delete;
+
+			void set( Buffer&& content, nodecpp::string contentType_, int level )
+			{
+				identity = std::move( content );
+				contentType = contentType_;
+				gzip.clear();
+				deflate.clear();
+#ifdef NODECPP_ENABLE_HTTP_COMPRESSION
+				if ( identity.size() && isCompressibleContentType( contentType ) )
+				{
+					gzip = compressBuffer( identity.begin(), identity.size(), ContentEncoding::gzip, level );
+					if ( gzip.size() >= identity.size() )
+						gzip.clear();
+					else
+						deflate = compressBuffer( identity.begin(), identity.size(), ContentEncoding::deflate, level );
+				}
+#endif // NODECPP_ENABLE_HTTP_COMPRESSION
+			}
+
+			const nodecpp::string& getContentType() const { return contentType; }
+			size_t size() const { return identity.size(); }
+			size_t memoryUsed() const { return identity.size() + gzip.size() + deflate.size(); }
+
+			// returns the best available representation; enc is updated to what is actually returned
+			const Buffer& get( ContentEncoding& enc ) const
+			{
+				if ( enc == ContentEncoding::gzip && gzip.size() )
+					return gzip;
+				if ( enc == ContentEncoding::deflate && deflate.size() )
+					return deflate;
+				enc = ContentEncoding::identity;
+				return identity;
+			}
+		};
+
+		// per-thread cache of static responses
+		class PrecompressedCache
+		{
+			nodecpp::map<nodecpp::string, nodecpp::owning_ptr<PrecompressedContent>> entries;
+			size_t memUsed = 0;
+
+		public:
+			PrecompressedCache() {}
+			PrecompressedCache(const PrecompressedCache&) = delete;
+			PrecompressedCache& operator = (const PrecompressedCache&) = delete;
+
+			nodecpp::soft_ptr<PrecompressedContent> find( const nodecpp::string& key )
+			{
+				auto it = entries.find( key );
+				if ( it == entries.end() )
+					return nodecpp::soft_ptr<PrecompressedContent>();
+				return it->second;
+			}
+
+			nodecpp::soft_ptr<PrecompressedContent> add( const nodecpp::string& key, Buffer&& content, nodecpp::string contentType, int level = 9 )
+			{
+				remove( key );
+				nodecpp::owning_ptr<PrecompressedContent> entry = nodecpp::make_owning<PrecompressedContent>();
+				entry->set( std::move( content ), contentType, level );
+				memUsed += entry->memoryUsed();
+				nodecpp::soft_ptr<PrecompressedContent> ret = entry;
+				entries.insert( nodecpp::make_pair( key, std::move( entry ) ) );
+				return ret;
+			}
+
+			nodecpp::soft_ptr<PrecompressedContent> addFile( const nodecpp::string& key, nodecpp::string path, nodecpp::string contentType, int level = 9 )
+			{
+				return add( key, fs::readFileSync( path ), contentType, level );
+			}
+
+			void remove( const nodecpp::string& key )
+			{
+				auto it = entries.find( key );
+				if ( it != entries.end() )
+				{
+					memUsed -= it->second->memoryUsed();
+					entries.erase( it );
+				}
+			}
+
+			void clear() { entries.clear(); memUsed = 0; }
+			size_t memoryUsed() const { return memUsed; }
+			size_t count() const { return entries.size(); }
+		};
+
+	} //namespace net
+} //namespace nodecpp
+
+#endif // NODECPP_HTTP_COMPRESSION_H
@@ -30,6 +30,7 @@
 
 #include "common.h"
 #include "server_common.h"
+#include "http_compression.h"
 
 #include <algorithm>
 #include <cctype>
@@ -47,6 +48,17 @@ namespace nodecpp {
 		class IncomingHttpMessageAtServer; // forward declaration
 		class HttpServerResponse; // forward declaration
 
+		struct Http2Options
+		{
+			bool enabled = false; // h2c, both with prior knowledge and via Upgrade
+			uint32_t maxConcurrentStreams = 256;
+			uint32_t initialWindowSize = 0x100000; // for both stream and connection level
+			uint32_t maxFrameSize = 0x4000;
+			size_t headerTableSize = 4096;
+			size_t maxHeaderListSize = 0x10000;
+			size_t writeHighWaterMark = 0x40000; // writers of all streams wait for the drain above this
+		};
+
 		class HttpServerBase : public nodecpp::net::ServerBase
 		{
 		public:
@@ -327,6 +339,15 @@ namespace nodecpp {
 				DataForHttpCommandProcessing::userHandlerClassPattern.getPatternForUpdate<UserClass>().template addHandler<handler, memmberFn, UserClass>();
 			}
 
+			// defaults for responses; may be overridden per response (that is, per route) by HttpServerResponse::setCompression()
+			HttpCompressionOptions compressionOptions;
+			void setCompression( const HttpCompressionOptions& options ) { compressionOptions = options; }
+			const HttpCompressionOptions& getCompression() const { return compressionOptions; }
+
+			Http2Options http2Options;
+			void enableHttp2( const Http2Options& options ) { http2Options = options; http2Options.enabled = true; }
+			const Http2Options& getHttp2Options() const { return http2Options; }
+
 			EventEmitter<event::HttpRequest> eHttpRequest;
 			void on(nodecpp::string_literal name, event::HttpRequest::callback cb NODECPP_MAY_EXTEND_TO_THIS) {
 				NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, name == string_literal(event::HttpRequest::name));
@@ -393,12 +414,26 @@ namespace nodecpp {
 				return str;
 			}
 
+			// parses 'key: value' line (end is the position of its last non-space character) and adds it to header
+			bool addHeaderFromLine( const nodecpp::string& line, size_t end )
+			{
+				size_t start = line.find_first_not_of( " \t" );
+				size_t idx = line.find(':', start);
+				if ( idx >= end )
+					return false;
+				size_t valStart = line.find_first_not_of( " \t", idx + 1 );
+				nodecpp::string key = line.substr( start, idx-start );
+				header.insert( nodecpp::make_pair( makeLower( key ), line.substr( valStart, end - valStart + 1 ) ));
+				return true;
+			}
+
 			void parseContentLength()
 			{
 				auto cl = header.find( "content-length" );
 				if ( cl != header.end() )
 					contentLength = ::atol( cl->second.c_str() ); // quick and dirty; TODO: revise
-				contentLength = 0;
+				else
+					contentLength = 0;
 			}
 
 			void parseConnStatus()
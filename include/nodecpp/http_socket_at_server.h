@@ -31,10 +31,13 @@
 #include "http_server_common.h"
 #include "socket_common.h"
 #include "url.h"
+#include "fs.h"
+#include "metrics.h"
 
 #include <algorithm>
 #include <cctype>
 #include <string>
+#include <string_view>
 
 
 // NOTE: current implementation is anty-optimal; it's just a sketch of what could be in use
@@ -45,11 +48,25 @@ namespace nodecpp {
 
 		class IncomingHttpMessageAtServer; // forward declaration
 		class HttpServerResponse; // forward declaration
+		class HttpBodyStream; // forward declaration
+		class WebSocket; // forward declaration
+		class Http2Session; // forward declaration
+		class Http2Stream; // forward declaration
+
+		struct HttpRequestTimings // mks (see infraGetCurrentTime()); 0 for a point not reached (yet)
+		{
+			uint64_t firstByteAt = 0; // the request line has been received (by the loop clock)
+			uint64_t headersParsedAt = 0; // (by the loop clock)
+			uint64_t handlerInvokedAt = 0;
+			uint64_t firstResponseByteAt = 0; // the head of the response has been handed over to the socket
+			uint64_t completedAt = 0; // the whole response has been flushed to the OS
+		};
 
         class HttpSocketBase : public nodecpp::net::SocketBase
 		{
 			friend class IncomingHttpMessageAtServer;
 			friend class HttpServerResponse;
+			friend class Http2Session;
 
 #ifndef NODECPP_NO_COROUTINES
 			static constexpr size_t maxHeaderSize = 0x4000;
@@ -73,12 +90,14 @@ namespace nodecpp {
 				uint64_t tail = 0;
 				size_t idxToStorageIdx(size_t idx ) { return idx & ((((size_t)1)<<sizeExp)-1); }
 				size_t capacity() { return ((size_t)1)<<sizeExp; }
+				static size_t pairBytes() { return sizeof( RRPair ) + sizeof( IncomingHttpMessageAtServer ) + sizeof( HttpServerResponse ); } // as accounted; their buffers are accounted by themselves
 			public:
 				RRQueue() {}
 				~RRQueue() { 
 					if ( cbuff != nullptr ) {
 						size_t size = ((size_t)1 << sizeExp);
 						nodecpp::dealloc( cbuff, size );
+						nodecpp::metrics::chargeMemory( nodecpp::metrics::MemCategory::HttpMessages, -(int64_t)( size * pairBytes() ) );
 					}
 				}
 				void init( nodecpp::soft_ptr<HttpSocketBase> );
@@ -111,6 +130,33 @@ namespace nodecpp {
 			bool release( size_t idx ) { return rrQueue.release( idx ); }
 
 			awaitable_handle_t ahd_continueGetting = nullptr;
+			bool upgraded = false; // once set (for instance, by WebSocket handshake), the socket is no longer processed as HTTP
+			bool h2PrefaceSeen = false; // first line of HTTP/2 client preface came instead of a request
+			nodecpp::owning_ptr<Http2Session> h2session;
+
+			struct UnflushedResponse // handed over to the socket, but not yet flushed to the OS
+			{
+				HttpRequestTimings t;
+				nodecpp::metrics::HttpRouteMetrics* route = nullptr;
+				nodecpp::string method;
+				nodecpp::string path; // without the query, for the slow request log
+			};
+			nodecpp::vector<UnflushedResponse> unflushedResponses; // their timings are completed as the write backlog is flushed; dropped if the connection goes away first
+			struct SlowRequestLog
+			{
+				uint64_t lastLoggedAt = 0;
+				uint64_t suppressed = 0;
+			};
+			static inline thread_local SlowRequestLog slowRequestLog;
+			void responseHandedOver( UnflushedResponse&& r );
+			void recordTimings( UnflushedResponse& r );
+
+		protected:
+			void onWriteBacklogFlushed() override;
+
+		private:
+			bool isH2cUpgrade( IncomingHttpMessageAtServer& request );
+			nodecpp::handler_ret_type runHttp2( size_t prefaceConsumed, nodecpp::soft_ptr<IncomingHttpMessageAtServer> upgradeRequest );
 
 #ifndef NODECPP_NO_COROUTINES
 			auto a_continueGetting() { 
@@ -167,7 +213,7 @@ namespace nodecpp {
 
 		public:
 			HttpSocketBase();
-			virtual ~HttpSocketBase() {}
+			virtual ~HttpSocketBase();
 
 #ifndef NODECPP_NO_COROUTINES
 			nodecpp::handler_ret_type run()
@@ -180,11 +226,26 @@ namespace nodecpp {
 
 					if ( status == CoroStandardOutcomes::ok ) // the most likely outcome
 					{
+						if ( isH2cUpgrade( *(rrPair.request) ) )
+						{
+							co_await runHttp2( 0, rrPair.request );
+							CO_RETURN;
+						}
+						rrPair.response->compression = soft_ptr_static_cast<HttpServerBase>(myServerSocket)->getCompression();
 						soft_ptr_static_cast<HttpServerBase>(myServerSocket)->onNewRequest( rrPair.request, rrPair.response );
+						if ( upgraded )
+							CO_RETURN;
 						if ( rrQueue.canPush() )
 							continue;
 						auto cg = a_continueGetting();
 						co_await cg;
+						if ( upgraded )
+							CO_RETURN;
+					}
+					else if ( h2PrefaceSeen )
+					{
+						co_await runHttp2( sizeof("PRI * HTTP/2.0\r\n") - 1, nodecpp::soft_ptr<IncomingHttpMessageAtServer>() );
+						CO_RETURN;
 					}
 					else
 					{
@@ -196,6 +257,9 @@ namespace nodecpp {
 				CO_RETURN;
 			}
 
+			void markUpgraded() { upgraded = true; }
+			bool isUpgraded() const { return upgraded; }
+
 			void proceedToNext()
 			{
 				if ( rrQueue.canPush() && ahd_continueGetting != nullptr )
@@ -244,6 +308,11 @@ namespace nodecpp {
 		class IncomingHttpMessageAtServer : protected HttpMessageBase // TODO: candidate for being a part of lib
 		{
 			friend class HttpSocketBase;
+			friend class HttpBodyStream;
+			friend class WebSocket;
+			friend class Http2Session;
+			friend class HttpServerResponse;
+			friend class HttpServerBase;
 
 		private:
 			struct Method // so far a struct
@@ -260,7 +329,19 @@ namespace nodecpp {
 			ReadStatus readStatus = ReadStatus::noinit;
 			size_t bodyBytesRetrieved = 0;
 
+		public:
+			using Timings = HttpRequestTimings;
+
+		private:
+			Timings timings;
+			nodecpp::string route; // for per-route metrics; if empty, the request is accounted under "(unrouted)"
+
+			nodecpp::soft_ptr<Http2Stream> h2stream; // set for messages coming over HTTP/2
+
 		private:
+#ifndef NODECPP_NO_COROUTINES
+			nodecpp::handler_ret_type h2ReadBody( Buffer& b );
+#endif // NODECPP_NO_COROUTINES
 
 		public:
 			IncomingHttpMessageAtServer() {}
@@ -292,10 +373,17 @@ namespace nodecpp {
 				contentLength = 0;
 				readStatus = ReadStatus::noinit;
 				bodyBytesRetrieved = 0;
+				timings = Timings();
+				route.clear();
 			}
 #ifndef NODECPP_NO_COROUTINES
 			nodecpp::handler_ret_type a_readBody( Buffer& b )
 			{
+				if ( h2stream != nullptr ) // whatever is available; empty at the end of the body
+				{
+					co_await h2ReadBody( b );
+					CO_RETURN;
+				}
 				if ( bodyBytesRetrieved < getContentLength() )
 				{
 					b.clear();
@@ -357,14 +445,7 @@ namespace nodecpp {
 					readStatus = contentLength ? ReadStatus::in_body : ReadStatus::completed;
 					return false;
 				}
-				size_t start = line.find_first_not_of( " \t" );
-				size_t idx = line.find(':', start);
-				if ( idx >= end )
-					return false;
-				size_t valStart = line.find_first_not_of( " \t", idx + 1 );
-				nodecpp::string key = line.substr( start, idx-start );
-				header.insert( nodecpp::make_pair( makeLower( key ), line.substr( valStart, end - valStart + 1 ) ));
-				return true;
+				return addHeaderFromLine( line, end );
 			}
 
 			const nodecpp::string& getMethod() { return method.name; }
@@ -373,6 +454,15 @@ namespace nodecpp {
 
 			size_t getContentLength() const { return contentLength; }
 
+			const Timings& getTimings() const { return timings; }
+			void setRoute( nodecpp::string route_ ) { route = std::move( route_ ); } // a low-cardinality name, such as "GET /users/:id", to have metrics of this request accounted under; the URL itself is never used, as it may be of unbounded cardinality
+
+			nodecpp::string getHeader( nodecpp::string key ) // empty if not present
+			{
+				auto h = header.find( makeLower( key ) );
+				return h != header.end() ? h->second : nodecpp::string();
+			}
+
 			void dbgTrace()
 			{
 				nodecpp::log::default_log::info( nodecpp::log::ModuleID(nodecpp::nodecpp_module_id), "   [->] {} {} HTTP/{}", method.name, method.url, method.version );
@@ -383,10 +473,123 @@ namespace nodecpp {
 			}
 		};
 
+#ifndef NODECPP_NO_COROUTINES
+		// Pulls request body chunk by chunk; while the consumer is busy, incoming data is kept at socket's read buffer
+		// up to highWaterMark bytes, and then the socket is paused until the consumer catches up. Usage:
+		//     HttpBodyStream body( request );
+		//     while ( co_await body.next() )
+		//         process( body.chunk() );
+		class HttpBodyStream
+		{
+		public:
+			static constexpr size_t defaultHighWaterMark = 0x10000;
+			static constexpr size_t defaultChunkSize = 0x4000;
+
+		private:
+			nodecpp::soft_ptr<IncomingHttpMessageAtServer> request;
+			size_t highWaterMark;
+			size_t lowWaterMark;
+			size_t chunkSize;
+			Buffer currentChunk;
+			bool completed = false;
+
+			void complete()
+			{
+				if ( completed )
+					return;
+				completed = true;
+				if ( request->h2stream != nullptr )
+					return;
+				auto sock = request->sock;
+				sock->setReadHighWaterMark( 0 );
+				if ( sock->isPaused() )
+					sock->resume();
+				sock->proceedToNext();
+			}
+
+		public:
+			HttpBodyStream( nodecpp::soft_ptr<IncomingHttpMessageAtServer> request_, size_t highWaterMark_ = defaultHighWaterMark, size_t chunkSize_ = defaultChunkSize ) :
+				request( request_ ), highWaterMark( highWaterMark_ ), lowWaterMark( highWaterMark_ / 2 ), chunkSize( chunkSize_ ), currentChunk( chunkSize_ )
+			{
+				NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, chunkSize != 0 ); 
+				NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, highWaterMark != 0 ); 
+				if ( request->h2stream != nullptr ) // HTTP/2 flow control does the job
+					return;
+				request->sock->dataForCommandProcessing.readBuffer.reserve( highWaterMark );
+				request->sock->setReadHighWaterMark( highWaterMark );
+			}
+			HttpBodyStream(const HttpBodyStream&) = delete;
+			HttpBodyStream& operator = (const HttpBodyStream&) = delete;
+			~HttpBodyStream()
+			{
+				if ( !completed && request->h2stream == nullptr && !request->sock->destroyed() )
+				{
+					request->sock->setReadHighWaterMark( 0 );
+					if ( request->sock->isPaused() )
+						request->sock->resume();
+				}
+			}
+
+			size_t remaining() const { return request->getContentLength() - request->bodyBytesRetrieved; }
+			Buffer& chunk() { return currentChunk; }
+
+			// returns false when the whole body has been consumed; chunk() is valid until the next call
+			::nodecpp::awaitable<bool> next()
+			{
+				if ( request->h2stream != nullptr )
+				{
+					if ( !completed )
+						co_await request->a_readBody( currentChunk );
+					if ( currentChunk.size() == 0 )
+						complete();
+					CO_RETURN currentChunk.size() != 0;
+				}
+				size_t toRead = remaining();
+				if ( toRead == 0 )
+				{
+					currentChunk.clear();
+					complete();
+					CO_RETURN false;
+				}
+				auto sock = request->sock;
+				if ( sock->isPaused() && sock->readBufferSize() <= lowWaterMark )
+					sock->resume();
+				co_await sock->a_read( currentChunk, 1, toRead < chunkSize ? toRead : chunkSize );
+				request->bodyBytesRetrieved += currentChunk.size();
+				if ( request->bodyBytesRetrieved == request->getContentLength() )
+					complete();
+				CO_RETURN true;
+			}
+
+			nodecpp::handler_ret_type pipe( nodecpp::fs::FD fd )
+			{
+				while ( co_await next() )
+				{
+					size_t written = nodecpp::fs::writeSync( fd, currentChunk, 0, currentChunk.size(), std::optional<size_t>() );
+					if ( written != currentChunk.size() )
+						throw Error();
+				}
+				CO_RETURN;
+			}
+
+			nodecpp::handler_ret_type pipe( nodecpp::soft_ptr<SocketBase> target )
+			{
+				while ( co_await next() )
+				{
+					co_await target->a_write( currentChunk );
+					if ( target->bufferSize() >= highWaterMark )
+						co_await target->a_drain();
+				}
+				CO_RETURN;
+			}
+		};
+#endif // NODECPP_NO_COROUTINES
+
 		class HttpServerResponse : protected HttpMessageBase // TODO: candidate for being a part of lib
 		{
 			friend class HttpSocketBase;
 			friend class RRQueue;
+			friend class Http2Session;
 			Buffer headerBuff;
 
 		private:
@@ -402,6 +605,18 @@ namespace nodecpp {
 			nodecpp::string replyStatus;
 			//size_t bodyBytesWritten = 0;
 
+			HttpCompressionOptions compression;
+#ifdef NODECPP_ENABLE_HTTP_COMPRESSION
+			std::unique_ptr<DeflateContext> deflater; // set only while streaming a compressed (and chunked) body
+#endif // NODECPP_ENABLE_HTTP_COMPRESSION
+
+			nodecpp::soft_ptr<Http2Stream> h2stream; // set for responses going over HTTP/2
+			void h2SerializeHeaders();
+#ifndef NODECPP_NO_COROUTINES
+			nodecpp::handler_ret_type h2WriteBody( const uint8_t* data, size_t sz, bool endStream );
+#endif // NODECPP_NO_COROUTINES
+			void h2Complete();
+
 		private:
 			nodecpp::handler_ret_type serializeHeaders()
 			{
@@ -426,6 +641,135 @@ namespace nodecpp {
 				CO_RETURN;
 			}
 
+			// headers put to replyStatus by writeHead() ("HTTP/x.y code message\r\nkey: value\r\n..."), if any; f( name, value ) is called for each
+			template<class F>
+			void forEachReplyStatusHeader( F f ) const
+			{
+				size_t lineEnd = replyStatus.find( '\n' );
+				while ( lineEnd != nodecpp::string::npos )
+				{
+					size_t start = lineEnd + 1;
+					lineEnd = replyStatus.find( '\n', start );
+					size_t end = ( lineEnd == nodecpp::string::npos ? replyStatus.size() : lineEnd );
+					while ( end > start && ( replyStatus[end-1] == '\r' || replyStatus[end-1] == ' ' ) )
+						--end;
+					size_t colon = replyStatus.find( ':', start );
+					if ( colon >= end )
+						continue;
+					size_t valStart = replyStatus.find_first_not_of( " \t", colon + 1 );
+					f( replyStatus.substr( start, colon - start ), valStart < end ? replyStatus.substr( valStart, end - valStart ) : nodecpp::string() );
+				}
+			}
+
+			ContentEncoding selectEncoding( size_t bodySize )
+			{
+				if ( !compression.enabled || bodySize < compression.minSize )
+					return ContentEncoding::identity;
+				bool compressible = true;
+				auto check = [&compressible]( nodecpp::string key, const nodecpp::string& value ) {
+					makeLower( key );
+					if ( key == "content-encoding" || ( key == "content-type" && !isCompressibleContentType( value ) ) )
+						compressible = false;
+				};
+				forEachReplyStatusHeader( check );
+				for ( auto& h : header )
+					check( h.first, h.second );
+				if ( !compressible )
+					return ContentEncoding::identity;
+				return negotiateContentEncoding( myRequest->getHeader( "accept-encoding" ), compression );
+			}
+
+			void addEncodingHeaders( ContentEncoding enc )
+			{
+				header.insert( nodecpp::make_pair( nodecpp::string("Content-Encoding"), nodecpp::string( contentEncodingName( enc ) ) ) );
+				header.insert( nodecpp::make_pair( nodecpp::string("Vary"), nodecpp::string("Accept-Encoding") ) );
+			}
+
+#ifdef NODECPP_ENABLE_HTTP_COMPRESSION
+			// body size is not known in advance, so compressed stream goes chunked (HTTP/1.1 only)
+			void startStreamCompression()
+			{
+				if ( myRequest->getHttpVersion() != "1.1" )
+					return;
+				ContentEncoding enc = selectEncoding( SIZE_MAX );
+				if ( enc == ContentEncoding::identity )
+					return;
+				deflater = DeflateContextPool::acquire( enc, compression.level );
+				addEncodingHeaders( enc );
+				header.insert( nodecpp::make_pair( nodecpp::string("Transfer-Encoding"), nodecpp::string("chunked") ) );
+			}
+
+			Buffer compressChunk( Buffer& b, bool finish )
+			{
+				Buffer compressed( deflater->bound( b.size() ) );
+				deflater->write( b.begin(), b.size(), compressed, finish );
+				Buffer out( compressed.size() + 32 );
+				if ( compressed.size() )
+				{
+					out.appendString( nodecpp::format( "{:x}\r\n", compressed.size() ) );
+					out.append( compressed );
+					out.append( "\r\n", 2 );
+				}
+				if ( finish )
+				{
+					out.append( "0\r\n\r\n", 5 );
+					DeflateContextPool::release( std::move( deflater ) );
+				}
+				return out;
+			}
+#endif // NODECPP_ENABLE_HTTP_COMPRESSION
+
+			void markResponseStarted()
+			{
+				if ( myRequest->timings.firstResponseByteAt == 0 )
+					myRequest->timings.firstResponseByteAt = infraGetCurrentTime();
+			}
+
+			void recordTimings()
+			{
+				IncomingHttpMessageAtServer::Timings& t = myRequest->timings;
+				if ( t.handlerInvokedAt == 0 ) // already done or not timed
+					return;
+				auto& metrics = nodecpp::metrics::thisThread();
+				metrics.httpRequests.add();
+				HttpSocketBase::UnflushedResponse r;
+				r.t = t;
+				t.handlerInvokedAt = 0;
+				if ( r.t.firstResponseByteAt == 0 )
+					r.t.firstResponseByteAt = infraGetCurrentTime();
+				if ( myRequest->route.size() != 0 )
+					r.route = &(nodecpp::metrics::httpRoute( metrics, myRequest->route.c_str(), myRequest->route.size() ));
+				else
+					r.route = &(nodecpp::metrics::httpRoute( metrics, "(unrouted)", sizeof( "(unrouted)" ) - 1 ));
+				if ( nodecpp::metrics::getOptions().httpSlowRequestMs != 0 )
+				{
+					const nodecpp::string& url = myRequest->getUrl();
+					r.method = myRequest->getMethod();
+					r.path = url.substr( 0, url.find( '?' ) );
+				}
+				sock->responseHandedOver( std::move( r ) );
+			}
+
+			void completeResponse()
+			{
+				recordTimings();
+				if ( h2stream != nullptr )
+				{
+					h2Complete();
+					return;
+				}
+				myRequest->clear();
+				if ( connStatus != ConnStatus::keep_alive )
+				{
+					sock->end();
+					clear();
+					return;
+				}
+				clear();
+				sock->release( idx );
+				sock->proceedToNext();
+			}
+
 
 		public:
 			HttpServerResponse() : headerBuff(0x1000) {}
@@ -437,6 +781,7 @@ namespace nodecpp {
 				header = std::move( other.header );
 				contentLength = other.contentLength;
 				headerBuff = std::move( other.headerBuff );
+				compression = other.compression;
 			}
 			HttpServerResponse& operator = (HttpServerResponse&& other)
 			{
@@ -445,6 +790,7 @@ namespace nodecpp {
 				headerBuff = std::move( other.headerBuff );
 				contentLength = other.contentLength;
 				other.contentLength = 0;
+				compression = other.compression;
 				return *this;
 			}
 			void clear() // TODO: ensure necessity (added for reuse purposes)
@@ -455,8 +801,19 @@ namespace nodecpp {
 				headerBuff.clear();
 				contentLength = 0;
 				writeStatus = WriteStatus::notyet;
+#ifdef NODECPP_ENABLE_HTTP_COMPRESSION
+				DeflateContextPool::release( std::move( deflater ) );
+#endif // NODECPP_ENABLE_HTTP_COMPRESSION
 			}
 
+			// per-route tuning; must be called before anything is written
+			void setCompression( const HttpCompressionOptions& options )
+			{
+				NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, writeStatus == WriteStatus::notyet ); 
+				compression = options;
+			}
+			void setCompressionLevel( int level ) { compression.level = level; }
+
 			void dbgTrace()
 			{
 				nodecpp::log::default_log::info( nodecpp::log::ModuleID(nodecpp::nodecpp_module_id), "   [<-] {}", replyStatus );
@@ -560,6 +917,13 @@ namespace nodecpp {
 #ifndef NODECPP_NO_COROUTINES
 			nodecpp::handler_ret_type flushHeaders()
 			{
+				markResponseStarted();
+				if ( h2stream != nullptr )
+				{
+					co_await h2WriteBody( nullptr, 0, false );
+					writeStatus = WriteStatus::hdr_flushed;
+					CO_RETURN;
+				}
 				if ( writeStatus == WriteStatus::notyet )
 					serializeHeaders();
 				NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, writeStatus == WriteStatus::hdr_serialized ); 
@@ -580,6 +944,39 @@ namespace nodecpp {
 
 			nodecpp::handler_ret_type writeBodyPart(Buffer& b)
 			{
+#ifdef NODECPP_ENABLE_HTTP_COMPRESSION
+				if ( writeStatus == WriteStatus::notyet )
+					startStreamCompression();
+				if ( deflater != nullptr )
+				{
+					Buffer out = compressChunk( b, false );
+					if ( out.size() || writeStatus == WriteStatus::notyet )
+						co_await writeRawBodyPart( out );
+					CO_RETURN;
+				}
+#endif // NODECPP_ENABLE_HTTP_COMPRESSION
+				co_await writeRawBodyPart( b );
+				CO_RETURN;
+			}
+
+			nodecpp::handler_ret_type writeLastBodyPart(Buffer& b)
+			{
+				markResponseStarted();
+				if ( h2stream != nullptr )
+					co_await h2WriteBody( b.begin(), b.size(), true );
+				else
+					co_await writeRawBodyPart( b );
+				CO_RETURN;
+			}
+
+			nodecpp::handler_ret_type writeRawBodyPart(Buffer& b)
+			{
+				markResponseStarted();
+				if ( h2stream != nullptr )
+				{
+					co_await h2WriteBody( b.begin(), b.size(), false );
+					CO_RETURN;
+				}
 				if ( writeStatus == WriteStatus::notyet )
 					serializeHeaders();
 				NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, writeStatus == WriteStatus::hdr_serialized || writeStatus == WriteStatus::hdr_flushed ); 
@@ -611,22 +1008,64 @@ namespace nodecpp {
 				if ( writeStatus != WriteStatus::in_body )
 				{
 					NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, writeStatus == WriteStatus::notyet ); 
+#ifdef NODECPP_ENABLE_HTTP_COMPRESSION
+					ContentEncoding enc = selectEncoding( b.size() );
+					if ( enc != ContentEncoding::identity )
+					{
+						Buffer compressed = compressBuffer( b.begin(), b.size(), enc, compression.level );
+						if ( compressed.size() < b.size() )
+						{
+							addEncodingHeaders( enc );
+							header.insert( nodecpp::make_pair( nodecpp::string("Content-Length"), format( "{}", compressed.size() ) ) );
+							co_await writeLastBodyPart( compressed );
+							completeResponse();
+							CO_RETURN;
+						}
+					}
+#endif // NODECPP_ENABLE_HTTP_COMPRESSION
 					header.insert( nodecpp::make_pair( nodecpp::string("Content-Length"), format( "{}", b.size() ) ) );
 				}
-//dbgTrace();
-				co_await writeBodyPart(b);
-
-				myRequest->clear();
-				if ( connStatus != ConnStatus::keep_alive )
+#ifdef NODECPP_ENABLE_HTTP_COMPRESSION
+				else if ( deflater != nullptr )
 				{
-					sock->end();
-					clear();
+					Buffer out = compressChunk( b, true );
+					co_await writeRawBodyPart( out );
+					completeResponse();
 					CO_RETURN;
 				}
+#endif // NODECPP_ENABLE_HTTP_COMPRESSION
+//dbgTrace();
+				co_await writeLastBodyPart(b);
+				completeResponse();
+				CO_RETURN;
+			}
 
-				clear();
-				sock->release( idx );
-				sock->proceedToNext();
+			// static content: the representation is chosen by Accept-Encoding, nothing is compressed on the fly
+			NODECPP_NO_AWAIT
+			nodecpp::handler_ret_type end(const PrecompressedContent& content)
+			{
+				NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, writeStatus == WriteStatus::notyet ); 
+				HttpCompressionOptions options = compression;
+				options.enabled = true;
+				ContentEncoding enc = negotiateContentEncoding( myRequest->getHeader( "accept-encoding" ), options );
+				const Buffer& body = content.get( enc );
+				if ( content.getContentType().size() )
+					header.insert( nodecpp::make_pair( nodecpp::string("Content-Type"), content.getContentType() ) );
+				if ( enc != ContentEncoding::identity )
+					addEncodingHeaders( enc );
+				else if ( content.memoryUsed() > content.size() )
+					header.insert( nodecpp::make_pair( nodecpp::string("Vary"), nodecpp::string("Accept-Encoding") ) );
+				header.insert( nodecpp::make_pair( nodecpp::string("Content-Length"), format( "{}", body.size() ) ) );
+				markResponseStarted();
+				if ( h2stream != nullptr )
+					co_await h2WriteBody( body.begin(), body.size(), true );
+				else
+				{
+					serializeHeaders();
+					headerBuff.append( body );
+					co_await flushHeaders();
+				}
+				completeResponse();
 				CO_RETURN;
 			}
 
@@ -662,19 +1101,19 @@ namespace nodecpp {
 			NODECPP_NO_AWAIT
 			nodecpp::handler_ret_type end()
 			{
-				if ( writeStatus != WriteStatus::hdr_flushed )
-					co_await flushHeaders();
-				myRequest->clear();
-				if ( connStatus != ConnStatus::keep_alive )
+#ifdef NODECPP_ENABLE_HTTP_COMPRESSION
+				if ( deflater != nullptr )
 				{
-					sock->end();
-					clear();
-					CO_RETURN;
+					Buffer empty;
+					Buffer out = compressChunk( empty, true );
+					co_await writeRawBodyPart( out );
 				}
+				else
+#endif // NODECPP_ENABLE_HTTP_COMPRESSION
+				if ( writeStatus != WriteStatus::hdr_flushed && writeStatus != WriteStatus::in_body && h2stream == nullptr ) // HTTP/2 headers go along with END_STREAM
+					co_await flushHeaders();
 //dbgTrace();
-				clear();
-				sock->release( idx );
-				sock->proceedToNext();
+				completeResponse();
 				CO_RETURN;
 			}
 #endif // NODECPP_NO_COROUTINES
@@ -684,6 +1123,12 @@ namespace nodecpp {
 		void HttpServerBase::onNewRequest( nodecpp::soft_ptr<IncomingHttpMessageAtServer> request, nodecpp::soft_ptr<HttpServerResponse> response )
 		{
 //printf( "entering onNewRequest()  %s\n", ahd_request.h == nullptr ? "ahd_request.h is nullptr" : "" );
+			IncomingHttpMessageAtServer::Timings& timings = request->timings;
+			if ( timings.headersParsedAt == 0 ) // HTTP/2
+				timings.headersParsedAt = nodecpp::metrics::loopClock();
+			if ( timings.firstByteAt == 0 )
+				timings.firstByteAt = timings.headersParsedAt;
+			timings.handlerInvokedAt = infraGetCurrentTime();
 			if ( ahd_request.h != nullptr )
 			{
 				ahd_request.request = request;
@@ -707,9 +1152,13 @@ namespace nodecpp {
 			if ( status == CoroStandardOutcomes::ok )
 			{
 //				nodecpp::log::default_log::info( nodecpp::log::ModuleID(nodecpp::nodecpp_module_id), "line [{} bytes]: {}", lb.size() - 1, reinterpret_cast<char*>(lb.begin()) );
+				message.timings = IncomingHttpMessageAtServer::Timings();
+				message.timings.firstByteAt = nodecpp::metrics::loopClock();
 				if ( !message.parseMethod( line ) )
 				{
 					// TODO: report error
+					if ( line == "PRI * HTTP/2.0\r\n" && soft_ptr_static_cast<HttpServerBase>(myServerSocket)->getHttp2Options().enabled )
+						h2PrefaceSeen = true;
 					CO_RETURN CoroStandardOutcomes::failed;
 				}
 			}
@@ -722,15 +1171,74 @@ namespace nodecpp {
 //				nodecpp::log::default_log::info( nodecpp::log::ModuleID(nodecpp::nodecpp_module_id), "line [{} bytes]: {}", lb.size() - 1, reinterpret_cast<char*>(lb.begin()) );
 			}
 			while ( status == CoroStandardOutcomes::ok && message.parseHeaderEntry( line ) );
+			message.timings.headersParsedAt = nodecpp::metrics::loopClock();
 
 			CO_RETURN message.readStatus == IncomingHttpMessageAtServer::ReadStatus::in_body || message.readStatus == IncomingHttpMessageAtServer::ReadStatus::completed ? CoroStandardOutcomes::ok : CoroStandardOutcomes::failed;
 		}
 
 		//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+		inline
+		void HttpSocketBase::responseHandedOver( UnflushedResponse&& r )
+		{
+			if ( dataForCommandProcessing.writeBuffer.used_size() + dataForCommandProcessing.ahd_write.b.size() == 0 ) // already with the OS
+			{
+				r.t.completedAt = infraGetCurrentTime();
+				recordTimings( r );
+			}
+			else
+				unflushedResponses.push_back( std::move( r ) );
+		}
+
+		inline
+		void HttpSocketBase::onWriteBacklogFlushed()
+		{
+			if ( unflushedResponses.size() == 0 )
+				return;
+			uint64_t now = infraGetCurrentTime();
+			for ( auto& r : unflushedResponses )
+			{
+				r.t.completedAt = now;
+				recordTimings( r );
+			}
+			unflushedResponses.clear();
+		}
+
+		inline
+		void HttpSocketBase::recordTimings( UnflushedResponse& r )
+		{
+			const HttpRequestTimings& t = r.t;
+			auto& metrics = nodecpp::metrics::thisThread();
+			metrics.httpRequestMks.record( t.completedAt - t.headersParsedAt );
+			nodecpp::metrics::HttpRouteMetrics& rm = *(r.route);
+			rm.receiveMks.record( t.headersParsedAt - t.firstByteAt );
+			rm.queueMks.record( t.handlerInvokedAt - t.headersParsedAt );
+			rm.handlerMks.record( t.firstResponseByteAt - t.handlerInvokedAt );
+			rm.sendMks.record( t.completedAt - t.firstResponseByteAt );
+			rm.totalMks.record( t.completedAt - t.firstByteAt );
+
+			const nodecpp::metrics::Options& options = nodecpp::metrics::getOptions();
+			if ( options.httpSlowRequestMs != 0 && t.completedAt - t.firstByteAt >= (uint64_t)options.httpSlowRequestMs * 1000 )
+			{
+				metrics.slowHttpRequests.add();
+				if ( slowRequestLog.lastLoggedAt != 0 && t.completedAt < slowRequestLog.lastLoggedAt + (uint64_t)options.httpSlowLogIntervalMs * 1000 )
+					++(slowRequestLog.suppressed);
+				else
+				{
+					nodecpp::log::default_log::info( nodecpp::log::ModuleID(nodecpp::nodecpp_module_id), "slow http request: {} {} from {} took {} ms (receive {} ms, queue {} ms, handler {} ms, send {} ms); {} more slow request(s) not logged since the previous record", 
+						r.method, r.path, remoteIP(), ( t.completedAt - t.firstByteAt ) / 1000, 
+						( t.headersParsedAt - t.firstByteAt ) / 1000, ( t.handlerInvokedAt - t.headersParsedAt ) / 1000, ( t.firstResponseByteAt - t.handlerInvokedAt ) / 1000, ( t.completedAt - t.firstResponseByteAt ) / 1000, 
+						slowRequestLog.suppressed );
+					slowRequestLog.lastLoggedAt = t.completedAt;
+					slowRequestLog.suppressed = 0;
+				}
+			}
+		}
+
 		inline
 		HttpSocketBase::HttpSocketBase() {
 #ifndef NODECPP_NO_COROUTINES
+			lineBuffer.setMemCategory( nodecpp::metrics::MemCategory::HttpMessages );
 			lineBuffer.reserve(maxHeaderSize);
 #endif // NODECPP_NO_COROUTINES
 			rrQueue.init( myThis.getSoftPtr<HttpSocketBase>(this) );
@@ -742,6 +1250,8 @@ namespace nodecpp {
 			size_t size = ((size_t)1 << sizeExp);
 			cbuff = nodecpp::alloc<RRPair>( size ); // TODO: use nodecpp::a
 			//cbuff = new RRPair [size];
+			nodecpp::metrics::chargeMemory( nodecpp::metrics::MemCategory::HttpMessages, size * pairBytes() );
+			nodecpp::metrics::MemoryCategoryScope memScope( nodecpp::metrics::MemCategory::HttpMessages ); // for buffers of requests and responses
 			for ( size_t i=0; i<size; ++i )
 			{
 				cbuff[i].request = nodecpp::make_owning<IncomingHttpMessageAtServer>();
@@ -759,4 +1269,6 @@ namespace nodecpp {
 	} //namespace net
 } //namespace nodecpp
 
+#include "http2.h"
+
 #endif // HTTP_SOCKET_AT_SERVER_H
@@ -0,0 +1,568 @@
+/* -------------------------------------------------------------------------------
+* Copyright (c) 2021, OLogN Technologies AG
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*     * Neither the name of the OLogN Technologies AG nor the
+*       names of its contributors may be used to endorse or promote products
+*       derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL OLogN Technologies AG BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+* -------------------------------------------------------------------------------*/
+
+#ifndef NODECPP_METRICS_H
+#define NODECPP_METRICS_H
+
+#include "basic_collections.h" // rather than common.h, as it is also used by low-level inter-thread code
+#include <atomic>
+#include <cstring>
+#include <memory>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+uint64_t infraGetCurrentTime();
+
+// Event-loop metrics: every thread running a loop owns a ThreadMetrics instance and is its only writer 
+// (plain relaxed load/store, no read-modify-write); readers aggregate them at any time without stopping the loops
+
+namespace nodecpp {
+
+	namespace metrics {
+
+		class Counter
+		{
+			std::atomic<uint64_t> val = 0;
+		public:
+			void add( uint64_t delta = 1 ) { val.store( val.load( std::memory_order_relaxed ) + delta, std::memory_order_relaxed ); }
+			void set( uint64_t v ) { val.store( v, std::memory_order_relaxed ); }
+			uint64_t get() const { return val.load( std::memory_order_relaxed ); }
+		};
+
+		// unlike Counter, may be updated by any thread (memory allocated by one thread may be freed by another)
+		class Gauge
+		{
+			std::atomic<int64_t> val = 0;
+		public:
+			void add( int64_t delta ) { val.fetch_add( delta, std::memory_order_relaxed ); }
+			int64_t get() const { return val.load( std::memory_order_relaxed ); }
+		};
+
+		// HDR-style log-linear histogram: exact below 32, then 16 sub-buckets per power of two (relative error below 1/16)
+		class Histogram
+		{
+		public:
+			static constexpr size_t subBucketBits = 4;
+			static constexpr size_t subBucketCnt = (size_t)1 << subBucketBits;
+			static constexpr size_t maxValueBits = 40;
+			static constexpr uint64_t maxValue = ( (uint64_t)1 << maxValueBits ) - 1; // larger values are clamped
+			static constexpr size_t bucketCnt = ( maxValueBits - subBucketBits + 1 ) * subBucketCnt;
+
+			static size_t msbIdx( uint64_t v ) {
+#ifdef _MSC_VER
+				unsigned long idx;
+				_BitScanReverse64( &idx, v );
+				return idx;
+#else
+				return 63 - __builtin_clzll( v );
+#endif
+			}
+			static size_t bucketIdx( uint64_t v ) {
+				if ( v > maxValue )
+					v = maxValue;
+				if ( v < 2 * subBucketCnt )
+					return (size_t)v;
+				size_t e = msbIdx( v ) - subBucketBits;
+				return ( e + 1 ) * subBucketCnt + (size_t)( ( v >> e ) - subBucketCnt );
+			}
+			static uint64_t bucketLowerBound( size_t idx ) {
+				if ( idx < 2 * subBucketCnt )
+					return idx;
+				size_t e = idx / subBucketCnt - 1;
+				return (uint64_t)( idx % subBucketCnt + subBucketCnt ) << e;
+			}
+
+		private:
+			std::atomic<uint64_t> counts[bucketCnt] = {};
+			Counter count;
+			Counter sum;
+			Counter max;
+
+		public:
+			void record( uint64_t v ) {
+				std::atomic<uint64_t>& c = counts[ bucketIdx( v ) ];
+				c.store( c.load( std::memory_order_relaxed ) + 1, std::memory_order_relaxed );
+				count.add();
+				sum.add( v );
+				if ( v > max.get() )
+					max.set( v );
+			}
+			uint64_t countAt( size_t idx ) const { return counts[idx].load( std::memory_order_relaxed ); }
+			uint64_t getCount() const { return count.get(); }
+			uint64_t getSum() const { return sum.get(); }
+			uint64_t getMax() const { return max.get(); }
+		};
+
+		struct HistogramSnapshot
+		{
+			uint64_t counts[Histogram::bucketCnt] = {};
+			uint64_t count = 0;
+			uint64_t sum = 0;
+			uint64_t max = 0;
+
+			void add( const Histogram& h ) {
+				for ( size_t i=0; i<Histogram::bucketCnt; ++i )
+					counts[i] += h.countAt( i );
+				count += h.getCount();
+				sum += h.getSum();
+				max = std::max( max, h.getMax() );
+			}
+			uint64_t mean() const { return count ? sum / count : 0; }
+			uint64_t percentile( double q ) const { // upper bound of the bucket holding the q-th quantile
+				uint64_t total = 0;
+				for ( size_t i=0; i<Histogram::bucketCnt; ++i )
+					total += counts[i]; // a concurrent writer may make 'count' differ slightly from the sum of buckets
+				if ( total == 0 )
+					return 0;
+				uint64_t rank = (uint64_t)( q * total );
+				if ( rank >= total )
+					rank = total - 1;
+				uint64_t seen = 0;
+				for ( size_t i=0; i<Histogram::bucketCnt; ++i )
+				{
+					seen += counts[i];
+					if ( seen > rank )
+						return std::min( max, i + 1 < Histogram::bucketCnt ? Histogram::bucketLowerBound( i + 1 ) - 1 : Histogram::maxValue );
+				}
+				return max;
+			}
+		};
+
+		enum class ThreadRole { Unknown, Master, Worker, Listener, Node };
+		inline const char* roleName( ThreadRole role ) {
+			switch ( role )
+			{
+				case ThreadRole::Master: return "master";
+				case ThreadRole::Worker: return "worker";
+				case ThreadRole::Listener: return "listener";
+				case ThreadRole::Node: return "node";
+				default: return "unknown";
+			}
+		}
+
+		enum class HandlerKind { None, Event, SocketRead, Timer };
+		static constexpr size_t handlerKindCnt = 4;
+		inline const char* handlerKindName( HandlerKind kind ) {
+			switch ( kind )
+			{
+				case HandlerKind::Event: return "event";
+				case HandlerKind::SocketRead: return "socket_read";
+				case HandlerKind::Timer: return "timer";
+				default: return "none";
+			}
+		}
+
+		// memory held by a thread, by what it is held for (see chargeMemory())
+		enum class MemCategory { SocketBuffers, HttpMessages, CoroutineFrames, Timers, User };
+		static constexpr size_t memCategoryCnt = 5;
+		inline const char* memCategoryName( MemCategory cat ) {
+			switch ( cat )
+			{
+				case MemCategory::SocketBuffers: return "socket_buffers";
+				case MemCategory::HttpMessages: return "http_messages";
+				case MemCategory::CoroutineFrames: return "coroutine_frames";
+				case MemCategory::Timers: return "timers";
+				default: return "user";
+			}
+		}
+
+		// what the loop is doing right now; read by the stall watchdog
+		struct LoopActivity
+		{
+			std::atomic<uint64_t> busySince = 0; // mks; 0 while waiting for events
+			std::atomic<HandlerKind> handler = HandlerKind::None;
+			std::atomic<uint64_t> socketIdx = 0;
+			std::atomic<const void*> origin = nullptr; // code of the coroutine being resumed, if known (see coroutineOrigin())
+		};
+
+		// HTTP timings by route: either set by the application (see IncomingHttpMessageAtServer::setRoute()), or the method and the path of a request
+		struct HttpRouteMetrics
+		{
+			static constexpr size_t maxRouteSize = 64; // including terminating zero; longer ones are truncated
+			char route[maxRouteSize] = {}; // written before the instance is published
+			Histogram receiveMks; // from the request line to the parsed head
+			Histogram queueMks; // from the parsed head to the handler (waiting behind pipelined requests)
+			Histogram handlerMks; // from the handler to the first byte of the response
+			Histogram sendMks; // from the first byte of the response to the whole of it flushed to the OS
+			Histogram totalMks;
+		};
+
+		struct alignas(64) ThreadMetrics
+		{
+			static constexpr size_t maxHttpRoutes = 32; // the last one collects the rest
+
+			std::atomic<ThreadRole> role = ThreadRole::Unknown;
+			std::atomic<size_t> instanceId = 0; // as used by logging
+			std::atomic<bool> live = false;
+
+			Counter iterations;
+			Counter polls;
+			Counter readyEvents; // returned by poll
+			Counter interThreadMsgs;
+			Counter timersFired;
+			Counter sessionsCreated;
+			Counter sessionsClosed;
+			Counter sendCalls;
+			Counter sendWouldBlock;
+			Counter bytesIn;
+			Counter bytesOut;
+			Counter openSockets; // a gauge: sockets (including listening ones) currently registered with the loop
+			Counter httpRequests; // completed ones
+			Counter msgPoolAllocs; // by OneShotMsgPool of this thread
+			Counter msgPoolHeapAllocs; // those of msgPoolAllocs not served from a free list
+			Counter tcpRetransmits; // as seen by TCP_INFO samples (see Options::tcpInfoPeriodMs)
+			Counter backloggedSockets; // a gauge, as of the last TCP_INFO sweep: sockets with data waiting to be sent
+			Counter backloggedBytes; // a gauge, as of the last TCP_INFO sweep: data waiting to be sent, over all sockets
+			Counter largestBacklog; // a gauge, as of the last TCP_INFO sweep: the most data waiting to be sent to a single socket
+			Counter slowHttpRequests; // see Options::httpSlowRequestMs
+			Counter memSheddingEpisodes; // see Options::memorySoftLimitBytes
+			Counter memShrunkBuffers; // idle socket buffers given back while over the soft memory limit
+			Counter largestSocketBuffers; // a gauge, as of the last memory sweep: the most buffer memory held by a single socket
+			Counter interThreadQueueSize; // a gauge: messages waiting at this thread's inter-thread queue (see InterThreadQueueStats)
+			Counter interThreadQueueHwm; // a gauge: high watermark of the above
+			Counter interThreadQueueFulls; // times a sender has found this thread's queue full
+			Counter interThreadOverflowed; // a gauge: messages to this thread waiting in overflows of senders
+			std::atomic<bool> memShedding = false; // over the soft memory limit right now
+
+			Histogram loopIterationMks; // busy part of an iteration (without waiting in poll)
+			Histogram pollWaitMks;
+			Histogram eventProcessingMks; // from return of poll to the end of the iteration
+			Histogram timerLatenessMks; // how late timers fire against their schedule
+			Histogram queueDepth; // inter-thread messages taken per wake-up
+			Histogram httpRequestMks; // from a parsed request head to the completed response
+			Histogram handlerMks[handlerKindCnt]; // by HandlerKind
+			Histogram writeBacklogMks; // for how long data was waiting to be sent, per episode
+			Histogram tcpRttMks; // from TCP_INFO samples
+			std::atomic<HttpRouteMetrics*> httpRoutes[maxHttpRoutes] = {}; // allocated on first use, never freed
+			Gauge memBytes[memCategoryCnt]; // by MemCategory; memory freed by a thread other than the allocating one may make a single thread's value off (even negative), but not the total
+
+			LoopActivity activity;
+			Counter stalls; // this and the next one are written by the stall watchdog thread only
+			Counter longestStallMks;
+		};
+
+		struct Snapshot
+		{
+			size_t threadCnt = 0;
+			uint64_t iterations = 0;
+			uint64_t polls = 0;
+			uint64_t readyEvents = 0;
+			uint64_t interThreadMsgs = 0;
+			uint64_t timersFired = 0;
+			uint64_t sessionsCreated = 0;
+			uint64_t sessionsClosed = 0;
+			uint64_t sendCalls = 0;
+			uint64_t sendWouldBlock = 0;
+			uint64_t bytesIn = 0;
+			uint64_t bytesOut = 0;
+			uint64_t openSockets = 0;
+			uint64_t httpRequests = 0;
+			uint64_t msgPoolAllocs = 0;
+			uint64_t msgPoolHeapAllocs = 0;
+			uint64_t stalls = 0;
+			uint64_t tcpRetransmits = 0;
+			uint64_t slowHttpRequests = 0;
+			uint64_t backloggedSockets = 0;
+			uint64_t backloggedBytes = 0;
+			uint64_t memSheddingEpisodes = 0;
+			uint64_t memSheddingThreads = 0;
+			int64_t memBytes[memCategoryCnt] = {};
+			HistogramSnapshot loopIterationMks;
+			HistogramSnapshot pollWaitMks;
+			HistogramSnapshot eventProcessingMks;
+			HistogramSnapshot timerLatenessMks;
+			HistogramSnapshot queueDepth;
+			HistogramSnapshot httpRequestMks;
+			HistogramSnapshot writeBacklogMks;
+			HistogramSnapshot tcpRttMks;
+
+			void add( const ThreadMetrics& tm ) {
+				++threadCnt;
+				iterations += tm.iterations.get();
+				polls += tm.polls.get();
+				readyEvents += tm.readyEvents.get();
+				interThreadMsgs += tm.interThreadMsgs.get();
+				timersFired += tm.timersFired.get();
+				sessionsCreated += tm.sessionsCreated.get();
+				sessionsClosed += tm.sessionsClosed.get();
+				sendCalls += tm.sendCalls.get();
+				sendWouldBlock += tm.sendWouldBlock.get();
+				bytesIn += tm.bytesIn.get();
+				bytesOut += tm.bytesOut.get();
+				if ( tm.live.load( std::memory_order_relaxed ) )
+				{
+					openSockets += tm.openSockets.get();
+					backloggedSockets += tm.backloggedSockets.get();
+					backloggedBytes += tm.backloggedBytes.get();
+					memSheddingThreads += tm.memShedding.load( std::memory_order_relaxed ) ? 1 : 0;
+				}
+				for ( size_t i=0; i<memCategoryCnt; ++i )
+					memBytes[i] += tm.memBytes[i].get(); // of exited threads too, as their memory may still be held (and freed) by others
+				httpRequests += tm.httpRequests.get();
+				msgPoolAllocs += tm.msgPoolAllocs.get();
+				msgPoolHeapAllocs += tm.msgPoolHeapAllocs.get();
+				stalls += tm.stalls.get();
+				tcpRetransmits += tm.tcpRetransmits.get();
+				slowHttpRequests += tm.slowHttpRequests.get();
+				memSheddingEpisodes += tm.memSheddingEpisodes.get();
+				loopIterationMks.add( tm.loopIterationMks );
+				pollWaitMks.add( tm.pollWaitMks );
+				eventProcessingMks.add( tm.eventProcessingMks );
+				timerLatenessMks.add( tm.timerLatenessMks );
+				queueDepth.add( tm.queueDepth );
+				httpRequestMks.add( tm.httpRequestMks );
+				writeBacklogMks.add( tm.writeBacklogMks );
+				tcpRttMks.add( tm.tcpRttMks );
+			}
+		};
+
+		// instances are never freed: a slot of an exited thread is reused by a new one, and its totals keep accumulating
+		class Registry
+		{
+		public:
+			static constexpr size_t maxThreads = 128;
+		private:
+			std::atomic<ThreadMetrics*> slots[maxThreads] = {};
+			std::atomic<bool> busy[maxThreads] = {};
+			std::atomic<size_t> usedCnt = 0;
+			ThreadMetrics overflow; // shared by threads beyond maxThreads (counts may be lost there)
+
+		public:
+			std::pair<ThreadMetrics*, size_t> acquire() {
+				for ( size_t i=0; i<maxThreads; ++i )
+				{
+					bool expected = false;
+					if ( !busy[i].compare_exchange_strong( expected, true, std::memory_order_acq_rel ) )
+						continue;
+					ThreadMetrics* tm = slots[i].load( std::memory_order_acquire );
+					if ( tm == nullptr )
+					{
+						tm = nodecpp::stdalloc<ThreadMetrics>( 1 );
+						slots[i].store( tm, std::memory_order_release );
+					}
+					tm->live.store( true, std::memory_order_relaxed );
+					size_t cnt = usedCnt.load( std::memory_order_relaxed );
+					while ( cnt < i + 1 && !usedCnt.compare_exchange_weak( cnt, i + 1, std::memory_order_release ) )
+						;
+					return std::make_pair( tm, i );
+				}
+				return std::make_pair( &overflow, maxThreads );
+			}
+			void release( size_t idx ) {
+				if ( idx >= maxThreads )
+					return;
+				slots[idx].load( std::memory_order_relaxed )->live.store( false, std::memory_order_relaxed );
+				slots[idx].load( std::memory_order_relaxed )->activity.busySince.store( 0, std::memory_order_relaxed );
+				busy[idx].store( false, std::memory_order_release );
+			}
+
+			template<class F>
+			void forEach( F f ) const { // f( const ThreadMetrics& )
+				size_t cnt = usedCnt.load( std::memory_order_acquire );
+				for ( size_t i=0; i<cnt; ++i )
+				{
+					const ThreadMetrics* tm = slots[i].load( std::memory_order_acquire );
+					if ( tm != nullptr )
+						f( *tm );
+				}
+			}
+		};
+
+		inline Registry& registry() { static Registry r; return r; }
+
+		namespace impl {
+			struct ThisThreadHolder
+			{
+				ThreadMetrics* tm;
+				size_t idx;
+				ThisThreadHolder() { auto r = registry().acquire(); tm = r.first; idx = r.second; }
+				ThisThreadHolder( const ThisThreadHolder& ) = delete;
+				ThisThreadHolder& operator = ( const ThisThreadHolder& ) = delete;
+				~ThisThreadHolder() { registry().release( idx ); }
+			};
+			inline thread_local ThisThreadHolder thisThreadHolder;
+		} // namespace impl
+
+		inline ThreadMetrics& thisThread() { return *(impl::thisThreadHolder.tm); }
+		inline size_t thisThreadSlot() { return impl::thisThreadHolder.idx; } // Registry::maxThreads for a thread without its own slot
+		inline void setThisThreadRole( ThreadRole role, size_t instanceId ) {
+			thisThread().role.store( role, std::memory_order_relaxed );
+			thisThread().instanceId.store( instanceId, std::memory_order_relaxed );
+		}
+
+		namespace impl {
+			inline thread_local uint64_t loopClockMks = 0;
+		} // namespace impl
+		// the time (see infraGetCurrentTime()) of the last return from waiting for events or of the last handler boundary, whichever is later;
+		// cheaper than reading the clock, and as precise as the loop itself
+		inline uint64_t loopClock() { return impl::loopClockMks != 0 ? impl::loopClockMks : infraGetCurrentTime(); }
+		inline void setLoopClock( uint64_t now ) { impl::loopClockMks = now; }
+
+		// memory accounting: what nodecpp allocates itself (socket rings, Buffers, coroutine frames, timers) is charged to the allocating thread;
+		// the application may account its own containers with AccountingAllocator
+		inline void chargeMemory( MemCategory cat, int64_t bytes ) { thisThread().memBytes[ (size_t)cat ].add( bytes ); } // negative to release
+		inline int64_t accountedMemory( const ThreadMetrics& tm ) {
+			int64_t total = 0;
+			for ( size_t i=0; i<memCategoryCnt; ++i )
+				total += tm.memBytes[i].get();
+			return total;
+		}
+
+		namespace impl {
+			inline thread_local MemCategory memCategory = MemCategory::User;
+		} // namespace impl
+		inline MemCategory currentMemCategory() { return impl::memCategory; }
+
+		// Buffers created within the scope are accounted under 'cat' rather than under MemCategory::User
+		class MemoryCategoryScope
+		{
+			MemCategory prev;
+		public:
+			MemoryCategoryScope( MemCategory cat ) : prev( impl::memCategory ) { impl::memCategory = cat; }
+			MemoryCategoryScope( const MemoryCategoryScope& ) = delete;
+			MemoryCategoryScope& operator = ( const MemoryCategoryScope& ) = delete;
+			~MemoryCategoryScope() { impl::memCategory = prev; }
+		};
+
+		template<class T, MemCategory category = MemCategory::User, template<class> class Base = std::allocator>
+		struct AccountingAllocator : public Base<T>
+		{
+			using value_type = T;
+			template<class U> struct rebind { using other = AccountingAllocator<U, category, Base>; };
+
+			AccountingAllocator() = default;
+			template<class U> AccountingAllocator( const AccountingAllocator<U, category, Base>& ) noexcept {}
+
+			T* allocate( std::size_t n ) {
+				T* ret = Base<T>::allocate( n );
+				chargeMemory( category, n * sizeof(T) );
+				return ret;
+			}
+			void deallocate( T* p, std::size_t n ) {
+				chargeMemory( category, -(int64_t)( n * sizeof(T) ) );
+				Base<T>::deallocate( p, n );
+			}
+		};
+		template<class T, class U, MemCategory category, template<class> class Base>
+		bool operator == ( const AccountingAllocator<T, category, Base>&, const AccountingAllocator<U, category, Base>& ) { return true; }
+		template<class T, class U, MemCategory category, template<class> class Base>
+		bool operator != ( const AccountingAllocator<T, category, Base>&, const AccountingAllocator<U, category, Base>& ) { return false; }
+
+		// to be called by the owning thread only
+		inline HttpRouteMetrics& httpRoute( ThreadMetrics& tm, const char* route, size_t len ) {
+			if ( len >= HttpRouteMetrics::maxRouteSize )
+				len = HttpRouteMetrics::maxRouteSize - 1;
+			size_t i = 0;
+			for ( ; i<ThreadMetrics::maxHttpRoutes - 1; ++i )
+			{
+				HttpRouteMetrics* rm = tm.httpRoutes[i].load( std::memory_order_relaxed );
+				if ( rm == nullptr )
+					break;
+				if ( memcmp( rm->route, route, len ) == 0 && rm->route[len] == 0 )
+					return *rm;
+			}
+			if ( i == ThreadMetrics::maxHttpRoutes - 1 ) // no more room
+			{
+				route = "(other)";
+				len = sizeof( "(other)" ) - 1;
+			}
+			HttpRouteMetrics* rm = tm.httpRoutes[i].load( std::memory_order_relaxed );
+			if ( rm == nullptr )
+			{
+				rm = nodecpp::stdalloc<HttpRouteMetrics>( 1 );
+				memcpy( rm->route, route, len );
+				rm->route[len] = 0;
+				tm.httpRoutes[i].store( rm, std::memory_order_release );
+			}
+			return *rm;
+		}
+
+		// marks a handler run by the loop for per-kind timing and for attribution of stalls; may be nested
+		class HandlerScope
+		{
+			ThreadMetrics& tm;
+			HandlerKind kind;
+			HandlerKind prevKind;
+			uint64_t prevSocketIdx;
+			const void* prevOrigin;
+			uint64_t start;
+
+		public:
+			HandlerScope( HandlerKind kind_, uint64_t socketIdx = 0, const void* origin = nullptr ) : tm( thisThread() ), kind( kind_ ) {
+				prevKind = tm.activity.handler.load( std::memory_order_relaxed );
+				prevSocketIdx = tm.activity.socketIdx.load( std::memory_order_relaxed );
+				prevOrigin = tm.activity.origin.load( std::memory_order_relaxed );
+				tm.activity.socketIdx.store( socketIdx, std::memory_order_relaxed );
+				tm.activity.origin.store( origin, std::memory_order_relaxed );
+				tm.activity.handler.store( kind, std::memory_order_relaxed );
+				start = infraGetCurrentTime();
+				setLoopClock( start );
+			}
+			HandlerScope( const HandlerScope& ) = delete;
+			HandlerScope& operator = ( const HandlerScope& ) = delete;
+			~HandlerScope() {
+				uint64_t end = infraGetCurrentTime();
+				setLoopClock( end );
+				tm.handlerMks[ (size_t)kind ].record( end - start );
+				tm.activity.handler.store( prevKind, std::memory_order_relaxed );
+				tm.activity.socketIdx.store( prevSocketIdx, std::memory_order_relaxed );
+				tm.activity.origin.store( prevOrigin, std::memory_order_relaxed );
+			}
+		};
+
+		inline Snapshot collect() {
+			Snapshot s;
+			registry().forEach( [&s]( const ThreadMetrics& tm ) { s.add( tm ); } );
+			return s;
+		}
+
+		struct Options
+		{
+			uint32_t logPeriodMs = 0; // if non-zero, each loop periodically logs its own counters (see reportLoopMetricsIfDue())
+			uint32_t shmPeriodMs = 0; // if non-zero, each loop periodically publishes its counters to a shared memory region (see metrics_shm.h)
+			const char* shmName = nullptr; // of that region; if nullptr, shm::defaultName() for this process
+			uint32_t stallThresholdMs = 0; // if non-zero, a watchdog thread reports loop iterations running longer than that
+			uint32_t stallLogIntervalMs = 10000; // at most one stall is logged per thread per this interval; the rest are only counted
+			int stallSignal = 0; // used to sample the stack of a stalled loop; 0 means SIGRTMIN + 7, -1 disables stack samples
+			uint32_t tcpInfoPeriodMs = 0; // if non-zero, each loop samples TCP_INFO of all its connections that often, a bounded slice per iteration (see net::SocketStats)
+			uint32_t httpSlowRequestMs = 0; // if non-zero, HTTP requests taking longer than that are counted and logged along with their timings
+			uint32_t httpSlowLogIntervalMs = 1000; // at most one slow request is logged per thread per this interval; the rest are only counted
+			uint64_t memorySoftLimitBytes = 0; // if non-zero, a loop holding more accounted memory stops accepting connections and gives back idle socket buffers until it is below 7/8 of that
+			uint32_t memorySweepPeriodMs = 1000; // how often each loop looks at buffer memory of its sockets (and, while over the soft limit, shrinks idle ones again)
+		};
+		namespace impl {
+			inline Options options;
+		} // namespace impl
+		inline void setOptions( const Options& opts ) { impl::options = opts; } // to be called before threads are started
+		inline const Options& getOptions() { return impl::options; }
+
+	} // namespace metrics
+
+} // namespace nodecpp
+
+#endif // NODECPP_METRICS_H
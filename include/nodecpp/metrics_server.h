@@ -0,0 +1,349 @@
+/* -------------------------------------------------------------------------------
+* Copyright (c) 2021, OLogN Technologies AG
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*     * Neither the name of the OLogN Technologies AG nor the
+*       names of its contributors may be used to endorse or promote products
+*       derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL OLogN Technologies AG BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+* -------------------------------------------------------------------------------*/
+
+#ifndef NODECPP_METRICS_SERVER_H
+#define NODECPP_METRICS_SERVER_H
+
+#include "http_server.h"
+#include "metrics.h"
+
+#include <cstdio>
+#include <cstring>
+#ifndef _MSC_VER
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#endif
+
+// Opt-in admin endpoint serving nodecpp::metrics of all threads of the process in Prometheus text format (0.0.4).
+// It is expected to run on the master (or on any single thread); a scrape only reads per-thread relaxed atomics,
+// so event loops are neither stopped nor locked
+
+namespace nodecpp {
+
+	namespace metrics {
+
+		class PrometheusExporter
+		{
+			struct CounterFamily
+			{
+				const char* name;
+				const char* type;
+				const char* help;
+				Counter ThreadMetrics::* counter;
+			};
+			static constexpr CounterFamily counterFamilies[] = {
+				{ "nodecpp_loop_iterations_total", "counter", "Event loop iterations.", &ThreadMetrics::iterations },
+				{ "nodecpp_loop_polls_total", "counter", "Waits for I/O readiness.", &ThreadMetrics::polls },
+				{ "nodecpp_loop_ready_events_total", "counter", "Ready descriptors returned by waits for I/O readiness.", &ThreadMetrics::readyEvents },
+				{ "nodecpp_timers_fired_total", "counter", "Timers fired.", &ThreadMetrics::timersFired },
+				{ "nodecpp_open_sockets", "gauge", "Sockets currently registered with the loop, including listening ones.", &ThreadMetrics::openSockets },
+				{ "nodecpp_connections_accepted_total", "counter", "Incoming connections accepted.", &ThreadMetrics::sessionsCreated },
+				{ "nodecpp_connections_closed_total", "counter", "Connections closed.", &ThreadMetrics::sessionsClosed },
+				{ "nodecpp_received_bytes_total", "counter", "Bytes received from sockets.", &ThreadMetrics::bytesIn },
+				{ "nodecpp_sent_bytes_total", "counter", "Bytes sent to sockets.", &ThreadMetrics::bytesOut },
+				{ "nodecpp_send_calls_total", "counter", "Send system calls.", &ThreadMetrics::sendCalls },
+				{ "nodecpp_send_would_block_total", "counter", "Send system calls that would block.", &ThreadMetrics::sendWouldBlock },
+				{ "nodecpp_http_requests_total", "counter", "HTTP requests completed.", &ThreadMetrics::httpRequests },
+				{ "nodecpp_interthread_messages_total", "counter", "Inter-thread messages received.", &ThreadMetrics::interThreadMsgs },
+				{ "nodecpp_interthread_queue_size", "gauge", "Inter-thread messages waiting at the queue of the thread.", &ThreadMetrics::interThreadQueueSize },
+				{ "nodecpp_interthread_queue_high_watermark", "gauge", "The most inter-thread messages ever waiting at the queue of the thread.", &ThreadMetrics::interThreadQueueHwm },
+				{ "nodecpp_interthread_queue_full_total", "counter", "Times a sender has found the inter-thread queue of the thread full.", &ThreadMetrics::interThreadQueueFulls },
+				{ "nodecpp_interthread_overflowed", "gauge", "Inter-thread messages to the thread waiting in overflows of senders, as its queue was full.", &ThreadMetrics::interThreadOverflowed },
+				{ "nodecpp_interthread_pool_allocations_total", "counter", "Inter-thread message blocks allocated.", &ThreadMetrics::msgPoolAllocs },
+				{ "nodecpp_interthread_pool_heap_allocations_total", "counter", "Inter-thread message blocks that were not served from a free list.", &ThreadMetrics::msgPoolHeapAllocs },
+				{ "nodecpp_loop_stalls_total", "counter", "Handlers that kept the event loop busy for longer than the stall threshold.", &ThreadMetrics::stalls },
+				{ "nodecpp_http_slow_requests_total", "counter", "HTTP requests that took longer than the slow request threshold.", &ThreadMetrics::slowHttpRequests },
+				{ "nodecpp_tcp_retransmits_total", "counter", "TCP retransmits, as seen by TCP_INFO samples.", &ThreadMetrics::tcpRetransmits },
+				{ "nodecpp_write_backlogged_sockets", "gauge", "Connections with data waiting to be sent, as of the last TCP_INFO sweep.", &ThreadMetrics::backloggedSockets },
+				{ "nodecpp_write_backlog_bytes", "gauge", "Data waiting to be sent over all connections, as of the last TCP_INFO sweep.", &ThreadMetrics::backloggedBytes },
+				{ "nodecpp_write_backlog_largest_bytes", "gauge", "The most data waiting to be sent to a single connection, as of the last TCP_INFO sweep.", &ThreadMetrics::largestBacklog },
+				{ "nodecpp_socket_buffers_largest_bytes", "gauge", "The most buffer memory held by a single connection, as of the last memory sweep.", &ThreadMetrics::largestSocketBuffers },
+				{ "nodecpp_memory_shedding_episodes_total", "counter", "Times the event loop went over its soft memory limit.", &ThreadMetrics::memSheddingEpisodes },
+				{ "nodecpp_memory_shrunk_buffers_total", "counter", "Idle socket buffers given back while over the soft memory limit.", &ThreadMetrics::memShrunkBuffers },
+			};
+
+			struct SummaryFamily
+			{
+				const char* name;
+				const char* help;
+				Histogram ThreadMetrics::* histogram;
+				double scale; // from recorded units to exported ones
+			};
+			static constexpr SummaryFamily summaryFamilies[] = {
+				{ "nodecpp_loop_iteration_seconds", "Busy part of event loop iterations.", &ThreadMetrics::loopIterationMks, 1e-6 },
+				{ "nodecpp_loop_poll_wait_seconds", "Time spent waiting for I/O readiness.", &ThreadMetrics::pollWaitMks, 1e-6 },
+				{ "nodecpp_timer_lateness_seconds", "Delay of timers against their schedule.", &ThreadMetrics::timerLatenessMks, 1e-6 },
+				{ "nodecpp_interthread_queue_depth", "Inter-thread messages taken per wake-up.", &ThreadMetrics::queueDepth, 1 },
+				{ "nodecpp_http_request_duration_seconds", "Time from a parsed HTTP request head to the completed response.", &ThreadMetrics::httpRequestMks, 1e-6 },
+				{ "nodecpp_write_backlog_seconds", "For how long data was waiting to be sent to a connection, per episode.", &ThreadMetrics::writeBacklogMks, 1e-6 },
+				{ "nodecpp_tcp_rtt_seconds", "Smoothed TCP round-trip time, as seen by TCP_INFO samples.", &ThreadMetrics::tcpRttMks, 1e-6 },
+			};
+
+			static constexpr double quantiles[] = { 0.5, 0.9, 0.99, 0.999 };
+
+			struct LoopTimes
+			{
+				uint64_t busyMks = 0;
+				uint64_t waitMks = 0;
+			};
+			nodecpp::stdmap<const ThreadMetrics*, LoopTimes> prevLoopTimes; // utilization is reported between two subsequent scrapes
+
+			struct ThreadEntry
+			{
+				const ThreadMetrics* tm;
+				nodecpp::string labels;
+			};
+
+			struct RoutePhase
+			{
+				const char* name;
+				Histogram HttpRouteMetrics::* histogram;
+			};
+			static constexpr RoutePhase routePhases[] = {
+				{ "receive", &HttpRouteMetrics::receiveMks },
+				{ "queue", &HttpRouteMetrics::queueMks },
+				{ "handler", &HttpRouteMetrics::handlerMks },
+				{ "send", &HttpRouteMetrics::sendMks },
+				{ "total", &HttpRouteMetrics::totalMks },
+			};
+			static constexpr size_t routePhaseCnt = sizeof( routePhases ) / sizeof( routePhases[0] );
+
+			static nodecpp::string escapeLabelValue( const char* s ) {
+				nodecpp::string ret;
+				for ( ; *s; ++s )
+				{
+					if ( *s == '\\' || *s == '"' )
+						ret.push_back( '\\' );
+					if ( *s == '\n' )
+						ret.append( "\\n" );
+					else
+						ret.push_back( *s );
+				}
+				return ret;
+			}
+
+			static void family( nodecpp::string& out, const char* name, const char* type, const char* help ) {
+				::fmt::format_to( std::back_inserter( out ), "# HELP {} {}\n# TYPE {} {}\n", name, help, name, type );
+			}
+			static void summary( nodecpp::string& out, const char* name, const nodecpp::string& labels, const HistogramSnapshot& h, double scale ) {
+				const char* sep = labels.size() ? "," : "";
+				for ( double q : quantiles )
+					::fmt::format_to( std::back_inserter( out ), "{}{{{}{}quantile=\"{}\"}} {}\n", name, labels.c_str(), sep, q, h.percentile( q ) * scale );
+				::fmt::format_to( std::back_inserter( out ), "{}_sum{{{}}} {}\n{}_count{{{}}} {}\n", name, labels.c_str(), h.sum * scale, name, labels.c_str(), h.count );
+			}
+
+			void renderProcess( nodecpp::string& out ) {
+#ifndef _MSC_VER
+				struct rusage usage;
+				if ( getrusage( RUSAGE_SELF, &usage ) == 0 )
+				{
+					double cpu = usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + ( usage.ru_utime.tv_usec + usage.ru_stime.tv_usec ) * 1e-6;
+					family( out, "process_cpu_seconds_total", "counter", "Total user and system CPU time spent in seconds." );
+					::fmt::format_to( std::back_inserter( out ), "process_cpu_seconds_total {}\n", cpu );
+				}
+				int fd = ::open( "/proc/self/statm", O_RDONLY ); // not available everywhere; then just skipped
+				if ( fd >= 0 )
+				{
+					char buff[128];
+					ssize_t sz = ::read( fd, buff, sizeof(buff) - 1 );
+					::close( fd );
+					unsigned long long sizePages = 0, residentPages = 0;
+					if ( sz > 0 )
+					{
+						buff[sz] = 0;
+						if ( sscanf( buff, "%llu %llu", &sizePages, &residentPages ) == 2 )
+						{
+							uint64_t pageSize = ::sysconf( _SC_PAGESIZE );
+							family( out, "process_virtual_memory_bytes", "gauge", "Virtual memory size in bytes." );
+							::fmt::format_to( std::back_inserter( out ), "process_virtual_memory_bytes {}\n", sizePages * pageSize );
+							family( out, "process_resident_memory_bytes", "gauge", "Resident memory size in bytes." );
+							::fmt::format_to( std::back_inserter( out ), "process_resident_memory_bytes {}\n", residentPages * pageSize );
+						}
+					}
+				}
+#endif
+			}
+
+		public:
+			void render( nodecpp::string& out ) {
+				nodecpp::stdvector<ThreadEntry> threads;
+				HistogramSnapshot clusterRequests;
+				registry().forEach( [&]( const ThreadMetrics& tm ) {
+					clusterRequests.add( tm.httpRequestMks );
+					if ( tm.live.load( std::memory_order_relaxed ) )
+						threads.push_back( ThreadEntry{ &tm, nodecpp::format( "role=\"{}\",instance=\"{}\"", roleName( tm.role.load( std::memory_order_relaxed ) ), tm.instanceId.load( std::memory_order_relaxed ) ) } );
+				} );
+
+				family( out, "nodecpp_threads", "gauge", "Threads running an event loop." );
+				::fmt::format_to( std::back_inserter( out ), "nodecpp_threads {}\n", threads.size() );
+
+				for ( const auto& f : counterFamilies )
+				{
+					family( out, f.name, f.type, f.help );
+					for ( const auto& t : threads )
+						::fmt::format_to( std::back_inserter( out ), "{}{{{}}} {}\n", f.name, t.labels.c_str(), ( t.tm->*f.counter ).get() );
+				}
+
+				family( out, "nodecpp_loop_busy_seconds_total", "counter", "Time spent by event loops outside of waits for I/O readiness." );
+				for ( const auto& t : threads )
+					::fmt::format_to( std::back_inserter( out ), "nodecpp_loop_busy_seconds_total{{{}}} {}\n", t.labels.c_str(), t.tm->loopIterationMks.getSum() * 1e-6 );
+				family( out, "nodecpp_loop_utilization", "gauge", "Busy share of event loop time since the previous scrape." );
+				for ( const auto& t : threads )
+				{
+					LoopTimes now{ t.tm->loopIterationMks.getSum(), t.tm->pollWaitMks.getSum() };
+					LoopTimes& prev = prevLoopTimes[ t.tm ];
+					if ( now.busyMks < prev.busyMks || now.waitMks < prev.waitMks ) // cannot normally happen; just in case
+						prev = LoopTimes();
+					uint64_t busy = now.busyMks - prev.busyMks;
+					uint64_t total = busy + now.waitMks - prev.waitMks;
+					prev = now;
+					::fmt::format_to( std::back_inserter( out ), "nodecpp_loop_utilization{{{}}} {}\n", t.labels.c_str(), total ? (double)busy / total : 0. );
+				}
+
+				for ( const auto& f : summaryFamilies )
+				{
+					family( out, f.name, "summary", f.help );
+					for ( const auto& t : threads )
+					{
+						HistogramSnapshot h;
+						h.add( t.tm->*f.histogram );
+						summary( out, f.name, t.labels, h, f.scale );
+					}
+				}
+
+				family( out, "nodecpp_handler_duration_seconds", "summary", "Time spent in handlers called by the event loop, by handler kind." );
+				for ( const auto& t : threads )
+					for ( size_t kind=1; kind<handlerKindCnt; ++kind )
+					{
+						HistogramSnapshot h;
+						h.add( t.tm->handlerMks[kind] );
+						summary( out, "nodecpp_handler_duration_seconds", nodecpp::format( "{},handler=\"{}\"", t.labels.c_str(), handlerKindName( (HandlerKind)kind ) ), h, 1e-6 );
+					}
+				family( out, "nodecpp_loop_longest_stall_seconds", "gauge", "Longest event loop stall seen so far." );
+				for ( const auto& t : threads )
+					::fmt::format_to( std::back_inserter( out ), "nodecpp_loop_longest_stall_seconds{{{}}} {}\n", t.labels.c_str(), t.tm->longestStallMks.get() * 1e-6 );
+
+				family( out, "nodecpp_memory_bytes", "gauge", "Memory held by the event loop, by category (memory freed by a thread other than the allocating one is accounted there)." );
+				for ( const auto& t : threads )
+					for ( size_t cat=0; cat<memCategoryCnt; ++cat )
+						::fmt::format_to( std::back_inserter( out ), "nodecpp_memory_bytes{{{},category=\"{}\"}} {}\n", t.labels.c_str(), memCategoryName( (MemCategory)cat ), t.tm->memBytes[cat].get() );
+				family( out, "nodecpp_memory_shedding", "gauge", "1 while the event loop is over its soft memory limit and sheds load." );
+				for ( const auto& t : threads )
+					::fmt::format_to( std::back_inserter( out ), "nodecpp_memory_shedding{{{}}} {}\n", t.labels.c_str(), t.tm->memShedding.load( std::memory_order_relaxed ) ? 1 : 0 );
+				int64_t memTotals[memCategoryCnt] = {};
+				registry().forEach( [&]( const ThreadMetrics& tm ) {
+					for ( size_t cat=0; cat<memCategoryCnt; ++cat )
+						memTotals[cat] += tm.memBytes[cat].get();
+				} );
+				family( out, "nodecpp_cluster_memory_bytes", "gauge", "Memory held over all threads, including exited ones, by category." );
+				for ( size_t cat=0; cat<memCategoryCnt; ++cat )
+					::fmt::format_to( std::back_inserter( out ), "nodecpp_cluster_memory_bytes{{category=\"{}\"}} {}\n", memCategoryName( (MemCategory)cat ), memTotals[cat] );
+
+				nodecpp::stdmap<nodecpp::string, nodecpp::stdvector<HistogramSnapshot>> routes; // over all threads
+				registry().forEach( [&]( const ThreadMetrics& tm ) {
+					for ( size_t i=0; i<ThreadMetrics::maxHttpRoutes; ++i )
+					{
+						const HttpRouteMetrics* rm = tm.httpRoutes[i].load( std::memory_order_acquire );
+						if ( rm == nullptr )
+							break;
+						auto& phases = routes[ nodecpp::string( rm->route ) ];
+						phases.resize( routePhaseCnt );
+						for ( size_t p=0; p<routePhaseCnt; ++p )
+							phases[p].add( rm->*(routePhases[p].histogram) );
+					}
+				} );
+				family( out, "nodecpp_http_route_phase_seconds", "summary", "Phases of HTTP requests by route, over all threads: receive (request line to parsed head), queue (to the handler), handler (to the first byte of the response), send (to the whole response written), and total." );
+				for ( const auto& route : routes )
+					for ( size_t p=0; p<routePhaseCnt; ++p )
+						summary( out, "nodecpp_http_route_phase_seconds", nodecpp::format( "route=\"{}\",phase=\"{}\"", escapeLabelValue( route.first.c_str() ).c_str(), routePhases[p].name ), route.second[p], 1e-6 );
+
+				family( out, "nodecpp_cluster_http_request_duration_seconds", "summary", "Time from a parsed HTTP request head to the completed response, over all threads." );
+				summary( out, "nodecpp_cluster_http_request_duration_seconds", nodecpp::string(), clusterRequests, 1e-6 );
+
+				renderProcess( out );
+			}
+		};
+
+		struct ServerOptions
+		{
+			uint16_t port = 9464;
+			const char* ip = "127.0.0.1";
+			int backlog = 16;
+			const char* path = "/metrics";
+		};
+
+		class MetricsServer : public nodecpp::net::HttpServer<void>
+		{
+			PrometheusExporter exporter;
+			nodecpp::string path;
+
+		public:
+			MetricsServer( const char* path_ ) : path( path_ ) {}
+			virtual ~MetricsServer() {}
+
+			void onRequest( nodecpp::net::IncomingHttpMessageAtServer& request, nodecpp::net::HttpServerResponse& response )
+			{
+				const nodecpp::string& url = request.getUrl();
+				size_t pathSz = url.find( '?' );
+				if ( pathSz == nodecpp::string::npos )
+					pathSz = url.size();
+				if ( request.getMethod() != "GET" && request.getMethod() != "HEAD" )
+				{
+					response.writeHead( 405, "Method Not Allowed" );
+					response.end();
+					return;
+				}
+				if ( pathSz != path.size() || memcmp( url.c_str(), path.c_str(), pathSz ) != 0 )
+				{
+					response.writeHead( 404, "Not Found" );
+					response.end();
+					return;
+				}
+				nodecpp::string body;
+				exporter.render( body );
+				response.writeHead( 200, {{"Content-Type", "text/plain; version=0.0.4; charset=utf-8"}} );
+				response.end( std::move( body ) );
+			}
+		};
+
+		// to be called from the master's main() (or from main() of the only thread if clustering is not used)
+		inline nodecpp::owning_ptr<MetricsServer> startServer( const ServerOptions& options = ServerOptions() ) {
+			auto srv = nodecpp::net::createHttpServer<MetricsServer>( options.path );
+			MetricsServer* server = &(*srv);
+			srv->on( nodecpp::string_literal( event::HttpRequest::name ), [server]( nodecpp::net::IncomingHttpMessageAtServer& request, nodecpp::net::HttpServerResponse& response ) {
+				server->onRequest( request, response );
+			} );
+			srv->listen( options.port, options.ip, options.backlog );
+			return srv;
+		}
+
+	} // namespace metrics
+
+} // namespace nodecpp
+
+#endif // NODECPP_METRICS_SERVER_H
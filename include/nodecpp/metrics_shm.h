@@ -0,0 +1,140 @@
+/* -------------------------------------------------------------------------------
+* Copyright (c) 2021, OLogN Technologies AG
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*     * Neither the name of the OLogN Technologies AG nor the
+*       names of its contributors may be used to endorse or promote products
+*       derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL OLogN Technologies AG BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+* -------------------------------------------------------------------------------*/
+
+#ifndef NODECPP_METRICS_SHM_H
+#define NODECPP_METRICS_SHM_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+
+// Layout of the shared memory region into which event loops periodically publish their counters (see metrics::Options::shmPeriodMs).
+// Deliberately self-contained: out-of-process readers (like tools/nodecpp_top) include this header only.
+// Each record has a single writer (its loop) and is protected by a seqlock; readers map the region read-only and never
+// reach the server in any way
+
+namespace nodecpp {
+
+	namespace metrics {
+
+		namespace shm {
+
+			static constexpr uint32_t magic = 0x4d43504e; // "NPCM"
+			static constexpr uint32_t version = 1;
+			static constexpr size_t maxThreads = 128; // same as Registry::maxThreads; a record index is the thread's slot there
+
+			enum Field { iterations, polls, readyEvents, interThreadMsgs, timersFired, connectionsAccepted, connectionsClosed, openSockets, 
+				bytesIn, bytesOut, sendCalls, sendWouldBlock, httpRequests, httpRequestMks, busyMks, waitMks, fieldCnt };
+
+			static constexpr const char* roleNames[] = { "unknown", "master", "worker", "listener", "node" }; // by metrics::ThreadRole
+
+			struct alignas(64) ThreadRecord
+			{
+				std::atomic<uint64_t> seq; // odd while an update is in progress
+				std::atomic<uint64_t> publishedAt; // mks, CLOCK_MONOTONIC
+				std::atomic<uint32_t> role;
+				std::atomic<uint32_t> instanceId;
+				std::atomic<uint64_t> values[fieldCnt]; // all cumulative, except openSockets
+			};
+
+			struct ThreadData
+			{
+				uint64_t publishedAt;
+				uint32_t role;
+				uint32_t instanceId;
+				uint64_t values[fieldCnt];
+			};
+
+			struct Header
+			{
+				uint32_t magic;
+				uint32_t version;
+				uint32_t headerSize;
+				uint32_t recordSize;
+				uint32_t recordCnt;
+				uint32_t fieldCnt;
+				uint32_t periodMs;
+				int32_t pid;
+				std::atomic<uint32_t> ready; // set last, once all of the above is valid
+			};
+
+			struct Region
+			{
+				alignas(64) Header header;
+				ThreadRecord threads[maxThreads];
+			};
+			static_assert( std::atomic<uint64_t>::is_always_lock_free && std::atomic<uint32_t>::is_always_lock_free ); // required to be usable across processes
+
+			inline bool isCompatible( const Header& h ) {
+				return h.ready.load( std::memory_order_acquire ) && h.magic == magic && h.version == version && 
+					h.headerSize == sizeof(Header) && h.recordSize == sizeof(ThreadRecord) && h.recordCnt == maxThreads && h.fieldCnt == fieldCnt;
+			}
+
+			inline void write( ThreadRecord& r, const ThreadData& d ) { // by the only writer of the record
+				uint64_t seq = r.seq.load( std::memory_order_relaxed );
+				r.seq.store( seq + 1, std::memory_order_relaxed );
+				std::atomic_thread_fence( std::memory_order_release );
+				r.publishedAt.store( d.publishedAt, std::memory_order_relaxed );
+				r.role.store( d.role, std::memory_order_relaxed );
+				r.instanceId.store( d.instanceId, std::memory_order_relaxed );
+				for ( size_t i=0; i<fieldCnt; ++i )
+					r.values[i].store( d.values[i], std::memory_order_relaxed );
+				r.seq.store( seq + 2, std::memory_order_release );
+			}
+
+			inline bool read( const ThreadRecord& r, ThreadData& d ) { // false if the record has never been written or is being updated too often
+				for ( size_t attempt=0; attempt<64; ++attempt )
+				{
+					uint64_t seq = r.seq.load( std::memory_order_acquire );
+					if ( seq == 0 )
+						return false;
+					if ( seq & 1 )
+						continue;
+					d.publishedAt = r.publishedAt.load( std::memory_order_relaxed );
+					d.role = r.role.load( std::memory_order_relaxed );
+					d.instanceId = r.instanceId.load( std::memory_order_relaxed );
+					for ( size_t i=0; i<fieldCnt; ++i )
+						d.values[i] = r.values[i].load( std::memory_order_relaxed );
+					std::atomic_thread_fence( std::memory_order_acquire );
+					if ( r.seq.load( std::memory_order_relaxed ) == seq )
+						return true;
+				}
+				return false;
+			}
+
+			inline void defaultName( char* buff, size_t sz, int pid ) {
+				snprintf( buff, sz, "/nodecpp-metrics.%d", pid );
+			}
+
+		} // namespace shm
+
+	} // namespace metrics
+
+} // namespace nodecpp
+
+#endif // NODECPP_METRICS_SHM_H
@@ -35,6 +35,7 @@
 
 namespace nodecpp {
 
+	// memory is accounted as metrics::MemCategory::SocketBuffers
 	class CircularByteBuffer
 	{
 		std::unique_ptr<uint8_t[]> buff; // TODO: switch to using safe memory objects ASAP
@@ -44,9 +45,17 @@ namespace nodecpp {
 		uint8_t* end = nullptr;
 
 		bool resize_up_and_append( const uint8_t* data, size_t data_size) {
+			if ( !resize_up( used_size() + data_size ) )
+				return false;
+			memcpy( end, data, data_size );
+			end += data_size;
+
+			return true;
+		}
+
+		bool resize_up( size_t total_sz ) {
 			// TODO: introduce upper limit and make this call bool
 			NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, buff != nullptr );
-			size_t total_sz = used_size() + data_size;
 			size_t new_size_exp = size_exp + 1;
 			while ( (((size_t)1) << new_size_exp) < total_sz + 1 )
 			{
@@ -57,6 +66,7 @@ namespace nodecpp {
 			}
 			size_t new_alloc_size = ((size_t)1) << new_size_exp;
 			std::unique_ptr<uint8_t[]> new_buff( new uint8_t[new_alloc_size] );
+			nodecpp::metrics::chargeMemory( nodecpp::metrics::MemCategory::SocketBuffers, new_alloc_size - alloc_size() );
 			size_t sz = 0;
 			if ( begin <= end )
 			{
@@ -75,9 +85,6 @@ namespace nodecpp {
 			begin = buff.get();
 			end = begin + sz;
 
-			memcpy( end, data, data_size );
-			end += data_size;
-
 			return true;
 		}
 
@@ -85,6 +92,7 @@ namespace nodecpp {
 		CircularByteBuffer(size_t sz_exp = 16) { 
 			size_exp = sz_exp; 
 			buff = std::unique_ptr<uint8_t[]>(new uint8_t[alloc_size()]);
+			nodecpp::metrics::chargeMemory( nodecpp::metrics::MemCategory::SocketBuffers, alloc_size() );
 			begin = end = buff.get();
 		}
 		CircularByteBuffer( const CircularByteBuffer& ) = delete;
@@ -95,15 +103,35 @@ namespace nodecpp {
 			end = other.end;
 		}
 		CircularByteBuffer& operator = ( CircularByteBuffer&& other ) {
-			size_exp = other.size_exp;
-			begin = other.begin;
-			end = other.end;
+			std::swap( buff, other.buff );
+			std::swap( size_exp, other.size_exp );
+			std::swap( begin, other.begin );
+			std::swap( end, other.end );
 			return *this;
 		}
+		~CircularByteBuffer() {
+			if ( buff != nullptr )
+				nodecpp::metrics::chargeMemory( nodecpp::metrics::MemCategory::SocketBuffers, -(int64_t)alloc_size() );
+		}
 		size_t used_size() const { return begin <= end ? end - begin : alloc_size() - (begin - end); }
 		size_t remaining_capacity() const { return alloc_size() - 1 - used_size(); }
 		bool empty() const { return begin == end; }
 		size_t alloc_size() const { return ((size_t)1)<<size_exp; }
+		bool reserve( size_t sz ) { return sz < alloc_size() ? true : resize_up( sz ); }
+		size_t allocated_size() const { return buff != nullptr ? alloc_size() : 0; }
+
+		// gives memory back if the buffer is empty and has grown beyond 2^sz_exp; returns true if it has done so
+		bool shrink_if_empty( size_t sz_exp ) {
+			if ( buff == nullptr || !empty() || size_exp <= sz_exp )
+				return false;
+			size_t new_alloc_size = ((size_t)1) << sz_exp;
+			std::unique_ptr<uint8_t[]> new_buff( new uint8_t[new_alloc_size] );
+			nodecpp::metrics::chargeMemory( nodecpp::metrics::MemCategory::SocketBuffers, (int64_t)new_alloc_size - (int64_t)alloc_size() );
+			buff = std::move( new_buff );
+			size_exp = sz_exp;
+			begin = end = buff.get();
+			return true;
+		}
 
 		// writer-related
 		bool append( const uint8_t* ptr, size_t sz ) { 
@@ -141,7 +169,7 @@ namespace nodecpp {
 			else if ( begin > end )
 			{
 				size_t sz2write = buff.get() + alloc_size() - begin;
-				bool can_continue = writer.write( end, sz2write, bytesWritten );
+				bool can_continue = writer.write( begin, sz2write, bytesWritten );
 				begin += bytesWritten;
 				bool till_end = begin == (buff.get() + alloc_size());
 				if( till_end )
@@ -170,6 +198,48 @@ namespace nodecpp {
 			get_ready_data( b, b.capacity() );
 		}
 
+		// copies up to sz bytes without consuming them; returns the number of bytes copied
+		size_t peek( uint8_t* dst, size_t sz ) const {
+			size_t avail = used_size();
+			if ( sz > avail )
+				sz = avail;
+			size_t fwd_sz = buff.get() + alloc_size() - begin;
+			if ( sz <= fwd_sz )
+				memcpy( dst, begin, sz );
+			else
+			{
+				memcpy( dst, begin, fwd_sz );
+				memcpy( dst + fwd_sz, buff.get(), sz - fwd_sz );
+			}
+			return sz;
+		}
+
+		void skip( size_t sz ) {
+			NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, sz <= used_size(), "{} vs. {}", sz, used_size() );
+			size_t fwd_sz = buff.get() + alloc_size() - begin;
+			if ( sz < fwd_sz )
+				begin += sz;
+			else
+				begin = buff.get() + ( sz - fwd_sz );
+		}
+
+		// unlike get_ready_data() appends to whatever is already at b; returns the number of bytes moved
+		size_t append_ready_data( Buffer& b, size_t bytes2read ) {
+			size_t avail = used_size();
+			if ( bytes2read > avail )
+				bytes2read = avail;
+			size_t fwd_sz = buff.get() + alloc_size() - begin;
+			if ( bytes2read <= fwd_sz )
+				b.append( begin, bytes2read );
+			else
+			{
+				b.append( begin, fwd_sz );
+				b.append( buff.get(), bytes2read - fwd_sz );
+			}
+			skip( bytes2read );
+			return bytes2read;
+		}
+
 		CoroStandardOutcomes read_ready_data_until_impl( Buffer& b, uint8_t what, uint8_t* workingEnd )
 		{
 
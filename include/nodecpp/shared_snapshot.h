@@ -0,0 +1,197 @@
+/* -------------------------------------------------------------------------------
+* Copyright (c) 2021, OLogN Technologies AG
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*     * Neither the name of the OLogN Technologies AG nor the
+*       names of its contributors may be used to endorse or promote products
+*       derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL OLogN Technologies AG BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+* -------------------------------------------------------------------------------*/
+
+#ifndef NODECPP_SHARED_SNAPSHOT_H
+#define NODECPP_SHARED_SNAPSHOT_H
+
+#include "common.h"
+#include <atomic>
+#include <mutex>
+
+namespace nodecpp {
+
+	// Quiescent-state-based reclamation: every event loop reports a quiescent point once per iteration 
+	// (and is 'offline' while waiting in poll); an object retired at epoch E is freed once no online loop is behind E
+	namespace qsbr {
+
+		static constexpr size_t maxThreads = 128;
+
+		class Domain
+		{
+			struct alignas(64) ThreadState
+			{
+				std::atomic<uint64_t> epoch = 0; // 0: offline
+				std::atomic<bool> used = false;
+			};
+			struct Retired
+			{
+				const void* ptr;
+				void (*deleter)(const void*);
+				uint64_t epoch;
+			};
+
+			ThreadState threads[maxThreads];
+			std::atomic<size_t> usedCnt = 0;
+			std::atomic<uint64_t> globalEpoch = 1;
+			std::mutex mx;
+			nodecpp::stdvector<Retired> retired; // mx-protected
+			std::atomic<size_t> retiredCnt = 0;
+
+		public:
+			size_t registerThread() {
+				for ( size_t i=0; i<maxThreads; ++i )
+				{
+					bool expected = false;
+					if ( threads[i].used.compare_exchange_strong( expected, true, std::memory_order_acq_rel ) )
+					{
+						online( i );
+						size_t cnt = usedCnt.load( std::memory_order_relaxed );
+						while ( cnt < i + 1 && !usedCnt.compare_exchange_weak( cnt, i + 1, std::memory_order_release ) )
+							;
+						return i;
+					}
+				}
+				NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, false, "too many threads ({} max)", maxThreads );
+				return (size_t)(-1);
+			}
+			void unregisterThread( size_t idx ) {
+				offline( idx );
+				threads[idx].used.store( false, std::memory_order_release );
+				tryReclaim();
+			}
+
+			void quiescent( size_t idx ) {
+				threads[idx].epoch.store( globalEpoch.load( std::memory_order_acquire ), std::memory_order_release );
+				if ( retiredCnt.load( std::memory_order_relaxed ) != 0 )
+					tryReclaim();
+			}
+			void offline( size_t idx ) { threads[idx].epoch.store( 0, std::memory_order_release ); }
+			void online( size_t idx ) {
+				threads[idx].epoch.store( globalEpoch.load( std::memory_order_acquire ), std::memory_order_relaxed );
+				std::atomic_thread_fence( std::memory_order_seq_cst ); // pairs with the fence in tryReclaim()
+			}
+
+			void retire( const void* ptr, void (*deleter)(const void*) ) {
+				uint64_t epoch = globalEpoch.fetch_add( 1, std::memory_order_acq_rel ) + 1;
+				{
+					std::unique_lock<std::mutex> lock(mx);
+					retired.push_back( Retired({ptr, deleter, epoch}) );
+				}
+				retiredCnt.fetch_add( 1, std::memory_order_relaxed );
+				tryReclaim();
+			}
+
+			void tryReclaim() {
+				std::atomic_thread_fence( std::memory_order_seq_cst );
+				uint64_t minEpoch = UINT64_MAX;
+				size_t cnt = usedCnt.load( std::memory_order_acquire );
+				for ( size_t i=0; i<cnt; ++i )
+				{
+					uint64_t e = threads[i].epoch.load( std::memory_order_acquire );
+					if ( e != 0 && e < minEpoch )
+						minEpoch = e;
+				}
+				nodecpp::stdvector<Retired> toFree;
+				{
+					std::unique_lock<std::mutex> lock(mx, std::try_to_lock);
+					if ( !lock.owns_lock() ) // someone else is reclaiming right now
+						return;
+					size_t kept = 0;
+					for ( size_t i=0; i<retired.size(); ++i )
+						if ( retired[i].epoch <= minEpoch )
+							toFree.push_back( retired[i] );
+						else
+							retired[kept++] = retired[i];
+					retired.resize( kept );
+				}
+				if ( toFree.empty() )
+					return;
+				retiredCnt.fetch_sub( toFree.size(), std::memory_order_relaxed );
+				for ( auto& r : toFree )
+					r.deleter( r.ptr );
+			}
+		};
+
+		inline Domain& domain() { static Domain d; return d; }
+		inline thread_local size_t thisThreadIdx = (size_t)(-1);
+
+		// to be called by event loops only
+		inline void registerThisThread() { NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, thisThreadIdx == (size_t)(-1) ); thisThreadIdx = domain().registerThread(); }
+		inline void unregisterThisThread() { if ( thisThreadIdx != (size_t)(-1) ) { domain().unregisterThread( thisThreadIdx ); thisThreadIdx = (size_t)(-1); } }
+		inline void quiescentState() { if ( thisThreadIdx != (size_t)(-1) ) domain().quiescent( thisThreadIdx ); }
+		inline void goOffline() { if ( thisThreadIdx != (size_t)(-1) ) domain().offline( thisThreadIdx ); }
+		inline void goOnline() { if ( thisThreadIdx != (size_t)(-1) ) domain().online( thisThreadIdx ); }
+
+		class LoopParticipation
+		{
+		public:
+			LoopParticipation() { registerThisThread(); }
+			LoopParticipation( const LoopParticipation& ) = delete;
+			LoopParticipation& operator = ( const LoopParticipation& ) = delete;
+			~LoopParticipation() { unregisterThisThread(); }
+		};
+
+	} // namespace qsbr
+
+	// Read-mostly data shared by all event loops (ACLs, routing maps, feature flags, ...).
+	// A writer publishes a new immutable version; a reader gets the current one with a single acquire load.
+	// A pointer returned by get() is valid until the reader's loop completes its current iteration; 
+	// it must not be kept across co_await or in callbacks to be called later.
+	template<class T>
+	class SharedSnapshot
+	{
+		std::atomic<const T*> current = nullptr;
+
+		static void deleter( const void* ptr ) { nodecpp::stddealloc( const_cast<T*>( reinterpret_cast<const T*>( ptr ) ), 1 ); } // may run at any thread
+
+	public:
+		SharedSnapshot() {}
+		SharedSnapshot( const SharedSnapshot& ) = delete;
+		SharedSnapshot& operator = ( const SharedSnapshot& ) = delete;
+		SharedSnapshot( SharedSnapshot&& ) = delete;
+		SharedSnapshot& operator = ( SharedSnapshot&& ) = delete;
+		~SharedSnapshot() { // no readers are expected at this point
+			const T* last = current.load( std::memory_order_acquire );
+			if ( last != nullptr )
+				deleter( last );
+		}
+
+		const T* get() const { return current.load( std::memory_order_acquire ); }
+
+		template<class ... Args>
+		void publish( Args&& ... args ) {
+			// note: if T owns memory, it should be allocated by nodecpp::stdallocator, as the version may be freed at another thread
+			T* fresh = nodecpp::stdalloc<T>( 1, std::forward<Args>( args )... );
+			const T* old = current.exchange( fresh, std::memory_order_acq_rel );
+			if ( old != nullptr )
+				qsbr::domain().retire( old, deleter );
+		}
+	};
+
+} // namespace nodecpp
+
+#endif // NODECPP_SHARED_SNAPSHOT_H
@@ -38,6 +38,31 @@ namespace nodecpp {
 
 	namespace net {
 
+		struct SocketStats
+		{
+			uint64_t bytesIn = 0; // as received from the OS
+			uint64_t bytesOut = 0; // as accepted by the OS
+			uint64_t reads = 0; // those that returned data
+			uint64_t writes = 0; // send calls
+			uint64_t writeBacklogMks = 0; // total time with data waiting to be sent, except the current backlog
+			uint64_t writeBacklogSince = 0; // start of the current backlog; 0 if there is none
+			size_t maxWriteBacklog = 0; // the most data that was waiting to be sent at once
+
+			struct TcpInfo // as of the last sample; see SocketBase::sampleTcpInfo() and nodecpp::metrics::Options::tcpInfoPeriodMs
+			{
+				uint64_t sampledAt = 0; // 0 if never sampled (TCP_INFO is only supported on Linux)
+				uint32_t rttMks = 0;
+				uint32_t rttVarMks = 0;
+				uint32_t cwnd = 0; // segments
+				uint32_t unacked = 0; // segments
+				uint32_t retransmits = 0; // over the connection lifetime
+			};
+			TcpInfo tcp;
+
+			void addRead( size_t sz ) { if ( sz != 0 ) { bytesIn += sz; ++reads; } }
+			uint64_t writeBacklogMksAt( uint64_t now ) const { return writeBacklogMks + ( writeBacklogSince != 0 ? now - writeBacklogSince : 0 ); }
+		};
+
 		class ServerBase; // forward declaration
 		class SocketBase
 		{
@@ -87,14 +112,21 @@ namespace nodecpp {
 				//bool localEnded = false;
 				//bool pendingLocalEnd = false;
 				bool paused = false;
+				size_t readHighWaterMark = 0; // if non-zero, incoming data is accumulated at readBuffer even with no a_read() pending; reading is paused as soon as this size is reached
 				bool allowHalfOpen = false; // nodejs-inspired reasonable default
 
 				bool refed = false;
 
-				CircularByteBuffer writeBuffer = CircularByteBuffer( 12 );
-				CircularByteBuffer readBuffer = CircularByteBuffer( 12 );
+				static constexpr size_t initialBufferSizeExp = 12;
+				CircularByteBuffer writeBuffer = CircularByteBuffer( initialBufferSizeExp );
+				CircularByteBuffer readBuffer = CircularByteBuffer( initialBufferSizeExp );
 
 				unsigned long long osSocket = 0;
+				SocketStats stats;
+#ifdef NODECPP_ENABLE_CLUSTERING
+				bool migrated = false; // the OS socket has been handed over to another worker; no close/error events are emitted here
+				bool migratable = false; // the app allows handing the connection over to another worker (see setMigratable())
+#endif // NODECPP_ENABLE_CLUSTERING
 
 
 				DataForCommandProcessing() {}
@@ -105,6 +137,19 @@ namespace nodecpp {
 				DataForCommandProcessing& operator=(DataForCommandProcessing&& other) = default;
 
 				bool isValid() const { return state != State::Uninitialized; }
+				size_t bufferBytes() const { return writeBuffer.allocated_size() + readBuffer.allocated_size() + ahd_write.b.capacity(); }
+				bool shrinkIdleBuffers() { // back to the initial size, if grown and empty
+					bool shrunk = writeBuffer.shrink_if_empty( initialBufferSizeExp );
+					// a pending a_read() (and a read high-water mark) rely on the space reserved for them: reading never grows readBuffer;
+					// a_read() and a_bytesAvailable() reserve what they need when called
+					size_t needed = ahd_read.h != nullptr ? ahd_read.min_bytes : 0;
+					if ( readHighWaterMark > needed )
+						needed = readHighWaterMark;
+					size_t readSizeExp = initialBufferSizeExp;
+					while ( (((size_t)1) << readSizeExp) < needed + 1 )
+						++readSizeExp;
+					return readBuffer.shrink_if_empty( readSizeExp ) || shrunk;
+				}
 
 
 				struct UserHandlersCommon
@@ -426,6 +471,9 @@ namespace nodecpp {
 			size_t bufferSize() const { return dataForCommandProcessing.writeBuffer.used_size(); }
 			size_t bytesRead() const { return _bytesRead; }
 			size_t bytesWritten() const { return _bytesWritten; }
+			const SocketStats& stats() const { return dataForCommandProcessing.stats; }
+			bool sampleTcpInfo(); // updates stats().tcp right away; returns false if not supported or failed
+			size_t bufferBytes() const { return dataForCommandProcessing.bufferBytes(); } // memory currently held by read and write buffers of the socket
 
 			bool connecting() const { return dataForCommandProcessing.state == DataForCommandProcessing::State::Connecting; }
 			void destroy();
@@ -446,7 +494,19 @@ namespace nodecpp {
 			void unref();
 			void pause();
 			void resume();
+			bool isPaused() const { return dataForCommandProcessing.paused; }
+			void setReadHighWaterMark( size_t hwm ) { dataForCommandProcessing.readHighWaterMark = hwm; }
+			size_t readBufferSize() const { return dataForCommandProcessing.readBuffer.used_size(); }
 			void reportBeingDestructed();
+#ifdef NODECPP_ENABLE_CLUSTERING
+			// hands the connection over to a less loaded worker (if any) together with its buffered data;
+			// on success this object is released as if closed, but without 'error' and 'close' events.
+			// Only event-mode sockets ('data' handlers) can migrate: a socket with a pending a_read() or a_write(),
+			// such as one served by HttpSocketBase::run() or a WebSocket/h2c session, is refused and stays here
+			bool migrate();
+			// opts the connection in to be migrated by a retiring worker and by periodic rebalancing of an overloaded one
+			void setMigratable( bool migratable ) { dataForCommandProcessing.migratable = migratable; }
+#endif // NODECPP_ENABLE_CLUSTERING
 
 		private:
 			bool write(const uint8_t* data, uint32_t size);
@@ -594,8 +654,13 @@ namespace nodecpp {
 				}
 			}
 
+		protected:
+			virtual void onWriteBacklogFlushed() {} // everything written so far has been handed over to the OS; called before the drain event is emitted
+
+		public:
 			void rrOnDrain()
 			{
+				onWriteBacklogFlushed();
 #ifdef NODECPP_RECORD_AND_REPLAY
 				if ( ::nodecpp::threadLocalData.binaryLog != nullptr && threadLocalData.binaryLog->mode() == record_and_replay_impl::BinaryLog::Mode::replaying )
 				{
@@ -901,6 +966,7 @@ namespace nodecpp {
 						}
 					}
 				};
+				dataForCommandProcessing.readBuffer.reserve( min_bytes ); // readBuffer may have been shrunk meanwhile (see shrinkIdleBuffers())
 				return read_data_awaiter(*this, buff, min_bytes, max_bytes);
 			}
 
@@ -1017,16 +1083,20 @@ namespace nodecpp {
 						}
 					}
 				};
+				dataForCommandProcessing.readBuffer.reserve( min_bytes ); // readBuffer may have been shrunk meanwhile (see shrinkIdleBuffers())
 				return read_data_awaiter(*this, period, buff, min_bytes, max_bytes);
 			}
 
-			auto a_someDataAvailable() { // resumed on data availablity or throws
+			auto a_someDataAvailable() { return a_bytesAvailable( 1 ); } // resumed on data availablity or throws
+
+			auto a_bytesAvailable( size_t min_bytes ) { // resumed as soon as at least min_bytes are at readBuffer, or throws
 
 				struct data_awaiter {
 					std::experimental::coroutine_handle<> myawaiting = nullptr;
 					SocketBase& socket;
+					size_t min_bytes;
 
-					data_awaiter(SocketBase& socket_) : socket( socket_ ) {
+					data_awaiter(SocketBase& socket_, size_t min_bytes_) : socket( socket_ ), min_bytes( min_bytes_ ) {
 					}
 
 					data_awaiter(const data_awaiter &) = delete;
@@ -1039,7 +1109,7 @@ namespace nodecpp {
 #ifdef NODECPP_RECORD_AND_REPLAY
 						if ( ::nodecpp::threadLocalData.binaryLog != nullptr && threadLocalData.binaryLog->mode() == record_and_replay_impl::BinaryLog::Mode::recording )
 						{
-							bool ret = socket.dataForCommandProcessing.readBuffer.used_size() >= 1;
+							bool ret = socket.dataForCommandProcessing.readBuffer.used_size() >= min_bytes;
 							::nodecpp::threadLocalData.binaryLog->addFrame( record_and_replay_impl::BinaryLog::FrameType::coro_await_ready_res, &ret, 1 );
 							return ret;
 						}
@@ -1051,11 +1121,11 @@ namespace nodecpp {
 						}
 						else
 #endif // NODECPP_RECORD_AND_REPLAY
-						return socket.dataForCommandProcessing.readBuffer.used_size() >= 1;
+						return socket.dataForCommandProcessing.readBuffer.used_size() >= min_bytes;
 					}
 
 					void await_suspend(std::experimental::coroutine_handle<> awaiting) {
-						socket.dataForCommandProcessing.ahd_read.min_bytes = 1;
+						socket.dataForCommandProcessing.ahd_read.min_bytes = min_bytes;
 						nodecpp::initCoroData(awaiting);
 						socket.dataForCommandProcessing.ahd_read.h = awaiting;
 						myawaiting = awaiting;
@@ -1070,7 +1140,7 @@ namespace nodecpp {
 								::nodecpp::threadLocalData.binaryLog->addFrame( record_and_replay_impl::BinaryLog::FrameType::http_sock_read_data_crh_except, nullptr, 0 );
 								throw nodecpp::getCoroException(myawaiting);
 							}
-							bool ret = socket.dataForCommandProcessing.readBuffer.used_size() >= 1;
+							bool ret = socket.dataForCommandProcessing.readBuffer.used_size() >= min_bytes;
 							::nodecpp::threadLocalData.binaryLog->addFrame( record_and_replay_impl::BinaryLog::FrameType::coro_await_ready_res, &ret, 1 );
 //							return ret;
 						}
@@ -1096,7 +1166,9 @@ namespace nodecpp {
 						}
 					}
 				};
-				return data_awaiter(*this);
+				NODECPP_ASSERT(nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, min_bytes != 0 );
+				dataForCommandProcessing.readBuffer.reserve( min_bytes );
+				return data_awaiter(*this, min_bytes);
 			}
 
 			::nodecpp::awaitable<CoroStandardOutcomes> a_readUntil( Buffer& b, uint8_t what ) { 
@@ -0,0 +1,290 @@
+/* -------------------------------------------------------------------------------
+* Copyright (c) 2021, OLogN Technologies AG
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*     * Neither the name of the OLogN Technologies AG nor the
+*       names of its contributors may be used to endorse or promote products
+*       derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL OLogN Technologies AG BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+* -------------------------------------------------------------------------------*/
+
+#ifndef NODECPP_THREAD_PLACEMENT_H
+#define NODECPP_THREAD_PLACEMENT_H
+
+#include "common.h"
+#include <atomic>
+#include <mutex>
+
+#ifdef __linux__
+#include <sched.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#include <algorithm>
+#endif
+
+namespace nodecpp {
+
+	struct ThreadPlacementOptions
+	{
+		enum class Policy { 
+			None, // threads are left to the scheduler
+			PinToCore, // each worker gets its own CPU (distinct physical cores first); listeners are bound to a NUMA node
+			PinToNumaNode // workers and listeners are bound to a NUMA node and may float within it
+		};
+		Policy policy = Policy::None;
+		bool localMemory = true; // prefer memory of the thread's own NUMA node (applies to the allocator arena, which is initialized after placement)
+		bool incomingCpu = true; // set SO_INCOMING_CPU on per-worker listening sockets (ReusePortPerWorker mode)
+	};
+
+	namespace placement {
+
+		enum class Role { Worker, Listener };
+
+		struct CpuInfo
+		{
+			int cpu;
+			int core;
+			int package;
+			int node;
+			int siblingRank; // 0 for the first logical CPU of a physical core, 1 for its SMT sibling, etc
+		};
+
+		class Topology
+		{
+			nodecpp::stdvector<CpuInfo> cpus_; // CPUs this process is allowed to run on
+			nodecpp::stdvector<nodecpp::stdvector<int>> nodeCpus_; // per NUMA node; distinct physical cores first
+			nodecpp::stdvector<int> nodeIds_; // NUMA node ids as seen by the OS, in the same order as nodeCpus_
+			bool valid_ = false;
+
+#ifdef __linux__
+			static int readIntFromFile( const char* path, int defaultValue )
+			{
+				FILE* f = fopen( path, "r" );
+				if ( f == nullptr )
+					return defaultValue;
+				int ret = defaultValue;
+				if ( fscanf( f, "%d", &ret ) != 1 )
+					ret = defaultValue;
+				fclose( f );
+				return ret;
+			}
+
+			static int nodeOfCpu( int cpu )
+			{
+				char path[128];
+				for ( int node=0; node<1024; ++node )
+				{
+					snprintf( path, sizeof(path), "/sys/devices/system/cpu/cpu%d/node%d", cpu, node );
+					if ( access( path, F_OK ) == 0 )
+						return node;
+				}
+				return 0;
+			}
+
+			void build()
+			{
+				cpu_set_t allowed;
+				CPU_ZERO( &allowed );
+				if ( sched_getaffinity( 0, sizeof(allowed), &allowed ) != 0 )
+					return;
+				char path[128];
+				for ( int cpu=0; cpu<CPU_SETSIZE; ++cpu )
+				{
+					if ( !CPU_ISSET( cpu, &allowed ) )
+						continue;
+					CpuInfo info;
+					info.cpu = cpu;
+					snprintf( path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/core_id", cpu );
+					info.core = readIntFromFile( path, cpu );
+					snprintf( path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/physical_package_id", cpu );
+					info.package = readIntFromFile( path, 0 );
+					info.node = nodeOfCpu( cpu );
+					info.siblingRank = 0;
+					for ( auto& other : cpus_ )
+						if ( other.core == info.core && other.package == info.package )
+							++(info.siblingRank);
+					cpus_.push_back( info );
+				}
+				if ( cpus_.empty() )
+					return;
+				int maxNode = 0;
+				for ( auto& c : cpus_ )
+					maxNode = std::max( maxNode, c.node );
+				nodecpp::stdvector<nodecpp::stdvector<int>> byNode( maxNode + 1 );
+				auto sorted = cpus_;
+				std::stable_sort( sorted.begin(), sorted.end(), []( const CpuInfo& a, const CpuInfo& b ) { return a.siblingRank < b.siblingRank; } );
+				for ( auto& c : sorted )
+					byNode[c.node].push_back( c.cpu );
+				for ( size_t node=0; node<byNode.size(); ++node ) // nodes may be sparse or have no CPUs available to us
+					if ( !byNode[node].empty() )
+					{
+						nodeCpus_.push_back( std::move( byNode[node] ) );
+						nodeIds_.push_back( (int)node );
+					}
+				valid_ = true;
+			}
+#else
+			void build() {} // not yet implemented for other platforms
+#endif
+
+		public:
+			static const Topology& get()
+			{
+				static Topology topology = []() { Topology t; t.build(); return t; }();
+				return topology;
+			}
+
+			bool valid() const { return valid_; }
+			size_t cpuCount() const { return cpus_.size(); }
+			size_t nodeCount() const { return nodeCpus_.size(); }
+			const nodecpp::stdvector<int>& cpusOfNode( size_t nodeIdx ) const { return nodeCpus_[nodeIdx]; }
+			int nodeId( size_t nodeIdx ) const { return nodeIds_[nodeIdx]; }
+			const nodecpp::stdvector<CpuInfo>& cpus() const { return cpus_; }
+
+			void log() const
+			{
+				if ( !valid_ )
+				{
+					nodecpp::log::default_log::info( nodecpp::log::ModuleID(nodecpp::nodecpp_module_id),"CPU topology is not available; threads are not pinned" );
+					return;
+				}
+				size_t cores = 0;
+				for ( auto& c : cpus_ )
+					if ( c.siblingRank == 0 )
+						++cores;
+				nodecpp::log::default_log::info( nodecpp::log::ModuleID(nodecpp::nodecpp_module_id),"CPU topology: {} logical CPUs, {} physical cores, {} NUMA node(s)", cpus_.size(), cores, nodeCpus_.size() );
+				for ( size_t i=0; i<nodeCpus_.size(); ++i )
+				{
+					nodecpp::string cpuList;
+					for ( auto cpu : nodeCpus_[i] )
+						cpuList += nodecpp::format( "{} ", cpu );
+					nodecpp::log::default_log::info( nodecpp::log::ModuleID(nodecpp::nodecpp_module_id),"    node {}: {}", nodeIds_[i], cpuList );
+				}
+			}
+		};
+
+		namespace impl {
+			inline ThreadPlacementOptions options;
+			inline std::atomic<size_t> placedCount[2] = {0, 0}; // per Role; numbers threads in the log only
+			inline std::mutex placementMx;
+			inline nodecpp::stdvector<size_t> threadsOnNode[2]; // per Role, per node index of Topology; threads that are currently running
+			inline nodecpp::stdvector<size_t> workersOnCpu; // per CPU; pinned workers that are currently running
+			inline thread_local int thisCpu = -1;
+			inline thread_local int thisNode = -1; // NUMA node id
+
+			// what placeThisThread() has taken; given back when the thread exits, so that a respawned thread takes the place of the one that is gone
+			struct Placed
+			{
+				size_t role = 0;
+				size_t nodeIdx = (size_t)(-1);
+				int cpu = -1;
+				~Placed()
+				{
+					if ( nodeIdx == (size_t)(-1) )
+						return;
+					std::unique_lock<std::mutex> lock( placementMx );
+					--(threadsOnNode[role][nodeIdx]);
+					if ( cpu >= 0 )
+						--(workersOnCpu[cpu]);
+				}
+			};
+			inline thread_local Placed placed;
+		} // namespace impl
+
+		// must be called at the master thread before any thread to be placed is started
+		inline void setOptions( const ThreadPlacementOptions& opts )
+		{
+			impl::options = opts;
+			if ( opts.policy != ThreadPlacementOptions::Policy::None )
+				Topology::get().log();
+		}
+		inline const ThreadPlacementOptions& getOptions() { return impl::options; }
+
+		inline int thisThreadCpu() { return impl::thisCpu; } // -1 if not pinned to a single CPU
+		inline int thisThreadNumaNode() { return impl::thisNode; } // -1 if not placed
+
+		// to be called at the very beginning of a newly started thread, before its allocator is initialized
+		inline void placeThisThread( Role role )
+		{
+			if ( impl::options.policy == ThreadPlacementOptions::Policy::None )
+				return;
+			const Topology& topology = Topology::get();
+			if ( !topology.valid() )
+				return;
+#ifdef __linux__
+			// threads of either role go to the NUMA node with the fewest running threads of that role, so that listeners and workers are spread evenly;
+			// a pinned worker takes the least used CPU of the node (a free one, if any; distinct physical cores first)
+			size_t idx = impl::placedCount[(size_t)role].fetch_add( 1, std::memory_order_relaxed );
+			std::unique_lock<std::mutex> lock( impl::placementMx );
+			auto& onNode = impl::threadsOnNode[(size_t)role];
+			if ( onNode.empty() )
+				onNode.resize( topology.nodeCount(), 0 );
+			size_t nodeIdx = 0;
+			for ( size_t i=1; i<onNode.size(); ++i )
+				if ( onNode[i] < onNode[nodeIdx] )
+					nodeIdx = i;
+			const auto& nodeCpus = topology.cpusOfNode( nodeIdx );
+			cpu_set_t set;
+			CPU_ZERO( &set );
+			int cpu = -1;
+			if ( role == Role::Worker && impl::options.policy == ThreadPlacementOptions::Policy::PinToCore )
+			{
+				if ( impl::workersOnCpu.empty() )
+					impl::workersOnCpu.resize( CPU_SETSIZE, 0 );
+				cpu = nodeCpus[0];
+				for ( auto c : nodeCpus )
+					if ( impl::workersOnCpu[c] < impl::workersOnCpu[cpu] )
+						cpu = c;
+				CPU_SET( cpu, &set );
+			}
+			else
+				for ( auto c : nodeCpus )
+					CPU_SET( c, &set );
+			if ( sched_setaffinity( 0, sizeof(set), &set ) != 0 )
+			{
+				nodecpp::log::default_log::info( nodecpp::log::ModuleID(nodecpp::nodecpp_module_id),"sched_setaffinity() failed; error {}", errno );
+				return;
+			}
+			++(onNode[nodeIdx]);
+			if ( cpu >= 0 )
+				++(impl::workersOnCpu[cpu]);
+			lock.unlock();
+			impl::placed.role = (size_t)role;
+			impl::placed.nodeIdx = nodeIdx;
+			impl::placed.cpu = cpu;
+			impl::thisCpu = cpu;
+			impl::thisNode = topology.nodeId( nodeIdx );
+			if ( impl::options.localMemory )
+				syscall( SYS_set_mempolicy, MPOL_LOCAL, nullptr, 0 ); // best effort; first-touch on a pinned thread is local anyway
+			if ( cpu >= 0 )
+				nodecpp::log::default_log::info( nodecpp::log::ModuleID(nodecpp::nodecpp_module_id),"{} thread #{} pinned to CPU {} (NUMA node {})", role == Role::Worker ? "Worker" : "Listener", idx, cpu, impl::thisNode );
+			else
+				nodecpp::log::default_log::info( nodecpp::log::ModuleID(nodecpp::nodecpp_module_id),"{} thread #{} bound to NUMA node {}", role == Role::Worker ? "Worker" : "Listener", idx, impl::thisNode );
+#endif
+		}
+
+	} // namespace placement
+
+} // namespace nodecpp
+
+#endif // NODECPP_THREAD_PLACEMENT_H
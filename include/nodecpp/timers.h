@@ -63,6 +63,7 @@ namespace nodecpp
 	namespace time
 	{
 		size_t now();
+		std::pair<long, long> get_thread_time(); // user and kernel time of the calling thread, mks
 	} // namespace time
 
 	void setInmediate(std::function<void()> cb);
@@ -70,9 +71,9 @@ namespace nodecpp
 
 uint64_t infraGetCurrentTime();
 
-#ifdef USE_TEMP_PERF_CTRS
-void reportTimes( uint64_t currentT);
-#endif
+void reportLoopMetricsIfDue( uint64_t currentT ); // see nodecpp::metrics::Options::logPeriodMs
+int capPollTimeoutForReporting( int timeoutMs ); // so that loops blocked in poll() keep publishing; see nodecpp::metrics::Options::shmPeriodMs
+void watchLoopForStalls(); // to be called once by each loop thread; see nodecpp::metrics::Options::stallThresholdMs
 
 
 #endif //TIMERS_H
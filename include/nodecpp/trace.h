@@ -0,0 +1,151 @@
+/* -------------------------------------------------------------------------------
+* Copyright (c) 2021, OLogN Technologies AG
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*     * Neither the name of the OLogN Technologies AG nor the
+*       names of its contributors may be used to endorse or promote products
+*       derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL OLogN Technologies AG BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+* -------------------------------------------------------------------------------*/
+
+#ifndef NODECPP_TRACE_H
+#define NODECPP_TRACE_H
+
+#include "metrics.h"
+#include <atomic>
+#include <chrono>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// Timeline tracing: each loop thread writes spans (a static name and TSC timestamps of its beginning and end) to its own ring buffer;
+// buffers are written to a trace file in Chrome JSON format (also loaded by Perfetto) on request (see Options::flushSignal) and at exit.
+// When tracing is compiled in but not enabled, a span costs one well-predicted branch; NODECPP_NO_TRACING compiles it out entirely
+
+namespace nodecpp {
+
+	namespace trace {
+
+		inline uint64_t timestamp() {
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+			return __rdtsc();
+#else
+			return std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+#endif
+		}
+
+		struct Record
+		{
+			uint64_t begin;
+			uint64_t end;
+			const char* name; // a string literal; its address serves as an ID
+		};
+
+		class Buffer
+		{
+		public:
+			static constexpr size_t maxBuffers = nodecpp::metrics::Registry::maxThreads;
+
+			Record* records = nullptr;
+			size_t mask = 0;
+			std::atomic<uint64_t> head = 0; // written by the owning thread only
+			uint64_t flushed = 0; // modified by a flush only
+			const nodecpp::metrics::ThreadMetrics* tm = nullptr; // role and instance id of the owner, as of the time of flush
+			size_t id = 0;
+
+			void add( const char* name, uint64_t begin, uint64_t end ) {
+				uint64_t h = head.load( std::memory_order_relaxed );
+				records[ h & mask ] = Record{ begin, end, name };
+				head.store( h + 1, std::memory_order_release );
+			}
+		};
+
+		struct Options
+		{
+			bool enabled = false;
+			uint32_t bufferSizeExp = 16; // records per thread, as a power of two; older ones are overwritten
+			const char* path = nullptr; // of the trace file; if nullptr, "nodecpp-trace.<pid>.json" in the current directory
+			int flushSignal = 0; // makes each loop append what it has collected so far to the trace file; 0 means SIGRTMIN + 8, -1 disables flushing on signal
+		};
+
+		namespace impl {
+			inline Options options;
+			inline bool enabled = false; // the only thing checked by a disabled span
+			inline std::atomic<Buffer*> buffers[Buffer::maxBuffers];
+			inline std::atomic<size_t> bufferCnt = 0;
+			inline thread_local Buffer* thisThreadBuffer = nullptr;
+
+			inline Buffer* makeThisThreadBuffer() {
+				size_t idx = bufferCnt.load( std::memory_order_relaxed );
+				do {
+					if ( idx >= Buffer::maxBuffers )
+						return nullptr; // not traced
+				} while ( !bufferCnt.compare_exchange_weak( idx, idx + 1, std::memory_order_relaxed ) );
+				Buffer* b = nodecpp::stdalloc<Buffer>( 1 );
+				b->records = nodecpp::stdalloc<Record>( (size_t)1 << options.bufferSizeExp );
+				b->mask = ( (size_t)1 << options.bufferSizeExp ) - 1;
+				b->tm = &( nodecpp::metrics::thisThread() );
+				b->id = idx;
+				buffers[idx].store( b, std::memory_order_release );
+				thisThreadBuffer = b;
+				return b;
+			}
+
+			inline void add( const char* name, uint64_t begin, uint64_t end ) {
+				Buffer* b = thisThreadBuffer;
+				if ( b == nullptr && ( b = makeThisThreadBuffer() ) == nullptr )
+					return;
+				b->add( name, begin, end );
+			}
+		} // namespace impl
+
+		inline void setOptions( const Options& opts ) { impl::options = opts; impl::enabled = opts.enabled; } // to be called before threads are started
+		inline const Options& getOptions() { return impl::options; }
+
+		class Span
+		{
+#ifndef NODECPP_NO_TRACING
+			const char* name;
+			uint64_t begin;
+#endif
+		public:
+#ifndef NODECPP_NO_TRACING
+			explicit Span( const char* name_ ) : name( impl::enabled ? name_ : nullptr ) {
+				if ( name != nullptr )
+					begin = timestamp();
+			}
+			~Span() {
+				if ( name != nullptr )
+					impl::add( name, begin, timestamp() );
+			}
+#else
+			explicit Span( const char* ) {}
+#endif
+			Span( const Span& ) = delete;
+			Span& operator = ( const Span& ) = delete;
+		};
+
+	} // namespace trace
+
+} // namespace nodecpp
+
+#endif // NODECPP_TRACE_H
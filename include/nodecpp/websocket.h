@@ -0,0 +1,834 @@
+/* -------------------------------------------------------------------------------
+* Copyright (c) 2021, OLogN Technologies AG
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*     * Neither the name of the OLogN Technologies AG nor the
+*       names of its contributors may be used to endorse or promote products
+*       derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL OLogN Technologies AG BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+* -------------------------------------------------------------------------------*/
+
+#ifndef NODECPP_WEBSOCKET_H
+#define NODECPP_WEBSOCKET_H
+
+#include "http_socket_at_server.h"
+#include "timers.h"
+
+#include <random>
+
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <immintrin.h>
+#define NODECPP_WS_MASK_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define NODECPP_WS_MASK_NEON
+#endif
+
+// RFC 6455 support on top of HTTP layer (server side) and SocketBase (client side)
+
+namespace nodecpp {
+
+	namespace net {
+
+		namespace ws_impl {
+
+			// payload (un)masking; phase is the offset of data[0] within the frame payload (masking is periodic with period 4)
+			inline
+			void applyMask( uint8_t* data, size_t sz, const uint8_t mask[4], size_t phase )
+			{
+				uint8_t m[4] = { mask[phase & 3], mask[(phase + 1) & 3], mask[(phase + 2) & 3], mask[(phase + 3) & 3] };
+				uint32_t m32;
+				memcpy( &m32, m, 4 );
+				size_t i = 0;
+#if defined(__AVX2__)
+				__m256i m256 = _mm256_set1_epi32( (int)m32 );
+				for ( ; i + 32 <= sz; i += 32 )
+				{
+					__m256i v = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( data + i ) );
+					_mm256_storeu_si256( reinterpret_cast<__m256i*>( data + i ), _mm256_xor_si256( v, m256 ) );
+				}
+#endif
+#if defined(NODECPP_WS_MASK_SSE2)
+				__m128i m128 = _mm_set1_epi32( (int)m32 );
+				for ( ; i + 16 <= sz; i += 16 )
+				{
+					__m128i v = _mm_loadu_si128( reinterpret_cast<const __m128i*>( data + i ) );
+					_mm_storeu_si128( reinterpret_cast<__m128i*>( data + i ), _mm_xor_si128( v, m128 ) );
+				}
+#elif defined(NODECPP_WS_MASK_NEON)
+				uint8x16_t m128 = vreinterpretq_u8_u32( vdupq_n_u32( m32 ) );
+				for ( ; i + 16 <= sz; i += 16 )
+					vst1q_u8( data + i, veorq_u8( vld1q_u8( data + i ), m128 ) );
+#endif
+				uint64_t m64 = ( (uint64_t)m32 << 32 ) | m32;
+				for ( ; i + 8 <= sz; i += 8 )
+				{
+					uint64_t v;
+					memcpy( &v, data + i, 8 );
+					v ^= m64;
+					memcpy( data + i, &v, 8 );
+				}
+				for ( ; i < sz; ++i )
+					data[i] ^= m[i & 3];
+			}
+
+			inline
+			void sha1( const uint8_t* data, size_t sz, uint8_t digest[20] )
+			{
+				uint32_t h[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+				auto rol = []( uint32_t x, int n ) { return ( x << n ) | ( x >> ( 32 - n ) ); };
+				auto processBlock = [&]( const uint8_t* block ) {
+					uint32_t w[80];
+					for ( size_t i=0; i<16; ++i )
+						w[i] = ( (uint32_t)block[4*i] << 24 ) | ( (uint32_t)block[4*i+1] << 16 ) | ( (uint32_t)block[4*i+2] << 8 ) | block[4*i+3];
+					for ( size_t i=16; i<80; ++i )
+						w[i] = rol( w[i-3] ^ w[i-8] ^ w[i-14] ^ w[i-16], 1 );
+					uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+					for ( size_t i=0; i<80; ++i )
+					{
+						uint32_t f, k;
+						if ( i < 20 ) { f = ( b & c ) | ( ~b & d ); k = 0x5A827999; }
+						else if ( i < 40 ) { f = b ^ c ^ d; k = 0x6ED9EBA1; }
+						else if ( i < 60 ) { f = ( b & c ) | ( b & d ) | ( c & d ); k = 0x8F1BBCDC; }
+						else { f = b ^ c ^ d; k = 0xCA62C1D6; }
+						uint32_t tmp = rol( a, 5 ) + f + e + k + w[i];
+						e = d; d = c; c = rol( b, 30 ); b = a; a = tmp;
+					}
+					h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e;
+				};
+				size_t full = sz / 64;
+				for ( size_t i=0; i<full; ++i )
+					processBlock( data + i * 64 );
+				uint8_t tail[128] = {};
+				size_t rem = sz - full * 64;
+				memcpy( tail, data + full * 64, rem );
+				tail[rem] = 0x80;
+				size_t tailSz = rem + 1 + 8 <= 64 ? 64 : 128;
+				uint64_t bits = (uint64_t)sz * 8;
+				for ( size_t i=0; i<8; ++i )
+					tail[tailSz - 1 - i] = (uint8_t)( bits >> ( 8 * i ) );
+				processBlock( tail );
+				if ( tailSz == 128 )
+					processBlock( tail + 64 );
+				for ( size_t i=0; i<5; ++i )
+				{
+					digest[4*i] = (uint8_t)( h[i] >> 24 );
+					digest[4*i+1] = (uint8_t)( h[i] >> 16 );
+					digest[4*i+2] = (uint8_t)( h[i] >> 8 );
+					digest[4*i+3] = (uint8_t)( h[i] );
+				}
+			}
+
+			inline
+			nodecpp::string base64Encode( const uint8_t* data, size_t sz )
+			{
+				static constexpr char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+				nodecpp::string ret;
+				size_t i = 0;
+				for ( ; i + 3 <= sz; i += 3 )
+				{
+					uint32_t v = ( (uint32_t)data[i] << 16 ) | ( (uint32_t)data[i+1] << 8 ) | data[i+2];
+					ret += alphabet[( v >> 18 ) & 0x3F];
+					ret += alphabet[( v >> 12 ) & 0x3F];
+					ret += alphabet[( v >> 6 ) & 0x3F];
+					ret += alphabet[v & 0x3F];
+				}
+				if ( i < sz )
+				{
+					uint32_t v = (uint32_t)data[i] << 16;
+					if ( i + 1 < sz )
+						v |= (uint32_t)data[i+1] << 8;
+					ret += alphabet[( v >> 18 ) & 0x3F];
+					ret += alphabet[( v >> 12 ) & 0x3F];
+					ret += i + 1 < sz ? alphabet[( v >> 6 ) & 0x3F] : '=';
+					ret += '=';
+				}
+				return ret;
+			}
+
+			inline
+			nodecpp::string computeAcceptKey( const nodecpp::string& key )
+			{
+				static constexpr char guid[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+				nodecpp::string s = key;
+				s.append( guid );
+				uint8_t digest[20];
+				sha1( reinterpret_cast<const uint8_t*>( s.c_str() ), s.size(), digest );
+				return base64Encode( digest, 20 );
+			}
+
+			inline
+			std::mt19937& randomGenerator()
+			{
+				thread_local std::mt19937 gen( std::random_device{}() );
+				return gen;
+			}
+
+			inline
+			bool containsTokenCaseInsensitive( nodecpp::string val, const char* token )
+			{
+				std::transform(val.begin(), val.end(), val.begin(), [](unsigned char c){ return std::tolower(c); });
+				return val.find( token ) != nodecpp::string::npos;
+			}
+
+		} // namespace ws_impl
+
+		struct WebSocketFrameHeader
+		{
+			static constexpr size_t maxSize = 14;
+
+			bool fin = false;
+			uint8_t rsv = 0; // RSV1-3
+			uint8_t opcode = 0;
+			bool masked = false;
+			uint8_t mask[4] = {};
+			uint64_t payloadLength = 0;
+			size_t size = 0;
+
+			// returns false if more bytes are required; size is then set to the minimal number of bytes to wait for
+			bool parse( const uint8_t* data, size_t avail )
+			{
+				if ( avail < 2 )
+				{
+					size = 2;
+					return false;
+				}
+				fin = ( data[0] & 0x80 ) != 0;
+				rsv = ( data[0] >> 4 ) & 0x07;
+				opcode = data[0] & 0x0F;
+				masked = ( data[1] & 0x80 ) != 0;
+				uint8_t len7 = data[1] & 0x7F;
+				size_t extSz = len7 == 126 ? 2 : ( len7 == 127 ? 8 : 0 );
+				size = 2 + extSz + ( masked ? 4 : 0 );
+				if ( avail < size )
+					return false;
+				if ( extSz == 0 )
+					payloadLength = len7;
+				else
+				{
+					payloadLength = 0;
+					for ( size_t i=0; i<extSz; ++i )
+						payloadLength = ( payloadLength << 8 ) | data[2 + i];
+				}
+				if ( masked )
+					memcpy( mask, data + 2 + extSz, 4 );
+				return true;
+			}
+
+			static void serialize( Buffer& b, bool fin, uint8_t opcode, uint64_t payloadLength, const uint8_t* mask )
+			{
+				uint8_t hdr[maxSize];
+				size_t sz = 2;
+				hdr[0] = ( fin ? 0x80 : 0 ) | ( opcode & 0x0F );
+				uint8_t maskBit = mask != nullptr ? 0x80 : 0;
+				if ( payloadLength < 126 )
+					hdr[1] = maskBit | (uint8_t)payloadLength;
+				else if ( payloadLength <= 0xFFFF )
+				{
+					hdr[1] = maskBit | 126;
+					hdr[2] = (uint8_t)( payloadLength >> 8 );
+					hdr[3] = (uint8_t)( payloadLength );
+					sz = 4;
+				}
+				else
+				{
+					hdr[1] = maskBit | 127;
+					for ( size_t i=0; i<8; ++i )
+						hdr[2 + i] = (uint8_t)( payloadLength >> ( 8 * ( 7 - i ) ) );
+					sz = 10;
+				}
+				if ( mask != nullptr )
+				{
+					memcpy( hdr + sz, mask, 4 );
+					sz += 4;
+				}
+				b.append( hdr, sz );
+			}
+		};
+
+		class WebSocketKeepAlive; // forward declaration
+
+		class WebSocket
+		{
+			friend class WebSocketKeepAlive;
+
+		public:
+			enum Opcode : uint8_t { continuation = 0x0, text = 0x1, binary = 0x2, close = 0x8, ping = 0x9, pong = 0xA };
+			enum CloseCode : uint16_t { normal = 1000, goingAway = 1001, protocolError = 1002, unsupportedData = 1003, policyViolation = 1008, messageTooBig = 1009, internalError = 1011 };
+
+			static constexpr size_t defaultMaxMessageSize = 0x1000000;
+			static constexpr size_t defaultFragmentSize = 0x10000; // outgoing messages larger than this are fragmented
+			static constexpr size_t readAheadWindow = 0x10000; // while no a_readMessage() is pending, incoming bytes are kept at the read buffer up to this size
+
+		public:
+			nodecpp::soft_this_ptr<WebSocket> myThis;
+
+		private:
+			nodecpp::soft_ptr<SocketBase> sock;
+			bool isClient = false;
+			bool closeSent = false;
+			bool closeReceived = false;
+			uint16_t peerCloseCode = 0;
+
+			size_t maxMessageSize = defaultMaxMessageSize;
+			size_t fragmentSize = defaultFragmentSize;
+
+			// keepalive-related (see WebSocketKeepAlive)
+			nodecpp::soft_ptr<WebSocketKeepAlive> keepAlive;
+			size_t keepAliveSlot = (size_t)(-1);
+			uint64_t lastActivity = 0; // in microseconds, see infraGetCurrentTime()
+			uint64_t pingSentAt = 0;
+			uint64_t lastRoundTrip = 0;
+			uint64_t bytesInAtPing = 0; // see SocketStats::bytesIn
+			bool pongOutstanding = false;
+			bool reading = false; // a_readMessage() is in progress
+
+			Buffer controlPayload;
+			Buffer frameBuff;
+
+			void sendFrame( bool fin, uint8_t opcode, const uint8_t* payload, size_t sz )
+			{
+				frameBuff.clear();
+				if ( isClient )
+				{
+					uint8_t mask[4];
+					uint32_t rnd = ws_impl::randomGenerator()();
+					memcpy( mask, &rnd, 4 );
+					WebSocketFrameHeader::serialize( frameBuff, fin, opcode, sz, mask );
+					size_t start = frameBuff.size();
+					frameBuff.append( payload, sz );
+					ws_impl::applyMask( frameBuff.begin() + start, sz, mask, 0 );
+				}
+				else
+				{
+					WebSocketFrameHeader::serialize( frameBuff, fin, opcode, sz, nullptr );
+					frameBuff.append( payload, sz );
+				}
+				sock->write( frameBuff );
+			}
+
+			void sendClose( uint16_t code )
+			{
+				if ( closeSent )
+					return;
+				closeSent = true;
+				uint8_t payload[2] = { (uint8_t)( code >> 8 ), (uint8_t)code };
+				sendFrame( true, Opcode::close, payload, 2 );
+			}
+
+			void failConnection( uint16_t code )
+			{
+				sendClose( code );
+				stopReadAhead();
+				sock->end();
+			}
+
+			// after the handshake, bytes arriving between a_readMessage() calls must go to the read buffer rather than to 'data' handlers
+			void startReadAhead()
+			{
+				sock->dataForCommandProcessing.readBuffer.reserve( readAheadWindow );
+				sock->setReadHighWaterMark( readAheadWindow );
+			}
+			void stopReadAhead()
+			{
+				if ( sock == nullptr || sock->destroyed() )
+					return;
+				sock->setReadHighWaterMark( 0 );
+				if ( sock->isPaused() )
+					sock->resume();
+			}
+			void resumeReadAhead() // to be called before awaiting more data: reading may have been paused at the window
+			{
+				if ( sock->isPaused() )
+					sock->resume();
+			}
+
+			void onPong()
+			{
+				if ( pongOutstanding )
+				{
+					lastRoundTrip = infraGetCurrentTime() - pingSentAt;
+					pongOutstanding = false;
+				}
+			}
+
+			// payload of a control frame (which is fully in the read buffer) follows; returns false if the connection is closed
+			bool processControlFrame( const WebSocketFrameHeader& hdr )
+			{
+				auto& readBuffer = sock->dataForCommandProcessing.readBuffer;
+				size_t plen = (size_t)(hdr.payloadLength);
+				controlPayload.clear();
+				readBuffer.append_ready_data( controlPayload, plen );
+				if ( hdr.masked )
+					ws_impl::applyMask( controlPayload.begin(), plen, hdr.mask, 0 );
+				switch ( hdr.opcode )
+				{
+					case Opcode::ping:
+						if ( !closeSent )
+							sendFrame( true, Opcode::pong, controlPayload.begin(), plen );
+						return true;
+					case Opcode::pong:
+						onPong();
+						return true;
+					case Opcode::close:
+						closeReceived = true;
+						peerCloseCode = plen >= 2 ? ( ( (uint16_t)controlPayload.begin()[0] << 8 ) | controlPayload.begin()[1] ) : CloseCode::normal;
+						sendClose( peerCloseCode );
+						stopReadAhead();
+						sock->end();
+						detachFromKeepAlive();
+						return false;
+					default:
+						failConnection( CloseCode::protocolError );
+						return false;
+				}
+			}
+
+			// while no a_readMessage() is in progress, control frames at the front of the read buffer are processed here (by keepalive);
+			// anything else is left for the next a_readMessage()
+			void processControlFramesAhead()
+			{
+				if ( reading || closeReceived || sock == nullptr )
+					return;
+				auto& readBuffer = sock->dataForCommandProcessing.readBuffer;
+				for (;;)
+				{
+					uint8_t hdrBytes[WebSocketFrameHeader::maxSize];
+					WebSocketFrameHeader hdr;
+					if ( !hdr.parse( hdrBytes, readBuffer.peek( hdrBytes, WebSocketFrameHeader::maxSize ) ) )
+						return;
+					if ( ( hdr.opcode & 0x8 ) == 0 || !hdr.fin || hdr.rsv != 0 || hdr.payloadLength > 125 || hdr.masked == isClient )
+						return;
+					if ( readBuffer.used_size() < hdr.size + hdr.payloadLength )
+						return;
+					readBuffer.skip( hdr.size );
+					if ( !processControlFrame( hdr ) )
+						return;
+				}
+			}
+
+			void detachFromKeepAlive();
+
+		public:
+			WebSocket() : controlPayload( 128 ), frameBuff( 0x1000 ) {}
+			WebSocket(const WebSocket&) = delete;
+			WebSocket& operator = (const WebSocket&) = delete;
+			~WebSocket() { detachFromKeepAlive(); }
+
+			void setMaxMessageSize( size_t sz ) { maxMessageSize = sz; }
+			void setFragmentSize( size_t sz ) { NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, sz != 0 ); fragmentSize = sz; }
+			nodecpp::soft_ptr<SocketBase> socket() { return sock; }
+			bool isOpen() const { return sock != nullptr && !closeSent && !closeReceived; }
+			uint16_t closeCode() const { return peerCloseCode; }
+			uint64_t roundTripTime() const { return lastRoundTrip; } // as measured by the last ping/pong; in microseconds
+
+#ifndef NODECPP_NO_COROUTINES
+			// Server side: completes the handshake for a request carrying 'Upgrade: websocket'. On success the underlying socket is detached from HTTP processing.
+			// NOTE: must be called before the request handler is suspended for the first time
+			::nodecpp::awaitable<bool> a_acceptUpgrade( nodecpp::soft_ptr<IncomingHttpMessageAtServer> request )
+			{
+				nodecpp::soft_ptr<HttpSocketBase> httpSock = request->sock;
+				nodecpp::string key = request->getHeader( "sec-websocket-key" );
+				if ( !ws_impl::containsTokenCaseInsensitive( request->getHeader( "upgrade" ), "websocket" ) ||
+					!ws_impl::containsTokenCaseInsensitive( request->getHeader( "connection" ), "upgrade" ) ||
+					request->getHeader( "sec-websocket-version" ) != "13" || key.size() == 0 )
+				{
+					Buffer b;
+					b.appendString( nodecpp::string( "HTTP/1.1 400 Bad Request\r\nSec-WebSocket-Version: 13\r\nContent-Length: 0\r\nConnection: close\r\n\r\n" ) );
+					httpSock->markUpgraded();
+					httpSock->write( b );
+					httpSock->end();
+					CO_RETURN false;
+				}
+				httpSock->markUpgraded();
+				sock = httpSock;
+				isClient = false;
+				Buffer b;
+				b.appendString( nodecpp::format( "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\nSec-WebSocket-Accept: {}\r\n\r\n", ws_impl::computeAcceptKey( key ) ) );
+				startReadAhead(); // before a_write(): the client may send its first frames right after reading the response
+				co_await sock->a_write( b );
+				lastActivity = infraGetCurrentTime();
+				CO_RETURN true;
+			}
+
+			// Client side: connects (if not yet connected) and performs the handshake
+			// NOTE: the socket is expected to be either not yet used or already connected
+			::nodecpp::awaitable<bool> a_connect( nodecpp::soft_ptr<SocketBase> sock_, const char* host, uint16_t port, const char* path = "/" )
+			{
+				sock = sock_;
+				isClient = true;
+				switch ( sock->dataForCommandProcessing.state )
+				{
+					case SocketBase::DataForCommandProcessing::State::Uninitialized:
+						co_await sock->a_connect( port, host );
+						break;
+					case SocketBase::DataForCommandProcessing::State::Connected:
+						break;
+					default: // connecting on behalf of someone else, or already ending or closed
+						CO_RETURN false;
+				}
+				uint8_t nonce[16];
+				for ( size_t i=0; i<16; i += 4 )
+				{
+					uint32_t rnd = ws_impl::randomGenerator()();
+					memcpy( nonce + i, &rnd, 4 );
+				}
+				nodecpp::string key = ws_impl::base64Encode( nonce, 16 );
+				Buffer b;
+				b.appendString( nodecpp::format( "GET {} HTTP/1.1\r\nHost: {}:{}\r\nUpgrade: websocket\r\nConnection: Upgrade\r\nSec-WebSocket-Key: {}\r\nSec-WebSocket-Version: 13\r\n\r\n", path, host, port, key ) );
+				co_await sock->a_write( b );
+
+				nodecpp::string expectedAccept = ws_impl::computeAcceptKey( key );
+				Buffer lineBuff( 0x1000 );
+				bool statusOk = false;
+				bool acceptOk = false;
+				for ( size_t lineNo = 0;; ++lineNo )
+				{
+					lineBuff.clear();
+					CoroStandardOutcomes ret = co_await sock->a_readUntil( lineBuff, '\n' );
+					if ( ret != CoroStandardOutcomes::ok )
+						CO_RETURN false;
+					nodecpp::string line;
+#ifdef NODECPP_USE_SAFE_MEMORY_CONTAINERS					
+					line.assign_unsafe( (const char*)(lineBuff.begin()), lineBuff.size() );
+#else
+					line.assign( (const char*)(lineBuff.begin()), lineBuff.size() );
+#endif // NODECPP_USE_SAFE_MEMORY_CONTAINERS					
+					if ( line == "\r\n" || line == "\n" )
+						break;
+					if ( lineNo == 0 )
+						statusOk = line.size() > 12 && memcmp( line.c_str(), "HTTP/1.1 101", 12 ) == 0;
+					else
+					{
+						size_t colon = line.find( ':' );
+						if ( colon == nodecpp::string::npos )
+							continue;
+						nodecpp::string name = line.substr( 0, colon );
+						if ( ws_impl::containsTokenCaseInsensitive( name, "sec-websocket-accept" ) )
+						{
+							size_t valStart = line.find_first_not_of( " \t", colon + 1 );
+							size_t valEnd = line.find_last_not_of( " \t\r\n" );
+							acceptOk = valStart != nodecpp::string::npos && line.substr( valStart, valEnd - valStart + 1 ) == expectedAccept;
+						}
+					}
+				}
+				if ( !statusOk || !acceptOk )
+				{
+					sock->end();
+					CO_RETURN false;
+				}
+				startReadAhead();
+				lastActivity = infraGetCurrentTime();
+				CO_RETURN true;
+			}
+
+			// Reads the next complete (reassembled) data message; control frames are processed on the way.
+			// Payload is moved from socket's read buffer directly to msg and unmasked in place.
+			// Returns false when the connection has been closed (by either side).
+			::nodecpp::awaitable<bool> a_readMessage( Buffer& msg, Opcode& type )
+			{
+				msg.clear();
+				struct ReadingFlag
+				{
+					bool& flag;
+					ReadingFlag( bool& flag_ ) : flag( flag_ ) { flag = true; }
+					~ReadingFlag() { flag = false; }
+				} readingFlag( reading );
+				bool inFragmentedMessage = false;
+				for (;;)
+				{
+					if ( closeReceived )
+						CO_RETURN false;
+					auto& readBuffer = sock->dataForCommandProcessing.readBuffer;
+					uint8_t hdrBytes[WebSocketFrameHeader::maxSize];
+					WebSocketFrameHeader hdr;
+					while ( !hdr.parse( hdrBytes, readBuffer.peek( hdrBytes, WebSocketFrameHeader::maxSize ) ) )
+					{
+						resumeReadAhead();
+						co_await sock->a_bytesAvailable( hdr.size );
+					}
+					readBuffer.skip( hdr.size );
+					lastActivity = infraGetCurrentTime();
+
+					if ( hdr.masked == isClient ) // clients must mask, servers must not
+					{
+						failConnection( CloseCode::protocolError );
+						CO_RETURN false;
+					}
+
+					// no extensions are negotiated, so RSV1-3 must be 0; so must be the most significant bit of a 64-bit length (RFC 6455, 5.2)
+					if ( hdr.rsv != 0 || ( hdr.payloadLength >> 63 ) != 0 )
+					{
+						failConnection( CloseCode::protocolError );
+						CO_RETURN false;
+					}
+
+					if ( hdr.opcode & 0x8 ) // control frame
+					{
+						if ( !hdr.fin || hdr.payloadLength > 125 )
+						{
+							failConnection( CloseCode::protocolError );
+							CO_RETURN false;
+						}
+						if ( hdr.payloadLength )
+						{
+							resumeReadAhead();
+							co_await sock->a_bytesAvailable( (size_t)(hdr.payloadLength) );
+						}
+						if ( !processControlFrame( hdr ) )
+							CO_RETURN false;
+						continue;
+					}
+
+					// data frame
+					if ( hdr.opcode == Opcode::continuation )
+					{
+						if ( !inFragmentedMessage )
+						{
+							failConnection( CloseCode::protocolError );
+							CO_RETURN false;
+						}
+					}
+					else if ( hdr.opcode == Opcode::text || hdr.opcode == Opcode::binary )
+					{
+						if ( inFragmentedMessage )
+						{
+							failConnection( CloseCode::protocolError );
+							CO_RETURN false;
+						}
+						type = (Opcode)(hdr.opcode);
+						inFragmentedMessage = true;
+					}
+					else
+					{
+						failConnection( CloseCode::protocolError );
+						CO_RETURN false;
+					}
+
+					if ( msg.size() + hdr.payloadLength > maxMessageSize )
+					{
+						failConnection( CloseCode::messageTooBig );
+						CO_RETURN false;
+					}
+					size_t remaining = (size_t)(hdr.payloadLength);
+					size_t phase = 0;
+					msg.reserve( msg.size() + remaining );
+					while ( remaining )
+					{
+						if ( readBuffer.empty() )
+						{
+							resumeReadAhead();
+							co_await sock->a_someDataAvailable();
+						}
+						size_t start = msg.size();
+						size_t moved = readBuffer.append_ready_data( msg, remaining );
+						if ( hdr.masked )
+							ws_impl::applyMask( msg.begin() + start, moved, hdr.mask, phase );
+						phase += moved;
+						remaining -= moved;
+					}
+					if ( hdr.fin )
+						CO_RETURN true;
+				}
+			}
+#endif // NODECPP_NO_COROUTINES
+
+			// Writes a message (fragmented, if larger than fragmentSize); data is queued at socket's write buffer if it cannot be sent immediately
+			void send( const uint8_t* data, size_t sz, Opcode type = Opcode::binary )
+			{
+				NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, type == Opcode::text || type == Opcode::binary, "{}", (size_t)type );
+				if ( closeSent )
+					throw Error();
+				uint8_t opcode = type;
+				do
+				{
+					size_t chunk = sz > fragmentSize ? fragmentSize : sz;
+					sendFrame( chunk == sz, opcode, data, chunk );
+					opcode = Opcode::continuation;
+					data += chunk;
+					sz -= chunk;
+				}
+				while ( sz );
+			}
+			void send( const Buffer& b, Opcode type = Opcode::binary ) { send( b.begin(), b.size(), type ); }
+			void send( const nodecpp::string& s ) { send( reinterpret_cast<const uint8_t*>( s.c_str() ), s.size(), Opcode::text ); }
+
+			void sendPing( const uint8_t* payload = nullptr, size_t sz = 0 )
+			{
+				NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, sz <= 125, "{}", sz );
+				if ( closeSent )
+					return;
+				pingSentAt = infraGetCurrentTime();
+				bytesInAtPing = sock->stats().bytesIn;
+				pongOutstanding = true;
+				sendFrame( true, Opcode::ping, payload, sz );
+			}
+
+			void close( uint16_t code = CloseCode::normal )
+			{
+				sendClose( code );
+				stopReadAhead(); // the peer's close frame, if awaited, is read by a_readMessage()
+				detachFromKeepAlive();
+			}
+
+			// Server side only: a message is serialized once and the same bytes are written to all recipients (server-to-client frames are not masked)
+			static void broadcast( nodecpp::vector<nodecpp::soft_ptr<WebSocket>>& recipients, const uint8_t* data, size_t sz, Opcode type = Opcode::binary )
+			{
+				Buffer frame( WebSocketFrameHeader::maxSize + sz );
+				WebSocketFrameHeader::serialize( frame, true, type, sz, nullptr );
+				frame.append( data, sz );
+				for ( auto& ws : recipients )
+				{
+					if ( ws == nullptr || !ws->isOpen() )
+						continue;
+					NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, !ws->isClient );
+					ws->sock->write( frame );
+				}
+			}
+			static void broadcast( nodecpp::vector<nodecpp::soft_ptr<WebSocket>>& recipients, const Buffer& b, Opcode type = Opcode::binary ) { broadcast( recipients, b.begin(), b.size(), type ); }
+		};
+
+		// Keepalive for many connections driven by a single timer: connections are spread over slotCount slots of a timing wheel,
+		// and at each tick only one slot is visited. A connection idle for a whole wheel turn is pinged; if a pong is still
+		// outstanding at its next visit, the connection is dropped.
+		class WebSocketKeepAlive
+		{
+			friend class WebSocket;
+
+		public:
+			nodecpp::soft_this_ptr<WebSocketKeepAlive> myThis;
+
+		private:
+			static constexpr size_t slotCount = 16;
+			nodecpp::vector<nodecpp::soft_ptr<WebSocket>> slots[slotCount];
+			size_t currentSlot = 0;
+			uint32_t tickMs; // rounded up, so that a wheel turn is never shorter than interval
+			uint64_t interval; // in microseconds
+			uint64_t idleLimit; // interval less a tick, so that timer jitter never postpones a check by a whole turn
+			nodecpp::Timeout timer;
+			bool running = false;
+
+			void remove( WebSocket& ws )
+			{
+				NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, ws.keepAliveSlot < slotCount );
+				auto& slot = slots[ws.keepAliveSlot];
+				for ( size_t i=0; i<slot.size(); ++i )
+					if ( &(*(slot[i])) == &ws )
+					{
+						slot[i] = slot.back();
+						slot.pop_back();
+						break;
+					}
+				ws.keepAliveSlot = (size_t)(-1);
+				ws.keepAlive = nullptr;
+			}
+
+			void tick()
+			{
+				uint64_t now = infraGetCurrentTime();
+				auto& slot = slots[currentSlot];
+				for ( size_t i=0; i<slot.size(); )
+				{
+					auto ws = slot[i];
+					ws->processControlFramesAhead(); // a pong waits in the read buffer until the app reads, if it does not
+					if ( ws->keepAlive == nullptr ) // closed by the peer meanwhile, and removed from the slot
+						continue;
+					if ( ws->pongOutstanding && ws->sock->stats().bytesIn != ws->bytesInAtPing )
+					{
+						// the pong is still behind unread data, but whatever has arrived since the ping proves the peer alive
+						ws->pongOutstanding = false;
+						ws->lastActivity = now;
+					}
+					if ( ws->pongOutstanding && now - ws->pingSentAt >= idleLimit )
+					{
+						// no pong within a wheel turn
+						ws->keepAliveSlot = (size_t)(-1);
+						ws->keepAlive = nullptr;
+						slot[i] = slot.back();
+						slot.pop_back();
+						ws->sock->destroy();
+						continue;
+					}
+					if ( !ws->pongOutstanding && now - ws->lastActivity >= idleLimit )
+						ws->sendPing();
+					++i;
+				}
+				currentSlot = ( currentSlot + 1 ) % slotCount;
+				if ( size() == 0 )
+				{
+					running = false; // nothing to watch; restarted by the next add()
+					return;
+				}
+				timer = nodecpp::setTimeout( [this]() { tick(); }, tickMs );
+			}
+
+		public:
+			WebSocketKeepAlive( uint32_t intervalMs = 30000 ) : tickMs( intervalMs > slotCount ? ( intervalMs + slotCount - 1 ) / slotCount : 1 ), interval( (uint64_t)intervalMs * 1000 )
+			{
+				idleLimit = interval > (uint64_t)tickMs * 1000 ? interval - (uint64_t)tickMs * 1000 : 0;
+			}
+			WebSocketKeepAlive(const WebSocketKeepAlive&) = delete;
+			WebSocketKeepAlive& operator = (const WebSocketKeepAlive&) = delete;
+			~WebSocketKeepAlive()
+			{
+				if ( running )
+					nodecpp::clearTimeout( timer );
+				for ( auto& slot : slots )
+					for ( auto& ws : slot )
+					{
+						ws->keepAliveSlot = (size_t)(-1);
+						ws->keepAlive = nullptr;
+					}
+			}
+
+			void add( nodecpp::soft_ptr<WebSocket> ws )
+			{
+				NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, ws->keepAlive == nullptr );
+				size_t slotIdx = ( currentSlot + slotCount - 1 ) % slotCount; // to be visited in a full turn
+				slots[slotIdx].push_back( ws );
+				ws->keepAliveSlot = slotIdx;
+				ws->keepAlive = myThis.getSoftPtr<WebSocketKeepAlive>(this);
+				if ( !running )
+				{
+					running = true;
+					timer = nodecpp::setTimeout( [this]() { tick(); }, tickMs );
+				}
+			}
+
+			size_t size() const
+			{
+				size_t ret = 0;
+				for ( auto& slot : slots )
+					ret += slot.size();
+				return ret;
+			}
+		};
+
+		inline
+		void WebSocket::detachFromKeepAlive()
+		{
+			if ( keepAlive != nullptr )
+				keepAlive->remove( *this );
+		}
+
+	} //namespace net
+} //namespace nodecpp
+
+#endif // NODECPP_WEBSOCKET_H
@@ -0,0 +1,7 @@
+// HttpClientSample.cpp : sample of user-defined code
+
+
+#include <infrastructure.h>
+#include "HttpClientSample.h"
+
+static NodeRegistrator<Runnable<MySampleTNode>> noname( "MySampleTemplateNode" );
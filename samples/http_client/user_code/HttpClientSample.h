@@ -0,0 +1,106 @@
+// HttpClientSample.h : sample of user-defined code for an http client talking to an http server in the same process
+
+#ifndef HTTP_CLIENT_SAMPLE_H
+#define HTTP_CLIENT_SAMPLE_H
+
+#include <nodecpp/common.h>
+#include <nodecpp/http_server.h>
+#include <nodecpp/http_client.h>
+
+using namespace nodecpp;
+
+class MySampleTNode : public NodeBase
+{
+	using ServerType = net::HttpServer<MySampleTNode>;
+	safememory::owning_ptr<ServerType> srv; 
+	net::HttpClient client;
+
+	static constexpr uint16_t port = 2002;
+	static constexpr size_t pipelinedCnt = 16;
+	size_t pending = 0;
+	size_t failed = 0;
+
+	static net::HttpClient::Options clientOptions()
+	{
+		net::HttpClient::Options options;
+		options.maxConnectionsPerOrigin = 1; // all requests below go over a single connection
+		options.maxPipelineDepth = pipelinedCnt;
+		options.idleTimeoutMs = 500;
+		options.responseTimeoutMs = 5000;
+		return options;
+	}
+
+	// GET /echo?value=x responds with x; GET /chunked?value=x responds with xx in two chunks
+	nodecpp::handler_ret_type serve()
+	{
+		nodecpp::soft_ptr<net::IncomingHttpMessageAtServer> request;
+		nodecpp::soft_ptr<net::HttpServerResponse> response;
+		try { 
+			for(;;) { 
+				co_await srv->a_request(request, response); 
+				Buffer body(0x1000);
+				co_await request->a_readBody( body );
+				auto queryValues = Url::parseUrlQueryString( request->getUrl() );
+				nodecpp::string value = queryValues[nodecpp::string("value")].toStr();
+				if ( request->getUrl().substr( 0, 8 ) == "/chunked" )
+				{
+					response->writeHead( 200, {{"Content-Type", "text/plain"}, {"Transfer-Encoding", "chunked"}} );
+					Buffer b;
+					b.appendString( nodecpp::format( "{:x};ext=1\r\n{}\r\n{:X}\r\n{}\r\n0\r\n\r\n", value.size(), value, value.size(), value ) );
+					co_await response->writeRawBodyPart( b );
+					response->end();
+				}
+				else
+				{
+					response->writeHead( 200, {{"Content-Type", "text/plain"}} );
+					response->end( value );
+				}
+			} 
+		} 
+		catch (...) {
+		}
+		CO_RETURN;
+	}
+
+	nodecpp::handler_ret_type check( nodecpp::string path, nodecpp::string expected )
+	{
+		++pending;
+		net::HttpClientRequest request( "GET", "127.0.0.1", port, path );
+		net::HttpClientResponse response;
+		CoroStandardOutcomes ret = co_await client.a_request( request, response );
+		Buffer& body = response.getBody();
+		bool ok = ret == CoroStandardOutcomes::ok && response.getStatusCode() == 200 && body.size() == expected.size() && memcmp( body.begin(), expected.c_str(), body.size() ) == 0;
+		if ( !ok )
+		{
+			++failed;
+			nodecpp::log::default_log::error( nodecpp::log::ModuleID(nodecpp::nodecpp_module_id), "{}: outcome {}, status {}, {} bytes of body instead of {}", path, (int)ret, response.getStatusCode(), body.size(), expected.size() );
+		}
+		if ( --pending == 0 )
+			checkDone();
+		CO_RETURN;
+	}
+
+	void checkDone()
+	{
+		nodecpp::log::default_log::info( nodecpp::log::ModuleID(nodecpp::nodecpp_module_id), "{}", failed == 0 ? "all responses match their requests" : "FAILED" );
+		srv->close();
+	}
+
+public:
+	MySampleTNode() : client( clientOptions() ) {}
+
+	nodecpp::handler_ret_type main()
+	{
+		srv = net::createHttpServer<ServerType>();
+		co_await srv->a_listen( port, "127.0.0.1", 128 );
+		serve();
+
+		// issued before the connection is established, so that all but the first one wait for it; responses come in the order of requests
+		for ( size_t i=0; i<pipelinedCnt; ++i )
+			check( nodecpp::format( "/echo?value={}", i ), nodecpp::format( "{}", i ) );
+		check( "/chunked?value=abc", "abcabc" );
+		CO_RETURN;
+	}
+};
+
+#endif // HTTP_CLIENT_SAMPLE_H
@@ -53,7 +53,46 @@ void setThisThreadDescriptor(ThreadStartupData& startupData) { thisThreadDescrip
 
 thread_local size_t workerIdxInLoadCollector = (size_t)(-1);
 extern void decrementWorkerLoadCtr( size_t idx );
+extern void incrementWorkerLoadCtr( size_t idx );
 void decrementThisWorkerLoadCtr() { decrementWorkerLoadCtr(workerIdxInLoadCollector); }
+void incrementThisWorkerLoadCtr() { incrementWorkerLoadCtr(workerIdxInLoadCollector); }
+void reportThisWorkerLoadSignals( uint32_t busyPermille, uint32_t queuedEvents, uint64_t bytesPerSec ) { reportWorkerLoadSignals(workerIdxInLoadCollector, busyPermille, queuedEvents, bytesPerSec); }
+void reportThisWorkerShedding( bool shedding ) { reportWorkerShedding(workerIdxInLoadCollector, shedding); }
+ThreadID selectMigrationTargetForThisWorker() { return selectMigrationTarget(workerIdxInLoadCollector); }
+
+void releaseThisWorkerThreadIfRetired()
+{
+	if ( !nodecpp::getCluster().isRetiring() )
+		return;
+	// the worker's loop has ended; the master and listener threads have already stopped addressing it
+	releaseWorkerEntryForLoadTracking( workerIdxInLoadCollector );
+	while ( hasInterThreadOverflow() ) // e.g. connections migrated at retirement; the overflow is thread-local and would be lost
+	{
+		flushInterThreadOverflow();
+		if ( hasInterThreadOverflow() )
+			std::this_thread::sleep_for( std::chrono::microseconds( interThreadOverflowRetryMks ) );
+	}
+	nodecpp::platform::internal_msg::InternalMsg imsg;
+	postInterThreadMsg( std::move( imsg ), InterThreadMsgType::ThreadTerminate, ThreadID({0, 0}) );
+	auto& slot = threadQueues[thisThreadDescriptor.threadID.slotId];
+	auto writingMeans = slot.getWriteHandleAndReincarnation();
+	slot.setTerminating();
+	// from now on nothing is posted here; messages still queued will not be processed, but OS sockets they carry must not leak
+	static constexpr size_t maxMsgCnt = 8;
+	InterThreadMsg undelivered[maxMsgCnt];
+	size_t droppedCnt = 0;
+	for ( size_t cnt = slot.queue.try_pop_front( undelivered, maxMsgCnt ); cnt != 0; cnt = slot.queue.try_pop_front( undelivered, maxMsgCnt ) )
+	{
+		for ( size_t i=0; i<cnt; ++i )
+			releaseUndeliveredInterThreadMsg( undelivered[i] );
+		droppedCnt += cnt;
+	}
+	if ( droppedCnt )
+		nodecpp::log::default_log::info( nodecpp::log::ModuleID(nodecpp::nodecpp_module_id),"retired Worker: {} queued message(s) dropped", droppedCnt );
+	if ( writingMeans.second.second != InterThreadCommData::invalid_write_handle )
+		nodecpp::internal_usage_only::internal_close( (SOCKET)(writingMeans.second.second) );
+	slot.setUnused( InterThreadCommData::invalid_write_handle ); // to be reused with the next reincarnation
+}
 
 size_t popFrontFromThisThreadQueue( InterThreadMsg* messages, size_t count )
 {
@@ -100,6 +139,16 @@ uintptr_t initInterThreadCommSystemAndGetReadHandleForMainThread()
 	return interThreadCommInitializer.init();
 }
 
+static void awakeInterThreadMsgTarget( uintptr_t writeHandle )
+{
+	// write a byte to writeHandle
+	uint8_t singleByte = 0x1;
+	size_t sentSize = 0;
+	auto ret = nodecpp::internal_usage_only::internal_send_packet( &singleByte, 1, writeHandle, sentSize );
+	NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, ret == COMMLAYER_RET_OK ); 
+	NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, sentSize == 1 ); 
+}
+
 void postInterThreadMsg(nodecpp::platform::internal_msg::InternalMsg&& msg, InterThreadMsgType msgType, NodeAddress targetThreadId )
 {
 	NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, targetThreadId.slotId < MAX_THREADS, "{} vs. {}", targetThreadId.slotId, MAX_THREADS );
@@ -114,12 +163,218 @@ void postInterThreadMsg(nodecpp::platform::internal_msg::InternalMsg&& msg, Inte
 	
 	NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, reincarnation == targetThreadId.reincarnation, "for idx = {}: {} vs. {}", targetThreadId.slotId, reincarnation, targetThreadId.reincarnation ); 
 	threadQueues[ targetThreadId.slotId ].queue.push_back( InterThreadMsg( std::move( msg ), msgType, thisThreadDescriptor.threadID, targetThreadId ) );
-	// write a byte to writeHandle
-	uint8_t singleByte = 0x1;
-	size_t sentSize = 0;
-	auto ret = nodecpp::internal_usage_only::internal_send_packet( &singleByte, 1, writeHandle, sentSize );
-	NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, ret == COMMLAYER_RET_OK ); 
-	NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, sentSize == 1 ); 
+	awakeInterThreadMsgTarget( writeHandle );
+}
+
+struct InterThreadOverflowEntry
+{
+	InterThreadMsg msg;
+	nodecpp::awaitable_handle_t awaiting = nullptr; // a_post() suspended until this message is enqueued
+};
+
+struct InterThreadOverflow
+{
+	nodecpp::stdvector<InterThreadOverflowEntry> entries;
+	size_t head = 0; // entries before head are already enqueued
+	bool empty() const { return head == entries.size(); }
+	size_t size() const { return entries.size() - head; }
+};
+
+static thread_local InterThreadOverflow interThreadOverflow[MAX_THREADS];
+static thread_local size_t interThreadOverflowCnt = 0;
+static std::atomic<size_t> overflowedToSlot[MAX_THREADS]; // over overflows of all threads, by target (see InterThreadQueueStats::overflowed)
+
+void releaseUndeliveredInterThreadMsg( InterThreadMsg& itmsg )
+{
+	// OS sockets passed between threads would otherwise leak
+	switch ( itmsg.msgType )
+	{
+		case InterThreadMsgType::ConnAccepted:
+		{
+			if ( itmsg.obj )
+			{
+				const ConnAcceptedEvMsg* msgs = itmsg.obj.get<ConnAcceptedEvMsg>();
+				size_t cnt = itmsg.obj.count<ConnAcceptedEvMsg>();
+				for ( size_t i=0; i<cnt; ++i )
+					nodecpp::internal_usage_only::internal_close( (SOCKET)(msgs[i].socket) );
+			}
+			else
+			{
+				nodecpp::platform::internal_msg::InternalMsg::ReadIter riter = itmsg.msg.getReadIter();
+				for ( size_t sz = riter.availableSize(); sz >= sizeof( ConnAcceptedEvMsg ); sz -= sizeof( ConnAcceptedEvMsg ) )
+				{
+					const ConnAcceptedEvMsg* msg = reinterpret_cast<const ConnAcceptedEvMsg*>( riter.read( sizeof( ConnAcceptedEvMsg ) ) );
+					nodecpp::internal_usage_only::internal_close( (SOCKET)(msg->socket) );
+				}
+			}
+			break;
+		}
+		case InterThreadMsgType::ConnMigrated:
+		{
+			nodecpp::platform::internal_msg::InternalMsg::ReadIter riter = itmsg.msg.getReadIter();
+			if ( riter.availableSize() >= sizeof( ConnMigratedEvMsg ) )
+			{
+				const ConnMigratedEvMsg* msg = reinterpret_cast<const ConnMigratedEvMsg*>( riter.read( sizeof( ConnMigratedEvMsg ) ) );
+				nodecpp::internal_usage_only::internal_close( (SOCKET)(msg->socket) );
+			}
+			break;
+		}
+		default:
+			break;
+	}
+	itmsg = InterThreadMsg();
+}
+
+static InterThreadPostResult tryPostInterThreadMsg( InterThreadMsg&& itmsg )
+{
+	NodeAddress targetThreadId = itmsg.targetThreadID;
+	NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, targetThreadId.slotId < MAX_THREADS, "{} vs. {}", targetThreadId.slotId, MAX_THREADS );
+	auto writingMeans = threadQueues[ targetThreadId.slotId ].getWriteHandleAndReincarnation();
+	if ( !writingMeans.first || writingMeans.second.first != targetThreadId.reincarnation ) // e.g. a worker that has just retired
+	{
+		nodecpp::log::default_log::info( nodecpp::log::ModuleID(nodecpp::nodecpp_module_id),"thread {} (reincarnation {}) is gone; message of type {} dropped", targetThreadId.slotId, targetThreadId.reincarnation, (size_t)(itmsg.msgType) );
+		releaseUndeliveredInterThreadMsg( itmsg );
+		return InterThreadPostResult::Dropped;
+	}
+
+	InterThreadOverflow& overflow = interThreadOverflow[ targetThreadId.slotId ];
+	if ( overflow.empty() && threadQueues[ targetThreadId.slotId ].queue.try_push_back( std::move( itmsg ) ) )
+	{
+		awakeInterThreadMsgTarget( writingMeans.second.second );
+		return InterThreadPostResult::Enqueued;
+	}
+	// either the queue is full, or there are earlier messages to this destination still waiting
+	InterThreadOverflowEntry entry;
+	entry.msg = std::move( itmsg );
+	overflow.entries.push_back( std::move( entry ) );
+	++interThreadOverflowCnt;
+	overflowedToSlot[ targetThreadId.slotId ].fetch_add( 1, std::memory_order_relaxed );
+	return InterThreadPostResult::Overflowed;
+}
+
+InterThreadPostResult tryPostInterThreadMsg(nodecpp::platform::internal_msg::InternalMsg&& msg, InterThreadMsgType msgType, NodeAddress targetThreadId )
+{
+	return tryPostInterThreadMsg( InterThreadMsg( std::move( msg ), msgType, thisThreadDescriptor.threadID, targetThreadId ) );
+}
+
+InterThreadPostResult tryPostInterThreadMsg(InterThreadObj&& obj, InterThreadMsgType msgType, NodeAddress targetThreadId )
+{
+	return tryPostInterThreadMsg( InterThreadMsg( std::move( obj ), msgType, thisThreadDescriptor.threadID, targetThreadId ) );
+}
+
+size_t broadcastInterThreadObj(InterThreadObj obj, const NodeAddress* targets, size_t targetCnt )
+{
+	NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, obj.isShared() );
+	size_t reached = 0;
+	for ( size_t i=0; i<targetCnt; ++i )
+	{
+		NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, targets[i].slotId < MAX_THREADS, "{} vs. {}", targets[i].slotId, MAX_THREADS );
+		if ( tryPostInterThreadMsg( InterThreadMsg( obj.share(), InterThreadMsgType::Broadcast, thisThreadDescriptor.threadID, targets[i] ) ) != InterThreadPostResult::Dropped )
+			++reached;
+	}
+	return reached; // our own reference is released here; the payload is freed by the last consumer
+}
+
+size_t broadcastToWorkers(InterThreadObj&& obj )
+{
+	ThreadID ids[MAX_THREADS];
+	size_t cnt = getActiveWorkers( ids, MAX_THREADS );
+	NodeAddress targets[MAX_THREADS];
+	for ( size_t i=0; i<cnt; ++i )
+		targets[i] = NodeAddress( ids[i], 0 );
+	return broadcastInterThreadObj( std::move( obj ), targets, cnt );
+}
+
+static OneShotMsgPool msgPools[MAX_THREADS];
+OneShotMsgPool& thisThreadMsgPool() { return msgPools[thisThreadDescriptor.threadID.slotId]; }
+
+void parkOnInterThreadOverflow( NodeAddress targetThreadId, nodecpp::awaitable_handle_t awaiting )
+{
+	InterThreadOverflow& overflow = interThreadOverflow[ targetThreadId.slotId ];
+	NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, !overflow.empty() );
+	NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, overflow.entries.back().awaiting == nullptr );
+	overflow.entries.back().awaiting = awaiting;
+}
+
+void flushInterThreadOverflow()
+{
+	if ( interThreadOverflowCnt == 0 )
+		return;
+	nodecpp::stdvector<nodecpp::awaitable_handle_t> delivered;
+	nodecpp::stdvector<nodecpp::awaitable_handle_t> dropped;
+	for ( size_t slotId = 0; slotId < MAX_THREADS; ++slotId )
+	{
+		InterThreadOverflow& overflow = interThreadOverflow[ slotId ];
+		if ( overflow.empty() )
+			continue;
+		auto writingMeans = threadQueues[ slotId ].getWriteHandleAndReincarnation();
+		bool targetAlive = writingMeans.first && writingMeans.second.first == overflow.entries[overflow.head].msg.targetThreadID.reincarnation;
+		if ( !targetAlive )
+			nodecpp::log::default_log::info( nodecpp::log::ModuleID(nodecpp::nodecpp_module_id),"thread {} is gone; {} overflowed message(s) dropped", slotId, overflow.size() );
+		size_t awaken = 0;
+		while ( !overflow.empty() )
+		{
+			InterThreadOverflowEntry& entry = overflow.entries[overflow.head];
+			if ( targetAlive )
+			{
+				if ( !threadQueues[ slotId ].queue.try_push_back( std::move( entry.msg ) ) )
+					break;
+				++awaken;
+				if ( entry.awaiting != nullptr )
+					delivered.push_back( entry.awaiting );
+			}
+			else
+			{
+				releaseUndeliveredInterThreadMsg( entry.msg );
+				if ( entry.awaiting != nullptr )
+					dropped.push_back( entry.awaiting );
+			}
+			++(overflow.head);
+			--interThreadOverflowCnt;
+			overflowedToSlot[ slotId ].fetch_sub( 1, std::memory_order_relaxed );
+		}
+		for ( size_t i=0; i<awaken; ++i )
+			awakeInterThreadMsgTarget( writingMeans.second.second );
+		if ( overflow.empty() )
+		{
+			overflow.entries.clear();
+			overflow.head = 0;
+		}
+	}
+#ifndef NODECPP_NO_COROUTINES
+	// resumed only now, as resumed coroutines may post again
+	for ( auto h : dropped )
+	{
+		nodecpp::setCoroException(h, std::exception()); // TODO: switch to our exceptions ASAP!
+		h();
+	}
+	for ( auto h : delivered )
+		h();
+#endif // NODECPP_NO_COROUTINES
+}
+
+bool hasInterThreadOverflow() { return interThreadOverflowCnt != 0; }
+
+InterThreadQueueStats getInterThreadQueueStats( size_t slotId )
+{
+	NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, slotId < MAX_THREADS, "{} vs. {}", slotId, MAX_THREADS );
+	InterThreadQueueStats stats = threadQueues[ slotId ].queue.getStats();
+	stats.overflowed = overflowedToSlot[ slotId ].load( std::memory_order_relaxed );
+	return stats;
+}
+
+void publishThisThreadQueueStatsIfDue( uint64_t now )
+{
+	static thread_local uint64_t lastPublished = 0;
+	if ( now - lastPublished < interThreadQueueStatsPeriodMks )
+		return;
+	lastPublished = now;
+	InterThreadQueueStats stats = getInterThreadQueueStats( thisThreadDescriptor.threadID.slotId );
+	auto& tm = nodecpp::metrics::thisThread();
+	tm.interThreadQueueSize.set( stats.size );
+	tm.interThreadQueueHwm.set( stats.hwmsize );
+	tm.interThreadQueueFulls.set( stats.nfulls );
+	tm.interThreadOverflowed.set( stats.overflowed );
 }
 
 
@@ -160,6 +415,7 @@ namespace nodecpp
 		size_t internalID = workers_.size();
 		Worker worker;
 		worker.id_ = ++coreCtr; // TODO: assign an actual value
+		worker.threadID_ = startupData->threadCommID;
 		startupData->IdWithinGroup = worker.id_;
 		// run worker thread
 		nodecpp::log::default_log::info( nodecpp::log::ModuleID(nodecpp::nodecpp_module_id),"about to start Worker thread with threadID = {} and WorkerID = {}...", threadIdx, worker.id_ );
@@ -177,6 +433,98 @@ namespace nodecpp
 		// TODO: ...
 	}
 
+	bool Cluster::retire( Worker& worker )
+	{
+		NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, isMaster() );
+		if ( worker.retiring_ )
+			return false;
+		if ( listeningOptions.mode == ListeningMode::ReusePortPerWorker )
+		{
+			// closing a SO_REUSEPORT listener drops connections waiting in its accept queue
+			nodecpp::log::default_log::info( nodecpp::log::ModuleID(nodecpp::nodecpp_module_id),"retiring workers is not supported in ReusePortPerWorker mode" );
+			return false;
+		}
+		if ( !retireWorkerForLoadTracking( worker.threadID_ ) ) // from now on listener threads do not select it
+			return false;
+		worker.retiring_ = true;
+		for ( auto& server : agentServers )
+			if ( server != nullptr )
+				for ( size_t i=0; i<server->socketsToSlaves.size(); )
+					if ( server->socketsToSlaves[i].targetThreadId.slotId == worker.threadID_.slotId )
+						server->socketsToSlaves.erase( server->socketsToSlaves.begin() + i );
+					else
+						++i;
+		nodecpp::log::default_log::info( nodecpp::log::ModuleID(nodecpp::nodecpp_module_id),"retiring Worker {} (threadID = {})", worker.id_, worker.threadID_.slotId );
+		nodecpp::platform::internal_msg::InternalMsg imsg;
+		tryPostInterThreadMsg( std::move( imsg ), InterThreadMsgType::ThreadTerminate, worker.threadID_ ); // a stalled worker must not block the master
+		return true;
+	}
+
+	void Cluster::onWorkerExited( ThreadID id )
+	{
+		NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, isMaster() );
+		for ( size_t i=0; i<workers_.size(); ++i )
+			if ( workers_[i].threadID_.slotId == id.slotId && workers_[i].threadID_.reincarnation == id.reincarnation )
+			{
+				nodecpp::log::default_log::info( nodecpp::log::ModuleID(nodecpp::nodecpp_module_id),"Worker {} (threadID = {}) has exited", workers_[i].id_, id.slotId );
+				workers_.erase( workers_.begin() + i );
+				return;
+			}
+	}
+
+	void Cluster::autoscaleIfDue( uint64_t now )
+	{
+		NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, isMaster() );
+		const ElasticPoolOptions& opts = elasticPoolOptions;
+		AutoscaleState& st = autoscaleState;
+		if ( !opts.enabled || now - st.lastCheck < 100000 )
+			return;
+		st.lastCheck = now;
+
+		size_t active = 0;
+		uint32_t busy = averageWorkerBusyPermille( active );
+		if ( active == 0 ) // not yet started
+			return;
+		size_t maxWorkers = opts.maxWorkers ? opts.maxWorkers : std::thread::hardware_concurrency();
+		if ( busy >= opts.scaleUpPermille && active < maxWorkers )
+		{
+			if ( st.aboveSince == 0 )
+				st.aboveSince = now;
+		}
+		else
+			st.aboveSince = 0;
+		if ( busy <= opts.scaleDownPermille && active > opts.minWorkers )
+		{
+			if ( st.belowSince == 0 )
+				st.belowSince = now;
+		}
+		else
+			st.belowSince = 0;
+
+		if ( st.lastAction != 0 && now - st.lastAction < opts.cooldownMs * 1000 )
+			return;
+		if ( st.aboveSince != 0 && now - st.aboveSince >= opts.sustainMs * 1000 )
+		{
+			nodecpp::log::default_log::info( nodecpp::log::ModuleID(nodecpp::nodecpp_module_id),"elastic pool: average load {}/1000 over {} worker(s); adding a worker", busy, active );
+			fork();
+			st.lastAction = now;
+			st.aboveSince = 0;
+		}
+		else if ( st.belowSince != 0 && now - st.belowSince >= opts.sustainMs * 1000 )
+		{
+			// the most recently added worker goes first
+			for ( size_t i=workers_.size(); i>0; --i )
+				if ( !workers_[i-1].retiring_ )
+				{
+					nodecpp::log::default_log::info( nodecpp::log::ModuleID(nodecpp::nodecpp_module_id),"elastic pool: average load {}/1000 over {} worker(s); retiring a worker", busy, active );
+					retire( workers_[i-1] );
+					break;
+				}
+			st.lastAction = now;
+			st.belowSince = 0;
+		}
+	}
+
 	void Cluster::AgentServer::registerServer() { 
 		nodecpp::soft_ptr<Cluster::AgentServer> myPtr = myThis.getSoftPtr<Cluster::AgentServer>(this);
 		::registerAgentServer(myPtr); 
@@ -196,6 +544,18 @@ namespace nodecpp
 	}
 
 
+	void Cluster::SlaveProcessor::onListeningReported( size_t requestID )
+	{
+		for ( size_t i=0; i<listeningRequests.size(); ++i )
+			if ( listeningRequests[i].first == requestID )
+			{
+				netServerManagerBase->addListeningServerEv( listeningRequests[i].second );
+				listeningRequests.erase( listeningRequests.begin() + i );
+				return;
+			}
+		// already reported (the master reports both when a slave joins a listening server and when the server starts listening)
+	}
+
 	nodecpp::handler_ret_type Cluster::SlaveProcessor::processResponse( ThreadID requestingThreadId, InterThreadMsgType msgType, nodecpp::platform::internal_msg::InternalMsg::ReadIter& riter )
 	{
 		size_t sz = riter.availableSize();
@@ -203,15 +563,36 @@ namespace nodecpp
 		{
 			case InterThreadMsgType::ServerListening:
 			{
-				// TODO: ...
+				NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, sizeof( ListeningEvMsg ) <= sz, "{} vs. {}", sizeof( ListeningEvMsg ), sz ); 
+				const ListeningEvMsg* msg = reinterpret_cast<const ListeningEvMsg*>( riter.read( sizeof( ListeningEvMsg ) ) );
+				onListeningReported( msg->requestID );
 				break;
 			}
 			case InterThreadMsgType::ConnAccepted:
 			{
 				NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, sizeof( ConnAcceptedEvMsg ) <= sz, "{} vs. {}", sizeof( ConnAcceptedEvMsg ), sz ); 
-				const ConnAcceptedEvMsg* msg = reinterpret_cast<const ConnAcceptedEvMsg*>( riter.read( sizeof( ConnAcceptedEvMsg ) ) );
+				// listener threads may batch several accepted connections into a single message
+				for ( ; sz >= sizeof( ConnAcceptedEvMsg ); sz -= sizeof( ConnAcceptedEvMsg ) )
+				{
+					const ConnAcceptedEvMsg* msg = reinterpret_cast<const ConnAcceptedEvMsg*>( riter.read( sizeof( ConnAcceptedEvMsg ) ) );
 //nodecpp::log::default_log::info( nodecpp::log::ModuleID(nodecpp::nodecpp_module_id), "conn accepted from threadID = {}...", requestingThreadId.slotId );
-				netServerManagerBase->addAcceptedSocket( msg->serverIdx, (SOCKET)(msg->socket), msg->ip, msg->uport );
+					netServerManagerBase->addAcceptedSocket( msg->serverIdx, (SOCKET)(msg->socket), msg->ip, msg->uport );
+				}
+				break;
+			}
+			case InterThreadMsgType::ThreadTerminate:
+			{
+				getCluster().beginRetirement( infraGetCurrentTime() );
+				break;
+			}
+			case InterThreadMsgType::ConnMigrated:
+			{
+				NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, sizeof( ConnMigratedEvMsg ) <= sz, "{} vs. {}", sizeof( ConnMigratedEvMsg ), sz ); 
+				ConnMigratedEvMsg msg = *reinterpret_cast<const ConnMigratedEvMsg*>( riter.read( sizeof( ConnMigratedEvMsg ) ) );
+				size_t bufferedSize = msg.readSize + msg.writeSize;
+				NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, sizeof( ConnMigratedEvMsg ) + bufferedSize <= sz, "{} vs. {}", sizeof( ConnMigratedEvMsg ) + bufferedSize, sz ); 
+				const uint8_t* bufferedData = bufferedSize ? riter.read( bufferedSize ) : nullptr;
+				netServerManagerBase->addMigratedSocket( msg, bufferedData );
 				break;
 			}
 			case InterThreadMsgType::ServerError:
@@ -235,6 +616,31 @@ namespace nodecpp
 		}
 		CO_RETURN;
 	}
+
+	nodecpp::handler_ret_type Cluster::SlaveProcessor::processTypedResponse( ThreadID requestingThreadId, InterThreadMsgType msgType, InterThreadObj& obj )
+	{
+		switch ( msgType )
+		{
+			case InterThreadMsgType::ServerListening:
+			{
+				onListeningReported( obj.get<ListeningEvMsg>()->requestID );
+				break;
+			}
+			case InterThreadMsgType::ConnAccepted:
+			{
+				const ConnAcceptedEvMsg* msgs = obj.get<ConnAcceptedEvMsg>();
+				size_t cnt = obj.count<ConnAcceptedEvMsg>();
+				NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, cnt != 0 ); 
+				for ( size_t i=0; i<cnt; ++i )
+					netServerManagerBase->addAcceptedSocket( msgs[i].serverIdx, (SOCKET)(msgs[i].socket), msgs[i].ip, msgs[i].uport );
+				break;
+			}
+			default:
+				NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, false, "unexpected type {}", (size_t)(msgType) ); 
+				break;
+		}
+		CO_RETURN;
+	}
 }
 
 #include "../include/nodecpp/logging.h"
@@ -54,6 +54,11 @@ void preinitThreadStartupData( ThreadStartupData& startupData, InterThreadMessag
 #error unexpected
 #endif
 void decrementThisWorkerLoadCtr();
+void incrementThisWorkerLoadCtr(); // for connections accepted by the worker itself (ReusePortPerWorker mode)
+void reportThisWorkerLoadSignals( uint32_t busyPermille, uint32_t queuedEvents, uint64_t bytesPerSec );
+void reportThisWorkerShedding( bool shedding ); // over its soft memory limit: not to be given new connections while others are not
+ThreadID selectMigrationTargetForThisWorker();
+void releaseThisWorkerThreadIfRetired(); // elastic pool: frees the thread slot of a retired worker
 
 #endif // NODECPP_ENABLE_CLUSTERING
 
@@ -31,6 +31,7 @@
 #if (defined NODECPP_ENABLE_CLUSTERING) || (defined NODECPP_USE_Q_BASED_INFRA)
 
 #include <internal_msg.h>
+#include "interthread_obj.h"
 
 #define MAX_THREADS 128
 
@@ -60,7 +61,7 @@ struct NodeAddress : public ThreadID
 	NodeAddress& operator = ( NodeAddress&& other ) = default;
 };
 
-enum class InterThreadMsgType { UserDefined, ThreadStarted, ThreadTerminate, ServerListening, ConnAccepted, ServerError, ServerCloseRequest, ServerClosedNotification, RequestToListeningThread, Infrastructural, GlobalMQ, Undefined };
+enum class InterThreadMsgType { UserDefined, ThreadStarted, ThreadTerminate, ServerListening, ConnAccepted, ServerError, ServerCloseRequest, ServerClosedNotification, ConnMigrated, RequestToListeningThread, Infrastructural, GlobalMQ, Broadcast, Undefined };
 
 extern thread_local size_t workerIdxInLoadCollector;
 
@@ -83,6 +84,7 @@ struct InterThreadMsg
 	uint32_t recipientID = invalidRecipientID;
 	InterThreadMsgType msgType = InterThreadMsgType::Undefined;
 	nodecpp::platform::internal_msg::InternalMsg msg;
+	InterThreadObj obj; // if set, the payload is passed as is (within the process), and 'msg' carries no body
 
 	InterThreadMsg() {}
 	InterThreadMsg( InterThreadMsgPtr ptr )
@@ -95,6 +97,8 @@ struct InterThreadMsg
 	}
 	InterThreadMsg( nodecpp::platform::internal_msg::InternalMsg&& msg_, InterThreadMsgType msgType_, NodeAddress sourceThreadID_, NodeAddress targetThreadID_, size_t recipientID_ = 0 ) : 
 		sourceThreadID( sourceThreadID_ ), targetThreadID( targetThreadID_ ), recipientID( recipientID_ ), msgType( msgType_ ), msg( std::move(msg_) )  {}
+	InterThreadMsg( InterThreadObj&& obj_, InterThreadMsgType msgType_, NodeAddress sourceThreadID_, NodeAddress targetThreadID_, size_t recipientID_ = 0 ) : 
+		sourceThreadID( sourceThreadID_ ), targetThreadID( targetThreadID_ ), recipientID( recipientID_ ), msgType( msgType_ ), obj( std::move(obj_) )  {}
 	InterThreadMsg( const InterThreadMsg& ) = delete;
 	InterThreadMsg& operator = ( const InterThreadMsg& ) = delete;
 	InterThreadMsg( InterThreadMsg&& other ) = default; 
@@ -102,6 +106,12 @@ struct InterThreadMsg
 
 	InterThreadMsgPtr convertToPointer()
 	{
+		if ( obj ) // leaving the process: the typed payload is serialized only now
+		{
+			NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, obj.isSerializable() );
+			msg.append( obj.data(), obj.size() );
+			obj.reset();
+		}
 		msg.appWriteData( &sourceThreadID, 0, sizeof( sourceThreadID ) );
 		msg.appWriteData( &targetThreadID, sizeof( sourceThreadID ), sizeof( targetThreadID ) );
 		msg.appWriteData( &msgType, sizeof( sourceThreadID ) + sizeof( targetThreadID ), sizeof( msgType ) );
@@ -112,8 +122,33 @@ struct InterThreadMsg
 //	void restoreFromPointer( InterThreadMsgPtr ptr )
 };
 
+struct InterThreadQueueStats
+{
+	size_t size = 0;
+	size_t hwmsize = 0; // high watermark on queue size
+	size_t nfulls = 0; // number of times a sender has found the queue full
+	size_t overflowed = 0; // messages still waiting in overflows of all sending threads for this queue
+};
+
 uintptr_t initInterThreadCommSystemAndGetReadHandleForMainThread();
 void postInterThreadMsg(nodecpp::platform::internal_msg::InternalMsg&& msg, InterThreadMsgType msgType, NodeAddress threadId );
+// never blocks: if the target queue is full, the message is kept in a per-destination overflow of the calling thread 
+// and is delivered (in order) by flushInterThreadOverflow(); if the target thread is gone, the message is dropped 
+// (OS sockets it carries are closed, see releaseUndeliveredInterThreadMsg())
+enum class InterThreadPostResult { Enqueued, Overflowed, Dropped };
+InterThreadPostResult tryPostInterThreadMsg(nodecpp::platform::internal_msg::InternalMsg&& msg, InterThreadMsgType msgType, NodeAddress threadId );
+InterThreadPostResult tryPostInterThreadMsg(InterThreadObj&& obj, InterThreadMsgType msgType, NodeAddress threadId ); // same, for typed payloads (see interthread_obj.h)
+void releaseUndeliveredInterThreadMsg( InterThreadMsg& msg ); // closes OS sockets carried by ConnAccepted and ConnMigrated
+// posts a handle to the same shared payload (see makeInterThreadSharedObj()) to each target; returns the number of targets reached
+size_t broadcastInterThreadObj(InterThreadObj obj, const NodeAddress* targets, size_t targetCnt );
+// nodes that receive broadcasts implement void onBroadcastMessage( NodeAddress from, InterThreadObj& obj )
+template<typename NodeT> concept has_broadcast_message_handler_call = requires { { std::declval<NodeT>().onBroadcastMessage(std::declval<NodeAddress>(), std::declval<InterThreadObj&>()) }; };
+void flushInterThreadOverflow();
+bool hasInterThreadOverflow();
+static constexpr uint64_t interThreadOverflowRetryMks = 1000; // how often a thread with a non-empty overflow retries
+InterThreadQueueStats getInterThreadQueueStats( size_t slotId );
+static constexpr uint64_t interThreadQueueStatsPeriodMks = 1000000;
+void publishThisThreadQueueStatsIfDue( uint64_t now ); // to nodecpp::metrics::thisThread(), for the queue of the calling thread
 #include "../../include/nodecpp/common_structs.h"
 void postInfrastructuralMsg(nodecpp::Message&& msg, NodeAddress threadId );
 struct ThreadStartupData;
@@ -127,10 +162,18 @@ struct ListenerThreadDescriptor
 };
 std::pair<const ListenerThreadDescriptor*, size_t> getListeners();
 
-size_t addWorkerEntryForLoadTracking( ThreadID id );
+size_t addWorkerEntryForLoadTracking( ThreadID id, int numaNode );
 void incrementWorkerLoadCtr( size_t idx );
 void decrementWorkerLoadCtr( size_t idx );
-ThreadID getLeastLoadedWorkerAndIncrementLoad();
+ThreadID selectWorkerAndIncrementLoad( uint32_t remoteIpNetwork );
+ThreadID selectMigrationTarget( size_t fromIdx ); // invalid ThreadID if there is no reason to migrate
+void reportWorkerLoadSignals( size_t idx, uint32_t busyPermille, uint32_t queuedEvents, uint64_t bytesPerSec );
+void reportWorkerShedding( size_t idx, bool shedding );
+bool retireWorkerForLoadTracking( ThreadID id ); // elastic pool: excludes the worker from further selection
+void releaseWorkerEntryForLoadTracking( size_t idx ); // the slot may be reused by a new worker
+uint32_t averageWorkerBusyPermille( size_t& activeWorkerCnt );
+size_t getActiveWorkers( ThreadID* ids, size_t maxCnt );
+size_t broadcastToWorkers(InterThreadObj&& obj ); // to all active workers
 void createListenerThread();
 
 #endif // NODECPP_ENABLE_CLUSTERING
@@ -133,6 +133,34 @@ public:
 		waitrd.notify_one();
 	}
 
+	bool try_push_back(T&& it) {
+		//never blocks; if the queue is full, 'it' is left intact and false is returned
+		{//creating scope for lock
+			std::unique_lock<std::mutex> lock(mx);
+			if (killflag)
+				return true; // same as push_back(): the message is silently dropped
+			if (coll.is_full()) {
+				++nfulls;
+				return false;
+			}
+			coll.push_back(std::move(it));
+			size_t sz = coll.size();
+			hwmsize = std::max(hwmsize, sz);
+		}//unlocking mx
+
+		waitrd.notify_one();
+		return true;
+	}
+
+	InterThreadQueueStats getStats() {
+		std::unique_lock<std::mutex> lock(mx);
+		InterThreadQueueStats stats;
+		stats.size = coll.size();
+		stats.hwmsize = hwmsize;
+		stats.nfulls = nfulls;
+		return stats;
+	}
+
 	std::pair<bool, T> pop_front() {
 		std::unique_lock<std::mutex> lock(mx);
 		while (coll.size() == 0 && !killflag) {
@@ -188,6 +216,18 @@ public:
 		return sz2move;
 	}
 
+	size_t try_pop_front( T* messages, size_t count ) { // never waits; returns 0 if the queue is empty
+		std::unique_lock<std::mutex> lock(mx);
+		size_t sz2move = count <= coll.size() ? count : coll.size();
+		for ( size_t i=0; i<sz2move; ++i )
+			messages[i] = std::move(coll.pop_front());
+		lock.unlock();
+		if ( sz2move )
+			waitwr.notify_one();
+
+		return sz2move;
+	}
+
 	void kill() {
 		{//creating scope for lock
 			std::unique_lock<std::mutex> lock(mx);
@@ -241,7 +281,7 @@ public:
 	}
 	void setTerminating() {
 		std::unique_lock<std::mutex> lock(mx);
-		NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, status == Status::running, "indeed: {}", status ); 
+		NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, status == Status::running || status == Status::acquired, "indeed: {}", status ); 
 		status = Status::terminating;
 	}
 	void setUnused( uintptr_t writeHandle_ ) {
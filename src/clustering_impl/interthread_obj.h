@@ -0,0 +1,264 @@
+/* -------------------------------------------------------------------------------
+* Copyright (c) 2021, OLogN Technologies AG
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*     * Neither the name of the OLogN Technologies AG nor the
+*       names of its contributors may be used to endorse or promote products
+*       derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL OLogN Technologies AG BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+* -------------------------------------------------------------------------------*/
+
+#ifndef INTERTHREAD_OBJ_H
+#define INTERTHREAD_OBJ_H
+
+#if (defined NODECPP_ENABLE_CLUSTERING) || (defined NODECPP_USE_Q_BASED_INFRA)
+
+#include "../../include/nodecpp/basic_collections.h"
+#include "../../include/nodecpp/metrics.h"
+#include <atomic>
+#include <type_traits>
+
+// Typed payloads passed between threads of the same process without serialization.
+// A block is allocated once by the sending thread from its own pool and is freed exactly once by the receiving thread;
+// blocks freed by other threads are returned to the owner's lock-free stack and are reclaimed by the owner in bulk.
+class OneShotMsgPool
+{
+	struct alignas(std::max_align_t) Block
+	{
+		Block* next;
+		OneShotMsgPool* owner; // nullptr for blocks too large to be pooled
+		size_t blockCnt; // including this header
+		size_t sizeClass;
+	};
+
+public:
+	static constexpr size_t sizeClassCnt = 4;
+	static constexpr size_t minBlockSize = 64; // payload capacity of the smallest class; each next class is 4 times larger
+
+private:
+	Block* local[sizeClassCnt] = {}; // owner thread only
+	std::atomic<Block*> remote[sizeClassCnt] = {}; // pushed by other threads; taken by the owner as a whole
+	static inline thread_local OneShotMsgPool* current = nullptr;
+
+	static constexpr size_t blockSize( size_t sizeClass ) { return minBlockSize << ( 2 * sizeClass ); }
+	static Block* allocateBlock( size_t sz ) {
+		size_t blockCnt = 1 + ( sz + sizeof(Block) - 1 ) / sizeof(Block);
+		nodecpp::stdallocator<Block> stdall;
+		Block* b = stdall.allocate( blockCnt );
+		b->blockCnt = blockCnt;
+		return b;
+	}
+
+public:
+	OneShotMsgPool() {}
+	OneShotMsgPool( const OneShotMsgPool& ) = delete;
+	OneShotMsgPool& operator = ( const OneShotMsgPool& ) = delete;
+	OneShotMsgPool( OneShotMsgPool&& ) = delete;
+	OneShotMsgPool& operator = ( OneShotMsgPool&& ) = delete;
+
+	void* allocate( size_t sz ) {
+		current = this;
+		auto& metrics = nodecpp::metrics::thisThread();
+		metrics.msgPoolAllocs.add();
+		size_t sizeClass = 0;
+		while ( sizeClass < sizeClassCnt && blockSize( sizeClass ) < sz )
+			++sizeClass;
+		Block* b;
+		if ( sizeClass == sizeClassCnt )
+		{
+			b = allocateBlock( sz );
+			b->owner = nullptr;
+			metrics.msgPoolHeapAllocs.add();
+		}
+		else
+		{
+			if ( local[sizeClass] == nullptr )
+				local[sizeClass] = remote[sizeClass].exchange( nullptr, std::memory_order_acquire );
+			if ( local[sizeClass] != nullptr )
+			{
+				b = local[sizeClass];
+				local[sizeClass] = b->next;
+			}
+			else
+			{
+				b = allocateBlock( blockSize( sizeClass ) );
+				metrics.msgPoolHeapAllocs.add();
+			}
+			b->owner = this;
+		}
+		b->sizeClass = sizeClass;
+		return b + 1;
+	}
+
+	static void deallocate( void* ptr ) {
+		Block* b = reinterpret_cast<Block*>( ptr ) - 1;
+		OneShotMsgPool* owner = b->owner;
+		if ( owner == nullptr )
+		{
+			nodecpp::stdallocator<Block> stdall;
+			stdall.deallocate( b, b->blockCnt );
+		}
+		else if ( owner == current )
+		{
+			b->next = owner->local[b->sizeClass];
+			owner->local[b->sizeClass] = b;
+		}
+		else
+		{
+			// push-only from foreign threads; the owner takes the whole stack at once, so there is no ABA
+			std::atomic<Block*>& head = owner->remote[b->sizeClass];
+			b->next = head.load( std::memory_order_relaxed );
+			while ( !head.compare_exchange_weak( b->next, b, std::memory_order_release, std::memory_order_relaxed ) )
+				;
+		}
+	}
+};
+
+OneShotMsgPool& thisThreadMsgPool(); // one pool per thread slot; pools outlive threads and are inherited with a slot
+
+class InterThreadObj
+{
+	// shared (broadcast) payloads are preceded by a reference counter; the last holder destroys the payload
+	struct alignas(std::max_align_t) SharedHeader
+	{
+		std::atomic<size_t> refs;
+	};
+
+	void* ptr = nullptr;
+	size_t sz = 0;
+	void (*destructor)(void*) = nullptr; // nullptr for trivially destructible payloads
+	bool serializable = false; // trivially copyable payloads can cross a process boundary as plain bytes
+	bool shared = false;
+
+	template<class T, class ... Args> friend InterThreadObj makeInterThreadObj( Args&& ... args );
+	template<class T> friend InterThreadObj makeInterThreadArray( size_t cnt );
+	template<class T, class ... Args> friend InterThreadObj makeInterThreadSharedObj( Args&& ... args );
+
+public:
+	InterThreadObj() {}
+	InterThreadObj( const InterThreadObj& ) = delete;
+	InterThreadObj& operator = ( const InterThreadObj& ) = delete;
+	InterThreadObj( InterThreadObj&& other ) : ptr( other.ptr ), sz( other.sz ), destructor( other.destructor ), serializable( other.serializable ), shared( other.shared ) { other.ptr = nullptr; other.sz = 0; }
+	InterThreadObj& operator = ( InterThreadObj&& other ) {
+		if ( this == &other )
+			return *this;
+		reset();
+		ptr = other.ptr;
+		sz = other.sz;
+		destructor = other.destructor;
+		serializable = other.serializable;
+		shared = other.shared;
+		other.ptr = nullptr;
+		other.sz = 0;
+		return *this;
+	}
+	~InterThreadObj() { reset(); }
+
+	explicit operator bool () const { return ptr != nullptr; }
+	template<class T> T* get() { return reinterpret_cast<T*>( ptr ); }
+	template<class T> size_t count() const { return sz / sizeof(T); }
+	const void* data() const { return ptr; }
+	size_t size() const { return sz; }
+	bool isSerializable() const { return serializable; }
+	bool isShared() const { return shared; }
+
+	InterThreadObj share() const { // one more handle to the same shared payload; payload must be treated as read-only
+		NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, ptr != nullptr && shared );
+		( reinterpret_cast<SharedHeader*>( ptr ) - 1 )->refs.fetch_add( 1, std::memory_order_relaxed );
+		InterThreadObj ret;
+		ret.ptr = ptr;
+		ret.sz = sz;
+		ret.destructor = destructor;
+		ret.serializable = serializable;
+		ret.shared = true;
+		return ret;
+	}
+
+	void reset() {
+		if ( ptr == nullptr )
+			return;
+		void* block = ptr;
+		if ( shared )
+		{
+			SharedHeader* header = reinterpret_cast<SharedHeader*>( ptr ) - 1;
+			block = header;
+			if ( header->refs.fetch_sub( 1, std::memory_order_acq_rel ) != 1 )
+			{
+				ptr = nullptr;
+				sz = 0;
+				return;
+			}
+		}
+		if ( destructor != nullptr )
+			destructor( ptr );
+		OneShotMsgPool::deallocate( block );
+		ptr = nullptr;
+		sz = 0;
+	}
+};
+
+template<class T, class ... Args>
+InterThreadObj makeInterThreadObj( Args&& ... args )
+{
+	InterThreadObj ret;
+	ret.ptr = thisThreadMsgPool().allocate( sizeof(T) );
+	new (ret.ptr) T( std::forward<Args>( args )... );
+	ret.sz = sizeof(T);
+	if constexpr ( !std::is_trivially_destructible<T>::value )
+		ret.destructor = []( void* p ) { reinterpret_cast<T*>( p )->~T(); };
+	ret.serializable = std::is_trivially_copyable<T>::value;
+	return ret;
+}
+
+template<class T>
+InterThreadObj makeInterThreadArray( size_t cnt )
+{
+	static_assert( std::is_trivially_copyable<T>::value && std::is_trivially_destructible<T>::value );
+	InterThreadObj ret;
+	ret.ptr = thisThreadMsgPool().allocate( sizeof(T) * cnt );
+	for ( size_t i=0; i<cnt; ++i )
+		new (reinterpret_cast<T*>( ret.ptr ) + i) T();
+	ret.sz = sizeof(T) * cnt;
+	ret.serializable = true;
+	return ret;
+}
+
+// payload of a broadcast: allocated once, delivered to several threads by InterThreadObj::share(), freed by the last consumer
+// (note: if T owns memory, it should be allocated by nodecpp::stdallocator, as it may be freed at another thread)
+template<class T, class ... Args>
+InterThreadObj makeInterThreadSharedObj( Args&& ... args )
+{
+	InterThreadObj ret;
+	void* block = thisThreadMsgPool().allocate( sizeof(InterThreadObj::SharedHeader) + sizeof(T) );
+	InterThreadObj::SharedHeader* header = new (block) InterThreadObj::SharedHeader;
+	header->refs.store( 1, std::memory_order_relaxed );
+	ret.ptr = header + 1;
+	new (ret.ptr) T( std::forward<Args>( args )... );
+	ret.sz = sizeof(T);
+	if constexpr ( !std::is_trivially_destructible<T>::value )
+		ret.destructor = []( void* p ) { reinterpret_cast<T*>( p )->~T(); };
+	ret.serializable = std::is_trivially_copyable<T>::value;
+	ret.shared = true;
+	return ret;
+}
+
+#endif // (defined NODECPP_ENABLE_CLUSTERING) || (defined NODECPP_USE_Q_BASED_INFRA)
+
+#endif // INTERTHREAD_OBJ_H
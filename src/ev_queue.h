@@ -33,6 +33,8 @@
 #include <functional>
 
 #include "../include/nodecpp/common.h"
+#include "../include/nodecpp/metrics.h"
+#include "../include/nodecpp/trace.h"
 
 
 class EvQueue
@@ -78,6 +80,8 @@ public:
 	void emit(std::function<void()>& ev) noexcept
 	{
 		//TODO wrapper so we don't let exceptions out of ev handler
+		nodecpp::metrics::HandlerScope handlerScope( nodecpp::metrics::HandlerKind::Event );
+		nodecpp::trace::Span span( "event" );
 		try
 		{
 			ev();
@@ -128,6 +128,7 @@ int main( int argc, char *argv_[] )
 #else
 
 #include "clustering_impl/clustering_impl.h"
+#include "../include/nodecpp/thread_placement.h"
 
 namespace nodecpp {
 extern void preinitMasterThreadClusterObject();
@@ -142,7 +143,8 @@ void workerThreadMain( void* pdata )
 	ThreadStartupData startupData = *sd;
 	nodecpp::stddealloc( sd, 1 );
 	setThisThreadDescriptor( startupData );
-	workerIdxInLoadCollector = addWorkerEntryForLoadTracking( startupData.threadCommID );
+	nodecpp::placement::placeThisThread( nodecpp::placement::Role::Worker ); // before the allocator is initialized: its arena should be node-local
+	workerIdxInLoadCollector = addWorkerEntryForLoadTracking( startupData.threadCommID, nodecpp::placement::thisThreadNumaNode() );
 #ifdef NODECPP_USE_IIBMALLOC
 	g_AllocManager.initialize();
 #endif
@@ -153,6 +155,7 @@ void workerThreadMain( void* pdata )
 	NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, NodeFactoryMap::getInstance().getFacoryMap()->size() == 1, "Indeed: {}. Current implementation supports exactly 1 node per thread. More nodes is a pending dev", NodeFactoryMap::getInstance().getFacoryMap()->size() );
 	for ( auto f : *(NodeFactoryMap::getInstance().getFacoryMap()) )
 		f.second->create()->run(false, &startupData);
+	releaseThisWorkerThreadIfRetired(); // elastic pool: the slot is to be reused by a next worker
 }
 
 int main( int argc, char *argv_[] )
@@ -32,9 +32,14 @@
 //#include <nodecpp/nls.h>
 #include "../include/nodecpp/nls.h"
 #include "../include/nodecpp/net_common.h"
+#include "../include/nodecpp/metrics_shm.h"
+#include "../include/nodecpp/trace.h"
 
 #include <time.h>
 #include <climits>
+#include <mutex>
+#include <thread>
+#include <chrono>
 
 #ifndef _MSC_VER
 #define _GNU_SOURCE
@@ -54,6 +59,14 @@
 #define gettid() syscall(SYS_gettid)
 #endif
 #include <sys/resource.h>
+#include <sys/mman.h>
+#include <errno.h>
+#include <signal.h>
+#include <execinfo.h>
+#include <dlfcn.h>
+#include <cxxabi.h>
+#else
+#include <process.h>
 #endif
 
 
@@ -143,7 +156,6 @@ namespace nodecpp {
 #endif
 		}
 
-#ifdef USE_TEMP_PERF_CTRS
 		std::pair<long, long> get_thread_time()
 		{
 #if defined NODECPP_MSVC || ( (defined NODECPP_WINDOWS) && (defined NODECPP_CLANG) )
@@ -228,91 +240,477 @@ namespace nodecpp {
 #error not implemented for this compiler
 #endif
 		}	
-#endif // USE_TEMP_PERF_CTRS
 	} // namespace time
 
 } // namespace nodecpp
 
 
-#ifdef USE_TEMP_PERF_CTRS
-//thread_local int pollRetMax = 0;
-//thread_local size_t sessionCreationtime = 0;
-//thread_local int sessionCnt = 0;
-thread_local uint64_t waitTime = 0;
-thread_local uint64_t lastWaitTime = 0;
+thread_local long lastUserT = 0;
+thread_local long lastKernelT = 0;
+thread_local uint64_t lastMetricsReportT = 0;
+thread_local nodecpp::metrics::Snapshot lastMetricsReported; // this thread's counters as of the previous report
+thread_local uint64_t lastMetricsPublishT = 0;
 
-thread_local uint64_t writeTime = 0;
-thread_local uint64_t lastWriteTime = 0;
+#ifndef _MSC_VER
+static std::once_flag metricsShmOnce;
+static nodecpp::metrics::shm::Region* metricsShmRegion = nullptr;
+static char metricsShmName[64];
+
+static void unlinkMetricsShm()
+{
+	shm_unlink( metricsShmName );
+}
 
-thread_local int eventCnt = 0;
-thread_local int lastEventCnt = 0;
+static nodecpp::metrics::shm::Region* getMetricsShmRegion()
+{
+	std::call_once( metricsShmOnce, [] {
+		const char* name = nodecpp::metrics::getOptions().shmName;
+		if ( name != nullptr )
+			snprintf( metricsShmName, sizeof(metricsShmName), "%s", name );
+		else
+			nodecpp::metrics::shm::defaultName( metricsShmName, sizeof(metricsShmName), (int)getpid() );
+		shm_unlink( metricsShmName ); // a leftover of a crashed process with the same name, if any
+		int fd = shm_open( metricsShmName, O_CREAT | O_EXCL | O_RDWR, 0644 );
+		if ( fd < 0 )
+		{
+			nodecpp::log::default_log::info( nodecpp::log::ModuleID(nodecpp::nodecpp_module_id), "metrics: shm_open(\"{}\") failed; error {}", metricsShmName, errno );
+			return;
+		}
+		void* ptr = MAP_FAILED;
+		if ( ftruncate( fd, sizeof(nodecpp::metrics::shm::Region) ) == 0 )
+			ptr = mmap( nullptr, sizeof(nodecpp::metrics::shm::Region), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+		close( fd );
+		if ( ptr == MAP_FAILED )
+		{
+			nodecpp::log::default_log::info( nodecpp::log::ModuleID(nodecpp::nodecpp_module_id), "metrics: mapping \"{}\" failed; error {}", metricsShmName, errno );
+			shm_unlink( metricsShmName );
+			return;
+		}
+		auto region = reinterpret_cast<nodecpp::metrics::shm::Region*>( ptr ); // zero-filled, which is a valid state of all atomics there
+		nodecpp::metrics::shm::Header& h = region->header;
+		h.magic = nodecpp::metrics::shm::magic;
+		h.version = nodecpp::metrics::shm::version;
+		h.headerSize = sizeof(nodecpp::metrics::shm::Header);
+		h.recordSize = sizeof(nodecpp::metrics::shm::ThreadRecord);
+		h.recordCnt = nodecpp::metrics::shm::maxThreads;
+		h.fieldCnt = nodecpp::metrics::shm::fieldCnt;
+		h.periodMs = nodecpp::metrics::getOptions().shmPeriodMs;
+		h.pid = (int32_t)getpid();
+		h.ready.store( 1, std::memory_order_release );
+		atexit( unlinkMetricsShm );
+		metricsShmRegion = region;
+		nodecpp::log::default_log::info( nodecpp::log::ModuleID(nodecpp::nodecpp_module_id), "metrics: publishing to \"{}\"", metricsShmName );
+	} );
+	return metricsShmRegion;
+}
 
-thread_local uint64_t eventProcTime = 0;
-thread_local uint64_t lastEventProcTime = 0;
+static void publishLoopMetrics( uint64_t currentT )
+{
+	static_assert( nodecpp::metrics::Registry::maxThreads == nodecpp::metrics::shm::maxThreads );
+	static_assert( (size_t)nodecpp::metrics::ThreadRole::Node + 1 == sizeof(nodecpp::metrics::shm::roleNames) / sizeof(nodecpp::metrics::shm::roleNames[0]) );
+	size_t slot = nodecpp::metrics::thisThreadSlot();
+	nodecpp::metrics::shm::Region* region = getMetricsShmRegion();
+	if ( region == nullptr || slot >= nodecpp::metrics::shm::maxThreads )
+		return;
+	using nodecpp::metrics::shm::Field;
+	const nodecpp::metrics::ThreadMetrics& tm = nodecpp::metrics::thisThread();
+	nodecpp::metrics::shm::ThreadData d;
+	d.publishedAt = currentT;
+	d.role = (uint32_t)tm.role.load( std::memory_order_relaxed );
+	d.instanceId = (uint32_t)tm.instanceId.load( std::memory_order_relaxed );
+	d.values[Field::iterations] = tm.iterations.get();
+	d.values[Field::polls] = tm.polls.get();
+	d.values[Field::readyEvents] = tm.readyEvents.get();
+	d.values[Field::interThreadMsgs] = tm.interThreadMsgs.get();
+	d.values[Field::timersFired] = tm.timersFired.get();
+	d.values[Field::connectionsAccepted] = tm.sessionsCreated.get();
+	d.values[Field::connectionsClosed] = tm.sessionsClosed.get();
+	d.values[Field::openSockets] = tm.openSockets.get();
+	d.values[Field::bytesIn] = tm.bytesIn.get();
+	d.values[Field::bytesOut] = tm.bytesOut.get();
+	d.values[Field::sendCalls] = tm.sendCalls.get();
+	d.values[Field::sendWouldBlock] = tm.sendWouldBlock.get();
+	d.values[Field::httpRequests] = tm.httpRequests.get();
+	d.values[Field::httpRequestMks] = tm.httpRequestMks.getSum();
+	d.values[Field::busyMks] = tm.loopIterationMks.getSum();
+	d.values[Field::waitMks] = tm.pollWaitMks.getSum();
+	nodecpp::metrics::shm::write( region->threads[slot], d );
+}
+#endif
 
-thread_local int pollCnt = 0;
-thread_local int lastPollCnt = 0;
+static void startLoopMetricsLog( uint64_t currentT ) // the baseline of the first report
+{
+	lastMetricsReportT = currentT;
+	auto times = nodecpp::time::get_thread_time();
+	lastUserT = times.first;
+	lastKernelT = times.second;
+	lastMetricsReported = nodecpp::metrics::Snapshot();
+	lastMetricsReported.add( nodecpp::metrics::thisThread() );
+}
 
-thread_local int pollRetCnt = 0;
-thread_local int lastPollRetCnt = 0;
+static void logLoopMetrics( uint64_t currentT )
+{
+	uint64_t wallClockDelta = currentT - lastMetricsReportT;
+	lastMetricsReportT = currentT;
+
+	auto times = nodecpp::time::get_thread_time();
+	bool userAndKernelTimeOK = times.first + times.second != 0;
+	long userDelta = times.first - lastUserT;
+	long kernelDelta = times.second - lastKernelT;
+	lastUserT = times.first;
+	lastKernelT = times.second;
+
+	nodecpp::metrics::Snapshot current;
+	current.add( nodecpp::metrics::thisThread() );
+	nodecpp::metrics::Snapshot& last = lastMetricsReported;
+
+	uint64_t waitDelta = current.pollWaitMks.sum - last.pollWaitMks.sum;
+	uint64_t procDelta = current.eventProcessingMks.sum - last.eventProcessingMks.sum;
+	uint64_t pollDelta = current.polls - last.polls;
+	uint64_t readyDelta = current.readyEvents - last.readyEvents;
+	nodecpp::log::default_log::info( nodecpp::log::ModuleID(nodecpp::nodecpp_module_id), "[{}ms] user: {}%, kernel: {}%, wait: {} ({}%), ev proc time: {} ({}%); iterations: {}, polls: {}, pollRetAvg: {}, itc msgs: {}, timers: {}, sends: {} (would block: {}); iteration p50/p99/max: {}/{}/{} mks; accounted memory: {} KB", 
+		wallClockDelta / 1000, userAndKernelTimeOK ? userDelta * 100 / (long)wallClockDelta : 0, userAndKernelTimeOK ? kernelDelta * 100 / (long)wallClockDelta : 0, 
+		waitDelta / 1000, waitDelta * 100 / wallClockDelta, procDelta / 1000, procDelta * 100 / wallClockDelta, 
+		current.iterations - last.iterations, pollDelta, pollDelta ? readyDelta / pollDelta : 0, current.interThreadMsgs - last.interThreadMsgs, current.timersFired - last.timersFired, 
+		current.sendCalls - last.sendCalls, current.sendWouldBlock - last.sendWouldBlock, 
+		current.loopIterationMks.percentile( 0.5 ), current.loopIterationMks.percentile( 0.99 ), current.loopIterationMks.max, 
+		nodecpp::metrics::accountedMemory( nodecpp::metrics::thisThread() ) / 1024 );
+	last = current;
+}
 
-thread_local int zeroSockCnt = 0;
-thread_local int lastZeroSockCnt = 0;
+static std::once_flag traceInitOnce;
+static std::mutex traceFileMx;
+static FILE* traceFile = nullptr; // opened on the first flush
+static bool traceFileFinished = false;
+static bool traceFileEmpty = true;
+static bool traceThreadNamed[nodecpp::trace::Buffer::maxBuffers];
+static uint64_t traceBaseTsc = 0;
+static uint64_t traceBaseMks = 0;
+static std::atomic<uint32_t> traceFlushRequests = 0;
+static thread_local uint32_t traceFlushRequestsSeen = 0;
+#ifndef _MSC_VER
+static bool traceFlushSignalSet = false;
+static std::atomic<pid_t> traceLoopTids[nodecpp::trace::Buffer::maxBuffers]; // to wake up loops blocked in poll() when a flush is requested
+static std::atomic<size_t> traceLoopCnt = 0;
+static thread_local bool traceLoopRegistered = false;
+#endif
 
-thread_local long lastUserT = 0;
-thread_local long lastKernelT = 0;
-thread_local uint64_t lastTimeReportT = 0;
-void reportTimes( uint64_t currentT)
+static int tracePid()
 {
-	if ( currentT > lastTimeReportT + 1000000 )
+#ifdef _MSC_VER
+	return _getpid();
+#else
+	return getpid();
+#endif
+}
+
+static void writeTraceRecords( nodecpp::trace::Buffer& b ) // under traceFileMx
+{
+	if ( traceFileFinished )
+		return;
+	if ( traceFile == nullptr )
 	{
-		uint64_t wallClockDelta = currentT - lastTimeReportT;
-		lastTimeReportT = currentT;
-
-		auto times = nodecpp::time::get_thread_time();
-		bool userAndKernelTimeOK = times.first + times.second != 0;
-		long userDelta = 0;
-		long kernelDelta = 0;
-		if ( userAndKernelTimeOK )
+		const char* path = nodecpp::trace::getOptions().path;
+		nodecpp::string defaultPath = nodecpp::format( "nodecpp-trace.{}.json", tracePid() );
+		traceFile = fopen( path != nullptr ? path : defaultPath.c_str(), "w" );
+		if ( traceFile == nullptr )
 		{
-			userDelta = times.first - lastUserT;
-			kernelDelta = times.second - lastKernelT;
-			lastUserT = times.first;
-			lastKernelT = times.second;
+			nodecpp::log::default_log::info( nodecpp::log::ModuleID(nodecpp::nodecpp_module_id), "trace: cannot open {} (error {})", path != nullptr ? path : defaultPath.c_str(), errno );
+			traceFileFinished = true;
+			return;
 		}
-		long totalT = userDelta + kernelDelta;
+		fputs( "[", traceFile ); // JSON Array Format: the closing bracket is written at exit and is optional for viewers
+	}
+
+	// TSC ticks are mapped to infraGetCurrentTime() using the rate observed since tracing was started
+	while ( infraGetCurrentTime() < traceBaseMks + 10000 ) // too short an interval to measure the rate
+		std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+	uint64_t nowTsc = nodecpp::trace::timestamp();
+	uint64_t nowMks = infraGetCurrentTime();
+	double ticksPerMks = (double)( nowTsc - traceBaseTsc ) / ( nowMks - traceBaseMks );
+	auto toMks = [ticksPerMks]( uint64_t tsc ) { return traceBaseMks + (double)(int64_t)( tsc - traceBaseTsc ) / ticksPerMks; };
+
+	nodecpp::string out;
+	int pid = tracePid();
+	if ( !traceThreadNamed[b.id] )
+	{
+		traceThreadNamed[b.id] = true;
+		::fmt::format_to( std::back_inserter( out ), "{}\n{{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":{},\"tid\":{},\"args\":{{\"name\":\"{} {}\"}}}}", 
+			traceFileEmpty ? "" : ",", pid, b.id, nodecpp::metrics::roleName( b.tm->role.load( std::memory_order_relaxed ) ), b.tm->instanceId.load( std::memory_order_relaxed ) );
+		traceFileEmpty = false;
+	}
+	uint64_t head = b.head.load( std::memory_order_acquire );
+	uint64_t from = head - b.flushed > b.mask + 1 ? head - ( b.mask + 1 ) : b.flushed; // older records have been overwritten
+	for ( uint64_t i=from; i<head; ++i )
+	{
+		const nodecpp::trace::Record& r = b.records[ i & b.mask ];
+		::fmt::format_to( std::back_inserter( out ), ",\n{{\"name\":\"{}\",\"ph\":\"X\",\"pid\":{},\"tid\":{},\"ts\":{:.3f},\"dur\":{:.3f}}}", 
+			r.name, pid, b.id, toMks( r.begin ), (double)( r.end - r.begin ) / ticksPerMks );
+	}
+	b.flushed = head;
+	fwrite( out.data(), 1, out.size(), traceFile );
+	fflush( traceFile );
+}
+
+static void finishTrace()
+{
+	std::unique_lock<std::mutex> lock( traceFileMx );
+	// loops may still be running at this point; whatever they write meanwhile is not guaranteed to make it to the file
+	size_t cnt = nodecpp::trace::impl::bufferCnt.load( std::memory_order_acquire );
+	for ( size_t i=0; i<cnt; ++i )
+	{
+		nodecpp::trace::Buffer* b = nodecpp::trace::impl::buffers[i].load( std::memory_order_acquire );
+		if ( b != nullptr )
+			writeTraceRecords( *b );
+	}
+	if ( traceFile != nullptr )
+	{
+		fputs( "\n]\n", traceFile );
+		fclose( traceFile );
+		traceFile = nullptr;
+	}
+	traceFileFinished = true;
+}
+
+#ifndef _MSC_VER
+static void traceFlushSignalHandler( int sig, siginfo_t* info, void* )
+{
+	if ( info != nullptr && info->si_code == SI_TKILL && info->si_pid == getpid() ) // forwarded below, just to interrupt poll()
+		return;
+	int savedErrno = errno;
+	traceFlushRequests.fetch_add( 1, std::memory_order_relaxed );
+	// a process-directed signal interrupts a single thread; the rest of the loops are woken up explicitly
+	pid_t self = (pid_t)gettid();
+	size_t cnt = std::min( traceLoopCnt.load( std::memory_order_acquire ), nodecpp::trace::Buffer::maxBuffers );
+	for ( size_t i=0; i<cnt; ++i )
+	{
+		pid_t tid = traceLoopTids[i].load( std::memory_order_relaxed );
+		if ( tid != 0 && tid != self )
+			syscall( SYS_tgkill, getpid(), tid, sig );
+	}
+	errno = savedErrno;
+}
+#endif
 
-		uint64_t waitDelta = waitTime - lastWaitTime;
-		lastWaitTime = waitTime;
+static void flushTraceIfRequested()
+{
+	std::call_once( traceInitOnce, [] {
+		traceBaseTsc = nodecpp::trace::timestamp();
+		traceBaseMks = infraGetCurrentTime();
+#ifndef _MSC_VER
+		int sig = nodecpp::trace::getOptions().flushSignal;
+		if ( sig >= 0 )
+		{
+			struct sigaction sa;
+			memset( &sa, 0, sizeof(sa) );
+			sa.sa_sigaction = traceFlushSignalHandler;
+			sigemptyset( &sa.sa_mask );
+			sa.sa_flags = SA_RESTART | SA_SIGINFO;
+			traceFlushSignalSet = sigaction( sig != 0 ? sig : SIGRTMIN + 8, &sa, nullptr ) == 0;
+		}
+#endif
+		atexit( finishTrace );
+	} );
+#ifndef _MSC_VER
+	if ( !traceLoopRegistered && traceFlushSignalSet )
+	{
+		traceLoopRegistered = true;
+		size_t idx = traceLoopCnt.fetch_add( 1, std::memory_order_acq_rel );
+		if ( idx < nodecpp::trace::Buffer::maxBuffers )
+			traceLoopTids[idx].store( (pid_t)gettid(), std::memory_order_relaxed );
+	}
+#endif
+	uint32_t requests = traceFlushRequests.load( std::memory_order_relaxed );
+	if ( requests == traceFlushRequestsSeen )
+		return;
+	traceFlushRequestsSeen = requests;
+	nodecpp::trace::Buffer* b = nodecpp::trace::impl::thisThreadBuffer;
+	if ( b == nullptr )
+		return;
+	std::unique_lock<std::mutex> lock( traceFileMx );
+	writeTraceRecords( *b ); // a loop flushes its own buffer only, so that records are never read while being written
+}
 
-		uint64_t writeDelta = writeTime - lastWriteTime;
-		lastWriteTime = writeTime;
+void reportLoopMetricsIfDue( uint64_t currentT )
+{
+	if ( nodecpp::trace::impl::enabled )
+		flushTraceIfRequested();
+	const nodecpp::metrics::Options& options = nodecpp::metrics::getOptions();
+	if ( options.logPeriodMs != 0 )
+	{
+		if ( lastMetricsReportT == 0 ) // the first call is made at the start of the loop
+			startLoopMetricsLog( currentT );
+		else if ( currentT >= lastMetricsReportT + (uint64_t)options.logPeriodMs * 1000 )
+			logLoopMetrics( currentT );
+	}
+#ifndef _MSC_VER
+	if ( options.shmPeriodMs != 0 && currentT >= lastMetricsPublishT + (uint64_t)options.shmPeriodMs * 1000 )
+	{
+		lastMetricsPublishT = currentT;
+		publishLoopMetrics( currentT );
+	}
+#endif
+}
 
-		int eventDelta = eventCnt - lastEventCnt;
-		lastEventCnt = eventCnt;
-			
-		uint64_t eventProcTimeDelta = eventProcTime - lastEventProcTime;
-		lastEventProcTime = eventProcTime;
+int capPollTimeoutForReporting( int timeoutMs )
+{
+#ifndef _MSC_VER
+	uint32_t periodMs = nodecpp::metrics::getOptions().shmPeriodMs; // a loop that stops publishing is shown as stale
+	if ( periodMs != 0 && ( timeoutMs < 0 || (uint32_t)timeoutMs > periodMs ) )
+		return (int)periodMs;
+#endif
+	return timeoutMs;
+}
 
-		int pollCntDelta = pollCnt - lastPollCnt;
-		lastPollCnt = pollCnt;
+#ifndef _MSC_VER
+struct StackSample
+{
+	static constexpr int maxDepth = 32;
+	std::atomic<uint32_t> requested = 0;
+	std::atomic<uint32_t> done = 0;
+	void* frames[maxDepth];
+	int depth = 0;
+};
+
+struct StallWatch // one per metrics::Registry slot
+{
+	std::atomic<nodecpp::metrics::ThreadMetrics*> tm = nullptr;
+	std::atomic<pid_t> tid = 0;
+	StackSample sample;
+	// used by the watchdog thread only
+	uint64_t reportedSince = 0;
+	uint64_t lastLoggedAt = 0;
+	uint64_t suppressed = 0;
+};
+
+static StallWatch stallWatches[nodecpp::metrics::Registry::maxThreads];
+static std::once_flag stallWatchdogOnce;
+static int stallSignal = -1;
+static thread_local StackSample* thisThreadStackSample = nullptr;
+
+static void stallSignalHandler( int )
+{
+	int savedErrno = errno;
+	StackSample* sample = thisThreadStackSample;
+	if ( sample != nullptr )
+	{
+		uint32_t requested = sample->requested.load( std::memory_order_acquire );
+		if ( requested != sample->done.load( std::memory_order_relaxed ) )
+		{
+			sample->depth = backtrace( sample->frames, StackSample::maxDepth );
+			sample->done.store( requested, std::memory_order_release );
+		}
+	}
+	errno = savedErrno;
+}
 
-		int pollRetCntDelta = pollRetCnt - lastPollRetCnt;
-		lastPollRetCnt = pollRetCnt;
+static nodecpp::string describeCode( const void* addr )
+{
+	Dl_info info;
+	if ( addr == nullptr || dladdr( addr, &info ) == 0 )
+		return nodecpp::format( "{}", addr );
+	if ( info.dli_sname == nullptr )
+		return nodecpp::format( "{}+{:#x}", info.dli_fname != nullptr ? info.dli_fname : "?", (uintptr_t)addr - (uintptr_t)info.dli_fbase );
+	int status = -1;
+	char* demangled = abi::__cxa_demangle( info.dli_sname, nullptr, nullptr, &status );
+	nodecpp::string ret = nodecpp::format( "{}", status == 0 ? demangled : info.dli_sname );
+	free( demangled );
+	return ret;
+}
 
-		int zeroSockDelta = zeroSockCnt - lastZeroSockCnt;
-		lastZeroSockCnt = zeroSockCnt;
+static nodecpp::string sampleStack( StallWatch& w, nodecpp::metrics::ThreadMetrics& tm, uint64_t since )
+{
+	if ( stallSignal <= 0 )
+		return nodecpp::string( "n/a" );
+	uint32_t request = w.sample.requested.load( std::memory_order_relaxed ) + 1;
+	w.sample.requested.store( request, std::memory_order_release );
+	if ( tm.activity.busySince.load( std::memory_order_relaxed ) != since ) // the stall is over; the stack would show something else
+		return nodecpp::string( "n/a (stall is over)" );
+	if ( syscall( SYS_tgkill, getpid(), w.tid.load( std::memory_order_relaxed ), stallSignal ) != 0 )
+		return nodecpp::string( "n/a" );
+	for ( int i=0; i<100 && w.sample.done.load( std::memory_order_acquire ) != request; ++i )
+		std::this_thread::sleep_for( std::chrono::microseconds( 100 ) );
+	if ( w.sample.done.load( std::memory_order_acquire ) != request )
+		return nodecpp::string( "n/a (no response)" );
+	nodecpp::string ret;
+	for ( int i=2; i<w.sample.depth; ++i ) // skipping the signal handler and the signal trampoline
+		::fmt::format_to( std::back_inserter( ret ), "{}{}", i > 2 ? " <- " : "", describeCode( w.sample.frames[i] ).c_str() );
+	return ret;
+}
 
-		if ( userAndKernelTimeOK )
-			nodecpp::log::default_log::info( nodecpp::log::ModuleID(nodecpp::nodecpp_module_id), "[{}ms] user: {}%, kernel: {}%, wait: {} ({}%), write: {} ({}%); events: {} ({}), ev proc time: {} ({}%); polls: {}, pollRetAvg: {}, ZeroSockCnt: {}", 
-				wallClockDelta / 1000, userDelta * 100 / wallClockDelta, kernelDelta * 100 / wallClockDelta, waitDelta / 1000, waitDelta * 100 / wallClockDelta, writeDelta / 1000, writeDelta * 100 / wallClockDelta, 
-				eventDelta, eventCnt, eventProcTimeDelta/1000, eventProcTimeDelta * 100 / wallClockDelta, pollCntDelta, pollCntDelta ? pollRetCntDelta / pollCntDelta : 0, zeroSockDelta );
-		else
-			nodecpp::log::default_log::info( nodecpp::log::ModuleID(nodecpp::nodecpp_module_id), "[{}ms] user: --%, kernel: --%, wait: {} ({}%), write: {} ({}%); events: {} ({}), ev proc time: {} ({}%); polls: {}, pollRetAvg: {}, ZeroSockCnt: {}", 
-				wallClockDelta / 1000, waitDelta / 1000, waitDelta * 100 / wallClockDelta, writeDelta / 1000, writeDelta * 100 / wallClockDelta, 
-				eventDelta, eventCnt, eventProcTimeDelta/1000, eventProcTimeDelta * 100 / wallClockDelta, pollCntDelta, pollCntDelta ? pollRetCntDelta / pollCntDelta : 0, zeroSockDelta );
+static void stallWatchdogMain()
+{
+	const nodecpp::metrics::Options& options = nodecpp::metrics::getOptions();
+	uint64_t thresholdMks = (uint64_t)options.stallThresholdMs * 1000;
+	uint64_t logIntervalMks = (uint64_t)options.stallLogIntervalMs * 1000;
+	uint64_t periodMks = std::max<uint64_t>( thresholdMks / 4, 1000 );
+	for (;;)
+	{
+		std::this_thread::sleep_for( std::chrono::microseconds( periodMks ) );
+		uint64_t now = infraGetCurrentTime();
+		for ( auto& w : stallWatches )
+		{
+			nodecpp::metrics::ThreadMetrics* tm = w.tm.load( std::memory_order_acquire );
+			if ( tm == nullptr || !tm->live.load( std::memory_order_relaxed ) )
+				continue;
+			uint64_t since = tm->activity.busySince.load( std::memory_order_relaxed );
+			if ( since == 0 || now < since + thresholdMks )
+				continue;
+			uint64_t stallMks = now - since;
+			if ( stallMks > tm->longestStallMks.get() )
+				tm->longestStallMks.set( stallMks );
+			if ( since == w.reportedSince ) // the same stall is still going on
+				continue;
+			w.reportedSince = since;
+			tm->stalls.add();
+			if ( w.lastLoggedAt != 0 && now < w.lastLoggedAt + logIntervalMks )
+			{
+				++(w.suppressed);
+				continue;
+			}
+			w.lastLoggedAt = now;
+			nodecpp::metrics::HandlerKind handler = tm->activity.handler.load( std::memory_order_relaxed );
+			uint64_t socketIdx = tm->activity.socketIdx.load( std::memory_order_relaxed );
+			const void* origin = tm->activity.origin.load( std::memory_order_relaxed );
+			nodecpp::string stack = sampleStack( w, *tm, since );
+			nodecpp::log::default_log::info( nodecpp::log::ModuleID(nodecpp::nodecpp_module_id), "stall: {} {} is busy for {} ms in '{}' handler (socket {}, coroutine {}); {} more stall(s) not logged since the previous record; stack: {}", 
+				nodecpp::metrics::roleName( tm->role.load( std::memory_order_relaxed ) ), tm->instanceId.load( std::memory_order_relaxed ), stallMks / 1000, 
+				nodecpp::metrics::handlerKindName( handler ), socketIdx, origin != nullptr ? describeCode( origin ).c_str() : "n/a", w.suppressed, stack.c_str() );
+			w.suppressed = 0;
+		}
 	}
 }
-#endif // USE_TEMP_PERF_CTRS
+#endif
+
+void watchLoopForStalls()
+{
+#ifndef _MSC_VER
+	const nodecpp::metrics::Options& options = nodecpp::metrics::getOptions();
+	size_t slot = nodecpp::metrics::thisThreadSlot();
+	if ( options.stallThresholdMs == 0 || slot >= nodecpp::metrics::Registry::maxThreads )
+		return;
+	std::call_once( stallWatchdogOnce, [&options] {
+		if ( options.stallSignal >= 0 )
+		{
+			int sig = options.stallSignal != 0 ? options.stallSignal : SIGRTMIN + 7;
+			struct sigaction sa;
+			memset( &sa, 0, sizeof(sa) );
+			sa.sa_handler = stallSignalHandler;
+			sigemptyset( &sa.sa_mask );
+			sa.sa_flags = SA_RESTART;
+			if ( sigaction( sig, &sa, nullptr ) == 0 )
+				stallSignal = sig;
+		}
+		std::thread( stallWatchdogMain ).detach();
+	} );
+	void* frame;
+	backtrace( &frame, 1 ); // the first call may load the unwinder, which is not something to be done in a signal handler
+	StallWatch& w = stallWatches[slot];
+	w.tid.store( (pid_t)gettid(), std::memory_order_relaxed );
+	thisThreadStackSample = &(w.sample);
+	nodecpp::metrics::thisThread().activity.busySince.store( infraGetCurrentTime(), std::memory_order_relaxed );
+	w.tm.store( &(nodecpp::metrics::thisThread()), std::memory_order_release );
+#endif
+}
 
 #endif // NODECPP_USE_Q_BASED_INFRA
@@ -36,6 +36,9 @@
 #include "tcp_socket/tcp_socket.h"
 
 #include "../include/nodecpp/timers.h"
+#include "../include/nodecpp/shared_snapshot.h"
+#include "../include/nodecpp/metrics.h"
+#include "../include/nodecpp/trace.h"
 #include <functional>
 
 #ifdef NODECPP_RECORD_AND_REPLAY
@@ -51,6 +54,18 @@ uint64_t infraGetCurrentTime();
 
 #include "clustering_impl/interthread_comm.h"
 
+#ifdef NODECPP_ENABLE_CLUSTERING
+template<class NodeT>
+void deliverBroadcastMessage( NodeT& node, InterThreadMsg& msg )
+{
+	// the payload is shared with other recipients and must be treated as read-only; it is released as 'msg' goes away
+	if constexpr ( has_broadcast_message_handler_call<NodeT> )
+		node.onBroadcastMessage( msg.sourceThreadID, msg.obj );
+	else
+		nodecpp::log::default_log::info( nodecpp::log::ModuleID(nodecpp::nodecpp_module_id),"broadcast message from thread {} is ignored (no onBroadcastMessage() handler)", msg.sourceThreadID.slotId );
+}
+#endif // NODECPP_ENABLE_CLUSTERING
+
 class Infrastructure
 {
 	template<class Node> 
@@ -63,6 +78,94 @@ class Infrastructure
 	TimeoutManager timeout;
 	EvQueue inmediateQueue;
 
+	nodecpp::metrics::ThreadMetrics& metrics = nodecpp::metrics::thisThread();
+	uint64_t lastWaitEnd = 0;
+	uint64_t lastWaitMks = 0; // of the current iteration
+
+#ifdef NODECPP_ENABLE_CLUSTERING
+	// periodically reports this worker's load (loop busy ratio, ready events per poll, bytes/s) to listener threads
+	struct LoadSampler
+	{
+		static constexpr uint64_t periodMks = 100000;
+		uint64_t periodStart = 0;
+		uint64_t waitMks = 0;
+		uint64_t readyEvents = 0;
+		uint64_t polls = 0;
+		uint64_t bytesAtPeriodStart = 0;
+
+		void onWait( uint64_t mks, int ready ) { 
+			waitMks += mks; 
+			++polls; 
+			if ( ready > 0 ) 
+				readyEvents += ready; 
+		}
+		bool reportIfDue( uint64_t now ) { // returns true if a new report has been made
+			uint64_t bytes = nodecpp::internal_usage_only::ioBytesTransferred;
+			if ( periodStart == 0 )
+			{
+				periodStart = now;
+				bytesAtPeriodStart = bytes;
+				return false;
+			}
+			uint64_t elapsed = now - periodStart;
+			if ( elapsed < periodMks )
+				return false;
+			uint32_t busyPermille = waitMks >= elapsed ? 0 : (uint32_t)( ( elapsed - waitMks ) * 1000 / elapsed );
+			uint32_t queuedEvents = polls ? (uint32_t)( ( readyEvents + polls - 1 ) / polls ) : 0;
+			reportThisWorkerLoadSignals( busyPermille, queuedEvents, ( bytes - bytesAtPeriodStart ) * 1000000 / elapsed );
+			periodStart = now;
+			bytesAtPeriodStart = bytes;
+			waitMks = 0;
+			readyEvents = 0;
+			polls = 0;
+			return true;
+		}
+	};
+	LoadSampler loadSampler;
+
+	// an overloaded worker moves a few opted-in connections (see setMigratable()) to a clearly less loaded one per load report;
+	// the bound lets load signals catch up before more connections are moved
+	static constexpr size_t maxRebalancedPerPeriod = 8;
+	void rebalanceStep()
+	{
+		if ( selectMigrationTargetForThisWorker().slotId == ThreadID::InvalidSlotID )
+			return;
+		size_t moved = 0;
+		ioSockets.forEachClientSocketEntry( [&moved]( NetSocketEntry& entry ) {
+			auto* data = entry.getClientSocketData();
+			if ( moved < maxRebalancedPerPeriod && data->migratable && !data->migrated && data->state == net::SocketBase::DataForCommandProcessing::Connected && entry.getClientSocket()->migrate() )
+				++moved;
+		} );
+	}
+
+	// a retiring worker hands over connections the app has opted in (see setMigratable()) and waits for the rest to close;
+	// connections still there after drainTimeoutMs are closed. Returns true as soon as it may leave its loop
+	bool retirementStep( uint64_t now )
+	{
+		uint64_t elapsed = now - getCluster().getRetirementStartedAt();
+		if ( elapsed < Cluster::retirementGraceMks )
+			return false;
+		bool drainTimedOut = elapsed >= Cluster::retirementGraceMks + Cluster::getElasticPoolOptions().drainTimeoutMs * 1000;
+		size_t remaining = 0;
+		ioSockets.forEachClientSocketEntry( [&remaining, drainTimedOut]( NetSocketEntry& entry ) {
+			auto* data = entry.getClientSocketData();
+			auto state = data->state;
+			if ( data->migrated || state == net::SocketBase::DataForCommandProcessing::Closing || state == net::SocketBase::DataForCommandProcessing::ErrorClosing || state == net::SocketBase::DataForCommandProcessing::Closed )
+				++remaining; // waits for final cleanup (see infraGetCloseEvent())
+			else if ( drainTimedOut )
+			{
+				if ( !data->isValid() ) // never connected; owns no OS socket
+					return;
+				entry.getClientSocket()->destroy(); // its OS socket is closed at this very iteration, and 'close' is emitted
+				++remaining;
+			}
+			else if ( !data->migratable || state != net::SocketBase::DataForCommandProcessing::Connected || !entry.getClientSocket()->migrate() )
+				++remaining; // is being drained, or cannot be migrated (yet)
+		} );
+		return remaining == 0;
+	}
+#endif // NODECPP_ENABLE_CLUSTERING
+
 public:
 	Infrastructure() : netSocket(ioSockets), netServer(ioSockets) {}
 
@@ -109,14 +212,29 @@ public:
 		int retval = poll(fds_begin, fds_sz, timeoutToUse);
 #endif
 */
-		int timeoutToUse = getPollTimeout(nextTimeoutAt, now);
-#ifdef USE_TEMP_PERF_CTRS
-extern thread_local size_t waitTime;
-size_t now1 = infraGetCurrentTime();
-		auto ret = ioSockets.wait( timeoutToUse );
-waitTime += infraGetCurrentTime() - now1;
-#else
-		auto ret = ioSockets.wait( timeoutToUse );
+		int timeoutToUse = capPollTimeoutForReporting( getPollTimeout(nextTimeoutAt, now) );
+		if ( netSocket.infraTcpInfoSweepInProgress() ) // the next slice is due at the next iteration
+			timeoutToUse = 0;
+		metrics.openSockets.set( ioSockets.getUsedCount() );
+		nodecpp::qsbr::goOffline(); // no snapshot is held while waiting; SharedSnapshot versions can be reclaimed meanwhile
+		uint64_t waitStart = infraGetCurrentTime();
+		metrics.activity.busySince.store( 0, std::memory_order_relaxed );
+		std::pair<bool, int> ret;
+		{
+			nodecpp::trace::Span span( "poll wait" );
+			ret = ioSockets.wait( timeoutToUse );
+		}
+		lastWaitEnd = infraGetCurrentTime();
+		metrics.activity.busySince.store( lastWaitEnd, std::memory_order_relaxed );
+		nodecpp::metrics::setLoopClock( lastWaitEnd );
+		lastWaitMks = lastWaitEnd - waitStart;
+		nodecpp::qsbr::goOnline();
+		metrics.pollWaitMks.record( lastWaitMks );
+		metrics.polls.add();
+		if ( ret.second > 0 )
+			metrics.readyEvents.add( ret.second );
+#ifdef NODECPP_ENABLE_CLUSTERING
+		loadSampler.onWait( lastWaitMks, ret.second );
 #endif
 
 		if ( !ret.first )
@@ -149,29 +267,11 @@ waitTime += infraGetCurrentTime() - now1;
 		}
 		else //if(retval)
 		{
-#ifdef USE_TEMP_PERF_CTRS
-extern thread_local int pollCnt;
-extern thread_local int pollRetCnt;	
-extern thread_local int pollRetMax;	
-extern thread_local int pollRetCnt;
-extern thread_local int zeroSockCnt;
-extern thread_local uint64_t eventProcTime;
-extern thread_local int eventCnt;
-
-++pollCnt;
-pollRetCnt += retval;
-if ( pollRetMax < retval ) 
-	pollRetMax = retval;
-
-#endif // USE_TEMP_PERF_CTRS
 			int processed = 0;
 #ifdef NODECPP_ENABLE_CLUSTERING
 			short revents = ioSockets.reventsAt(ioSockets.awakerSockIdx);
 			if ( revents && (int64_t)(ioSockets.socketsAt(ioSockets.awakerSockIdx)) > 0 )
 			{
-#ifdef USE_TEMP_PERF_CTRS
-++zeroSockCnt;
-#endif // USE_TEMP_PERF_CTRS
 				++processed;
 				// TODO: see infraCheckPollFdSet() for more details to be implemented
 				if ( clusterIsMaster() )
@@ -188,8 +288,14 @@ if ( pollRetMax < retval )
 							InterThreadMsg thq[maxMsgCnt];
 							size_t actualFromQueue = popFrontFromThisThreadQueue( thq, actaulFromSock );
 							NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, actualFromQueue == actaulFromSock, "{} vs. {}", actualFromQueue, actaulFromSock );
+							metrics.queueDepth.record( actualFromQueue );
+							metrics.interThreadMsgs.add( actualFromQueue );
+							nodecpp::trace::Span span( "inter-thread messages" );
 							for ( size_t i=0; i<actualFromQueue; ++i )
-								getCluster().onInterthreadMessage( thq[i] );
+								if ( thq[i].msgType == InterThreadMsgType::Broadcast )
+									deliverBroadcastMessage( node, thq[i] );
+								else
+									getCluster().onInterthreadMessage( thq[i] );
 						}
 						else
 						{
@@ -212,8 +318,14 @@ if ( pollRetMax < retval )
 							InterThreadMsg thq[maxMsgCnt];
 							size_t actualFromQueue = popFrontFromThisThreadQueue( thq, actaulFromSock );
 							NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, actualFromQueue == actaulFromSock, "{} vs. {}", actualFromQueue, actaulFromSock );
+							metrics.queueDepth.record( actualFromQueue );
+							metrics.interThreadMsgs.add( actualFromQueue );
+							nodecpp::trace::Span span( "inter-thread messages" );
 							for ( size_t i=0; i<actualFromQueue; ++i )
-								getCluster().slaveProcessor.onInterthreadMessage( thq[i] );
+								if ( thq[i].msgType == InterThreadMsgType::Broadcast )
+									deliverBroadcastMessage( node, thq[i] );
+								else
+									getCluster().slaveProcessor.onInterthreadMessage( thq[i] );
 						}
 						else
 						{
@@ -225,10 +337,6 @@ if ( pollRetMax < retval )
 			}
 #endif // NODECPP_ENABLE_CLUSTERING
 				
-#ifdef USE_TEMP_PERF_CTRS
-size_t now2 = infraGetCurrentTime();
-
-#endif // #ifdef NODECPP_ENABLE_CLUSTERING
 			for ( size_t i=ioSockets.reserved_capacity; processed<retval; ++i)
 			{
 				NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::pedantic, i<=ioSockets.size(), "i={}, processed={}, retval={}, ioSockets.size()={}", i, processed, retval, ioSockets.size());
@@ -241,9 +349,6 @@ size_t now2 = infraGetCurrentTime();
 				if ( revents && (int64_t)(ioSockets.socketsAt(i)) > 0 ) // on Windows WSAPoll() may set revents to a non-zero value despite the socket is invalid
 				{
 #endif
-#ifdef USE_TEMP_PERF_CTRS
-++eventCnt;
-#endif // USE_TEMP_PERF_CTRS
 					++processed;
 					NetSocketEntry& current = ioSockets.at( i );
 					if ( current.isAssociated() )
@@ -264,10 +369,6 @@ size_t now2 = infraGetCurrentTime();
 					}
 				}
 			}
-#ifdef USE_TEMP_PERF_CTRS
-eventProcTime += infraGetCurrentTime() - now2;
-#endif
-
 #ifdef NODECPP_ENABLE_CLUSTERING
 			if ( getCluster().isWorker() )
 				netServer. infraEmitAcceptedSocketEventsReceivedfromMaster();
@@ -286,12 +387,12 @@ eventProcTime += infraGetCurrentTime() - now2;
 	template<class NodeT>
 	void runStandardLoop( NodeT& node )
 	{
-extern thread_local uint64_t eventProcTime;
-#ifdef USE_TEMP_PERF_CTRS
-size_t now2 = infraGetCurrentTime();
-#endif
+		uint64_t iterationStart = infraGetCurrentTime();
+		lastWaitEnd = iterationStart;
+		nodecpp::qsbr::LoopParticipation qsbrParticipation; // see SharedSnapshot
 		while (running)
 		{
+			nodecpp::qsbr::quiescentState(); // nothing obtained from SharedSnapshot during the previous iteration is in use anymore
 
 			EvQueue queue;
 
@@ -300,23 +401,45 @@ size_t now2 = infraGetCurrentTime();
 			queue.emit();
 
 			uint64_t now = infraGetCurrentTime();
-#ifdef USE_TEMP_PERF_CTRS
-			reportTimes( now );
-#endif
+			reportLoopMetricsIfDue( now );
+			netSocket.infraSampleTcpInfoIfDue( now );
+			netSocket.infraCheckMemoryIfDue( now );
+#ifdef NODECPP_ENABLE_CLUSTERING
+			if ( getCluster().isWorker() )
+			{
+				bool reported = loadSampler.reportIfDue( now );
+				if ( getCluster().isRetiring() )
+				{
+					if ( retirementStep( now ) )
+					{
+						nodecpp::log::default_log::info( nodecpp::log::ModuleID(nodecpp::nodecpp_module_id),"retired Worker is leaving its loop" );
+						return;
+					}
+				}
+				else if ( reported )
+					rebalanceStep();
+			}
+			else
+				getCluster().autoscaleIfDue( now );
+			flushInterThreadOverflow();
+			publishThisThreadQueueStatsIfDue( now );
+#endif // NODECPP_ENABLE_CLUSTERING
 			timeout.infraTimeoutEvents(now, queue);
 			queue.emit();
 
-#ifdef USE_TEMP_PERF_CTRS
-eventProcTime += infraGetCurrentTime() - now2;
-#endif
 			now = infraGetCurrentTime();
-			bool refed = pollPhase2( node, refedTimeout(), nextTimeout(), now );
+			uint64_t nextTimeoutAt = nextTimeout();
+#ifdef NODECPP_ENABLE_CLUSTERING
+			if ( getCluster().isWorker() || Cluster::getElasticPoolOptions().enabled ) // load sampling, retirement and autoscaling are periodic
+				nextTimeoutAt = std::min( nextTimeoutAt, now + LoadSampler::periodMks );
+			if ( hasInterThreadOverflow() ) // there is no notification on space freed at target queues; retry soon
+				nextTimeoutAt = std::min( nextTimeoutAt, now + interThreadOverflowRetryMks );
+#endif // NODECPP_ENABLE_CLUSTERING
+			lastWaitMks = 0;
+			bool refed = pollPhase2( node, refedTimeout(), nextTimeoutAt, now );
 			if(!refed)
 				return;
 
-#ifdef USE_TEMP_PERF_CTRS
-now2 = infraGetCurrentTime();
-#endif
 			queue.emit();
 			emitInmediates();
 
@@ -329,6 +452,13 @@ now2 = infraGetCurrentTime();
 			netServer.infraClearStores();
 
 			ioSockets.reworkIfNecessary();
+
+			uint64_t iterationEnd = infraGetCurrentTime();
+			metrics.eventProcessingMks.record( iterationEnd - lastWaitEnd );
+			uint64_t iterationMks = iterationEnd - iterationStart;
+			metrics.loopIterationMks.record( iterationMks > lastWaitMks ? iterationMks - lastWaitMks : 0 );
+			metrics.iterations.add();
+			iterationStart = iterationEnd;
 		}
 	}
 };
@@ -457,6 +587,55 @@ auto a_timeout_impl(uint32_t ms) {
 }
 #endif // NODECPP_NO_COROUTINES
 
+#if (defined NODECPP_ENABLE_CLUSTERING) && !(defined NODECPP_NO_COROUTINES)
+void parkOnInterThreadOverflow( NodeAddress targetThreadId, nodecpp::awaitable_handle_t awaiting );
+
+// does not block the thread: if the target queue is full, the coroutine is suspended until the message is enqueued;
+// throws if the target thread is gone (and the message is dropped)
+inline
+auto a_post(nodecpp::Message&& msg, InterThreadMsgType msgType, NodeAddress targetThreadId) { 
+
+    struct post_awaiter {
+
+        std::experimental::coroutine_handle<> who_is_awaiting = nullptr;
+		nodecpp::Message msg;
+		InterThreadMsgType msgType;
+		NodeAddress targetThreadId;
+		InterThreadPostResult result = InterThreadPostResult::Enqueued;
+
+        post_awaiter(nodecpp::Message&& msg_, InterThreadMsgType msgType_, NodeAddress targetThreadId_) : msg( std::move( msg_ ) ), msgType( msgType_ ), targetThreadId( targetThreadId_ ) {}
+
+        post_awaiter(const post_awaiter &) = delete;
+        post_awaiter &operator = (const post_awaiter &) = delete;
+
+        post_awaiter(post_awaiter &&) = delete;
+        post_awaiter &operator = (post_awaiter &&) = delete;
+
+        ~post_awaiter() {}
+
+        bool await_ready() {
+			// if overflowed, the message is already in the overflow
+            result = tryPostInterThreadMsg( std::move( msg ), msgType, targetThreadId );
+            return result != InterThreadPostResult::Overflowed;
+        }
+
+        void await_suspend(std::experimental::coroutine_handle<> awaiting) {
+			nodecpp::initCoroData(awaiting);
+            who_is_awaiting = awaiting;
+			parkOnInterThreadOverflow( targetThreadId, awaiting );
+        }
+
+		auto await_resume() {
+			if ( result == InterThreadPostResult::Dropped )
+				throw std::exception(); // TODO: switch to our exceptions ASAP!
+			if ( who_is_awaiting != nullptr && nodecpp::isCoroException(who_is_awaiting) )
+				throw nodecpp::getCoroException(who_is_awaiting);
+		}
+    };
+    return post_awaiter(std::move(msg), msgType, targetThreadId);
+}
+#endif // NODECPP_ENABLE_CLUSTERING && !NODECPP_NO_COROUTINES
+
 extern thread_local NodeBase* thisThreadNode;
 template<class Node>
 class Runnable : public RunnableBase
@@ -482,6 +661,10 @@ class Runnable : public RunnableBase
 			inmediateQueue = &infra.getInmediateQueue();
 			netServerManagerBase = reinterpret_cast<NetServerManagerBase*>(&infra.getNetServer());
 			infra.doBasicInitialization();
+#ifndef NODECPP_ENABLE_CLUSTERING
+			nodecpp::metrics::setThisThreadRole( nodecpp::metrics::ThreadRole::Master, 0 );
+			watchLoopForStalls();
+#endif
 #ifdef NODECPP_ENABLE_CLUSTERING
 			if ( isMaster )
 			{
@@ -496,6 +679,8 @@ class Runnable : public RunnableBase
 #endif
 			// from now on all internal structures are ready to use; let's run their "users"
 #ifdef NODECPP_ENABLE_CLUSTERING
+			nodecpp::metrics::setThisThreadRole( isMaster ? nodecpp::metrics::ThreadRole::Master : nodecpp::metrics::ThreadRole::Worker, isMaster ? 0 : startupData->threadCommID.slotId );
+			watchLoopForStalls();
 			nodecpp::postinitThreadClusterObject();
 			if ( isMaster )
 			{
@@ -51,6 +51,17 @@ void SocketBase::unref() { netSocketManagerBase->appUnref(dataForCommandProcessi
 void SocketBase::resume() { netSocketManagerBase->appResume(dataForCommandProcessing.index); }
 void SocketBase::pause() { netSocketManagerBase->appPause(dataForCommandProcessing.index); }
 void SocketBase::reportBeingDestructed() { netSocketManagerBase->appReportBeingDestructed(dataForCommandProcessing.index); }
+#ifdef NODECPP_ENABLE_CLUSTERING
+bool SocketBase::migrate()
+{
+	if ( !getCluster().isWorker() || myServerSocket == nullptr ) // only connections accepted by a worker have a counterpart elsewhere
+		return false;
+	ThreadID target = selectMigrationTargetForThisWorker();
+	if ( target.slotId == ThreadID::InvalidSlotID )
+		return false;
+	return netSocketManagerBase->appMigrate( dataForCommandProcessing, target, myServerSocket->dataForCommandProcessing.localAddress.port );
+}
+#endif // NODECPP_ENABLE_CLUSTERING
 
 void SocketBase::destroy() { OSLayer::appDestroy(dataForCommandProcessing); }
 void SocketBase::end() { OSLayer::appEnd(dataForCommandProcessing); }
@@ -73,6 +84,8 @@ void SocketBase::registerMeAndAssignSocket(OpaqueSocketData& sdata) {
 	registerWithInfraAndAssignSocket(p, sdata);
 }
 
+bool SocketBase::sampleTcpInfo() { return dataForCommandProcessing.isValid() && OSLayer::sampleTcpInfo(dataForCommandProcessing, infraGetCurrentTime()); }
+
 SocketBase& SocketBase::setNoDelay(bool noDelay) { OSLayer::appSetNoDelay(dataForCommandProcessing, noDelay); return *this; }
 SocketBase& SocketBase::setKeepAlive(bool enable) { OSLayer::appSetKeepAlive(dataForCommandProcessing, enable); return *this; }
 
@@ -124,7 +137,10 @@ void ServerBase::close() {
 #ifndef NODECPP_ENABLE_CLUSTERING
 	closingProcedure();
 #else
-	getCluster().acceptRequestForServerCloseAtSlave(dataForCommandProcessing.index);
+	if ( netServerManagerBase->appIsListeningViaMaster(dataForCommandProcessing) )
+		getCluster().acceptRequestForServerCloseAtSlave(dataForCommandProcessing.index);
+	else
+		closingProcedure();
 #endif // NODECPP_ENABLE_CLUSTERING
 }
 
@@ -230,6 +230,28 @@ void postInterThreadMsg(nodecpp::platform::internal_msg::InternalMsg&& msg, Inte
 	postman->postMessage( InterThreadMsg( std::move( msg ), msgType, NodeAddress(thisThreadDescriptor.threadID, 0 /*TODO: we need means to supply nodeID, if applicable*/), targetThreadId ) );
 }
 
+size_t broadcastInterThreadObj(InterThreadObj obj, const NodeAddress* targets, size_t targetCnt )
+{
+	NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, obj.isShared() );
+	size_t reached = 0;
+	for ( size_t i=0; i<targetCnt; ++i )
+	{
+		NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, targets[i].slotId < MAX_THREADS, "{} vs. {}", targets[i].slotId, MAX_THREADS );
+		auto writingMeans = threadQueues[ targets[i].slotId ].getPostmanAndReincarnation();
+		if ( !writingMeans.first || writingMeans.second.second != targets[i].reincarnation || writingMeans.second.first == nullptr )
+			continue;
+		writingMeans.second.first->postMessage( InterThreadMsg( obj.share(), InterThreadMsgType::Broadcast, NodeAddress(thisThreadDescriptor.threadID, 0), targets[i] ) );
+		++reached;
+	}
+	return reached; // our own reference is released here; the payload is freed by the last consumer
+}
+
+static OneShotMsgPool msgPools[MAX_THREADS];
+OneShotMsgPool& thisThreadMsgPool() {
+	size_t slotId = thisThreadDescriptor.threadID.slotId;
+	return msgPools[ slotId < MAX_THREADS ? slotId : 0 ]; // the main thread has no slot here, and slot 0 is never assigned to node threads
+}
+
 void postGmqMsg(nodecpp::platform::internal_msg::InternalMsg&& msg, size_t recipientID, size_t slotId )
 {
 	NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, slotId < MAX_THREADS, "{} vs. {}", slotId, MAX_THREADS );
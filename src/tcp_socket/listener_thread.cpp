@@ -29,6 +29,8 @@
 
 #include "listener_thread_impl.h"
 #include "../clustering_impl/clustering_impl.h"
+#include "../../include/nodecpp/thread_placement.h"
+#include <atomic>
 
 class Listeners
 {
@@ -75,92 +77,317 @@ std::pair<const ListenerThreadDescriptor*, size_t> getListeners() { return liste
 class WorkerLoad
 {
 private:
-	std::mutex mx;
-	size_t usedSlotCnt;
-	struct Worker
+	// all members but 'id' are updated concurrently by listener threads (connections) and by the worker itself (load signals);
+	// each worker has its own cache line to avoid false sharing
+	struct alignas(64) Worker
 	{
-		size_t load = 0;
-		ThreadID id;
+		// slots of retired workers are reused (elastic pool); 'version' is odd while a slot is retired or being (re)published,
+		// and readers of 'id' re-check it (seqlock), so that a reused slot never yields a mix of old and new ids
+		std::atomic<uint64_t> version = 1;
+		std::atomic<size_t> idSlot = ThreadID::InvalidSlotID;
+		std::atomic<uint64_t> idReincarnation = ThreadID::InvalidReincarnation;
+		std::atomic<bool> free = false; // retired and its thread has exited
+		int numaNode = -1; // written while 'version' is odd
+		std::atomic<int64_t> connections = 0;
+		std::atomic<uint32_t> busyPermille = 0;
+		std::atomic<uint32_t> queuedEvents = 0;
+		std::atomic<uint64_t> bytesPerSec = 0;
+		std::atomic<bool> shedding = false; // over its soft memory limit
+
+		bool isActive() const { return ( version.load( std::memory_order_acquire ) & 1 ) == 0; }
+
+		bool readId( ThreadID& id ) const
+		{
+			uint64_t v1 = version.load( std::memory_order_acquire );
+			if ( v1 & 1 )
+				return false;
+			id.slotId = idSlot.load( std::memory_order_relaxed );
+			id.reincarnation = idReincarnation.load( std::memory_order_relaxed );
+			std::atomic_thread_fence( std::memory_order_acquire );
+			return version.load( std::memory_order_relaxed ) == v1;
+		}
+
+		uint64_t score() const
+		{
+			// a saturated loop dominates; connection and event counts break ties among idle workers
+			int64_t conns = connections.load( std::memory_order_relaxed );
+			return (uint64_t)(busyPermille.load( std::memory_order_relaxed )) * 64 + 
+				(uint64_t)( conns > 0 ? conns : 0 ) * 16 + 
+				(uint64_t)(queuedEvents.load( std::memory_order_relaxed )) * 16 + 
+				( bytesPerSec.load( std::memory_order_relaxed ) >> 16 );
+		}
 	};
-	static constexpr size_t workerMax = MAX_THREADS; // to awoid dyn allocation
-	Worker workers[MAX_THREADS];
-	size_t totalLoadCtr = 0;
+	Worker workers[MAX_THREADS]; // to awoid dyn allocation
+	std::atomic<size_t> usedSlotCnt = 0;
+	std::mutex addMx; // adding and retiring workers is rare; selection and accounting are lock-free
+	std::atomic<size_t> rrCounter = 0;
+
+	static uint64_t nextRandom()
+	{
+		static thread_local uint64_t state = 0x9E3779B97F4A7C15ULL ^ (uint64_t)(uintptr_t)(&state);
+		state ^= state << 13;
+		state ^= state >> 7;
+		state ^= state << 17;
+		return state;
+	}
 
-	size_t current = 0;
+	static uint64_t mix( uint64_t x ) // splitmix64 finalizer
+	{
+		x ^= x >> 30; x *= 0xBF58476D1CE4E5B9ULL;
+		x ^= x >> 27; x *= 0x94D049BB133111EBULL;
+		x ^= x >> 31;
+		return x;
+	}
 
-	void _validate()
+	// candidates are indices of active workers; with NUMA-aware placement only workers on the listener's node are considered (if any);
+	// workers shedding load are only considered if all are
+	size_t collectCandidates( size_t cnt, size_t* candidates, bool preferLocal ) const
 	{
-		/*size_t sum = 0;
-		for ( size_t i=0; i<usedSlotCnt; ++i )
-			sum += workers[i].load;
-		NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, totalLoadCtr == sum, "{} vs. {}", totalLoadCtr, sum );*/
+		int node = preferLocal ? nodecpp::placement::thisThreadNumaNode() : -1;
+		size_t n = 0;
+		for ( bool includeShedding : { false, true } )
+		{
+			if ( node >= 0 )
+				for ( size_t i=0; i<cnt; ++i )
+					if ( workers[i].numaNode == node && workers[i].isActive() && ( includeShedding || !workers[i].shedding.load( std::memory_order_relaxed ) ) )
+						candidates[n++] = i;
+			if ( n == 0 )
+				for ( size_t i=0; i<cnt; ++i )
+					if ( workers[i].isActive() && ( includeShedding || !workers[i].shedding.load( std::memory_order_relaxed ) ) )
+						candidates[n++] = i;
+			if ( n != 0 )
+				break;
+		}
+		return n;
+	}
+
+	size_t selectLeastLoaded( const size_t* candidates, size_t cnt ) const
+	{
+		size_t best = candidates[0];
+		uint64_t bestScore = workers[best].score();
+		for ( size_t i=1; i<cnt; ++i )
+		{
+			uint64_t sc = workers[candidates[i]].score();
+			if ( sc < bestScore )
+			{
+				best = candidates[i];
+				bestScore = sc;
+			}
+		}
+		return best;
+	}
+
+	size_t selectPowerOfTwoChoices( const size_t* candidates, size_t cnt ) const
+	{
+		if ( cnt == 1 )
+			return candidates[0];
+		uint64_t rnd = nextRandom();
+		size_t first = candidates[ (size_t)( rnd % cnt ) ];
+		size_t secondIdx = (size_t)( (rnd >> 32) % ( cnt - 1 ) );
+		size_t second = candidates[ secondIdx ] == first ? candidates[ cnt - 1 ] : candidates[ secondIdx ];
+		return workers[second].score() < workers[first].score() ? second : first;
+	}
+
+	size_t selectByIpHash( const size_t* candidates, size_t cnt, uint32_t remoteIp ) const
+	{
+		// rendezvous hashing: adding or removing a worker only remaps connections of that worker
+		size_t best = candidates[0];
+		uint64_t bestWeight = 0;
+		for ( size_t i=0; i<cnt; ++i )
+		{
+			uint64_t weight = mix( ( (uint64_t)remoteIp << 32 ) ^ ( workers[candidates[i]].idSlot.load( std::memory_order_relaxed ) * 0x9E3779B97F4A7C15ULL ) );
+			if ( weight >= bestWeight )
+			{
+				best = candidates[i];
+				bestWeight = weight;
+			}
+		}
+		return best;
+	}
+
+	size_t findIdx( ThreadID id ) const
+	{
+		size_t cnt = usedSlotCnt.load( std::memory_order_acquire );
+		for ( size_t i=0; i<cnt; ++i )
+			if ( !workers[i].free.load( std::memory_order_relaxed ) && 
+				workers[i].idSlot.load( std::memory_order_relaxed ) == id.slotId && 
+				workers[i].idReincarnation.load( std::memory_order_relaxed ) == id.reincarnation )
+				return i;
+		return (size_t)(-1);
 	}
 
 public:
-	size_t addWorker( ThreadID id_ )
+	size_t addWorker( ThreadID id_, int numaNode )
 	{
-		size_t assignedIdx;
-		std::unique_lock<std::mutex> lock(mx);
-		NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, usedSlotCnt < MAX_THREADS, "{} vs. {}", usedSlotCnt, MAX_THREADS );
-		workers[usedSlotCnt].id = id_;
-		assignedIdx = usedSlotCnt;
-		++usedSlotCnt;
-		lock.unlock();
-_validate();
+		std::unique_lock<std::mutex> lock(addMx);
+		size_t cnt = usedSlotCnt.load( std::memory_order_relaxed );
+		size_t assignedIdx = cnt;
+		for ( size_t i=0; i<cnt; ++i )
+			if ( workers[i].free.load( std::memory_order_relaxed ) )
+			{
+				assignedIdx = i;
+				break;
+			}
+		NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, assignedIdx < MAX_THREADS, "{} vs. {}", assignedIdx, MAX_THREADS );
+		Worker& w = workers[assignedIdx];
+		NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, w.version.load( std::memory_order_relaxed ) & 1 );
+		w.idSlot.store( id_.slotId, std::memory_order_relaxed );
+		w.idReincarnation.store( id_.reincarnation, std::memory_order_relaxed );
+		w.numaNode = numaNode;
+		w.connections.store( 0, std::memory_order_relaxed );
+		w.busyPermille.store( 0, std::memory_order_relaxed );
+		w.queuedEvents.store( 0, std::memory_order_relaxed );
+		w.bytesPerSec.store( 0, std::memory_order_relaxed );
+		w.shedding.store( false, std::memory_order_relaxed );
+		w.free.store( false, std::memory_order_relaxed );
+		w.version.fetch_add( 1, std::memory_order_release ); // even: active
+		if ( assignedIdx == cnt )
+			usedSlotCnt.store( assignedIdx + 1, std::memory_order_release );
 		return assignedIdx;
 	}
 
+	bool retireWorker( ThreadID id ) // no new connections will be assigned to it
+	{
+		std::unique_lock<std::mutex> lock(addMx);
+		size_t idx = findIdx( id );
+		if ( idx == (size_t)(-1) || !workers[idx].isActive() )
+			return false;
+		workers[idx].version.fetch_add( 1, std::memory_order_release ); // odd: retired
+		return true;
+	}
+
+	void releaseWorker( size_t idx ) // called by a retired worker right before its thread exits
+	{
+		std::unique_lock<std::mutex> lock(addMx);
+		NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, idx < usedSlotCnt.load( std::memory_order_relaxed ), "{} vs. {}", idx, usedSlotCnt.load( std::memory_order_relaxed ) ); 
+		NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, !workers[idx].isActive() );
+		workers[idx].free.store( true, std::memory_order_relaxed );
+	}
+
+	uint32_t averageBusyPermille( size_t& activeCnt ) const
+	{
+		size_t cnt = usedSlotCnt.load( std::memory_order_acquire );
+		uint64_t total = 0;
+		activeCnt = 0;
+		for ( size_t i=0; i<cnt; ++i )
+			if ( workers[i].isActive() )
+			{
+				total += workers[i].busyPermille.load( std::memory_order_relaxed );
+				++activeCnt;
+			}
+		return activeCnt ? (uint32_t)( total / activeCnt ) : 0;
+	}
+
+	size_t getActiveWorkers( ThreadID* ids, size_t maxCnt ) const
+	{
+		size_t cnt = usedSlotCnt.load( std::memory_order_acquire );
+		size_t n = 0;
+		for ( size_t i=0; i<cnt && n<maxCnt; ++i )
+			if ( workers[i].readId( ids[n] ) )
+				++n;
+		return n;
+	}
+
+	void incrementLoadCtr( size_t idx )
+	{
+		NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, idx < usedSlotCnt.load( std::memory_order_relaxed ), "{} vs. {}", idx, usedSlotCnt.load( std::memory_order_relaxed ) ); 
+		workers[ idx ].connections.fetch_add( 1, std::memory_order_relaxed );
+	}
+
 	void decrementLoadCtr( size_t idx )
 	{
-		std::unique_lock<std::mutex> lock(mx);
-		NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, idx < usedSlotCnt, "{} vs. {}", idx, usedSlotCnt ); 
-_validate();
-		--( workers[ idx ].load );
-		--totalLoadCtr;
-_validate();
+		NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, idx < usedSlotCnt.load( std::memory_order_relaxed ), "{} vs. {}", idx, usedSlotCnt.load( std::memory_order_relaxed ) ); 
+		workers[ idx ].connections.fetch_sub( 1, std::memory_order_relaxed );
+	}
+
+	void reportLoadSignals( size_t idx, uint32_t busyPermille, uint32_t queuedEvents, uint64_t bytesPerSec )
+	{
+		NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, idx < usedSlotCnt.load( std::memory_order_relaxed ), "{} vs. {}", idx, usedSlotCnt.load( std::memory_order_relaxed ) ); 
+		workers[ idx ].busyPermille.store( busyPermille, std::memory_order_relaxed );
+		workers[ idx ].queuedEvents.store( queuedEvents, std::memory_order_relaxed );
+		workers[ idx ].bytesPerSec.store( bytesPerSec, std::memory_order_relaxed );
 	}
 
-	ThreadID getCandidateAndIncrementLoad() // updates 'current'; current is always set to a valid value (if at all possible)
+	void reportShedding( size_t idx, bool shedding )
 	{
-		std::unique_lock<std::mutex> lock(mx);
-//		NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, usedSlotCnt != 0 ); 
-_validate();
-		if ( usedSlotCnt )
+		NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, idx < usedSlotCnt.load( std::memory_order_relaxed ), "{} vs. {}", idx, usedSlotCnt.load( std::memory_order_relaxed ) ); 
+		workers[ idx ].shedding.store( shedding, std::memory_order_relaxed );
+	}
+
+	ThreadID getCandidateAndIncrementLoad( uint32_t remoteIp )
+	{
+		size_t candidates[MAX_THREADS];
+		for (;;) // normally a single pass; repeated only if the selected worker has been retired meanwhile
 		{
-			size_t comparisonBase = (totalLoadCtr << 32) + (totalLoadCtr << 28) / usedSlotCnt + 1;
-			size_t presentCurrent = current;
-			++current;
-			for ( ; current < usedSlotCnt; ++current )
-				if ( (workers[current].load << 32) < comparisonBase )
-				{
-					++( workers[current].load );
-					++totalLoadCtr;
-_validate();
-					return workers[current].id;
-				}
-			for ( current=0; current <= presentCurrent; ++current )
-				if ( (workers[current].load << 32) < comparisonBase )
-				{
-					++( workers[current].load );
-					++totalLoadCtr;
-_validate();
-					return workers[current].id;
-				}
-			NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, false, "failed to find a candidate out of {} used slots", usedSlotCnt ); 
-			return ThreadID();
+			size_t cnt = usedSlotCnt.load( std::memory_order_acquire );
+			auto selection = nodecpp::Cluster::getListeningOptions().workerSelection;
+			bool preferLocal = selection == nodecpp::Cluster::WorkerSelection::LeastLoaded || selection == nodecpp::Cluster::WorkerSelection::PowerOfTwoChoices;
+			size_t n = collectCandidates( cnt, candidates, preferLocal );
+			if ( n == 0 )
+			{
+				NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, false, "failed to find a candidate: no active workers" ); 
+				return ThreadID();
+			}
+			size_t idx;
+			switch ( selection )
+			{
+				case nodecpp::Cluster::WorkerSelection::RoundRobin: idx = candidates[ rrCounter.fetch_add( 1, std::memory_order_relaxed ) % n ]; break;
+				case nodecpp::Cluster::WorkerSelection::LeastLoaded: idx = selectLeastLoaded( candidates, n ); break;
+				case nodecpp::Cluster::WorkerSelection::ConsistentHashByIp: idx = selectByIpHash( candidates, n, remoteIp ); break;
+				default: idx = selectPowerOfTwoChoices( candidates, n ); break;
+			}
+			ThreadID id;
+			if ( !workers[ idx ].readId( id ) )
+				continue;
+			workers[ idx ].connections.fetch_add( 1, std::memory_order_relaxed );
+			return id;
 		}
-		else
-		{
-			NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, false, "failed to find a candidate: no used slots" ); 
+	}
+
+	ThreadID selectMigrationTarget( size_t fromIdx ) const
+	{
+		// hysteresis: migrate only away from a saturated loop and only towards a worker that is clearly less loaded,
+		// so that two similarly loaded workers do not keep bouncing connections;
+		// a retired worker hands everything over to the least loaded active one
+		static constexpr uint32_t overloadedPermille = 750;
+		size_t cnt = usedSlotCnt.load( std::memory_order_acquire );
+		NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, fromIdx < cnt, "{} vs. {}", fromIdx, cnt ); 
+		bool retiring = !workers[ fromIdx ].isActive();
+		if ( cnt < 2 || ( !retiring && workers[ fromIdx ].busyPermille.load( std::memory_order_relaxed ) < overloadedPermille ) )
 			return ThreadID();
+		uint64_t ourScore = workers[ fromIdx ].score();
+		size_t best = fromIdx;
+		uint64_t bestScore = UINT64_MAX;
+		for ( size_t i=0; i<cnt; ++i )
+		{
+			if ( i == fromIdx || !workers[i].isActive() || workers[i].shedding.load( std::memory_order_relaxed ) )
+				continue;
+			uint64_t sc = workers[i].score();
+			if ( sc < bestScore )
+			{
+				best = i;
+				bestScore = sc;
+			}
 		}
+		ThreadID id;
+		if ( best == fromIdx || ( !retiring && bestScore * 4 >= ourScore * 3 ) || !workers[ best ].readId( id ) )
+			return ThreadID();
+		return id;
 	}
 };
 static WorkerLoad workerLoad;
 
-size_t addWorkerEntryForLoadTracking( ThreadID id ) { return workerLoad.addWorker( id ); }
+size_t addWorkerEntryForLoadTracking( ThreadID id, int numaNode ) { return workerLoad.addWorker( id, numaNode ); }
 void decrementWorkerLoadCtr( size_t idx ) { workerLoad.decrementLoadCtr( idx ); }
-ThreadID getLeastLoadedWorkerAndIncrementLoad() { return workerLoad.getCandidateAndIncrementLoad(); }
+void incrementWorkerLoadCtr( size_t idx ) { workerLoad.incrementLoadCtr( idx ); }
+void reportWorkerLoadSignals( size_t idx, uint32_t busyPermille, uint32_t queuedEvents, uint64_t bytesPerSec ) { workerLoad.reportLoadSignals( idx, busyPermille, queuedEvents, bytesPerSec ); }
+void reportWorkerShedding( size_t idx, bool shedding ) { workerLoad.reportShedding( idx, shedding ); }
+bool retireWorkerForLoadTracking( ThreadID id ) { return workerLoad.retireWorker( id ); }
+void releaseWorkerEntryForLoadTracking( size_t idx ) { workerLoad.releaseWorker( idx ); }
+uint32_t averageWorkerBusyPermille( size_t& activeWorkerCnt ) { return workerLoad.averageBusyPermille( activeWorkerCnt ); }
+size_t getActiveWorkers( ThreadID* ids, size_t maxCnt ) { return workerLoad.getActiveWorkers( ids, maxCnt ); }
+ThreadID selectWorkerAndIncrementLoad( uint32_t remoteIpNetwork ) { return workerLoad.getCandidateAndIncrementLoad( remoteIpNetwork ); }
+ThreadID selectMigrationTarget( size_t fromIdx ) { return workerLoad.selectMigrationTarget( fromIdx ); }
 
 thread_local ListenerThreadWorker listenerThreadWorker;
 thread_local NetServerManagerForListenerThread netServerManagerBaseForListenerThread;
@@ -173,12 +400,15 @@ void listenerThreadMain( void* pdata )
 	ThreadStartupData startupData = *sd;
 	nodecpp::stddealloc( sd, 1 );
 	setThisThreadDescriptor( startupData );
+	nodecpp::placement::placeThisThread( nodecpp::placement::Role::Listener );
 #ifdef NODECPP_USE_IIBMALLOC
 	g_AllocManager.initialize();
 #endif
 	nodecpp::logging_impl::currentLog = startupData.defaultLog;
 	nodecpp::logging_impl::instanceId = startupData.threadCommID.slotId;
 	nodecpp::log::default_log::info( nodecpp::log::ModuleID(nodecpp::nodecpp_module_id),"starting Listener thread with threadID = {}", startupData.threadCommID.slotId );
+	nodecpp::metrics::setThisThreadRole( nodecpp::metrics::ThreadRole::Listener, startupData.threadCommID.slotId );
+	watchLoopForStalls();
 	listenerThreadWorker.preinit();
 	netServerManagerBaseForListenerThread.runLoop( startupData.readHandle );
 }
@@ -252,6 +482,13 @@ nodecpp::log::default_log::info( nodecpp::log::ModuleID(nodecpp::nodecpp_module_
 	}
 }
 
+void ListenerThreadWorker::AgentServer::onConnection(uint64_t socket, Ip4& remoteIp, Port& remotePort) { 
+	NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, socket != 0 ); 
+	ThreadID id = selectWorkerAndIncrementLoad( remoteIp.getNetwork() );
+	//nodecpp::log::default_log::info( nodecpp::log::ModuleID(nodecpp::nodecpp_module_id),"listener thread: accepted connection is being sent to thread id {}", id.slotId);
+	listenerThreadWorker.queueConnAcceptedEv( id, entryIndexAtSlave, socket, remoteIp, remotePort );
+}
+
 void ListenerThreadWorker::AgentServer::addServerSocketAndStartListening( SOCKET socket) { 
 	nodecpp::soft_ptr<ListenerThreadWorker::AgentServer> myPtr = myThis.getSoftPtr<ListenerThreadWorker::AgentServer>(this);
 	netServerManagerBaseForListenerThread.appAddAgentServerSocketAndStartListening(myPtr, socket); 
@@ -35,6 +35,8 @@
 #include "../clustering_impl/clustering_impl.h"
 #include "../clustering_impl/interthread_comm.h"
 #include "../../include/nodecpp/timers.h"
+#include "../../include/nodecpp/metrics.h"
+#include "../../include/nodecpp/trace.h"
 
 
 using namespace nodecpp;
@@ -43,18 +45,24 @@ using namespace nodecpp;
 class ListenerThreadWorker
 {
 private:
-	static void sendConnAcceptedEv( ThreadID targetThreadId, size_t internalID, uint64_t socket, Ip4& remoteIp, Port& remotePort )
+	// connections accepted within a single poll event are grouped per target worker and sent as one ConnAccepted message
+	struct PendingConnAccepted
 	{
+		ThreadID targetThreadId;
 		ConnAcceptedEvMsg msg;
-		msg.requestID = 0; // TODO:
-		msg.serverIdx = internalID;
-		msg.socket = socket;
-		msg.ip = remoteIp;
-		msg.uport = remotePort;
+	};
+	nodecpp::stdvector<PendingConnAccepted> pendingConnAccepted;
 
-		nodecpp::platform::internal_msg::InternalMsg imsg;
-		imsg.append( &msg, sizeof(msg) );
-		postInterThreadMsg( std::move( imsg ), InterThreadMsgType::ConnAccepted, targetThreadId );
+	void queueConnAcceptedEv( ThreadID targetThreadId, size_t internalID, uint64_t socket, Ip4& remoteIp, Port& remotePort )
+	{
+		PendingConnAccepted pending;
+		pending.targetThreadId = targetThreadId;
+		pending.msg.requestID = 0; // TODO:
+		pending.msg.serverIdx = internalID;
+		pending.msg.socket = socket;
+		pending.msg.ip = remoteIp;
+		pending.msg.uport = remotePort;
+		pendingConnAccepted.push_back( pending );
 	}
 
 	static void sendServerErrorEv( ThreadID targetThreadId, Error e )
@@ -65,7 +73,7 @@ private:
 
 		nodecpp::platform::internal_msg::InternalMsg imsg;
 		imsg.append( &msg, sizeof(msg) );
-		postInterThreadMsg( std::move( imsg ), InterThreadMsgType::ServerError, targetThreadId );
+		tryPostInterThreadMsg( std::move( imsg ), InterThreadMsgType::ServerError, targetThreadId );
 	}
 
 	static void sendServerCloseNotification( ThreadID targetThreadId, size_t entryIdx, bool hasError )
@@ -77,7 +85,7 @@ private:
 
 		nodecpp::platform::internal_msg::InternalMsg imsg;
 		imsg.append( &msg, sizeof(msg) );
-		postInterThreadMsg( std::move( imsg ), InterThreadMsgType::ServerClosedNotification, targetThreadId );
+		tryPostInterThreadMsg( std::move( imsg ), InterThreadMsgType::ServerClosedNotification, targetThreadId );
 	}
 
 	void reportThreadStarted()
@@ -93,6 +101,34 @@ private:
 	void processInterthreadRequest( ThreadID requestingThreadId, InterThreadMsgType msgType, nodecpp::platform::internal_msg::InternalMsg::ReadIter& riter );
 
 public:
+	static constexpr size_t maxAcceptBatch = 64; // keeps a batched ConnAccepted message well below a page
+
+	void flushConnAcceptedEvs()
+	{
+		for ( size_t i=0; i<pendingConnAccepted.size(); ++i )
+		{
+			ThreadID target = pendingConnAccepted[i].targetThreadId;
+			if ( target.slotId == ThreadID::InvalidSlotID ) // already sent as a part of a previous batch
+				continue;
+			size_t cnt = 0;
+			for ( size_t j=i; j<pendingConnAccepted.size(); ++j )
+				if ( pendingConnAccepted[j].targetThreadId.slotId == target.slotId && pendingConnAccepted[j].targetThreadId.reincarnation == target.reincarnation )
+					++cnt;
+			// passed to the worker as is, without serialization
+			InterThreadObj obj = makeInterThreadArray<ConnAcceptedEvMsg>( cnt );
+			ConnAcceptedEvMsg* msgs = obj.get<ConnAcceptedEvMsg>();
+			cnt = 0;
+			for ( size_t j=i; j<pendingConnAccepted.size(); ++j )
+				if ( pendingConnAccepted[j].targetThreadId.slotId == target.slotId && pendingConnAccepted[j].targetThreadId.reincarnation == target.reincarnation )
+				{
+					msgs[cnt++] = pendingConnAccepted[j].msg;
+					pendingConnAccepted[j].targetThreadId = ThreadID();
+				}
+			tryPostInterThreadMsg( std::move( obj ), InterThreadMsgType::ConnAccepted, target );
+		}
+		pendingConnAccepted.clear();
+	}
+
 	void onInterthreadMessage( InterThreadMsg& msg )
 	{
 		// NOTE: in present quick-and-dirty implementation we assume that the message total size is less than a single page
@@ -140,19 +176,7 @@ public:
 		void onListening() { 
 			nodecpp::log::default_log::info( nodecpp::log::ModuleID(nodecpp::nodecpp_module_id),"clustering Agent server: onListening()!");
 		}
-		void onConnection(uint64_t socket, Ip4& remoteIp, Port& remotePort) { 
-//				nodecpp::log::default_log::info( nodecpp::log::ModuleID(nodecpp::nodecpp_module_id),"clustering Agent server: onConnection()!");
-			NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, socket != 0 ); 
-			/*NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, socketsToSlaves.size() != 0 ); 
-			// TODO: consider alternative ways selection between Slaves
-			nextStep = nextStep % socketsToSlaves.size();
-			sendConnAcceptedEv( socketsToSlaves[nextStep].targetThreadId, socketsToSlaves[nextStep].entryIndex, socket, remoteIp, remotePort ); // TODO-ITC: upgrade
-			++nextStep;*/
-			ThreadID id = getLeastLoadedWorkerAndIncrementLoad();
-			//nodecpp::log::default_log::info( nodecpp::log::ModuleID(nodecpp::nodecpp_module_id),"listener thread: accepted connection is being sent to thread id {}", id.slotId);
-			sendConnAcceptedEv( id, entryIndexAtSlave, socket, remoteIp, remotePort );
-			// TODO: assert is good
-		}
+		void onConnection(uint64_t socket, Ip4& remoteIp, Port& remotePort);
 		void onError( nodecpp::Error& e ) { 
 			nodecpp::log::default_log::info( nodecpp::log::ModuleID(nodecpp::nodecpp_module_id),"clustering Agent server: onError()!");
 			/*for ( auto& slaveData : socketsToSlaves )
@@ -451,6 +475,8 @@ public:
 		int retval = WSAPoll(&(osSide[1]), static_cast<ULONG>(osSide.size() - 1), timeoutToUse);
 #else
 		int retval = poll(&(osSide[1]), static_cast<nfds_t>(osSide.size() - 1), timeoutToUse);
+		if ( retval < 0 && errno == EINTR ) // a signal has been handled by this thread (trace flush, stack sampling, etc); nothing is ready
+			retval = 0;
 #endif
 		return std::make_pair(true, retval);
 	}
@@ -537,13 +563,19 @@ private:
 		else if ((revents & POLLIN) != 0)
 		{
 //!!//			nodecpp::log::default_log::info( nodecpp::log::ModuleID(nodecpp::nodecpp_module_id),"POLLIN event at {}", current.getServerSocketData()->osSocket);
-			OpaqueSocketData osd( false );
-			Ip4 remoteIp;
-			Port remotePort;
-			if ( !getAcceptedSockData(current.getAgentServerData()->osSocket, osd, remoteIp, remotePort) )
-				return;
-			SOCKET osSocket = osd.s.release();
-			current.getAgentServer()->onConnection( osSocket, remoteIp, remotePort );
+			// drain the backlog (up to a limit) so that connections can be handed off to workers in batches
+			nodecpp::trace::Span span( "accept" );
+			for ( size_t i=0; i<ListenerThreadWorker::maxAcceptBatch; ++i )
+			{
+				OpaqueSocketData osd( false );
+				Ip4 remoteIp;
+				Port remotePort;
+				if ( !getAcceptedSockData(current.getAgentServerData()->osSocket, osd, remoteIp, remotePort) )
+					break;
+				SOCKET osSocket = osd.s.release();
+				current.getAgentServer()->onConnection( osSocket, remoteIp, remotePort );
+			}
+			listenerThreadWorker.flushConnAcceptedEvs();
 		}
 		else if (revents != 0)
 		{
@@ -557,14 +589,24 @@ private:
 
 	bool pollPhase2()
 	{
-#ifdef USE_TEMP_PERF_CTRS
-extern thread_local size_t waitTime;
-size_t now1 = infraGetCurrentTime();
-		auto ret = ioSockets.wait( TimeOutNever );
-waitTime += infraGetCurrentTime() - now1;
-#else
-		auto ret = ioSockets.wait( TimeOutNever );
-#endif
+		// there is no notification on space freed at target queues; with a non-empty overflow, retry soon
+		int timeoutToUse = hasInterThreadOverflow() ? (int)(interThreadOverflowRetryMks / 1000) : (int)TimeOutNever;
+		timeoutToUse = capPollTimeoutForReporting( timeoutToUse );
+		nodecpp::metrics::ThreadMetrics& metrics = nodecpp::metrics::thisThread();
+		uint64_t waitStart = infraGetCurrentTime();
+		metrics.activity.busySince.store( 0, std::memory_order_relaxed );
+		std::pair<bool, int> ret;
+		{
+			nodecpp::trace::Span span( "poll wait" );
+			ret = ioSockets.wait( timeoutToUse );
+		}
+		uint64_t waitEnd = infraGetCurrentTime();
+		metrics.activity.busySince.store( waitEnd, std::memory_order_relaxed );
+		nodecpp::metrics::setLoopClock( waitEnd );
+		metrics.pollWaitMks.record( waitEnd - waitStart );
+		metrics.polls.add();
+		if ( ret.second > 0 )
+			metrics.readyEvents.add( ret.second );
 
 		if ( !ret.first )
 		{
@@ -634,6 +676,9 @@ waitTime += infraGetCurrentTime() - now1;
 								InterThreadMsg thq[maxMsgCnt];
 								size_t actualFromQueue = popFrontFromThisThreadQueue( thq, actaulFromSock );
 								NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, actualFromQueue == actaulFromSock, "{} vs. {}", actualFromQueue, actaulFromSock );
+								nodecpp::metrics::thisThread().queueDepth.record( actualFromQueue );
+								nodecpp::metrics::thisThread().interThreadMsgs.add( actualFromQueue );
+								nodecpp::trace::Span span( "inter-thread messages" );
 								for ( size_t i=0; i<actualFromQueue; ++i )
 									listenerThreadWorker.onInterthreadMessage( thq[i] );
 							}
@@ -656,13 +701,15 @@ public:
 		NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical,isNetInitialized());
 		ioSockets.setAwakerSocket( listenerReadHandle );
 		listenerThreadWorker.postinit();
+		nodecpp::metrics::ThreadMetrics& metrics = nodecpp::metrics::thisThread();
 		while (running)
 		{
+			metrics.iterations.add();
 			uint64_t now = infraGetCurrentTime();
-#ifdef USE_TEMP_PERF_CTRS
-			reportTimes( now );
-#endif
+			reportLoopMetricsIfDue( now );
 			ioSockets.makeCompactIfNecessary();
+			flushInterThreadOverflow();
+			publishThisThreadQueueStatsIfDue( now );
 			bool refed = pollPhase2();
 			if(!refed)
 				return;
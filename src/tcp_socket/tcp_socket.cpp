@@ -28,6 +28,7 @@
 #include "tcp_socket.h"
 #include "../../include/nodecpp/common.h"
 #include "../../include/nodecpp/_error.h"
+#include "../../include/nodecpp/metrics.h"
 #ifndef NODECPP_USE_Q_BASED_INFRA
 #include <infrastructure.h>
 #else
@@ -71,6 +72,10 @@ typedef int ssize_t;
 #include <sys/time.h>
 #include <sys/types.h>
 #include <netinet/tcp.h>
+#ifdef __linux__
+#include <linux/filter.h>
+#include <mutex>
+#endif
 
 #define CLOSE_SOCKET( x ) close( x )
 
@@ -126,14 +131,12 @@ bool netInitialize()
 }
 
 
-#ifdef USE_TEMP_PERF_CTRS
-extern thread_local size_t waitTime;
-extern thread_local size_t writeTime;
-#endif // USE_TEMP_PERF_CTRS
 namespace nodecpp
 {
 	namespace internal_usage_only
 	{
+		thread_local uint64_t ioBytesTransferred = 0;
+
 		void internal_close(SOCKET sock)
 		{
 //!!//			nodecpp::log::default_log::info( nodecpp::log::ModuleID(nodecpp::nodecpp_module_id),"internal_close() on sock {}", sock);
@@ -301,6 +304,22 @@ namespace nodecpp
 			return sock;
 		}
 
+		bool internal_set_incoming_cpu(SOCKET sock, int cpu)
+		{
+		#if defined __linux__ && defined SO_INCOMING_CPU
+			int res = setsockopt(sock, SOL_SOCKET, SO_INCOMING_CPU, &cpu, sizeof(cpu));
+			if (0 != res)
+			{
+				int error = getSockError();
+				nodecpp::log::default_log::info( nodecpp::log::ModuleID(nodecpp::nodecpp_module_id),"SO_INCOMING_CPU on sock {} failed; error {}", sock, error);
+				return false;
+			}
+			return true;
+		#else
+			return false;
+		#endif
+		}
+
 		bool internal_bind_socket(SOCKET sock, struct ::sockaddr_in& sa_self)
 		{
 			int res = ::bind(sock, (struct sockaddr *)(&sa_self), sizeof(struct ::sockaddr_in));
@@ -380,6 +399,87 @@ namespace nodecpp
 			return true;
 		}
 
+	#if defined __linux__ && defined SO_ATTACH_REUSEPORT_CBPF
+		// The kernel numbers members of a reuseport group in the order they start listening, and when a member leaves, the last one
+		// takes its place; the program attached to a group returns such a number. Groups with CPU steering are mirrored here in the same order.
+		struct ReuseportGroup
+		{
+			uint32_t ip;
+			uint16_t port;
+			nodecpp::stdvector<std::pair<SOCKET, int>> members; // socket and the CPU its worker is pinned to (-1 if none)
+		};
+		static std::mutex reuseportGroupsMx;
+		static nodecpp::stdvector<ReuseportGroup> reuseportGroups;
+
+		// maps each CPU that has a pinned member to that member; for other CPUs, an out-of-range number makes the kernel fall back to its hash
+		static
+		bool internal_attach_reuseport_cpu_steering(const ReuseportGroup& group)
+		{
+			nodecpp::stdvector<struct sock_filter> code;
+			code.push_back( BPF_STMT( BPF_LD | BPF_W | BPF_ABS, (uint32_t)(SKF_AD_OFF + SKF_AD_CPU) ) );
+			for ( size_t i=0; i<group.members.size(); ++i )
+				if ( group.members[i].second >= 0 )
+				{
+					code.push_back( BPF_JUMP( BPF_JMP | BPF_JEQ | BPF_K, (uint32_t)(group.members[i].second), 0, 1 ) );
+					code.push_back( BPF_STMT( BPF_RET | BPF_K, (uint32_t)i ) );
+				}
+			code.push_back( BPF_STMT( BPF_RET | BPF_K, 0xFFFFFFFF ) );
+			if ( code.size() > BPF_MAXINSNS )
+				return false;
+			struct sock_fprog prog = { (unsigned short)(code.size()), code.data() };
+			SOCKET sock = group.members.back().first; // the program belongs to the group, so any member will do
+			int res = setsockopt(sock, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog));
+			if (0 != res)
+			{
+				int error = getSockError();
+				nodecpp::log::default_log::info( nodecpp::log::ModuleID(nodecpp::nodecpp_module_id),"SO_ATTACH_REUSEPORT_CBPF on sock {} failed; error {}", sock, error);
+				return false;
+			}
+			return true;
+		}
+	#endif
+
+		bool internal_listen_reuseport_cpu_steered(SOCKET sock, Ip4 ip, Port port, int backlog, int cpu)
+		{
+	#if defined __linux__ && defined SO_ATTACH_REUSEPORT_CBPF
+			std::unique_lock<std::mutex> lock(reuseportGroupsMx); // so that members join the group in the same order as they are mirrored
+			if (!internal_listen_tcp_socket(sock, backlog))
+				return false;
+			auto group = std::find_if( reuseportGroups.begin(), reuseportGroups.end(), [&]( const ReuseportGroup& g ) { return g.ip == ip.getNetwork() && g.port == port.getNetwork(); } );
+			if ( group == reuseportGroups.end() )
+			{
+				reuseportGroups.push_back( ReuseportGroup{ ip.getNetwork(), port.getNetwork(), {} } );
+				group = reuseportGroups.end() - 1;
+			}
+			group->members.push_back( std::make_pair( sock, cpu ) );
+			internal_attach_reuseport_cpu_steering( *group ); // best effort; on failure the kernel hash is used
+			return true;
+	#else
+			return internal_listen_tcp_socket(sock, backlog);
+	#endif
+		}
+
+		void internal_leave_reuseport_cpu_steering(SOCKET sock)
+		{
+	#if defined __linux__ && defined SO_ATTACH_REUSEPORT_CBPF
+			std::unique_lock<std::mutex> lock(reuseportGroupsMx);
+			for ( size_t i=0; i<reuseportGroups.size(); ++i )
+			{
+				auto& members = reuseportGroups[i].members;
+				auto member = std::find_if( members.begin(), members.end(), [&]( const std::pair<SOCKET, int>& m ) { return m.first == sock; } );
+				if ( member == members.end() )
+					continue;
+				*member = members.back(); // as the kernel does
+				members.pop_back();
+				if ( members.empty() )
+					reuseportGroups.erase( reuseportGroups.begin() + i );
+				else
+					internal_attach_reuseport_cpu_steering( reuseportGroups[i] );
+				return;
+			}
+	#endif
+		}
+
 		static
 		uint8_t internal_connect_for_address(Ip4 peerIp, Port peerPort, SOCKET sock)
 		{
@@ -405,7 +505,8 @@ namespace nodecpp
 			if (INVALID_SOCKET == outSock)
 			{
 				int error = getSockError();
-				nodecpp::log::default_log::fatal( nodecpp::log::ModuleID(nodecpp::nodecpp_module_id),"accept() on sock {} failed; error {}", sock, error);
+				if (!isErrorWouldBlock(error)) // would-block is expected when the backlog is drained
+					nodecpp::log::default_log::fatal( nodecpp::log::ModuleID(nodecpp::nodecpp_module_id),"accept() on sock {} failed; error {}", sock, error);
 				return INVALID_SOCKET;
 			}
 
@@ -447,13 +548,8 @@ namespace nodecpp
 		uint8_t internal_send_packet(const uint8_t* data, size_t size, SOCKET sock, size_t& sentSize)
 		{
 			const char* ptr = reinterpret_cast<const char*>(data); //windows uses char*, linux void*
-#ifdef USE_TEMP_PERF_CTRS
-size_t now1 = infraGetCurrentTime();
-			ssize_t bytes_sent = sendto(sock, ptr, (int)size, 0, nullptr, 0);
-writeTime += infraGetCurrentTime() - now1;
-#else
 			ssize_t bytes_sent = sendto(sock, ptr, (int)size, 0, nullptr, 0);
-#endif // USE_TEMP_PERF_CTRS
+			nodecpp::metrics::thisThread().sendCalls.add();
 
 			if (bytes_sent < 0)
 			{
@@ -462,6 +558,7 @@ writeTime += infraGetCurrentTime() - now1;
 				if (isErrorWouldBlock(error))
 				{
 //!!//					nodecpp::log::default_log::info( nodecpp::log::ModuleID(nodecpp::nodecpp_module_id),"internal_send_packet() on sock {} size {} PENDING", sock, size);
+					nodecpp::metrics::thisThread().sendWouldBlock.add();
 
 					return COMMLAYER_RET_PENDING;
 				}
@@ -474,6 +571,8 @@ writeTime += infraGetCurrentTime() - now1;
 			else
 			{
 				sentSize = static_cast<size_t>(bytes_sent);
+				ioBytesTransferred += sentSize;
+				nodecpp::metrics::thisThread().bytesOut.add( sentSize );
 				if(sentSize == size)
 				{
 					//nodecpp::log::default_log::info( nodecpp::log::ModuleID(nodecpp::nodecpp_module_id),"internal_send_packet() on sock {} size {} OK", sock, size);
@@ -493,15 +592,37 @@ writeTime += infraGetCurrentTime() - now1;
 		{
 			SOCKET sock;
 			uint8_t ret;
+			size_t calls = 0;
 		public:
 			internal_send_packet_object( SOCKET sock_ ) : sock( sock_ ) {};
 			bool write( const uint8_t* data, size_t size, size_t& sentSize_ ) {
+				++calls;
 				ret =  internal_send_packet( data, size, sock, sentSize_ );
 				return ret == COMMLAYER_RET_OK && size == sentSize_;
 			}
 			uint8_t get_ret_value() const { return ret; }
+			size_t get_calls() const { return calls; }
 		};
 
+		static
+		bool internal_get_tcp_info(SOCKET sock, net::SocketStats::TcpInfo& info)
+		{
+#ifdef __linux__
+			struct tcp_info ti;
+			socklen_t len = sizeof(ti);
+			if ( getsockopt(sock, IPPROTO_TCP, TCP_INFO, &ti, &len) != 0 )
+				return false;
+			info.rttMks = ti.tcpi_rtt;
+			info.rttVarMks = ti.tcpi_rttvar;
+			info.cwnd = ti.tcpi_snd_cwnd;
+			info.unacked = ti.tcpi_unacked;
+			info.retransmits = ti.tcpi_total_retrans;
+			return true;
+#else
+			return false; // TODO: TCP_CONNECTION_INFO on Mac, SIO_TCP_INFO on Windows
+#endif
+		}
+
 		static
 		uint8_t internal_get_packet_bytes2(SOCKET sock, uint8_t* buff, size_t buffSz, size_t& retSz, struct ::sockaddr_in& sa_other, socklen_t& fromlen)
 		{
@@ -527,6 +648,8 @@ writeTime += infraGetCurrentTime() - now1;
 			}
 
 			retSz = static_cast<size_t>(ret);
+			ioBytesTransferred += retSz;
+			nodecpp::metrics::thisThread().bytesIn.add( retSz );
 			//nodecpp::log::default_log::info( nodecpp::log::ModuleID(nodecpp::nodecpp_module_id),"internal_get_packet_bytes2() on sock {} size {} OK", sock, retSz);
 			return COMMLAYER_RET_OK;
 		}
@@ -729,6 +852,8 @@ bool NetSocketManagerBase::appWrite(net::SocketBase::DataForCommandProcessing& s
 	{
 		size_t sentSize = 0;
 		uint8_t res = internal_usage_only::internal_send_packet(data, size, sockData.osSocket, sentSize);
+		++(sockData.stats.writes);
+		sockData.stats.bytesOut += sentSize;
 		if (res == COMMLAYER_RET_FAILED)
 		{
 //			errorCloseSocket(sockData, storeError(Error()));
@@ -744,6 +869,7 @@ bool NetSocketManagerBase::appWrite(net::SocketBase::DataForCommandProcessing& s
 		{
 			NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical,sentSize < size);
 			sockData.writeBuffer.append(data + sentSize, size - sentSize);
+			updateWriteBacklog( sockData );
 			ioSockets.setPollout( sockData.index );
 			return false;
 		}
@@ -751,6 +877,7 @@ bool NetSocketManagerBase::appWrite(net::SocketBase::DataForCommandProcessing& s
 	else
 	{
 		sockData.writeBuffer.append(data, size);
+		updateWriteBacklog( sockData );
 		return false;
 	}
 }
@@ -779,6 +906,8 @@ bool NetSocketManagerBase::appWrite2(net::SocketBase::DataForCommandProcessing&
 	{
 		size_t sentSize = 0;
 		uint8_t res = internal_usage_only::internal_send_packet(buff.begin(), buff.size(), sockData.osSocket, sentSize);
+		++(sockData.stats.writes);
+		sockData.stats.bytesOut += sentSize;
 		if (res == COMMLAYER_RET_FAILED)
 		{
 //			nodecpp::setCoroException(sockData.ahd_write.h, std::exception()); // TODO: switch to our exceptions ASAP!
@@ -795,6 +924,7 @@ bool NetSocketManagerBase::appWrite2(net::SocketBase::DataForCommandProcessing&
 		{
 			NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical,sentSize < buff.size());
 			sockData.writeBuffer.append(buff.begin() + sentSize, buff.size() - sentSize);
+			updateWriteBacklog( sockData );
 			ioSockets.setPollout( sockData.index );
 			return false;
 		}
@@ -804,17 +934,67 @@ bool NetSocketManagerBase::appWrite2(net::SocketBase::DataForCommandProcessing&
 		if ( sockData.writeBuffer.remaining_capacity() >= buff.size() )
 		{
 			sockData.writeBuffer.append(buff.begin(), buff.size());
+			updateWriteBacklog( sockData );
 			return true;
 		}
 		else
 		{
 			NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, sockData.ahd_write.b.size() == 0 );
 			sockData.ahd_write.b = std::move( buff );
+			updateWriteBacklog( sockData );
 			return false;
 		}
 	}
 }
 
+#ifdef NODECPP_ENABLE_CLUSTERING
+bool NetSocketManagerBase::appMigrate(net::SocketBase::DataForCommandProcessing& sockData, ThreadID target, uint16_t serverPort)
+{
+	NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, getCluster().isWorker() );
+	// only an idle established event-mode connection can be moved: nobody may await anything (a pending a_read() would never be resumed here,
+	// as a migrated socket emits neither 'error' nor 'close'; coroutine-driven connections thus stay), and buffered data must fit a single message
+	if ( sockData.state != net::SocketBase::DataForCommandProcessing::Connected || sockData.remoteEnded || sockData.paused )
+		return false;
+	if ( sockData.ahd_read.h != nullptr || sockData.ahd_write.h != nullptr || sockData.ahd_write.b.size() != 0 || sockData.ahd_drain != nullptr )
+		return false;
+	size_t readSize = sockData.readBuffer.used_size();
+	size_t writeSize = sockData.writeBuffer.used_size();
+	if ( readSize + writeSize > maxMigratedBufferedBytes )
+		return false;
+
+	ConnMigratedEvMsg msg;
+	msg.serverPort = serverPort;
+	msg.socket = (uintptr_t)(sockData.osSocket);
+	msg.ip = sockData._remote.ip;
+	msg.uport = Port::fromHost( sockData._remote.port );
+	msg.readSize = readSize;
+	msg.writeSize = writeSize;
+	nodecpp::platform::internal_msg::InternalMsg imsg;
+	imsg.append( &msg, sizeof(msg) );
+	uint8_t bytes[maxMigratedBufferedBytes];
+	if ( readSize )
+	{
+		sockData.readBuffer.peek( bytes, readSize );
+		imsg.append( bytes, readSize );
+	}
+	if ( writeSize )
+	{
+		sockData.writeBuffer.peek( bytes, writeSize );
+		imsg.append( bytes, writeSize );
+	}
+
+	// detach: from now on the OS socket belongs to the target; the local object goes through regular cleanup, but silently
+	ioSockets.setSocketClosed( sockData.index );
+	sockData.osSocket = INVALID_SOCKET;
+	sockData.migrated = true;
+	sockData.state = net::SocketBase::DataForCommandProcessing::Closing;
+	pendingCloseEvents.push_back(std::make_pair( sockData.index, std::make_pair( false, Error())));
+
+	tryPostInterThreadMsg( std::move( imsg ), InterThreadMsgType::ConnMigrated, target );
+	return true;
+}
+#endif // NODECPP_ENABLE_CLUSTERING
+
 bool OSLayer::infraGetPacketBytes(Buffer& buff, SOCKET sock)
 {
 	size_t sz = 0;
@@ -883,6 +1063,8 @@ NetSocketManagerBase::ShouldEmit NetSocketManagerBase::_infraProcessWriteEvent(n
 		//uint8_t res = internal_usage_only::internal_send_packet(sockData.writeBuffer.begin(), sockData.writeBuffer.used_size(), sockData.osSocket, sentSize);
 		internal_usage_only::internal_send_packet_object writer(sockData.osSocket);
 		sockData.writeBuffer.write(writer, sentSize);
+		sockData.stats.writes += writer.get_calls();
+		sockData.stats.bytesOut += sentSize;
 		if ( writer.get_ret_value() == COMMLAYER_RET_FAILED )
 		{
 			//			pendingCloseEvents.push_back(entry.id);
@@ -901,6 +1083,8 @@ NetSocketManagerBase::ShouldEmit NetSocketManagerBase::_infraProcessWriteEvent(n
 			if ( sockData.ahd_write.b.size() )
 			{
 				uint8_t res = internal_usage_only::internal_send_packet(sockData.ahd_write.b.begin(), sockData.ahd_write.b.size(), sockData.osSocket, sentSize);
+				++(sockData.stats.writes);
+				sockData.stats.bytesOut += sentSize;
 				if (res == COMMLAYER_RET_FAILED)
 				{
 					Error e;
@@ -945,6 +1129,7 @@ NetSocketManagerBase::ShouldEmit NetSocketManagerBase::_infraProcessWriteEvent(n
 			NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical,sentSize < sockData.writeBuffer.used_size());
 //			entry.writeEvents = true;
 		}
+		updateWriteBacklog( sockData );
 	}
 	else //ignore?
 		NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical,false, "Not supported yet!");
@@ -952,6 +1137,33 @@ NetSocketManagerBase::ShouldEmit NetSocketManagerBase::_infraProcessWriteEvent(n
 	return ret;
 }
 
+bool OSLayer::sampleTcpInfo(net::SocketBase::DataForCommandProcessing& sockData, uint64_t now)
+{
+	if ( sockData.state != net::SocketBase::DataForCommandProcessing::Connected && sockData.state != net::SocketBase::DataForCommandProcessing::LocalEnding )
+		return false;
+	if ( !internal_usage_only::internal_get_tcp_info(sockData.osSocket, sockData.stats.tcp) )
+		return false;
+	sockData.stats.tcp.sampledAt = now;
+	return true;
+}
+
+void OSLayer::updateWriteBacklog(net::SocketBase::DataForCommandProcessing& sockData)
+{
+	net::SocketStats& stats = sockData.stats;
+	size_t backlog = sockData.writeBuffer.used_size() + sockData.ahd_write.b.size();
+	if ( backlog > stats.maxWriteBacklog )
+		stats.maxWriteBacklog = backlog;
+	if ( backlog != 0 && stats.writeBacklogSince == 0 )
+		stats.writeBacklogSince = infraGetCurrentTime();
+	else if ( backlog == 0 && stats.writeBacklogSince != 0 )
+	{
+		uint64_t backlogMks = infraGetCurrentTime() - stats.writeBacklogSince;
+		stats.writeBacklogMks += backlogMks;
+		stats.writeBacklogSince = 0;
+		nodecpp::metrics::thisThread().writeBacklogMks.record( backlogMks );
+	}
+}
+
 void OSLayer::closeSocket(net::SocketBase::DataForCommandProcessing& sockData)
 {
 	if ( !( sockData.state == net::SocketBase::DataForCommandProcessing::Closing ||
@@ -32,6 +32,9 @@
 #include "tcp_socket_base.h"
 #include "../clustering_impl/clustering_impl.h"
 #include "../clustering_impl/interthread_comm.h"
+#include "../../include/nodecpp/thread_placement.h"
+#include "../../include/nodecpp/metrics.h"
+#include "../../include/nodecpp/trace.h"
 
 #ifdef NODECPP_RECORD_AND_REPLAY
 #include "tcp_socket/tcp_socket_replaying_loop.h"
@@ -296,6 +299,7 @@ public:
 #endif // NODECPP_ENABLE_CLUSTERING
 
 	size_t size() const {return ourSide.size() - 1; }
+	size_t getUsedCount() const { return usedCount; }
 	bool isValidId( size_t idx ) { return idx >= reserved_capacity && idx < ourSide.size() + ourSideAccum.size(); }
 
 	template<class SocketType>
@@ -343,6 +347,39 @@ public:
 
 		return;
 	}
+	template<class F>
+	void forEachClientSocketEntry(F f) {
+		for ( size_t i=reserved_capacity; i<ourSide.size(); ++i )
+			if ( ourSide[i].isUsed() && ourSide[i].getObjectType() == OpaqueEmitter::ObjectType::ClientSocket )
+				f( ourSide[i] );
+		for ( auto& entry : ourSideAccum )
+			if ( entry.isUsed() && entry.getObjectType() == OpaqueEmitter::ObjectType::ClientSocket )
+				f( entry );
+	}
+	template<class F>
+	size_t forEachClientSocketEntryFrom(size_t from, size_t maxCnt, F f) { // up to maxCnt of them, starting at entry 'from'; returns the entry to continue from, or 0 if the end is reached
+		size_t total = ourSide.size() + ourSideAccum.size();
+		size_t i = from < reserved_capacity ? reserved_capacity : from;
+		for ( ; i<total && maxCnt != 0; ++i )
+		{
+			NetSocketEntry& entry = i < ourSide.size() ? ourSide[i] : ourSideAccum[i - ourSide.size()];
+			if ( entry.isUsed() && entry.getObjectType() == OpaqueEmitter::ObjectType::ClientSocket )
+			{
+				f( entry );
+				--maxCnt;
+			}
+		}
+		return i < total ? i : 0;
+	}
+	template<class F>
+	void forEachServerSocketEntry(F f) { // listening sockets polled by this loop
+		for ( size_t i=reserved_capacity; i<ourSide.size(); ++i )
+			if ( ourSide[i].isUsed() && ourSide[i].getObjectType() == OpaqueEmitter::ObjectType::ServerSocket )
+				f( ourSide[i] );
+		for ( auto& entry : ourSideAccum )
+			if ( entry.isUsed() && entry.getObjectType() == OpaqueEmitter::ObjectType::ServerSocket )
+				f( entry );
+	}
 #ifdef NODECPP_ENABLE_CLUSTERING
 	void setAwakerSocket( SOCKET sock )
 	{
@@ -353,6 +390,17 @@ public:
 		++associatedCount;
 		return;
 	}
+	static bool isSlaveServerIndex(size_t idx) { return idx >= SlaveServerEntryMinIndex; }
+	NetSocketEntry* findServerEntryByLocalPort(uint16_t port) { // server indices differ between workers; the port does not
+		for ( auto& entry : slaveServers )
+			if ( entry.isUsed() && entry.getServerSocketData()->localAddress.port == port )
+				return &entry;
+		for ( auto* side : { &ourSide, &ourSideAccum } )
+			for ( auto& entry : *side )
+				if ( entry.isUsed() && entry.getObjectType() == OpaqueEmitter::ObjectType::ServerSocket && entry.getServerSocketData()->localAddress.port == port )
+					return &entry;
+		return nullptr;
+	}
 	NetSocketEntry& slaveServerAt(size_t idx) {
 		NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, idx >= SlaveServerEntryMinIndex ); 
 		NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, idx < SlaveServerEntryMinIndex + slaveServers.size() ); 
@@ -520,6 +568,7 @@ public:
 	}
 	void setSocketClosed( size_t idx ) {
 		NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, idx >= reserved_capacity ); 
+		OpaqueEmitter::ObjectType type;
 		if ( idx < ourSide.size() )
 		{
 			NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, ourSide[idx].isUsed() ); 
@@ -527,6 +576,7 @@ public:
 				--associatedCount;
 			osSide[idx].fd = INVALID_SOCKET; 
 			ourSide[idx].setSocketClosed();
+			type = ourSide[idx].getObjectType();
 		}
 		else
 		{
@@ -538,9 +588,10 @@ public:
 				--associatedCount;
 			osSideAccum[idx].fd = INVALID_SOCKET; 
 			ourSideAccum[idx].setSocketClosed();
+			type = ourSideAccum[idx].getObjectType();
 		}
 #ifdef NODECPP_ENABLE_CLUSTERING
-		if ( cluster.isWorker() )
+		if ( cluster.isWorker() && type == OpaqueEmitter::ObjectType::ClientSocket ) // workers may also own their ReusePortPerWorker listeners
 			decrementThisWorkerLoadCtr();
 #endif // NODECPP_ENABLE_CLUSTERING
 	}
@@ -564,6 +615,8 @@ public:
 		int retval = WSAPoll(&(osSide[1]), static_cast<ULONG>(osSide.size() - 1), timeoutToUse);
 #else
 		int retval = poll(&(osSide[1]), static_cast<nfds_t>(osSide.size() - 1), timeoutToUse);
+		if ( retval < 0 && errno == EINTR ) // a signal has been handled by this thread (trace flush, stack sampling, etc); nothing is ready
+			retval = 0;
 #endif
 		return std::make_pair(true, retval);
 	}
@@ -690,6 +743,30 @@ public:
 	}
 	bool appWrite(net::SocketBase::DataForCommandProcessing& sockData, const uint8_t* data, uint32_t size);
 	bool appWrite2(net::SocketBase::DataForCommandProcessing& sockData, Buffer& b );
+#ifdef NODECPP_ENABLE_CLUSTERING
+	bool appMigrate(net::SocketBase::DataForCommandProcessing& sockData, ThreadID target, uint16_t serverPort);
+	void infraPreloadMigratedData(net::SocketBase::DataForCommandProcessing& sockData, const Buffer& readData, const Buffer& writeData)
+	{
+		if ( readData.size() )
+			sockData.readBuffer.append( readData.begin(), readData.size() );
+		if ( writeData.size() )
+		{
+			sockData.writeBuffer.append( writeData.begin(), writeData.size() );
+			ioSockets.setPollout( sockData.index );
+		}
+	}
+	// called once the new socket is handed to the app: preloaded bytes are delivered the way data arriving now would be,
+	// that is, left for a_read() (pending or read-ahead mode) or emitted to 'data' handlers
+	void infraEmitMigratedData(net::SocketBase& sock)
+	{
+		auto& sockData = sock.dataForCommandProcessing;
+		if ( sockData.state != net::SocketBase::DataForCommandProcessing::Connected || sockData.ahd_read.h != nullptr || sockData.readHighWaterMark != 0 || sockData.readBuffer.used_size() == 0 )
+			return;
+		Buffer b( sockData.readBuffer.used_size() );
+		sockData.readBuffer.get_ready_data( b, sockData.readBuffer.used_size() );
+		sock.rrOnReadHandler( b );
+	}
+#endif // NODECPP_ENABLE_CLUSTERING
 	bool getAcceptedSockData(SOCKET s, OpaqueSocketData& osd, Ip4& remoteIp, Port& remotePort )
 	{
 		SocketRiia newSock(internal_usage_only::internal_tcp_accept(remoteIp, remotePort, s));
@@ -778,10 +855,13 @@ public:
 	void appPause(size_t id) { 
 		auto& entry = appGetEntry(id);
 		entry.getClientSocketData()->paused = true;
+		ioSockets.unsetPollin(id); // otherwise poll() would keep reporting data we are not going to read
 	}
 	void appResume(size_t id) { 
 		auto& entry = appGetEntry(id);
 		entry.getClientSocketData()->paused = false; 
+		if ( !entry.getClientSocketData()->remoteEnded )
+			ioSockets.setPollin(id);
 	}
 	void appReportBeingDestructed(size_t id) { 
 #ifdef NODECPP_RECORD_AND_REPLAY
@@ -804,9 +884,121 @@ extern thread_local NetSocketManagerBase* netSocketManagerBase;
 class NetSocketManager : public NetSocketManagerBase {
 	Buffer recvBuffer;
 	static constexpr size_t recvBufferCapacity = 64 * 1024;
+	static constexpr size_t tcpInfoSweepSlice = 256; // connections sampled per loop iteration, so that large loops do not stall on getsockopt()
+	uint64_t lastTcpInfoSweepAt = 0;
+	size_t tcpInfoSweepCursor = 0; // non-zero while a sweep is in progress
+	struct BacklogTotals { uint64_t sockets = 0; uint64_t bytes = 0; uint64_t largest = 0; };
+	BacklogTotals tcpInfoSweepBacklog;
+	uint64_t lastMemorySweepAt = 0;
+	bool memoryShedding = false;
+
+	void infraSetMemoryShedding( bool shedding, int64_t accounted )
+	{
+		memoryShedding = shedding;
+		nodecpp::metrics::ThreadMetrics& metrics = nodecpp::metrics::thisThread();
+		metrics.memShedding.store( shedding, std::memory_order_relaxed );
+		if ( shedding )
+			metrics.memSheddingEpisodes.add();
+		// connections already accepted are served as usual; new ones wait in the backlog (or go to other workers)
+		ioSockets.forEachServerSocketEntry( [&]( NetSocketEntry& entry ) {
+			if ( shedding )
+				ioSockets.unsetPollin( entry.index );
+			else
+				ioSockets.setPollin( entry.index );
+		} );
+#ifdef NODECPP_ENABLE_CLUSTERING
+		if ( getCluster().isWorker() )
+			reportThisWorkerShedding( shedding );
+#endif // NODECPP_ENABLE_CLUSTERING
+		nodecpp::log::default_log::info( nodecpp::log::ModuleID(nodecpp::nodecpp_module_id),"memory: {} bytes accounted (socket buffers {}, http messages {}, coroutine frames {}, timers {}, user {}) vs. soft limit {}; {}", 
+			accounted, 
+			metrics.memBytes[(size_t)nodecpp::metrics::MemCategory::SocketBuffers].get(), 
+			metrics.memBytes[(size_t)nodecpp::metrics::MemCategory::HttpMessages].get(), 
+			metrics.memBytes[(size_t)nodecpp::metrics::MemCategory::CoroutineFrames].get(), 
+			metrics.memBytes[(size_t)nodecpp::metrics::MemCategory::Timers].get(), 
+			metrics.memBytes[(size_t)nodecpp::metrics::MemCategory::User].get(), 
+			nodecpp::metrics::getOptions().memorySoftLimitBytes, 
+			shedding ? "no longer accepting connections, shrinking idle buffers" : "accepting connections again" );
+	}
 
 public:
-	NetSocketManager(NetSockets& ioSockets) : NetSocketManagerBase(ioSockets), recvBuffer(recvBufferCapacity) {}
+	NetSocketManager(NetSockets& ioSockets) : NetSocketManagerBase(ioSockets), recvBuffer(recvBufferCapacity) { recvBuffer.setMemCategory( nodecpp::metrics::MemCategory::SocketBuffers ); }
+
+	// see nodecpp::metrics::Options::memorySoftLimitBytes and memorySweepPeriodMs
+	void infraCheckMemoryIfDue( uint64_t now )
+	{
+		const nodecpp::metrics::Options& opts = nodecpp::metrics::getOptions();
+		nodecpp::metrics::ThreadMetrics& metrics = nodecpp::metrics::thisThread();
+		bool changed = false;
+		if ( opts.memorySoftLimitBytes != 0 ) // checked at every iteration: it takes a few relaxed loads
+		{
+			int64_t accounted = nodecpp::metrics::accountedMemory( metrics );
+			if ( memoryShedding ? accounted < (int64_t)( opts.memorySoftLimitBytes / 8 * 7 ) : accounted > (int64_t)opts.memorySoftLimitBytes )
+			{
+				infraSetMemoryShedding( !memoryShedding, accounted );
+				changed = true;
+			}
+		}
+		if ( !( changed && memoryShedding ) && ( opts.memorySweepPeriodMs == 0 || now < lastMemorySweepAt + (uint64_t)opts.memorySweepPeriodMs * 1000 ) )
+			return;
+		lastMemorySweepAt = now;
+		uint64_t largest = 0;
+		ioSockets.forEachClientSocketEntry( [&]( NetSocketEntry& entry ) {
+			net::SocketBase::DataForCommandProcessing* sockData = entry.getClientSocketData();
+			if ( sockData == nullptr )
+				return;
+			if ( memoryShedding && sockData->shrinkIdleBuffers() )
+				metrics.memShrunkBuffers.add();
+			uint64_t bytes = sockData->bufferBytes();
+			if ( bytes > largest )
+				largest = bytes;
+		} );
+		metrics.largestSocketBuffers.set( largest );
+	}
+
+	bool infraTcpInfoSweepInProgress() const { return tcpInfoSweepCursor != 0; }
+
+	// see nodecpp::metrics::Options::tcpInfoPeriodMs
+	void infraSampleTcpInfoIfDue( uint64_t now )
+	{
+		uint32_t periodMs = nodecpp::metrics::getOptions().tcpInfoPeriodMs;
+		if ( periodMs == 0 )
+			return;
+		if ( tcpInfoSweepCursor == 0 )
+		{
+			if ( now < lastTcpInfoSweepAt + (uint64_t)periodMs * 1000 )
+				return;
+			lastTcpInfoSweepAt = now;
+			tcpInfoSweepBacklog = BacklogTotals();
+		}
+		nodecpp::metrics::ThreadMetrics& metrics = nodecpp::metrics::thisThread();
+		BacklogTotals& totals = tcpInfoSweepBacklog;
+		tcpInfoSweepCursor = ioSockets.forEachClientSocketEntryFrom( tcpInfoSweepCursor, tcpInfoSweepSlice, [&]( NetSocketEntry& entry ) {
+			net::SocketBase::DataForCommandProcessing* sockData = entry.getClientSocketData();
+			if ( sockData == nullptr )
+				return;
+			uint64_t backlog = sockData->writeBuffer.used_size() + sockData->ahd_write.b.size();
+			if ( backlog != 0 )
+			{
+				++(totals.sockets);
+				totals.bytes += backlog;
+				if ( backlog > totals.largest )
+					totals.largest = backlog;
+			}
+			uint32_t prevRetransmits = sockData->stats.tcp.retransmits;
+			bool sampledBefore = sockData->stats.tcp.sampledAt != 0;
+			if ( OSLayer::sampleTcpInfo( *sockData, now ) )
+			{
+				metrics.tcpRttMks.record( sockData->stats.tcp.rttMks );
+				metrics.tcpRetransmits.add( sockData->stats.tcp.retransmits - ( sampledBefore ? prevRetransmits : 0 ) );
+			}
+		} );
+		if ( tcpInfoSweepCursor != 0 ) // to be continued at the next iteration
+			return;
+		metrics.backloggedSockets.set( totals.sockets );
+		metrics.backloggedBytes.set( totals.bytes );
+		metrics.largestBacklog.set( totals.largest );
+	}
 
 	// to help with 'poll'
 	void infraGetCloseEvent()
@@ -846,27 +1038,25 @@ public:
 						ioSockets.setSocketClosed( entry.index );
 					}
 
-					if (err && entry.isUsed()) //if error closing, then first error event
+#ifdef NODECPP_ENABLE_CLUSTERING
+					bool migrated = entry.getClientSocketData()->migrated; // the connection lives on at another worker
+#else
+					constexpr bool migrated = false;
+#endif // NODECPP_ENABLE_CLUSTERING
+					if (err && entry.isUsed() && !migrated) //if error closing, then first error event
 					{
 						entry.getClientSocket()->emitError(current.second.second);
 						if (entry.getClientSocketData()->isErrorEventHandler())
 							entry.getClientSocketData()->handleErrorEvent(entry.getClientSocket(), current.second.second);
 					}
-					if (entry.isUsed())
+					if (entry.isUsed() && !migrated)
 						entry.getClientSocket()->emitClose(err);
-					if (entry.getClientSocketData()->isCloseEventHandler())
+					if (entry.getClientSocketData()->isCloseEventHandler() && !migrated)
 						entry.getClientSocketData()->handleCloseEvent(entry.getClientSocket(), err);
 					if (entry.isUsed())
 						entry.getClientSocketData()->state = net::SocketBase::DataForCommandProcessing::Closed;
-#ifdef USE_TEMP_PERF_CTRS
-extern thread_local size_t sessionCreationtime;
-extern uint64_t infraGetCurrentTime();
-size_t now = infraGetCurrentTime();
 					entry.getClientSocket()->onFinalCleanup();
-sessionCreationtime += infraGetCurrentTime() - now;
-#else
-					entry.getClientSocket()->onFinalCleanup();
-#endif // USE_TEMP_PERF_CTRS
+					nodecpp::metrics::thisThread().sessionsClosed.add();
 					entry = NetSocketEntry(current.first); 
 				}
 			}
@@ -957,6 +1147,8 @@ private:
 		}
 #endif // NODECPP_RECORD_AND_REPLAY
 		auto hr = entry.getClientSocketData()->ahd_read.h;
+		nodecpp::metrics::HandlerScope handlerScope( nodecpp::metrics::HandlerKind::SocketRead, entry.index, nodecpp::coroutineOrigin( hr ) );
+		nodecpp::trace::Span span( "socket read" );
 		if ( hr )
 		{
 			size_t required_min_sz = entry.getClientSocketData()->ahd_read.min_bytes;
@@ -978,12 +1170,16 @@ private:
 
 				entry.getClientSocketData()->ahd_read.h = nullptr;
 				nodecpp::setCoroException(hr, std::exception()); // TODO: switch to our exceptions ASAP!
-				hr();
+				{
+					nodecpp::trace::Span resumeSpan( "coroutine resume" );
+					hr();
+				}
 			}
 			else
 			{
 				size_t total_received_sz = entry.getClientSocketData()->readBuffer.used_size();
 				size_t added_sz = total_received_sz - current_sz;
+				entry.getClientSocketData()->stats.addRead( added_sz );
 				if ( added_sz > 0 )
 				{
 					if ( total_received_sz >= required_min_sz )
@@ -997,7 +1193,10 @@ private:
 						}
 #endif // NODECPP_RECORD_AND_REPLAY
 						entry.getClientSocketData()->ahd_read.h = nullptr;
-						hr();
+						{
+							nodecpp::trace::Span resumeSpan( "coroutine resume" );
+							hr();
+						}
 					}
 				}
 				else
@@ -1013,7 +1212,10 @@ private:
 						}
 #endif // NODECPP_RECORD_AND_REPLAY
 						entry.getClientSocketData()->ahd_read.h = nullptr;
-						hr();
+						{
+							nodecpp::trace::Span resumeSpan( "coroutine resume" );
+							hr();
+						}
 					}
 					else
 					{
@@ -1027,12 +1229,43 @@ private:
 #endif // NODECPP_RECORD_AND_REPLAY
 						entry.getClientSocketData()->ahd_read.h = nullptr;
 						nodecpp::setCoroException(hr, std::exception()); // TODO: switch to our exceptions ASAP!
-						hr();
+						{
+							nodecpp::trace::Span resumeSpan( "coroutine resume" );
+							hr();
+						}
 					}
 					infraProcessRemoteEnded(entry);
 				}
 			}
 		}
+		else if ( entry.getClientSocketData()->readHighWaterMark != 0 )
+		{
+			// read-ahead mode: data is kept at readBuffer until a consumer calls a_read()
+			auto& sockData = *(entry.getClientSocketData());
+			size_t current_sz = sockData.readBuffer.used_size();
+			if ( current_sz < sockData.readHighWaterMark && sockData.readBuffer.remaining_capacity() != 0 )
+			{
+				bool read_ok = OSLayer::infraGetPacketBytes2(sockData.readBuffer, sockData.osSocket, sockData.readHighWaterMark - current_sz);
+				if ( !read_ok )
+				{
+					internal_usage_only::internal_getsockopt_so_error(sockData.osSocket);
+					Error e;
+					errorCloseSocket(entry, e);
+					return;
+				}
+				sockData.stats.addRead( sockData.readBuffer.used_size() - current_sz );
+				if ( sockData.readBuffer.used_size() == current_sz )
+				{
+					infraProcessRemoteEnded(entry);
+					return;
+				}
+			}
+			if ( sockData.readBuffer.used_size() >= sockData.readHighWaterMark || sockData.readBuffer.remaining_capacity() == 0 )
+			{
+				sockData.paused = true;
+				ioSockets.unsetPollin(entry.index);
+			}
+		}
 		else
 		{
 			recvBuffer.clear();
@@ -1041,6 +1274,7 @@ private:
 			{
 				if (recvBuffer.size() != 0)
 				{
+					entry.getClientSocketData()->stats.addRead( recvBuffer.size() );
 					entry.getClientSocket()->rrOnReadHandler( recvBuffer );
 					NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, recvBuffer.capacity() == recvBufferCapacity );
 				}
@@ -1101,6 +1335,7 @@ private:
 
 	void infraProcessWriteEvent(NetSocketEntry& current)
 	{
+		nodecpp::trace::Span span( "socket write" );
 		NetSocketManagerBase::ShouldEmit status = this->_infraProcessWriteEvent(*current.getClientSocketData());
 		switch ( status )
 		{
@@ -1143,6 +1378,16 @@ protected:
 		Port remotePort;
 	};
 	nodecpp::stdvector<AcceptedSocketData> acceptedSockets;
+	struct MigratedSocketData
+	{
+		uint16_t serverPort;
+		SOCKET socket;
+		Ip4 remoteIp;
+		Port remotePort;
+		Buffer readData;
+		Buffer writeData;
+	};
+	nodecpp::stdvector<MigratedSocketData> migratedSockets;
 	nodecpp::stdvector<size_t> receivedListeningEvs;
 #endif // NODECPP_ENABLE_CLUSTERING
 
@@ -1171,14 +1416,17 @@ public:
 
 		//pendingCloseEvents.emplace_back(entry.index, false); note: it will be finally closed only after all accepted connections are ended
 #else
-		auto& entry = getCluster().isMaster() ? appGetEntry(id) : ioSockets.slaveServerAt(id);
+		bool viaMaster = ioSockets.isSlaveServerIndex(id);
+		auto& entry = viaMaster ? ioSockets.slaveServerAt(id) : appGetEntry(id);
 		if (!entry.isUsed())
 		{
 			nodecpp::log::default_log::info( nodecpp::log::ModuleID(nodecpp::nodecpp_module_id),"Unexpected id {} on NetServerManager::close", id);
 			return;
 		}
-		if ( getCluster().isMaster() )
+		if ( !viaMaster )
 		{
+			if ( Cluster::getListeningOptions().steerByCpu )
+				internal_usage_only::internal_leave_reuseport_cpu_steering(serverData.osSocket);
 			internal_usage_only::internal_close(serverData.osSocket);
 			ioSockets.setSocketClosed( entry.index );
 			//pendingCloseEvents.emplace_back(entry.index, false); note: it will be finally closed only after all accepted connections are ended
@@ -1324,6 +1572,47 @@ public:
 	}
 #endif // NODECPP_ENABLE_CLUSTERING
 
+#ifdef NODECPP_ENABLE_CLUSTERING
+	// ReusePortPerWorker mode: the worker binds its own SO_REUSEPORT listener, moves the server from the slave (master-fed)
+	// entries to the polled ones, and accepts without any hand-off. Returns false if the caller should fall back to the master.
+	template<class DataForCommandProcessing>
+	bool appListenAtWorker(DataForCommandProcessing& dataForCommandProcessing, nodecpp::Ip4 ip, uint16_t port, int backlog) {
+		NODECPP_ASSERT( nodecpp::module_id, nodecpp::assert::AssertLevel::critical, getCluster().isWorker() ); 
+		if ( port == 0 ) // each worker would get its own ephemeral port
+			return false;
+		SocketRiia s(internal_usage_only::internal_make_shared_tcp_socket());
+		if (!s)
+			return false;
+		if (!internal_usage_only::internal_bind_socket(s.get(), ip, Port::fromHost(port)))
+			return false;
+		if ( Cluster::getListeningOptions().steerByCpu )
+		{
+			if (!internal_usage_only::internal_listen_reuseport_cpu_steered(s.get(), ip, Port::fromHost(port), backlog, placement::thisThreadCpu()))
+				return false;
+		}
+		else if (!internal_usage_only::internal_listen_tcp_socket(s.get(), backlog))
+			return false;
+		if ( placement::getOptions().incomingCpu && placement::thisThreadCpu() >= 0 )
+			internal_usage_only::internal_set_incoming_cpu(s.get(), placement::thisThreadCpu()); // prefer this listener for SYNs handled by our CPU
+
+		nodecpp::soft_ptr<net::ServerBase> ptr = ioSockets.slaveServerAt(dataForCommandProcessing.index).getServerSocket();
+		ioSockets.setSlaveServerUnused(dataForCommandProcessing.index);
+		dataForCommandProcessing.osSocket = s.release();
+		addServerEntry(ptr);
+
+		dataForCommandProcessing.rrProcessListen( family, ip, port, backlog );
+		ioSockets.setAssociated(dataForCommandProcessing.index);
+		ioSockets.setPollin(dataForCommandProcessing.index);
+		ioSockets.setRefed(dataForCommandProcessing.index, true);
+		pendingListenEvents.push_back( dataForCommandProcessing.index );
+		return true;
+	}
+	template<class DataForCommandProcessing>
+	bool appIsListeningViaMaster(const DataForCommandProcessing& dataForCommandProcessing) const {
+		return getCluster().isWorker() && ioSockets.isSlaveServerIndex(dataForCommandProcessing.index);
+	}
+#endif // NODECPP_ENABLE_CLUSTERING
+
 	template<class DataForCommandProcessing>
 	void appListen(DataForCommandProcessing& dataForCommandProcessing, nodecpp::Ip4 ip, uint16_t port, int backlog) { //TODO:CLUSTERING alt impl
 #ifdef NODECPP_RECORD_AND_REPLAY
@@ -1343,6 +1632,8 @@ public:
 			dataForCommandProcessing.localAddress.ip = ip;
 			dataForCommandProcessing.localAddress.port = port;
 			dataForCommandProcessing.localAddress.family = family;
+			if ( Cluster::getListeningOptions().mode == Cluster::ListeningMode::ReusePortPerWorker && appListenAtWorker( dataForCommandProcessing, ip, port, backlog ) )
+				return;
 			getCluster().acceptRequestForListeningAtSlave( dataForCommandProcessing.index, ip, port, family, backlog );
 			return;
 		}
@@ -1396,10 +1687,10 @@ public:
 #ifndef NODECPP_ENABLE_CLUSTERING
 		ioSockets.setUnused(id); 
 #else
-		if ( getCluster().isMaster() )
-			ioSockets.setUnused(id); 
-		else
+		if ( ioSockets.isSlaveServerIndex(id) )
 			ioSockets.setSlaveServerUnused(id); 
+		else
+			ioSockets.setUnused(id); 
 #endif
 	}
 
@@ -1422,6 +1713,19 @@ public:
 		NODECPP_ASSERT( nodecpp::module_id, nodecpp::assert::AssertLevel::critical, getCluster().isWorker() ); 
 		acceptedSockets.push_back(AcceptedSocketData({serverIdx, socket, remoteIp, remotePort})); 
 	}
+	void addMigratedSocket( const ConnMigratedEvMsg& msg, const uint8_t* bufferedData ) {	
+		NODECPP_ASSERT( nodecpp::module_id, nodecpp::assert::AssertLevel::critical, getCluster().isWorker() ); 
+		MigratedSocketData data;
+		data.serverPort = msg.serverPort;
+		data.socket = (SOCKET)(msg.socket);
+		data.remoteIp = msg.ip;
+		data.remotePort = msg.uport;
+		if ( msg.readSize )
+			data.readData.append( bufferedData, msg.readSize );
+		if ( msg.writeSize )
+			data.writeData.append( bufferedData + msg.readSize, msg.writeSize );
+		migratedSockets.push_back( std::move( data ) );
+	}
 	void addListeningServerEv( size_t serverIdx ) { 
 		NODECPP_ASSERT( nodecpp::module_id, nodecpp::assert::AssertLevel::critical, getCluster().isWorker() ); 
 		receivedListeningEvs.push_back(serverIdx);
@@ -1551,6 +1855,13 @@ public:
 	void infraEmitAcceptedSocketEventsReceivedfromMaster()
 	{
 		NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::pedantic, getCluster().isWorker() );
+		for ( auto idx : receivedListeningEvs )
+		{
+			auto& entry = ioSockets.slaveServerAt( idx );
+			if ( entry.isUsed() ) // might have been closed meanwhile
+				entry.getServerSocket()->rrOnListening( idx );
+		}
+		receivedListeningEvs.clear();
 		for ( auto& info : acceptedSockets )
 		{
 			auto& entry = ioSockets.slaveServerAt( info.idx );
@@ -1558,12 +1869,27 @@ public:
 			consumeAcceptedSocket(entry, osd, info.remoteIp, info.remotePort);
 		}
 		acceptedSockets.clear();
+		for ( auto& info : migratedSockets )
+		{
+			NetSocketEntry* entry = ioSockets.findServerEntryByLocalPort( info.serverPort );
+			if ( entry == nullptr ) // not (or no longer) listening here
+			{
+				nodecpp::log::default_log::info( nodecpp::log::ModuleID(nodecpp::nodecpp_module_id),"no server at port {} for a migrated connection; closing it", info.serverPort );
+				internal_usage_only::internal_close( info.socket );
+				continue;
+			}
+			incrementThisWorkerLoadCtr();
+			OpaqueSocketData osd = NetSocketManagerBase::createOpaqueSocketData( info.socket );
+			consumeAcceptedSocket(*entry, osd, info.remoteIp, info.remotePort, &info);
+		}
+		migratedSockets.clear();
 	}
 #endif // NODECPP_ENABLE_CLUSTERING
 
 private:
 	void infraProcessAcceptEvent(NetSocketEntry& entry) //TODO:CLUSTERING alt impl
 	{
+		nodecpp::trace::Span span( "accept" );
 		OpaqueSocketData osd( false );
 
 		Ip4 remoteIp;
@@ -1586,6 +1912,8 @@ private:
 		{
 			if ( !netSocketManagerBase->getAcceptedSockData(entry.getServerSocketData()->osSocket, osd, remoteIp, remotePort) )
 				return;
+			if ( getCluster().isWorker() ) // accepted by the worker's own listener
+				incrementThisWorkerLoadCtr();
 			consumeAcceptedSocket(entry, osd, remoteIp, remotePort);
 		}
 #else
@@ -1596,7 +1924,11 @@ private:
 	}
 
 
+#ifdef NODECPP_ENABLE_CLUSTERING
+	void consumeAcceptedSocket(NetSocketEntry& entry, OpaqueSocketData& osd, Ip4 remoteIp, Port remotePort, const MigratedSocketData* migrated = nullptr)
+#else
 	void consumeAcceptedSocket(NetSocketEntry& entry, OpaqueSocketData& osd, Ip4 remoteIp, Port remotePort)
+#endif // NODECPP_ENABLE_CLUSTERING
 	{
 #ifdef NODECPP_RECORD_AND_REPLAY
 		if ( ::nodecpp::threadLocalData.binaryLog != nullptr && threadLocalData.binaryLog->mode() == record_and_replay_impl::BinaryLog::Mode::replaying )
@@ -1606,15 +1938,6 @@ private:
 		}
 #endif // NODECPP_RECORD_AND_REPLAY
 //		soft_ptr<net::SocketBase> ptr = entry.getServerSocket()->makeSocket( osd );
-#ifdef USE_TEMP_PERF_CTRS
-extern thread_local int sessionCnt;
-extern thread_local size_t sessionCreationtime;
-extern uint64_t infraGetCurrentTime();
-++sessionCnt;
-size_t now = infraGetCurrentTime();
-		auto ptr = entry.getServerSocket()->makeSocket(osd);
-sessionCreationtime += infraGetCurrentTime() - now;
-#else
 #ifdef NODECPP_RECORD_AND_REPLAY
 		if ( ::nodecpp::threadLocalData.binaryLog != nullptr && threadLocalData.binaryLog->mode() == record_and_replay_impl::BinaryLog::Mode::recording )
 		{
@@ -1636,11 +1959,15 @@ sessionCreationtime += infraGetCurrentTime() - now;
 			::nodecpp::threadLocalData.binaryLog->addFrame( record_and_replay_impl::BinaryLog::FrameType::server_make_socket_output, &edata, sizeof( edata ) );
 		}
 #endif // NODECPP_RECORD_AND_REPLAY
-#endif // USE_TEMP_PERF_CTRS
+		nodecpp::metrics::thisThread().sessionsCreated.add();
 		NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical, netSocketManagerBase != nullptr );
 		netSocketManagerBase->infraAddAccepted(ptr);
 		ptr->dataForCommandProcessing._remote.ip = remoteIp;
 		ptr->dataForCommandProcessing._remote.port = remotePort.getHost();
+#ifdef NODECPP_ENABLE_CLUSTERING
+		if ( migrated != nullptr )
+			netSocketManagerBase->infraPreloadMigratedData( ptr->dataForCommandProcessing, migrated->readData, migrated->writeData );
+#endif // NODECPP_ENABLE_CLUSTERING
 
 		auto hr = entry.getServerSocketData()->ahd_connection.h;
 		if ( hr )
@@ -1656,7 +1983,10 @@ sessionCreationtime += infraGetCurrentTime() - now;
 #endif // NODECPP_RECORD_AND_REPLAY
 			entry.getServerSocketData()->ahd_connection.sock = ptr;
 			entry.getServerSocketData()->ahd_connection.h = nullptr;
-			hr();
+			{
+				nodecpp::trace::Span resumeSpan( "coroutine resume" );
+				hr();
+			}
 		}
 		else
 		{
@@ -1674,6 +2004,10 @@ sessionCreationtime += infraGetCurrentTime() - now;
 				entry.getServerSocketData()->handleConnectionEvent(entry.getServerSocket(), ptr);
 			// TODO: what should we do with this event, if, at present, nobody is willing to process it?
 		}
+#ifdef NODECPP_ENABLE_CLUSTERING
+		if ( migrated != nullptr )
+			netSocketManagerBase->infraEmitMigratedData( *ptr );
+#endif // NODECPP_ENABLE_CLUSTERING
 
 		return;
 	}
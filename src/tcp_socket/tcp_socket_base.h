@@ -40,6 +40,7 @@
 #include <winsock2.h>
 using socklen_t = int;
 #else
+#include <errno.h>
 #include <sys/poll.h> // for pollfd
 using SOCKET = int;
 const SOCKET INVALID_SOCKET = -1;
@@ -166,12 +167,17 @@ namespace nodecpp
 {
 	namespace internal_usage_only
 	{
+		extern thread_local uint64_t ioBytesTransferred; // total sent + received by this thread's sockets
+
 		SOCKET internal_make_tcp_socket();
 		SOCKET internal_make_shared_tcp_socket();
+		bool internal_set_incoming_cpu(SOCKET sock, int cpu);
 		bool internal_bind_socket(SOCKET sock, struct sockaddr_in& sa_self);
 		bool internal_bind_socket(SOCKET sock, Ip4 ip, Port port);
 		uint16_t internal_port_of_tcp_socket(SOCKET sock);
 		bool internal_listen_tcp_socket(SOCKET sock, int backlog);
+		bool internal_listen_reuseport_cpu_steered(SOCKET sock, Ip4 ip, Port port, int backlog, int cpu); // SYNs received by cpu go to sock (Linux only; elsewhere just listens)
+		void internal_leave_reuseport_cpu_steering(SOCKET sock); // before sock is closed
 		bool internal_getsockopt_so_error(SOCKET sock);
 		void internal_shutdown_send(SOCKET sock);
 		bool internal_linger_zero_socket(SOCKET sock);
@@ -227,6 +233,8 @@ public:
 
 	static void closeSocket(net::SocketBase::DataForCommandProcessing& sockData);//app-infra neutral
 	static void errorCloseSocket(net::SocketBase::DataForCommandProcessing& sockData, Error& err);//app-infra neutral
+	static bool sampleTcpInfo(net::SocketBase::DataForCommandProcessing& sockData, uint64_t now);//app-infra neutral
+	static void updateWriteBacklog(net::SocketBase::DataForCommandProcessing& sockData);//app-infra neutral; to be called whenever data waiting to be sent is added or gone
 };
 
 
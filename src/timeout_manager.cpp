@@ -30,6 +30,8 @@
 //#include <nodecpp/nls.h>
 #include "../include/nodecpp/nls.h"
 #include "../include/nodecpp/net_common.h"
+#include "../include/nodecpp/metrics.h"
+#include "../include/nodecpp/trace.h"
 
 #include <time.h>
 #include <climits>
@@ -135,9 +137,12 @@ void TimeoutManager::infraTimeoutEvents(uint64_t now, EvQueue& evs)
 	auto itEnd = nextTimeouts.upper_bound(now);
 	auto it = itBegin;
 	nodecpp::vector<TimeoutEntryHandlerData> handlers; // TODO: this approach could potentially be generalized
+	auto& metrics = nodecpp::metrics::thisThread();
 	while (it != itEnd)
 	{
 		auto it2 = timers.find(it->second);
+		metrics.timerLatenessMks.record( now - it->first );
+		metrics.timersFired.add();
 
 		NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical,it2 != timers.end());
 		NODECPP_ASSERT( nodecpp::module_id, ::nodecpp::assert::AssertLevel::critical,it2->second.active);
@@ -157,6 +162,8 @@ void TimeoutManager::infraTimeoutEvents(uint64_t now, EvQueue& evs)
 
 	for ( auto h : handlers )
 	{
+		nodecpp::metrics::HandlerScope handlerScope( nodecpp::metrics::HandlerKind::Timer, 0, nodecpp::coroutineOrigin( h.h ) );
+		nodecpp::trace::Span span( "timer" );
 		if ( h.cb != nullptr )
 			h.cb();
 		else if ( h.h != nullptr )
@@ -164,6 +171,7 @@ void TimeoutManager::infraTimeoutEvents(uint64_t now, EvQueue& evs)
 			auto hr = h.h;
 			nodecpp::setCoroStatus( hr, nodecpp::CoroStandardOutcomes::timeout );
 			h.h = nullptr;
+			nodecpp::trace::Span resumeSpan( "coroutine resume" );
 			hr();
 		}
 	}
@@ -34,6 +34,7 @@
 #include "ev_queue.h"
 
 #include "../include/nodecpp/timers.h"
+#include "../include/nodecpp/metrics.h"
 #include <functional>
 
 
@@ -68,9 +69,12 @@ struct TimeoutEntry : public TimeoutEntryHandlerData
 
 class TimeoutManager
 {
+	template<class T>
+	using TimersAllocator = nodecpp::metrics::AccountingAllocator<T, nodecpp::metrics::MemCategory::Timers>;
+
 	uint64_t lastId = 0;
-	std::unordered_map<uint64_t, TimeoutEntry> timers;
-	std::multimap<uint64_t, uint64_t> nextTimeouts;
+	std::unordered_map<uint64_t, TimeoutEntry, std::hash<uint64_t>, std::equal_to<uint64_t>, TimersAllocator<std::pair<const uint64_t, TimeoutEntry>>> timers;
+	std::multimap<uint64_t, uint64_t, std::less<uint64_t>, TimersAllocator<std::pair<const uint64_t, uint64_t>>> nextTimeouts;
 	template<class H>
 	nodecpp::Timeout appSetTimeoutImpl(H h, int32_t ms, uint64_t now)
 	{
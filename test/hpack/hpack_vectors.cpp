@@ -0,0 +1,311 @@
+/* -------------------------------------------------------------------------------
+* Copyright (c) 2021, OLogN Technologies AG
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*     * Neither the name of the OLogN Technologies AG nor the
+*       names of its contributors may be used to endorse or promote products
+*       derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL OLogN Technologies AG BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+* -------------------------------------------------------------------------------*/
+
+// Examples of RFC 7541, Appendix C, run against include/nodecpp/hpack.h:
+// integer representation (C.1), literal and indexed fields (C.2), header blocks sharing a dynamic table
+// without and with Huffman coding (C.3, C.4), and responses that make a 256-octet table evict (C.5, C.6).
+// Prints failed checks to stderr; exit code is the number of failed checks.
+
+#include <nodecpp/common.h>
+#include <nodecpp/hpack.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+nodecpp::stdvector<nodecpp::stdstring> argv; // normally defined next to main() at infra_main.cpp
+
+using namespace nodecpp::net;
+
+namespace {
+
+	size_t checks = 0;
+	size_t failures = 0;
+
+	void check( bool ok, const char* what, const char* vector )
+	{
+		++checks;
+		if ( !ok )
+		{
+			++failures;
+			fprintf( stderr, "FAILED: %s: %s\n", vector, what );
+		}
+	}
+
+	std::vector<uint8_t> fromHex( const char* hex )
+	{
+		std::vector<uint8_t> ret;
+		for ( ; hex[0] && hex[1]; hex += 2 )
+		{
+			unsigned b;
+			sscanf( hex, "%2x", &b );
+			ret.push_back( (uint8_t)b );
+		}
+		return ret;
+	}
+
+	bool same( const nodecpp::string& s, const char* expected )
+	{
+		return s.size() == strlen( expected ) && memcmp( s.c_str(), expected, s.size() ) == 0;
+	}
+
+	bool same( const nodecpp::Buffer& b, const char* expectedHex )
+	{
+		auto expected = fromHex( expectedHex );
+		return b.size() == expected.size() && memcmp( b.begin(), expected.data(), b.size() ) == 0;
+	}
+
+	struct Field
+	{
+		const char* name;
+		const char* value;
+	};
+
+	const char* date21 = "Mon, 21 Oct 2013 20:13:21 GMT";
+	const char* date22 = "Mon, 21 Oct 2013 20:13:22 GMT";
+	const char* location = "https://www.example.com";
+	const char* cookie = "foo=ASDJKHQKBZXOQWEOPIUAXQWEOIU; max-age=3600; version=1";
+
+	// decodes one header block and checks both the decoded list and the dynamic table (newest entry first) afterwards
+	void checkBlock( hpack::Decoder& decoder, const char* vector, const char* hex, std::vector<Field> expected, std::vector<Field> table, size_t tableOctets )
+	{
+		auto data = fromHex( hex );
+		std::vector<std::pair<nodecpp::string, nodecpp::string>> decoded;
+		bool ok = decoder.decode( data.data(), data.size(), [&]( const nodecpp::string& name, const nodecpp::string& value ) { decoded.push_back( std::make_pair( name, value ) ); } );
+		check( ok, "block is decoded", vector );
+		check( decoded.size() == expected.size(), "number of header fields", vector );
+		for ( size_t i=0; i<decoded.size() && i<expected.size(); ++i )
+			check( same( decoded[i].first, expected[i].name ) && same( decoded[i].second, expected[i].value ), "header field", vector );
+
+		const hpack::DynamicTable& t = decoder.getTable();
+		check( t.size() == table.size(), "number of dynamic table entries", vector );
+		check( t.getOctets() == tableOctets, "dynamic table size", vector );
+		for ( size_t i=0; i<t.size() && i<table.size(); ++i )
+		{
+			auto e = t.get( i );
+			check( e != nullptr && same( e->name, table[i].name ) && same( e->value, table[i].value ), "dynamic table entry", vector );
+		}
+	}
+
+	void testIntegers()
+	{
+		struct { size_t value; uint8_t prefixBits; const char* hex; const char* vector; } cases[] = {
+			{ 10, 5, "0a", "C.1.1" },
+			{ 1337, 5, "1f9a0a", "C.1.2" },
+			{ 42, 8, "2a", "C.1.3" },
+		};
+		for ( auto& c : cases )
+		{
+			nodecpp::Buffer b;
+			hpack::encodeInteger( b, 0, c.prefixBits, c.value );
+			check( same( b, c.hex ), "encoded integer", c.vector );
+
+			auto data = fromHex( c.hex );
+			const uint8_t* p = data.data();
+			size_t value = 0;
+			check( hpack::decodeInteger( p, data.data() + data.size(), c.prefixBits, value ) && value == c.value && p == data.data() + data.size(), "decoded integer", c.vector );
+		}
+
+		// bits above the prefix belong to the representation and must not leak into the value
+		auto data = fromHex( "ff9a0a" );
+		const uint8_t* p = data.data();
+		size_t value = 0;
+		check( hpack::decodeInteger( p, data.data() + data.size(), 5, value ) && value == 1337, "flags above prefix are ignored", "C.1.2" );
+
+		data = fromHex( "1f9a" );
+		p = data.data();
+		check( !hpack::decodeInteger( p, data.data() + data.size(), 5, value ), "truncated integer is rejected", "C.1.2" );
+	}
+
+	void testHuffman()
+	{
+		struct { const char* str; const char* hex; } cases[] = {
+			{ "www.example.com", "f1e3c2e5f23a6ba0ab90f4ff" },
+			{ "no-cache", "a8eb10649cbf" },
+			{ "custom-key", "25a849e95ba97d7f" },
+			{ "custom-value", "25a849e95bb8e8b4bf" },
+			{ "302", "6402" },
+			{ "307", "640eff" },
+			{ "private", "aec3771a4b" },
+			{ date21, "d07abe941054d444a8200595040b8166e082a62d1bff" },
+			{ date22, "d07abe941054d444a8200595040b8166e084a62d1bff" },
+			{ location, "9d29ad171863c78f0b97c8e9ae82ae43d3" },
+			{ "gzip", "9bd9ab" },
+			{ cookie, "94e7821dd7f2e6c7b335dfdfcd5b3960d5af27087f3672c1ab270fb5291f9587316065c003ed4ee5b1063d5007" },
+		};
+		for ( auto& c : cases )
+		{
+			nodecpp::Buffer b;
+			hpack::huffmanEncode( (const uint8_t*)(c.str), strlen( c.str ), b );
+			check( same( b, c.hex ), "Huffman encoding", c.str );
+			check( hpack::huffmanEncodedSize( (const uint8_t*)(c.str), strlen( c.str ) ) == b.size(), "Huffman encoded size", c.str );
+
+			auto data = fromHex( c.hex );
+			nodecpp::string decoded;
+			check( hpack::huffmanDecode( data.data(), data.size(), decoded ) && same( decoded, c.str ), "Huffman decoding", c.str );
+		}
+
+		// padding longer than 7 bits, padding that is not a prefix of EOS, and EOS itself are decoding errors (RFC 7541, 5.2)
+		const char* invalid[] = { "f1e3c2e5f23a6ba0ab90f4ffff", "f1e3c2e5f23a6ba0ab90f4fe", "ffffffff" };
+		for ( auto hex : invalid )
+		{
+			auto data = fromHex( hex );
+			nodecpp::string decoded;
+			check( !hpack::huffmanDecode( data.data(), data.size(), decoded ), "invalid Huffman string is rejected", hex );
+		}
+	}
+
+	void testFieldRepresentations()
+	{
+		{
+			hpack::Decoder decoder;
+			checkBlock( decoder, "C.2.1", "400a637573746f6d2d6b65790d637573746f6d2d686561646572",
+				{ { "custom-key", "custom-header" } },
+				{ { "custom-key", "custom-header" } }, 55 );
+		}
+		{
+			hpack::Decoder decoder;
+			checkBlock( decoder, "C.2.2", "040c2f73616d706c652f70617468", { { ":path", "/sample/path" } }, {}, 0 );
+		}
+		{
+			hpack::Decoder decoder;
+			checkBlock( decoder, "C.2.3", "100870617373776f726406736563726574", { { "password", "secret" } }, {}, 0 );
+		}
+		{
+			hpack::Decoder decoder;
+			checkBlock( decoder, "C.2.4", "82", { { ":method", "GET" } }, {}, 0 );
+		}
+	}
+
+	void testRequests( bool huffman )
+	{
+		const char* blocks[2][3] = {
+			{
+				"828684410f7777772e6578616d706c652e636f6d",
+				"828684be58086e6f2d6361636865",
+				"828785bf400a637573746f6d2d6b65790c637573746f6d2d76616c7565",
+			},
+			{
+				"828684418cf1e3c2e5f23a6ba0ab90f4ff",
+				"828684be5886a8eb10649cbf",
+				"828785bf408825a849e95ba97d7f8925a849e95bb8e8b4bf",
+			},
+		};
+		const char* names[2][3] = { { "C.3.1", "C.3.2", "C.3.3" }, { "C.4.1", "C.4.2", "C.4.3" } };
+		int k = huffman ? 1 : 0;
+
+		hpack::Decoder decoder;
+		checkBlock( decoder, names[k][0], blocks[k][0],
+			{ { ":method", "GET" }, { ":scheme", "http" }, { ":path", "/" }, { ":authority", "www.example.com" } },
+			{ { ":authority", "www.example.com" } }, 57 );
+		checkBlock( decoder, names[k][1], blocks[k][1],
+			{ { ":method", "GET" }, { ":scheme", "http" }, { ":path", "/" }, { ":authority", "www.example.com" }, { "cache-control", "no-cache" } },
+			{ { "cache-control", "no-cache" }, { ":authority", "www.example.com" } }, 110 );
+		checkBlock( decoder, names[k][2], blocks[k][2],
+			{ { ":method", "GET" }, { ":scheme", "https" }, { ":path", "/index.html" }, { ":authority", "www.example.com" }, { "custom-key", "custom-value" } },
+			{ { "custom-key", "custom-value" }, { "cache-control", "no-cache" }, { ":authority", "www.example.com" } }, 164 );
+	}
+
+	void testResponses( bool huffman )
+	{
+		const char* blocks[2][3] = {
+			{
+				"4803333032580770726976617465611d4d6f6e2c203231204f637420323031332032303a31333a323120474d546e1768747470733a2f2f7777772e6578616d706c652e636f6d",
+				"4803333037c1c0bf",
+				"88c1611d4d6f6e2c203231204f637420323031332032303a31333a323220474d54c05a04677a69707738666f6f3d4153444a4b48514b425a584f5157454f50495541585157454f49553b206d61782d6167653d333630303b2076657273696f6e3d31",
+			},
+			{
+				"488264025885aec3771a4b6196d07abe941054d444a8200595040b8166e082a62d1bff6e919d29ad171863c78f0b97c8e9ae82ae43d3",
+				"4883640effc1c0bf",
+				"88c16196d07abe941054d444a8200595040b8166e084a62d1bffc05a839bd9ab77ad94e7821dd7f2e6c7b335dfdfcd5b3960d5af27087f3672c1ab270fb5291f9587316065c003ed4ee5b1063d5007",
+			},
+		};
+		const char* names[2][3] = { { "C.5.1", "C.5.2", "C.5.3" }, { "C.6.1", "C.6.2", "C.6.3" } };
+		int k = huffman ? 1 : 0;
+
+		// the examples assume SETTINGS_HEADER_TABLE_SIZE of 256; a size update (RFC 7541, 6.3) brings the table down from the default 4096
+		hpack::Decoder decoder;
+		decoder.setMaxAllowedTableSize( 256 );
+		checkBlock( decoder, "size update to 256", "3fe101", {}, {}, 0 );
+		check( decoder.getTable().getMaxSize() == 256, "dynamic table max size", "size update to 256" );
+		auto tooLarge = fromHex( "3fe201" ); // 257
+		check( !decoder.decode( tooLarge.data(), tooLarge.size(), []( const nodecpp::string&, const nodecpp::string& ) {} ), "size update above SETTINGS_HEADER_TABLE_SIZE is rejected", "size update to 257" );
+		check( decoder.getTable().getMaxSize() == 256, "rejected size update leaves the table as is", "size update to 257" );
+
+		checkBlock( decoder, names[k][0], blocks[k][0],
+			{ { ":status", "302" }, { "cache-control", "private" }, { "date", date21 }, { "location", location } },
+			{ { "location", location }, { "date", date21 }, { "cache-control", "private" }, { ":status", "302" } }, 222 );
+		// ":status: 302" is evicted to make room for ":status: 307"
+		checkBlock( decoder, names[k][1], blocks[k][1],
+			{ { ":status", "307" }, { "cache-control", "private" }, { "date", date21 }, { "location", location } },
+			{ { ":status", "307" }, { "location", location }, { "date", date21 }, { "cache-control", "private" } }, 222 );
+		// several entries are evicted, including one that the block itself has just referenced
+		checkBlock( decoder, names[k][2], blocks[k][2],
+			{ { ":status", "200" }, { "cache-control", "private" }, { "date", date22 }, { "location", location }, { "content-encoding", "gzip" }, { "set-cookie", cookie } },
+			{ { "set-cookie", cookie }, { "content-encoding", "gzip" }, { "date", date22 } }, 215 );
+	}
+
+	void testEncoder()
+	{
+		// Encoder never indexes, so its output must decode back with an empty dynamic table
+		hpack::Encoder encoder;
+		nodecpp::Buffer b;
+		encoder.encodeStatus( 200, b );
+		encoder.encodeStatus( 302, b );
+		encoder.encode( "cache-control", "private", b );
+		encoder.encode( "accept-encoding", "gzip, deflate", b );
+		encoder.encode( "x-custom", "custom-value", b );
+		hpack::Decoder decoder;
+		size_t i = 0;
+		Field expected[] = { { ":status", "200" }, { ":status", "302" }, { "cache-control", "private" }, { "accept-encoding", "gzip, deflate" }, { "x-custom", "custom-value" } };
+		bool ok = decoder.decode( b.begin(), b.size(), [&]( const nodecpp::string& name, const nodecpp::string& value ) {
+			check( i < 5 && same( name, expected[i].name ) && same( value, expected[i].value ), "header field", "encoder round trip" );
+			++i;
+		} );
+		check( ok && i == 5, "block is decoded", "encoder round trip" );
+		check( decoder.getTable().size() == 0, "dynamic table stays empty", "encoder round trip" );
+	}
+
+} // anonymous namespace
+
+int main( int argc, char *argv_[] )
+{
+	for ( int i=0; i<argc; ++i )
+		argv.push_back( argv_[i] );
+
+	testIntegers();
+	testHuffman();
+	testFieldRepresentations();
+	testRequests( false );
+	testRequests( true );
+	testResponses( false );
+	testResponses( true );
+	testEncoder();
+
+	fprintf( stderr, "hpack: %zu checks, %zu failed\n", checks, failures );
+	return (int)failures;
+}
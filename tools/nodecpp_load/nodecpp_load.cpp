@@ -0,0 +1,538 @@
+/* -------------------------------------------------------------------------------
+* Copyright (c) 2021, OLogN Technologies AG
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*     * Neither the name of the OLogN Technologies AG nor the
+*       names of its contributors may be used to endorse or promote products
+*       derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL OLogN Technologies AG BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+* -------------------------------------------------------------------------------*/
+
+// A load generator for the sample servers (samples/tcp_server, samples/http_server); see run_loopback.sh to run both in one go.
+//
+// Each step of a sweep opens a number of connections and sends requests over them either
+//   - closed loop (-r 0): every connection keeps <depth> requests in flight, sending the next one as soon as a response comes; or
+//   - open loop (-r <rate>): requests are scheduled at a constant total rate, round robin over connections, regardless of responses;
+//     a request that cannot be sent in time (all <depth> slots of its connection are busy) waits, and its latency is counted
+//     from the time it was scheduled at, not from the time it was sent (that is, without coordinated omission).
+// Service time (from actually sending to getting the response) is reported as well; with an open loop it is what a
+// load generator suffering from coordinated omission would report as latency.
+//
+// usage: nodecpp_load [-m http|tcp] [-a <ip>] [-p <port>] [-c <connections, e.g. 1,16,256>] [-r <total rates, requests/s; 0 for closed loop, e.g. 0,10000>]
+//                     [-d <requests in flight per connection (pipelining), http only>] [-t <measured seconds per step>] [-w <warm-up seconds per step>]
+//                     [-u <path, http>] [-s <request size, tcp, 2..255>] [-q <response size, tcp, 1..255>] [-o <json file>]
+
+#include <nodecpp/common.h>
+#include <nodecpp/socket_common.h>
+#include <nodecpp/timers.h>
+#include <nodecpp/metrics.h>
+
+#include <infrastructure.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace nodecpp;
+
+class LoadGenerator : public NodeBase
+{
+	enum class Protocol { http, tcp };
+
+	struct Options
+	{
+		Protocol protocol = Protocol::http;
+		nodecpp::stdstring ip = "127.0.0.1";
+		uint16_t port = 2000;
+		nodecpp::vector<size_t> connections = { 16 };
+		nodecpp::vector<uint64_t> rates = { 0 };
+		size_t depth = 1;
+		uint64_t durationMks = 10000000;
+		uint64_t warmupMks = 2000000;
+		nodecpp::stdstring path = "/?value=hello";
+		size_t requestSize = 2;
+		size_t responseSize = 1;
+		nodecpp::stdstring jsonFile;
+	};
+	Options options;
+
+	static constexpr uint64_t tickMs = 1;
+	static constexpr uint64_t drainLimitMks = 5000000; // for responses still due at the end of a step
+
+	struct InFlight
+	{
+		uint64_t intendedAt;
+		uint64_t sentAt;
+	};
+
+	struct Connection
+	{
+		size_t idx = 0;
+		nodecpp::owning_ptr<net::SocketBase> sock;
+		bool connected = false;
+		uint64_t scheduled = 0; // requests sent so far (open loop: the next one is due at intendedAt( scheduled ))
+		nodecpp::vector<InFlight> inFlight; // oldest first
+		Buffer out;
+		// response parsing
+		Buffer in; // an incomplete response head (http), if any
+		uint64_t bodyRemaining = 0;
+		bool inBody = false;
+		bool responseOk = true;
+		size_t received = 0; // bytes of the current response (tcp)
+	};
+
+	struct Step
+	{
+		size_t connections = 0;
+		uint64_t rate = 0; // 0 for closed loop
+		uint64_t startedAt = 0;
+		uint64_t measureFrom = 0;
+		uint64_t endsAt = 0;
+		uint64_t completed = 0;
+		uint64_t errors = 0; // non-2xx responses (http) and connections closed by the server
+		uint64_t unfinished = 0; // due, but not responded to within drainLimitMks
+		metrics::HistogramSnapshot latency; // mks from the scheduled time
+		metrics::HistogramSnapshot service; // mks from the time the request was sent
+	};
+
+	nodecpp::vector<Step> results;
+	size_t stepIdx = 0;
+	Step step;
+	nodecpp::vector<Connection> conns;
+	nodecpp::vector<nodecpp::owning_ptr<net::SocketBase>> retired; // sockets of finished steps, till the end of the run
+	size_t connectedCnt = 0;
+	bool measuring = false;
+	Buffer request;
+	nodecpp::Timeout ticker;
+
+	static void record( metrics::HistogramSnapshot& h, uint64_t v )
+	{
+		++h.counts[ metrics::Histogram::bucketIdx( v ) ];
+		++h.count;
+		h.sum += v;
+		if ( v > h.max )
+			h.max = v;
+	}
+
+	static bool parseList( const nodecpp::stdstring& s, auto& list )
+	{
+		list.clear();
+		const char* p = s.c_str();
+		while ( *p )
+		{
+			char* end;
+			list.push_back( strtoull( p, &end, 10 ) );
+			if ( end == p || ( *end != ',' && *end != 0 ) )
+				return false;
+			p = *end ? end + 1 : end;
+		}
+		return list.size() != 0;
+	}
+
+	bool parseOptions()
+	{
+		auto argv = getArgv();
+		for ( size_t i=1; i<argv.size(); ++i )
+		{
+			if ( i + 1 >= argv.size() )
+				return false;
+			const nodecpp::stdstring& key = argv[i];
+			const nodecpp::stdstring& value = argv[++i];
+			if ( key == "-m" && ( value == "http" || value == "tcp" ) )
+				options.protocol = value == "http" ? Protocol::http : Protocol::tcp;
+			else if ( key == "-a" )
+				options.ip = value;
+			else if ( key == "-p" )
+				options.port = (uint16_t)atoi( value.c_str() );
+			else if ( key == "-c" )
+			{
+				if ( !parseList( value, options.connections ) )
+					return false;
+			}
+			else if ( key == "-r" )
+			{
+				if ( !parseList( value, options.rates ) )
+					return false;
+			}
+			else if ( key == "-d" )
+				options.depth = atoi( value.c_str() );
+			else if ( key == "-t" )
+				options.durationMks = (uint64_t)( atof( value.c_str() ) * 1000000 );
+			else if ( key == "-w" )
+				options.warmupMks = (uint64_t)( atof( value.c_str() ) * 1000000 );
+			else if ( key == "-u" )
+				options.path = value;
+			else if ( key == "-s" )
+				options.requestSize = atoi( value.c_str() );
+			else if ( key == "-q" )
+				options.responseSize = atoi( value.c_str() );
+			else if ( key == "-o" )
+				options.jsonFile = value;
+			else
+				return false;
+		}
+		for ( size_t c : options.connections )
+			if ( c == 0 )
+				return false;
+		if ( options.protocol == Protocol::tcp ) // the sample server takes each 'data' event for a single request, so requests must not be coalesced
+			options.depth = 1;
+		return options.depth != 0 && options.durationMks != 0 && options.port != 0 &&
+			options.requestSize >= 2 && options.requestSize <= 255 && options.responseSize >= 1 && options.responseSize <= 255;
+	}
+
+	void prepareRequest()
+	{
+		request.clear();
+		if ( options.protocol == Protocol::http )
+		{
+			request.appendString( nodecpp::format( "GET {} HTTP/1.1\r\nHost: {}:{}\r\n\r\n", options.path.c_str(), options.ip.c_str(), options.port ) );
+		}
+		else // see samples/tcp_server: [request size][response size][padding]
+		{
+			request.appendUint8( (uint8_t)options.requestSize );
+			request.appendUint8( (uint8_t)options.responseSize );
+			for ( size_t i=2; i<options.requestSize; ++i )
+				request.appendUint8( 0 );
+		}
+	}
+
+	uint64_t intendedAt( const Connection& c, uint64_t n ) const { // open loop
+		return step.startedAt + (uint64_t)( ( c.idx + n * step.connections ) * 1e6 / step.rate );
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////////
+
+	void startStep()
+	{
+		size_t cIdx = stepIdx / options.rates.size();
+		if ( cIdx >= options.connections.size() )
+		{
+			report();
+			return; // nothing is left refed, so the loop exits
+		}
+		step = Step();
+		step.connections = options.connections[ cIdx ];
+		step.rate = options.rates[ stepIdx % options.rates.size() ];
+		measuring = false;
+		connectedCnt = 0;
+		for ( auto& c : conns )
+			retired.push_back( std::move( c.sock ) );
+		conns.clear();
+		conns.resize( step.connections );
+		for ( size_t i=0; i<conns.size(); ++i )
+		{
+			size_t thisStep = stepIdx;
+			Connection& c = conns[i];
+			c.idx = i;
+			c.sock = net::createSocket();
+			c.sock->on( event::connect, [this, thisStep, i]() {
+				if ( thisStep != stepIdx )
+					return;
+				conns[i].connected = true;
+				conns[i].sock->setNoDelay( true );
+				if ( ++connectedCnt == conns.size() )
+					beginMeasurement();
+			});
+			c.sock->on( event::data, [this, thisStep, i]( const Buffer& buffer ) {
+				if ( thisStep == stepIdx && measuring )
+					onData( conns[i], buffer.begin(), buffer.size() );
+			});
+			c.sock->on( event::close, [this, thisStep, i]( bool ) {
+				if ( thisStep != stepIdx )
+					return;
+				if ( !measuring )
+				{
+					printf( "connection #%zu has failed; is there a server at %s:%d?\n", i, options.ip.c_str(), options.port );
+					abortRun( i );
+					return;
+				}
+				conns[i].connected = false;
+				++step.errors;
+			});
+			c.sock->connect( options.port, options.ip.c_str() );
+		}
+	}
+
+	void beginMeasurement()
+	{
+		measuring = true;
+		step.startedAt = infraGetCurrentTime();
+		step.measureFrom = step.startedAt + options.warmupMks;
+		step.endsAt = step.measureFrom + options.durationMks;
+		tick();
+	}
+
+	void tick()
+	{
+		uint64_t now = infraGetCurrentTime();
+		bool drained = true;
+		for ( auto& c : conns )
+		{
+			if ( !c.connected )
+				continue;
+			pump( c, now );
+			if ( c.inFlight.size() || ( step.rate && intendedAt( c, c.scheduled ) < step.endsAt ) )
+				drained = false;
+		}
+		if ( now >= step.endsAt && ( drained || now >= step.endsAt + drainLimitMks ) )
+		{
+			finishStep();
+			return;
+		}
+		ticker = nodecpp::setTimeout( [this]() { tick(); }, tickMs );
+	}
+
+	// sends whatever is due and fits
+	void pump( Connection& c, uint64_t now )
+	{
+		while ( c.inFlight.size() < options.depth )
+		{
+			uint64_t intended = now;
+			if ( step.rate )
+			{
+				intended = intendedAt( c, c.scheduled );
+				if ( intended > now || intended >= step.endsAt )
+					break;
+			}
+			else if ( now >= step.endsAt )
+				break;
+			c.out.append( request.begin(), request.size() );
+			c.inFlight.push_back( InFlight{ intended, now } );
+			++c.scheduled;
+		}
+		if ( c.out.size() )
+		{
+			c.sock->write( c.out );
+			c.out.clear();
+		}
+	}
+
+	void onResponse( Connection& c, bool ok )
+	{
+		if ( c.inFlight.size() == 0 ) // e.g. 'goodbye!' from the tcp sample
+			return;
+		InFlight rq = c.inFlight.front();
+		c.inFlight.erase( c.inFlight.begin() );
+		uint64_t now = infraGetCurrentTime();
+		if ( rq.intendedAt >= step.measureFrom && rq.intendedAt < step.endsAt )
+		{
+			record( step.latency, now - rq.intendedAt );
+			record( step.service, now - rq.sentAt );
+			++step.completed;
+			if ( !ok )
+				++step.errors;
+		}
+		pump( c, now );
+	}
+
+	void onData( Connection& c, const uint8_t* data, size_t size )
+	{
+		if ( options.protocol == Protocol::tcp )
+		{
+			c.received += size;
+			while ( c.received >= options.responseSize && c.inFlight.size() )
+			{
+				c.received -= options.responseSize;
+				onResponse( c, true );
+			}
+			return;
+		}
+
+		if ( c.in.size() ) // the rest of a head that has come in pieces
+		{
+			c.in.append( data, size );
+			Buffer pending = std::move( c.in );
+			c.in = Buffer();
+			parseHttp( c, pending.begin(), pending.size() );
+		}
+		else
+			parseHttp( c, data, size );
+	}
+
+	static size_t findHeadEnd( const uint8_t* p, size_t size ) // the offset right after "\r\n\r\n", or 0
+	{
+		for ( size_t i=3; i<size; ++i )
+			if ( p[i] == '\n' && p[i-1] == '\r' && p[i-2] == '\n' && p[i-3] == '\r' )
+				return i + 1;
+		return 0;
+	}
+
+	static uint64_t parseContentLength( const uint8_t* head, size_t size )
+	{
+		static constexpr char name[] = "content-length:";
+		static constexpr size_t nameLen = sizeof( name ) - 1;
+		for ( size_t i=0; i + nameLen < size; ++i )
+		{
+			if ( i != 0 && head[i-1] != '\n' )
+				continue;
+			size_t j = 0;
+			while ( j < nameLen && ( head[i+j] | 0x20 ) == (uint8_t)name[j] )
+				++j;
+			if ( j == nameLen )
+				return strtoull( (const char*)head + i + nameLen, nullptr, 10 ); // stops at "\r\n"
+		}
+		return 0;
+	}
+
+	void parseHttp( Connection& c, const uint8_t* data, size_t size )
+	{
+		while ( size )
+		{
+			if ( c.inBody )
+			{
+				size_t n = std::min<uint64_t>( c.bodyRemaining, size );
+				c.bodyRemaining -= n;
+				data += n;
+				size -= n;
+				if ( c.bodyRemaining )
+					return;
+				c.inBody = false;
+				onResponse( c, c.responseOk );
+				continue;
+			}
+			size_t headSize = findHeadEnd( data, size );
+			if ( headSize == 0 )
+			{
+				c.in.append( data, size );
+				return;
+			}
+			c.responseOk = headSize > 9 && memcmp( data, "HTTP/1.", 7 ) == 0 && data[9] == '2';
+			c.bodyRemaining = parseContentLength( data, headSize );
+			c.inBody = true;
+			data += headSize;
+			size -= headSize;
+			if ( c.bodyRemaining == 0 )
+			{
+				c.inBody = false;
+				onResponse( c, c.responseOk );
+			}
+		}
+	}
+
+	void finishStep()
+	{
+		measuring = false;
+		for ( auto& c : conns )
+		{
+			if ( step.rate )
+				while ( intendedAt( c, c.scheduled ) < step.endsAt )
+					if ( intendedAt( c, c.scheduled++ ) >= step.measureFrom )
+						++step.unfinished;
+			for ( auto& rq : c.inFlight )
+				if ( rq.intendedAt >= step.measureFrom && rq.intendedAt < step.endsAt )
+					++step.unfinished;
+			if ( c.connected )
+				c.sock->end();
+		}
+		printStep( step );
+		results.push_back( step );
+		++stepIdx;
+		startStep();
+	}
+
+	void abortRun( size_t failed )
+	{
+		stepIdx = options.connections.size() * options.rates.size(); // events of this step are ignored from now on
+		for ( size_t i=0; i<conns.size(); ++i )
+			if ( i != failed && ( conns[i].connected || conns[i].sock->connecting() ) )
+				conns[i].sock->destroy();
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////////
+
+	static double ms( uint64_t mks ) { return mks / 1000.; }
+
+	void printHeader()
+	{
+		printf( "%s to %s:%d, %zu in flight per connection, %.1f s (+%.1f s warm-up) per step\n",
+			options.protocol == Protocol::http ? "http" : "tcp", options.ip.c_str(), options.port, options.depth, options.durationMks / 1e6, options.warmupMks / 1e6 );
+		printf( "%6s %9s %10s %9s %9s %9s %9s %9s | %9s %9s %7s %7s\n",
+			"conns", "target/s", "done/s", "p50,ms", "p99,ms", "p999,ms", "max,ms", "mean,ms", "svc p50", "svc p99", "errors", "unfin" );
+	}
+
+	void printStep( const Step& s )
+	{
+		char target[32];
+		if ( s.rate )
+			snprintf( target, sizeof( target ), "%llu", (unsigned long long)s.rate );
+		else
+			snprintf( target, sizeof( target ), "closed" );
+		double done = s.completed * 1e6 / options.durationMks;
+		printf( "%6zu %9s %10.0f %9.3f %9.3f %9.3f %9.3f %9.3f | %9.3f %9.3f %7llu %7llu%s\n",
+			s.connections, target, done,
+			ms( s.latency.percentile( 0.5 ) ), ms( s.latency.percentile( 0.99 ) ), ms( s.latency.percentile( 0.999 ) ), ms( s.latency.max ), ms( s.latency.mean() ),
+			ms( s.service.percentile( 0.5 ) ), ms( s.service.percentile( 0.99 ) ),
+			(unsigned long long)s.errors, (unsigned long long)s.unfinished,
+			s.rate && done < s.rate * 0.95 ? "  (saturated)" : "" );
+		fflush( stdout );
+	}
+
+	static void writeHistogramJson( FILE* f, const char* name, const metrics::HistogramSnapshot& h )
+	{
+		fprintf( f, "\"%s\": { \"p50\": %llu, \"p90\": %llu, \"p99\": %llu, \"p999\": %llu, \"max\": %llu, \"mean\": %llu }", name,
+			(unsigned long long)h.percentile( 0.5 ), (unsigned long long)h.percentile( 0.9 ), (unsigned long long)h.percentile( 0.99 ),
+			(unsigned long long)h.percentile( 0.999 ), (unsigned long long)h.max, (unsigned long long)h.mean() );
+	}
+
+	void report()
+	{
+		if ( options.jsonFile.size() == 0 )
+			return;
+		FILE* f = fopen( options.jsonFile.c_str(), "w" );
+		if ( f == nullptr )
+		{
+			printf( "cannot open '%s'\n", options.jsonFile.c_str() );
+			return;
+		}
+		fprintf( f, "{\n\"tool\": \"nodecpp_load\",\n\"protocol\": \"%s\",\n\"target\": \"%s:%d\",\n\"depth\": %zu,\n\"duration_s\": %.3f,\n\"warmup_s\": %.3f,\n\"steps\": [\n",
+			options.protocol == Protocol::http ? "http" : "tcp", options.ip.c_str(), options.port, options.depth, options.durationMks / 1e6, options.warmupMks / 1e6 );
+		for ( size_t i=0; i<results.size(); ++i )
+		{
+			const Step& s = results[i];
+			fprintf( f, "  { \"connections\": %zu, \"mode\": \"%s\", \"target_rps\": %llu, \"achieved_rps\": %.1f, \"requests\": %llu, \"errors\": %llu, \"unfinished\": %llu, ",
+				s.connections, s.rate ? "open" : "closed", (unsigned long long)s.rate, s.completed * 1e6 / options.durationMks,
+				(unsigned long long)s.completed, (unsigned long long)s.errors, (unsigned long long)s.unfinished );
+			writeHistogramJson( f, "latency_us", s.latency );
+			fprintf( f, ", " );
+			writeHistogramJson( f, "service_us", s.service );
+			fprintf( f, " }%s\n", i + 1 < results.size() ? "," : "" );
+		}
+		fprintf( f, "]\n}\n" );
+		fclose( f );
+	}
+
+public:
+	nodecpp::handler_ret_type main()
+	{
+		if ( !parseOptions() )
+		{
+			printf( "usage: nodecpp_load [-m http|tcp] [-a <ip>] [-p <port>] [-c <connections, e.g. 1,16,256>] [-r <total rates, requests/s; 0 for closed loop, e.g. 0,10000>]\n"
+				"                    [-d <requests in flight per connection, http>] [-t <measured seconds per step>] [-w <warm-up seconds per step>]\n"
+				"                    [-u <path, http>] [-s <request size, tcp, 2..255>] [-q <response size, tcp, 1..255>] [-o <json file>]\n" );
+			CO_RETURN;
+		}
+		prepareRequest();
+		printHeader();
+		startStep();
+		CO_RETURN;
+	}
+};
+
+static NodeRegistrator<Runnable<LoadGenerator>> noname( "LoadGenerator" );
@@ -0,0 +1,44 @@
+#!/bin/bash
+# Starts a sample server (samples/http_server or samples/tcp_server, as built at <build dir>), runs nodecpp_load against it
+# over loopback, and stops the server. Options after the protocol go to nodecpp_load as they are.
+#
+# usage: run_loopback.sh <build dir> [http|tcp] [nodecpp_load options]
+# e.g.:  run_loopback.sh build http -c 1,16,256 -r 0 -d 8
+#        run_loopback.sh build tcp -c 16 -r 0,20000,50000 -o tcp.json
+
+if [ "$#" -lt 1 ]; then
+	echo "usage: $0 <build dir> [http|tcp] [nodecpp_load options]"
+	exit 2
+fi
+build=$1
+proto=${2:-http}
+shift 2 2>/dev/null || shift
+
+case $proto in
+	http) server=$build/samples/HttpServerSample ;;
+	tcp) server=$build/samples/TcpServerSample ;;
+	*) echo "unknown protocol: $proto"; exit 2 ;;
+esac
+load=$build/nodecpp_load
+for f in "$server" "$load"; do
+	if [ ! -x "$f" ]; then
+		echo "$f not found; build the tree with NODECPP_TEST on"
+		exit 2
+	fi
+done
+
+"$server" > /dev/null &
+pid=$!
+trap 'kill $pid 2> /dev/null; wait $pid 2> /dev/null' EXIT
+
+# both samples listen at 127.0.0.1:2000
+for i in $(seq 50); do
+	(exec 3<> /dev/tcp/127.0.0.1/2000) 2> /dev/null && break
+	if ! kill -0 $pid 2> /dev/null; then
+		echo "$server has exited"
+		exit 1
+	fi
+	sleep 0.1
+done
+
+"$load" -m "$proto" -a 127.0.0.1 -p 2000 "$@"
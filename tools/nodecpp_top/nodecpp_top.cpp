@@ -0,0 +1,179 @@
+/* -------------------------------------------------------------------------------
+* Copyright (c) 2021, OLogN Technologies AG
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*     * Neither the name of the OLogN Technologies AG nor the
+*       names of its contributors may be used to endorse or promote products
+*       derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL OLogN Technologies AG BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+* -------------------------------------------------------------------------------*/
+
+// A top-like view of a running node.cpp process.
+// The region published by the process (see metrics::Options::shmPeriodMs) is mapped read-only; nothing reaches the process itself.
+//
+// usage: nodecpp_top <pid> | -n <shm name> [-i <refresh period, ms>] [-1]
+
+#include <nodecpp/metrics_shm.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+using namespace nodecpp::metrics;
+
+static uint64_t monotonicMks()
+{
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void usage()
+{
+	fprintf( stderr, "usage: nodecpp_top <pid> | -n <shm name> [-i <refresh period, ms>] [-1]\n" );
+	exit( 2 );
+}
+
+struct Prev
+{
+	bool valid = false;
+	shm::ThreadData data;
+};
+
+static double perSec( uint64_t now, uint64_t prev, uint64_t deltaMks )
+{
+	return deltaMks ? ( now - prev ) * 1e6 / deltaMks : 0;
+}
+
+static void printRow( const char* role, const char* instance, const shm::ThreadData& d, const shm::ThreadData& p, uint64_t deltaMks )
+{
+	using namespace shm;
+	uint64_t busy = d.values[busyMks] - p.values[busyMks];
+	uint64_t total = busy + d.values[waitMks] - p.values[waitMks];
+	uint64_t requests = d.values[httpRequests] - p.values[httpRequests];
+	printf( "%-9s%-6s%6.1f%% %10.0f %8llu %9.0f %10.2f %10.2f %9.0f %8.3f %9.0f %8.0f\n",
+		role, instance, total ? busy * 100.0 / total : 0., 
+		perSec( d.values[iterations], p.values[iterations], deltaMks ), 
+		(unsigned long long)d.values[openSockets], 
+		perSec( d.values[connectionsAccepted], p.values[connectionsAccepted], deltaMks ), 
+		perSec( d.values[bytesIn], p.values[bytesIn], deltaMks ) / ( 1024 * 1024 ), 
+		perSec( d.values[bytesOut], p.values[bytesOut], deltaMks ) / ( 1024 * 1024 ), 
+		perSec( d.values[httpRequests], p.values[httpRequests], deltaMks ), 
+		requests ? ( d.values[httpRequestMks] - p.values[httpRequestMks] ) / 1000.0 / requests : 0., 
+		perSec( d.values[interThreadMsgs], p.values[interThreadMsgs], deltaMks ), 
+		perSec( d.values[timersFired], p.values[timersFired], deltaMks ) );
+}
+
+int main( int argc, char** argv )
+{
+	char name[64] = {};
+	unsigned periodMs = 1000;
+	bool once = false;
+	for ( int i=1; i<argc; ++i )
+	{
+		if ( strcmp( argv[i], "-n" ) == 0 && i + 1 < argc )
+			snprintf( name, sizeof(name), "%s", argv[++i] );
+		else if ( strcmp( argv[i], "-i" ) == 0 && i + 1 < argc )
+			periodMs = (unsigned)atoi( argv[++i] );
+		else if ( strcmp( argv[i], "-1" ) == 0 )
+			once = true;
+		else if ( argv[i][0] != '-' && name[0] == 0 )
+			shm::defaultName( name, sizeof(name), atoi( argv[i] ) );
+		else
+			usage();
+	}
+	if ( name[0] == 0 || periodMs == 0 )
+		usage();
+
+	int fd = shm_open( name, O_RDONLY, 0 );
+	if ( fd < 0 )
+	{
+		fprintf( stderr, "cannot open \"%s\" (is shmPeriodMs set for the process?)\n", name );
+		return 1;
+	}
+	void* ptr = mmap( nullptr, sizeof(shm::Region), PROT_READ, MAP_SHARED, fd, 0 );
+	close( fd );
+	if ( ptr == MAP_FAILED )
+	{
+		fprintf( stderr, "cannot map \"%s\"\n", name );
+		return 1;
+	}
+	const shm::Region& region = *reinterpret_cast<const shm::Region*>( ptr );
+	if ( !shm::isCompatible( region.header ) )
+	{
+		fprintf( stderr, "\"%s\" has incompatible layout (version %u vs. %u expected)\n", name, region.header.version, shm::version );
+		return 1;
+	}
+	uint64_t staleMks = (uint64_t)region.header.periodMs * 1000 * 5; // a record not updated for that long belongs to a thread that is gone (or stuck)
+
+	static Prev prev[shm::maxThreads];
+	for ( bool firstPass = true;; firstPass = false ) // rates need two samples, so nothing is shown at the first pass
+	{
+		if ( !once && !firstPass )
+			printf( "\033[H\033[2J" );
+		uint64_t now = monotonicMks();
+		if ( !firstPass )
+		{
+			printf( "pid %d (%s), published every %u ms\n\n", region.header.pid, name, region.header.periodMs );
+			printf( "%-9s%-6s%7s %10s %8s %9s %10s %10s %9s %8s %9s %8s\n", "role", "id", "busy", "iter/s", "sockets", "accept/s", "rx MiB/s", "tx MiB/s", "req/s", "req ms", "itc/s", "timer/s" );
+		}
+		shm::ThreadData totalNow = {}, totalPrev = {};
+		uint64_t maxDeltaMks = 0;
+		for ( size_t i=0; i<shm::maxThreads; ++i )
+		{
+			shm::ThreadData d;
+			if ( !shm::read( region.threads[i], d ) || now > d.publishedAt + staleMks )
+			{
+				prev[i].valid = false;
+				continue;
+			}
+			const shm::ThreadData& p = prev[i].valid ? prev[i].data : d;
+			uint64_t deltaMks = d.publishedAt - p.publishedAt;
+			char instance[16];
+			snprintf( instance, sizeof(instance), "%u", d.instanceId );
+			if ( !firstPass )
+				printRow( d.role < sizeof(shm::roleNames) / sizeof(shm::roleNames[0]) ? shm::roleNames[d.role] : "?", instance, d, p, deltaMks );
+			for ( size_t f=0; f<shm::fieldCnt; ++f )
+			{
+				totalNow.values[f] += d.values[f];
+				totalPrev.values[f] += p.values[f];
+			}
+			if ( deltaMks > maxDeltaMks )
+				maxDeltaMks = deltaMks;
+			prev[i].data = d;
+			prev[i].valid = true;
+		}
+		if ( !firstPass )
+		{
+			printf( "\n" );
+			printRow( "total", "", totalNow, totalPrev, maxDeltaMks ); // loops publish independently, so rates of the total are approximate
+			fflush( stdout );
+			if ( once )
+				break;
+		}
+		usleep( periodMs * 1000 );
+	}
+	munmap( ptr, sizeof(shm::Region) );
+	return 0;
+}